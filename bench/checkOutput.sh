@@ -0,0 +1,81 @@
+#!/bin/sh
+#
+# Checks that conversions which must agree do, on small synthetic traces.
+#
+# Usage: checkOutput.sh <generateTrace> <lttng2prv>
+#
+# Each check converts a generated trace with two sets of arguments and
+# fails if the .prv, past its header line and its date, the .pcf or the
+# .row differ. Both runs leave out the thread cache, so neither reuses the
+# first pass of the other. Traces go to CHECK_DIR, made again every run.
+
+GENERATE=${1:-./generateTrace}
+LTTNG2PRV=${2:-../src/lttng2prv}
+
+CHECK_DIR=${CHECK_DIR:-check-traces}
+
+status=0
+
+# same_output <name> <trace> <arguments> <reference arguments>
+same_output()
+{
+        out="$CHECK_DIR/out/$1"
+        failed=0
+
+        if ! "$LTTNG2PRV" --no-cache $3 -o "$out" "$2" > /dev/null ||
+            ! "$LTTNG2PRV" --no-cache $4 -o "$out.ref" "$2" > /dev/null; then
+                echo "FAIL: $1: conversion failed" >&2
+                status=1
+                return
+        fi
+        tail -n +2 "$out.prv" > "$out.body"
+        tail -n +2 "$out.ref.prv" > "$out.ref.body"
+        for ext in body pcf row; do
+                if ! cmp -s "$out.$ext" "$out.ref.$ext"; then
+                        echo "FAIL: $1: .$ext with \"$3\" differs from" \
+                            "\"$4\"" >&2
+                        failed=1
+                fi
+        done
+        if [ $failed -eq 0 ]; then
+                echo "PASS: $1"
+                rm -f "$out".*
+        else
+                status=1
+        fi
+}
+
+rm -rf "$CHECK_DIR"
+mkdir -p "$CHECK_DIR/out" || exit 1
+
+# A kernel and a UST trace: the UST events of a CPU run in the application
+# the kernel stream of that CPU switched to, whichever job reads them
+"$GENERATE" -o "$CHECK_DIR/session" --ust --cpus=4 --size=4M \
+    > /dev/null || exit 1
+same_output session-jobs "$CHECK_DIR/session" "-j 2" ""
+
+# Timestamps rounded to 1us, so that events of several CPUs tie: the jobs
+# must break the ties like babeltrace does without them
+"$GENERATE" -o "$CHECK_DIR/ties" --cpus=4 --tick=1000 --size=4M \
+    > /dev/null || exit 1
+same_output ties-jobs "$CHECK_DIR/ties" "-j 2" ""
+same_output ties-jobs3 "$CHECK_DIR/ties" "-j 3" ""
+
+# The native decoder against babeltrace, large headers and lost events
+# included
+"$GENERATE" -o "$CHECK_DIR/native" --cpus=4 --size=4M --large-header \
+    --lost-every=5 > /dev/null || exit 1
+same_output native "$CHECK_DIR/native" "--decoder=native" \
+    "--decoder=babeltrace"
+same_output session-native "$CHECK_DIR/session" "--decoder=native" \
+    "--decoder=babeltrace"
+same_output native-states "$CHECK_DIR/native" \
+    "--decoder=native --state-records" "--decoder=babeltrace --state-records"
+
+# --single-pass spools the body and learns the threads, IRQs and CPUs as it
+# goes: the trace it writes must be the one of the two passes
+same_output single-pass "$CHECK_DIR/native" "--single-pass" ""
+same_output ties-single-pass "$CHECK_DIR/ties" "--single-pass" ""
+same_output session-single-pass "$CHECK_DIR/session" "--single-pass" ""
+
+exit $status
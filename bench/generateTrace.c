@@ -0,0 +1,998 @@
+/*
+ * Synthetic LTTng kernel trace generator for the benchmarks.
+ *
+ * Writes a CTF trace laid out like the ones of lttng-modules: the same
+ * metadata declarations, compact or large event headers, per-CPU streams
+ * with a cpu_id and an events_discarded counter in the packet context and
+ * the fields lttng2prv reads. Events follow a simple model of a machine
+ * running a set of processes: a statedump, then on every CPU a mix of
+ * system calls, interrupts, softirqs and scheduling. With --ust the
+ * threads also log to a UST trace next to the kernel one, like in the
+ * session directory of lttng.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <popt.h>
+
+#define PACKET_MAGIC 0xC1FC1FC1
+/* packet header and context, see write_metadata() */
+#define PACKET_HEADER_SIZE 68
+#define DEFAULT_PACKET_SIZE (256 << 10)
+#define DEFAULT_SIZE (64 << 20)
+/* timestamps are counted from here, in ns */
+#define TRACE_START 1000000000ULL
+#define CLOCK_OFFSET 1400000000000000000ULL
+#define THREADS_PER_PROCESS 4
+#define COMM_LEN 16
+
+/* Field types of the event declarations */
+enum
+{
+        FIELD_S32 = 0,
+        FIELD_U32,
+        FIELD_S64,
+        FIELD_U64,
+        FIELD_HEX64,
+        FIELD_COMM,
+        FIELD_STRING
+};
+
+struct fieldDecl
+{
+        int type;
+        const char *name;
+};
+
+/* Ids past 30 (compact) or 65534 (large) need an extended header */
+struct eventDecl
+{
+        const char *name;
+        unsigned int id;
+        const struct fieldDecl fields[12];
+};
+
+enum
+{
+        EV_STATEDUMP_START = 0,
+        EV_STATEDUMP_END,
+        EV_STATEDUMP_PROCESS,
+        EV_SCHED_SWITCH,
+        EV_SCHED_WAKEUP,
+        EV_PROCESS_FORK,
+        EV_IRQ_ENTRY,
+        EV_IRQ_EXIT,
+        EV_SOFTIRQ_ENTRY,
+        EV_SOFTIRQ_EXIT,
+        EV_SOFTIRQ_RAISE,
+        EV_SYSCALLS
+};
+
+static const struct eventDecl events[] =
+{
+        { "lttng_statedump_start", 0, { { 0 } } },
+        { "lttng_statedump_end", 1, { { 0 } } },
+        { "lttng_statedump_process_state", 2, {
+                { FIELD_S32, "_tid" }, { FIELD_S32, "_vtid" },
+                { FIELD_S32, "_pid" }, { FIELD_S32, "_vpid" },
+                { FIELD_S32, "_ppid" }, { FIELD_S32, "_vppid" },
+                { FIELD_COMM, "_name" }, { FIELD_S32, "_type" },
+                { FIELD_S32, "_mode" }, { FIELD_S32, "_submode" },
+                { FIELD_S32, "_status" }, { 0 } } },
+        { "sched_switch", 3, {
+                { FIELD_COMM, "_prev_comm" }, { FIELD_S32, "_prev_tid" },
+                { FIELD_S32, "_prev_prio" }, { FIELD_S64, "_prev_state" },
+                { FIELD_COMM, "_next_comm" }, { FIELD_S32, "_next_tid" },
+                { FIELD_S32, "_next_prio" }, { 0 } } },
+        { "sched_wakeup", 4, {
+                { FIELD_COMM, "_comm" }, { FIELD_S32, "_tid" },
+                { FIELD_S32, "_prio" }, { FIELD_S32, "_success" },
+                { FIELD_S32, "_target_cpu" }, { 0 } } },
+        { "sched_process_fork", 5, {
+                { FIELD_COMM, "_parent_comm" }, { FIELD_S32, "_parent_tid" },
+                { FIELD_S32, "_parent_pid" }, { FIELD_COMM, "_child_comm" },
+                { FIELD_S32, "_child_tid" }, { FIELD_S32, "_child_pid" },
+                { 0 } } },
+        { "irq_handler_entry", 6, {
+                { FIELD_S32, "_irq" }, { FIELD_STRING, "_name" }, { 0 } } },
+        { "irq_handler_exit", 7, {
+                { FIELD_S32, "_irq" }, { FIELD_S32, "_ret" }, { 0 } } },
+        { "softirq_entry", 8, { { FIELD_U32, "_vec" }, { 0 } } },
+        { "softirq_exit", 9, { { FIELD_U32, "_vec" }, { 0 } } },
+        { "softirq_raise", 10, { { FIELD_U32, "_vec" }, { 0 } } },
+        /* entry and exit of each system call, numbered like lttng does */
+        { "syscall_entry_read", 100, {
+                { FIELD_U32, "_fd" }, { FIELD_HEX64, "_buf" },
+                { FIELD_U64, "_count" }, { 0 } } },
+        { "syscall_exit_read", 101, {
+                { FIELD_S64, "_ret" }, { FIELD_HEX64, "_buf" }, { 0 } } },
+        { "syscall_entry_write", 102, {
+                { FIELD_U32, "_fd" }, { FIELD_HEX64, "_buf" },
+                { FIELD_U64, "_count" }, { 0 } } },
+        { "syscall_exit_write", 103, { { FIELD_S64, "_ret" }, { 0 } } },
+        { "syscall_entry_ioctl", 104, {
+                { FIELD_U32, "_fd" }, { FIELD_U32, "_cmd" },
+                { FIELD_U64, "_arg" }, { 0 } } },
+        { "syscall_exit_ioctl", 105, {
+                { FIELD_S64, "_ret" }, { FIELD_U64, "_arg" }, { 0 } } },
+        { "syscall_entry_poll", 106, {
+                { FIELD_HEX64, "_ufds" }, { FIELD_U32, "_nfds" },
+                { FIELD_S32, "_timeout_msecs" }, { 0 } } },
+        { "syscall_exit_poll", 107, {
+                { FIELD_S64, "_ret" }, { FIELD_HEX64, "_ufds" }, { 0 } } },
+        { "syscall_entry_close", 108, { { FIELD_U32, "_fd" }, { 0 } } },
+        { "syscall_exit_close", 109, { { FIELD_S64, "_ret" }, { 0 } } }
+};
+
+#define NSYSCALLS ((sizeof(events) / sizeof(events[0]) - EV_SYSCALLS) / 2)
+
+/* Events of the UST trace */
+static const struct eventDecl ust_events[] =
+{
+        { "bench_ust:tick", 0, { { FIELD_S32, "_tid" },
+                { FIELD_U64, "_count" }, { 0 } } }
+};
+
+static const char *const irq_names[] = { "timer", "eth0", "ahci", "i915" };
+
+/* One per-CPU stream file being written */
+struct stream
+{
+        FILE *fp;
+        const struct eventDecl *decls;
+        /* UST stream of the same CPU, NULL without --ust */
+        struct stream *ust;
+        unsigned int cpu;
+        uint8_t *packet;
+        size_t pos;
+        uint64_t begin;
+        uint64_t last;
+        uint64_t discarded;
+        uint64_t packets;
+        uint64_t events;
+        uint64_t bytes;
+};
+
+struct thread
+{
+        int32_t tid;
+        int32_t pid;
+        char comm[COMM_LEN];
+};
+
+static const char *opt_output;
+static unsigned int ncpus = 4;
+static unsigned int nthreads = 64;
+static unsigned int mix[4] = { 60, 5, 10, 25 };
+static unsigned int lost_every = 0;
+static uint64_t trace_size = DEFAULT_SIZE;
+static size_t packet_size = DEFAULT_PACKET_SIZE;
+static bool large_header = false;
+static unsigned int extra_events = 0;
+static bool ust = false;
+static uint64_t tick = 1;
+static unsigned int seed = 1;
+
+static struct thread *threads;
+static unsigned int threads_len;
+static uint8_t uuid[16];
+
+enum
+{
+        OPT_NONE = 0,
+        OPT_OUTPUT,
+        OPT_CPUS,
+        OPT_THREADS,
+        OPT_MIX,
+        OPT_LOST_EVERY,
+        OPT_SIZE,
+        OPT_PACKET_SIZE,
+        OPT_LARGE_HEADER,
+        OPT_EXTRA_EVENTS,
+        OPT_UST,
+        OPT_TICK,
+        OPT_SEED
+};
+
+static struct poptOption long_options[] =
+{
+        {"output", 'o', POPT_ARG_STRING, NULL, OPT_OUTPUT,
+            "Trace directory to create", "DIR" },
+        {"cpus", 'c', POPT_ARG_STRING, NULL, OPT_CPUS,
+            "Number of CPUs, one stream each", "N" },
+        {"threads", 't', POPT_ARG_STRING, NULL, OPT_THREADS,
+            "Number of threads in the statedump", "N" },
+        {"mix", 0, POPT_ARG_STRING, NULL, OPT_MIX,
+            "Weights of system calls, IRQs, softirqs and scheduling",
+            "S,I,F,W" },
+        {"lost-every", 0, POPT_ARG_STRING, NULL, OPT_LOST_EVERY,
+            "Lose events before every Nth packet of a stream", "N" },
+        {"size", 's', POPT_ARG_STRING, NULL, OPT_SIZE,
+            "Total size of the streams, with an optional K, M or G suffix",
+            "SIZE" },
+        {"packet-size", 0, POPT_ARG_STRING, NULL, OPT_PACKET_SIZE,
+            "Size of the packets", "SIZE" },
+        {"large-header", 0, POPT_ARG_NONE, NULL, OPT_LARGE_HEADER,
+            "Use event_header_large, 16-bit event ids", NULL },
+        {"extra-events", 0, POPT_ARG_STRING, NULL, OPT_EXTRA_EVENTS,
+            "Declare N more system calls, never emitted", "N" },
+        {"ust", 0, POPT_ARG_NONE, NULL, OPT_UST,
+            "Also write a UST trace, the kernel one going to DIR/kernel",
+            NULL },
+        {"tick", 0, POPT_ARG_STRING, NULL, OPT_TICK,
+            "Round the timestamps down to N ns, for events at the same time "
+            "on several CPUs", "N" },
+        {"seed", 0, POPT_ARG_STRING, NULL, OPT_SEED,
+            "Seed of the event model", "N" },
+        POPT_AUTOHELP
+        POPT_TABLEEND
+};
+
+static int parse_options(int _argc, char **_argv);
+
+static int parse_size(const char *_arg, uint64_t *_size);
+
+static void put_bytes(struct stream *_s, const void *_data, size_t _len);
+
+static void put_uint(struct stream *_s, uint64_t _value, unsigned int _len);
+
+static void open_packet(struct stream *_s, uint64_t _timestamp);
+
+static void close_packet(struct stream *_s);
+
+static void emit(struct stream *_s, unsigned int _event, uint64_t _timestamp,
+    ...);
+
+static int make_dirs(char *_path);
+
+static void write_metadata(FILE *_fp, bool _kernel);
+
+static void create_metadata(const char *_dir, bool _kernel);
+
+static void open_stream(struct stream *_s, const char *_dir,
+    unsigned int _cpu);
+
+static void write_cpu(struct stream *_s, uint64_t _size);
+
+static unsigned int
+rnd(unsigned int n)
+{
+        return n ? (unsigned int) (random() % n) : 0;
+}
+
+static int
+parse_size(const char *arg, uint64_t *size)
+{
+        char *end;
+
+        if (arg == NULL) {
+                return -1;
+        }
+        *size = strtoull(arg, &end, 10);
+        switch (*end) {
+        case 'G':
+                *size <<= 10;
+                /* FALLTHROUGH */
+        case 'M':
+                *size <<= 10;
+                /* FALLTHROUGH */
+        case 'K':
+                *size <<= 10;
+                end++;
+                break;
+        default:
+                break;
+        }
+
+        return (end == arg || *end != '\0' || *size == 0) ? -1 : 0;
+}
+
+static void
+put_bytes(struct stream *s, const void *data, size_t len)
+{
+        memcpy(s->packet + s->pos, data, len);
+        s->pos += len;
+}
+
+/* Integers are little endian and byte aligned, like in lttng-modules */
+static void
+put_uint(struct stream *s, uint64_t value, unsigned int len)
+{
+        unsigned int i;
+
+        for (i = 0; i < len; i++) {
+                s->packet[s->pos++] = value >> (8 * i);
+        }
+}
+
+static void
+open_packet(struct stream *s, uint64_t timestamp)
+{
+        s->pos = PACKET_HEADER_SIZE;
+        s->begin = timestamp;
+        s->last = timestamp;
+        s->packets++;
+        if (lost_every > 0 && s->packets % lost_every == 0) {
+                s->discarded += 100 + rnd(900);
+        }
+}
+
+static void
+close_packet(struct stream *s)
+{
+        size_t content = s->pos;
+
+        memset(s->packet + content, 0, packet_size - content);
+        s->pos = 0;
+        /* packet header */
+        put_uint(s, PACKET_MAGIC, 4);
+        put_bytes(s, uuid, sizeof(uuid));
+        put_uint(s, 0, 4);
+        /* packet context */
+        put_uint(s, s->begin, 8);
+        put_uint(s, s->last, 8);
+        put_uint(s, content * 8, 8);
+        put_uint(s, packet_size * 8, 8);
+        put_uint(s, s->discarded, 8);
+        put_uint(s, s->cpu, 4);
+
+        if (fwrite(s->packet, packet_size, 1, s->fp) != 1) {
+                perror("fwrite");
+                exit(EXIT_FAILURE);
+        }
+        s->pos = 0;
+        s->bytes += packet_size;
+}
+
+/*
+ * Appends an event to the stream, the variable arguments are its field
+ * values in declaration order: uint64_t for integers, const char * for
+ * names and strings.
+ */
+static void
+emit(struct stream *s, unsigned int event, uint64_t timestamp, ...)
+{
+        const struct eventDecl *decl = &s->decls[event];
+        const struct fieldDecl *field;
+        uint8_t payload[256];
+        size_t len = 0, slen, header;
+        uint64_t value;
+        const char *str;
+        bool compact;
+        va_list ap;
+
+        timestamp -= timestamp % tick;
+        va_start(ap, timestamp);
+        for (field = decl->fields; field->name != NULL; field++) {
+                switch (field->type) {
+                case FIELD_COMM:
+                        str = va_arg(ap, const char *);
+                        memset(payload + len, 0, COMM_LEN);
+                        strncpy((char *) payload + len, str, COMM_LEN - 1);
+                        len += COMM_LEN;
+                        break;
+                case FIELD_STRING:
+                        str = va_arg(ap, const char *);
+                        slen = strlen(str) + 1;
+                        memcpy(payload + len, str, slen);
+                        len += slen;
+                        break;
+                default:
+                        value = va_arg(ap, uint64_t);
+                        slen = (field->type == FIELD_S32 ||
+                            field->type == FIELD_U32) ? 4 : 8;
+                        for (header = 0; header < slen; header++) {
+                                payload[len++] = value >> (8 * header);
+                        }
+                        break;
+                }
+        }
+        va_end(ap);
+
+        if (large_header) {
+                compact = decl->id < 65535 &&
+                    timestamp - s->last < (1ULL << 32);
+                header = compact ? 6 : 14;
+        } else {
+                compact = decl->id < 31 && timestamp - s->last < (1ULL << 27);
+                header = compact ? 4 : 13;
+        }
+        if (s->pos == 0 || s->pos + header + len > packet_size) {
+                if (s->pos != 0) {
+                        close_packet(s);
+                }
+                open_packet(s, timestamp);
+                compact = decl->id < (large_header ? 65535 : 31);
+        }
+
+        if (large_header && compact) {
+                put_uint(s, decl->id, 2);
+                put_uint(s, timestamp, 4);
+        } else if (large_header) {
+                put_uint(s, 65535, 2);
+                put_uint(s, decl->id, 4);
+                put_uint(s, timestamp, 8);
+        } else if (compact) {
+                /* 5-bit id then the low 27 bits of the timestamp */
+                put_uint(s, decl->id | ((timestamp & ((1 << 27) - 1)) << 5),
+                    4);
+        } else {
+                put_uint(s, 31, 1);
+                put_uint(s, decl->id, 4);
+                put_uint(s, timestamp, 8);
+        }
+        put_bytes(s, payload, len);
+
+        s->last = timestamp;
+        s->events++;
+}
+
+/* mkdir -p, _path is changed while it runs */
+static int
+make_dirs(char *path)
+{
+        char *p = path;
+
+        do {
+                p = strchr(p + 1, '/');
+                if (p != NULL) {
+                        *p = '\0';
+                }
+                if (mkdir(path, 0777) < 0 && errno != EEXIST) {
+                        perror(path);
+                        return -1;
+                }
+                if (p != NULL) {
+                        *p = '/';
+                }
+        } while (p != NULL);
+
+        return 0;
+}
+
+/* Metadata of the kernel trace or, without _kernel, of the UST one */
+static void
+write_metadata(FILE *fp, bool kernel)
+{
+        const struct eventDecl *decls = kernel ? events : ust_events;
+        unsigned int ndecls = kernel ?
+            sizeof(events) / sizeof(events[0]) :
+            sizeof(ust_events) / sizeof(ust_events[0]);
+        const struct eventDecl *decl;
+        const struct fieldDecl *field;
+        unsigned int i;
+        char uuid_str[37];
+
+        snprintf(uuid_str, sizeof(uuid_str), "%02x%02x%02x%02x-%02x%02x-"
+            "%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x", uuid[0], uuid[1],
+            uuid[2], uuid[3], uuid[4], uuid[5], uuid[6], uuid[7], uuid[8],
+            uuid[9], uuid[10], uuid[11], uuid[12], uuid[13], uuid[14],
+            uuid[15]);
+
+        fprintf(fp, "/* CTF 1.8 */\n\n"
+            "typealias integer { size = 8; align = 8; signed = false; } "
+            ":= uint8_t;\n"
+            "typealias integer { size = 16; align = 8; signed = false; } "
+            ":= uint16_t;\n"
+            "typealias integer { size = 32; align = 8; signed = false; } "
+            ":= uint32_t;\n"
+            "typealias integer { size = 64; align = 8; signed = false; } "
+            ":= uint64_t;\n"
+            "typealias integer { size = 64; align = 8; signed = false; } "
+            ":= unsigned long;\n"
+            "typealias integer { size = 5; align = 1; signed = false; } "
+            ":= uint5_t;\n"
+            "typealias integer { size = 27; align = 1; signed = false; } "
+            ":= uint27_t;\n\n"
+            "trace {\n"
+            "\tmajor = 1;\n"
+            "\tminor = 8;\n"
+            "\tuuid = \"%s\";\n"
+            "\tbyte_order = le;\n"
+            "\tpacket.header := struct {\n"
+            "\t\tuint32_t magic;\n"
+            "\t\tuint8_t  uuid[16];\n"
+            "\t\tuint32_t stream_id;\n"
+            "\t};\n"
+            "};\n\n"
+            "env {\n"
+            "\thostname = \"bench\";\n"
+            "\tdomain = \"%s\";\n"
+            "\tsysname = \"Linux\";\n"
+            "\ttracer_name = \"%s\";\n"
+            "\ttracer_major = 2;\n"
+            "\ttracer_minor = 5;\n"
+            "};\n\n"
+            "clock {\n"
+            "\tname = monotonic;\n"
+            "\tuuid = \"%s\";\n"
+            "\tdescription = \"Monotonic Clock\";\n"
+            "\tfreq = 1000000000;\n"
+            "\toffset = %" PRIu64 ";\n"
+            "};\n\n"
+            "typealias integer {\n"
+            "\tsize = 27; align = 1; signed = false;\n"
+            "\tmap = clock.monotonic.value;\n"
+            "} := uint27_clock_monotonic_t;\n\n"
+            "typealias integer {\n"
+            "\tsize = 32; align = 8; signed = false;\n"
+            "\tmap = clock.monotonic.value;\n"
+            "} := uint32_clock_monotonic_t;\n\n"
+            "typealias integer {\n"
+            "\tsize = 64; align = 8; signed = false;\n"
+            "\tmap = clock.monotonic.value;\n"
+            "} := uint64_clock_monotonic_t;\n\n"
+            "struct packet_context {\n"
+            "\tuint64_clock_monotonic_t timestamp_begin;\n"
+            "\tuint64_clock_monotonic_t timestamp_end;\n"
+            "\tuint64_t content_size;\n"
+            "\tuint64_t packet_size;\n"
+            "\tunsigned long events_discarded;\n"
+            "\tuint32_t cpu_id;\n"
+            "};\n\n"
+            "struct event_header_compact {\n"
+            "\tenum : uint5_t { compact = 0 ... 30, extended = 31 } id;\n"
+            "\tvariant <id> {\n"
+            "\t\tstruct {\n"
+            "\t\t\tuint27_clock_monotonic_t timestamp;\n"
+            "\t\t} compact;\n"
+            "\t\tstruct {\n"
+            "\t\t\tuint32_t id;\n"
+            "\t\t\tuint64_clock_monotonic_t timestamp;\n"
+            "\t\t} extended;\n"
+            "\t} v;\n"
+            "} align(8);\n\n"
+            "struct event_header_large {\n"
+            "\tenum : uint16_t { compact = 0 ... 65534, extended = 65535 } "
+            "id;\n"
+            "\tvariant <id> {\n"
+            "\t\tstruct {\n"
+            "\t\t\tuint32_clock_monotonic_t timestamp;\n"
+            "\t\t} compact;\n"
+            "\t\tstruct {\n"
+            "\t\t\tuint32_t id;\n"
+            "\t\t\tuint64_clock_monotonic_t timestamp;\n"
+            "\t\t} extended;\n"
+            "\t} v;\n"
+            "} align(8);\n\n"
+            "stream {\n"
+            "\tid = 0;\n"
+            "\tevent.header := struct %s;\n"
+            "\tpacket.context := struct packet_context;\n"
+            "};\n\n", uuid_str, kernel ? "kernel" : "ust",
+            kernel ? "lttng-modules" : "lttng-ust", uuid_str,
+            (uint64_t) CLOCK_OFFSET,
+            large_header ? "event_header_large" : "event_header_compact");
+
+        for (i = 0; i < ndecls; i++) {
+                decl = &decls[i];
+                fprintf(fp, "event {\n"
+                    "\tname = \"%s\";\n"
+                    "\tid = %u;\n"
+                    "\tstream_id = 0;\n"
+                    "\tfields := struct {\n", decl->name, decl->id);
+                for (field = decl->fields; field->name != NULL; field++) {
+                        switch (field->type) {
+                        case FIELD_COMM:
+                                fprintf(fp, "\t\tinteger { size = 8; "
+                                    "align = 8; signed = 1; encoding = UTF8; "
+                                    "base = 10; } %s[16];\n", field->name);
+                                break;
+                        case FIELD_STRING:
+                                fprintf(fp, "\t\tstring %s;\n", field->name);
+                                break;
+                        default:
+                                fprintf(fp, "\t\tinteger { size = %d; "
+                                    "align = 8; signed = %d; encoding = none; "
+                                    "base = %d; } %s;\n",
+                                    (field->type == FIELD_S32 ||
+                                        field->type == FIELD_U32) ? 32 : 64,
+                                    (field->type == FIELD_S32 ||
+                                        field->type == FIELD_S64),
+                                    field->type == FIELD_HEX64 ? 16 : 10,
+                                    field->name);
+                                break;
+                        }
+                }
+                fprintf(fp, "\t};\n};\n\n");
+        }
+
+        /* lttng-modules declares a thousand or so events */
+        for (i = 0; kernel && i < extra_events; i++) {
+                fprintf(fp, "event {\n"
+                    "\tname = \"syscall_entry_bench%u\";\n"
+                    "\tid = %u;\n"
+                    "\tstream_id = 0;\n"
+                    "\tfields := struct {\n"
+                    "\t\tinteger { size = 32; align = 8; signed = 0; "
+                    "encoding = none; base = 10; } _fd;\n"
+                    "\t};\n};\n\n"
+                    "event {\n"
+                    "\tname = \"syscall_exit_bench%u\";\n"
+                    "\tid = %u;\n"
+                    "\tstream_id = 0;\n"
+                    "\tfields := struct {\n"
+                    "\t\tinteger { size = 64; align = 8; signed = 1; "
+                    "encoding = none; base = 10; } _ret;\n"
+                    "\t};\n};\n\n", i, 1000 + 2 * i, i, 1001 + 2 * i);
+        }
+}
+
+static void
+create_metadata(const char *dir, bool kernel)
+{
+        char *path = malloc(strlen(dir) + 16);
+        FILE *fp;
+
+        sprintf(path, "%s/metadata", dir);
+        if (!(fp = fopen(path, "w"))) {
+                perror(path);
+                exit(EXIT_FAILURE);
+        }
+        write_metadata(fp, kernel);
+        fclose(fp);
+        free(path);
+}
+
+/* Starts the stream file of _cpu in _dir, the packet buffer is kept */
+static void
+open_stream(struct stream *s, const char *dir, unsigned int cpu)
+{
+        char *path = malloc(strlen(dir) + 32);
+
+        sprintf(path, "%s/channel0_%u", dir, cpu);
+        if (!(s->fp = fopen(path, "w"))) {
+                perror(path);
+                exit(EXIT_FAILURE);
+        }
+        free(path);
+        s->cpu = cpu;
+        s->pos = 0;
+        s->discarded = 0;
+        s->packets = 0;
+        s->events = 0;
+        s->bytes = 0;
+}
+
+/*
+ * Writes the events of one CPU until the stream reaches _size. The CPU
+ * runs a thread in user mode and between gaps either calls into the
+ * kernel, takes an interrupt or a softirq, or schedules another thread.
+ * With --ust the thread now and then logs a UST event first.
+ */
+static void
+write_cpu(struct stream *s, uint64_t size)
+{
+        uint64_t t = TRACE_START + rnd(1000);
+        unsigned int total = mix[0] + mix[1] + mix[2] + mix[3];
+        const struct thread *cur = &threads[0], *next;
+        struct thread *child;
+        unsigned int pick, sc, irq, vec, cur_idx;
+        uint64_t ret;
+
+        /* the statedump goes to the first CPU */
+        if (s->cpu == 0) {
+                emit(s, EV_STATEDUMP_START, t);
+                for (pick = 1; pick < threads_len; pick++) {
+                        const struct thread *th = &threads[pick];
+
+                        t += 100 + rnd(200);
+                        emit(s, EV_STATEDUMP_PROCESS, t, (uint64_t) th->tid,
+                            (uint64_t) th->tid, (uint64_t) th->pid,
+                            (uint64_t) th->pid, (uint64_t) 1, (uint64_t) 1,
+                            th->comm, (uint64_t) 0, (uint64_t) 0,
+                            (uint64_t) 0, (uint64_t) 5);
+                }
+                t += 100;
+                emit(s, EV_STATEDUMP_END, t);
+        }
+
+        while (s->bytes + s->pos < size) {
+                /* now and then a long idle gap, past the compact timestamp */
+                t += rnd(10000) == 0 ? (1ULL << 28) : 100 + rnd(5000);
+                if (s->ust != NULL && rnd(4) == 0) {
+                        emit(s->ust, 0, t, (uint64_t) cur->tid,
+                            s->ust->events);
+                        t += 100 + rnd(1000);
+                }
+                pick = rnd(total);
+
+                if (pick < mix[0]) {
+                        sc = EV_SYSCALLS + 2 * rnd(NSYSCALLS);
+                        ret = rnd(4096);
+                        switch (sc - EV_SYSCALLS) {
+                        case 0:
+                        case 2:
+                                emit(s, sc, t, (uint64_t) rnd(64),
+                                    (uint64_t) 0x7f0000001000ULL,
+                                    (uint64_t) 4096);
+                                t += 200 + rnd(20000);
+                                if (sc == EV_SYSCALLS) {
+                                        emit(s, sc + 1, t, ret,
+                                            (uint64_t) 0x7f0000001000ULL);
+                                } else {
+                                        emit(s, sc + 1, t, ret);
+                                }
+                                break;
+                        case 4:
+                                emit(s, sc, t, (uint64_t) rnd(64),
+                                    (uint64_t) 0x5401, (uint64_t) 0);
+                                t += 200 + rnd(2000);
+                                emit(s, sc + 1, t, (uint64_t) 0,
+                                    (uint64_t) 0);
+                                break;
+                        case 6:
+                                emit(s, sc, t, (uint64_t) 0x7ffd0000ULL,
+                                    (uint64_t) 1 + rnd(8), (uint64_t) 10);
+                                t += 1000 + rnd(50000);
+                                emit(s, sc + 1, t, (uint64_t) rnd(2),
+                                    (uint64_t) 0x7ffd0000ULL);
+                                break;
+                        default:
+                                emit(s, sc, t, (uint64_t) rnd(64));
+                                t += 200 + rnd(1000);
+                                emit(s, sc + 1, t, (uint64_t) 0);
+                                break;
+                        }
+                } else if (pick < mix[0] + mix[1]) {
+                        irq = rnd(sizeof(irq_names) / sizeof(irq_names[0]));
+                        emit(s, EV_IRQ_ENTRY, t, (uint64_t) irq * 8,
+                            irq_names[irq]);
+                        t += 500 + rnd(3000);
+                        if (rnd(2) == 0) {
+                                emit(s, EV_SOFTIRQ_RAISE, t, (uint64_t) 3);
+                                t += 10;
+                        }
+                        emit(s, EV_IRQ_EXIT, t, (uint64_t) irq * 8,
+                            (uint64_t) 1);
+                } else if (pick < mix[0] + mix[1] + mix[2]) {
+                        vec = rnd(10);
+                        emit(s, EV_SOFTIRQ_ENTRY, t, (uint64_t) vec);
+                        t += 500 + rnd(10000);
+                        emit(s, EV_SOFTIRQ_EXIT, t, (uint64_t) vec);
+                } else {
+                        /* idle, another thread or, rarely, a new one */
+                        next = rnd(8) == 0 ? &threads[0] :
+                            &threads[rnd(threads_len)];
+                        if (rnd(50) == 0 && cur->tid != 0) {
+                                cur_idx = cur - threads;
+                                threads = realloc(threads,
+                                    (threads_len + 1) * sizeof(*threads));
+                                child = &threads[threads_len];
+                                cur = &threads[cur_idx];
+                                child->tid = 100000 + s->cpu * 100000 +
+                                    threads_len;
+                                child->pid = cur->pid;
+                                memcpy(child->comm, cur->comm, COMM_LEN);
+                                threads_len++;
+                                emit(s, EV_PROCESS_FORK, t, cur->comm,
+                                    (uint64_t) cur->tid, (uint64_t) cur->pid,
+                                    child->comm, (uint64_t) child->tid,
+                                    (uint64_t) child->pid);
+                                t += 1000;
+                                next = child;
+                        }
+                        emit(s, EV_SCHED_WAKEUP, t, next->comm,
+                            (uint64_t) next->tid, (uint64_t) 120,
+                            (uint64_t) 1, (uint64_t) s->cpu);
+                        t += 500 + rnd(2000);
+                        emit(s, EV_SCHED_SWITCH, t, cur->comm,
+                            (uint64_t) cur->tid, (uint64_t) 120,
+                            (uint64_t) rnd(2), next->comm,
+                            (uint64_t) next->tid, (uint64_t) 120);
+                        cur = next;
+                }
+        }
+
+        if (s->pos != 0) {
+                close_packet(s);
+        }
+        if (s->ust != NULL && s->ust->pos != 0) {
+                close_packet(s->ust);
+        }
+}
+
+static int
+parse_options(int argc, char **argv)
+{
+        poptContext pc;
+        int opt, ret = 0;
+        char *arg, *end;
+        uint64_t size;
+
+        pc = poptGetContext(NULL, argc, (const char **) argv, long_options, 0);
+        poptReadDefaultConfig(pc, 0);
+        poptSetOtherOptionHelp(pc, "[OPTIONS...] -o <trace_dir>");
+
+        while ((opt = poptGetNextOpt(pc)) != -1) {
+                arg = poptGetOptArg(pc);
+                switch (opt) {
+                case OPT_OUTPUT:
+                        opt_output = arg;
+                        arg = NULL;
+                        break;
+                case OPT_CPUS:
+                        ncpus = arg ? strtoul(arg, &end, 10) : 0;
+                        if (!arg || *end != '\0' || ncpus == 0) {
+                                fprintf(stderr, "Wrong number of CPUs\n");
+                                ret = -EINVAL;
+                        }
+                        break;
+                case OPT_THREADS:
+                        nthreads = arg ? strtoul(arg, &end, 10) : 0;
+                        if (!arg || *end != '\0' || nthreads == 0) {
+                                fprintf(stderr, "Wrong number of threads\n");
+                                ret = -EINVAL;
+                        }
+                        break;
+                case OPT_MIX:
+                        if (!arg || sscanf(arg, "%u,%u,%u,%u", &mix[0],
+                                &mix[1], &mix[2], &mix[3]) != 4 ||
+                            mix[0] + mix[1] + mix[2] + mix[3] == 0) {
+                                fprintf(stderr, "Wrong event mix\n");
+                                ret = -EINVAL;
+                        }
+                        break;
+                case OPT_LOST_EVERY:
+                        lost_every = arg ? strtoul(arg, &end, 10) : 0;
+                        if (!arg || *end != '\0') {
+                                fprintf(stderr, "Wrong packet count\n");
+                                ret = -EINVAL;
+                        }
+                        break;
+                case OPT_SIZE:
+                        if (parse_size(arg, &trace_size) < 0) {
+                                fprintf(stderr, "Wrong trace size\n");
+                                ret = -EINVAL;
+                        }
+                        break;
+                case OPT_PACKET_SIZE:
+                        if (parse_size(arg, &size) < 0 ||
+                            size < 4096 || size % 8 != 0) {
+                                fprintf(stderr, "Wrong packet size\n");
+                                ret = -EINVAL;
+                        }
+                        packet_size = size;
+                        break;
+                case OPT_LARGE_HEADER:
+                        large_header = true;
+                        break;
+                case OPT_UST:
+                        ust = true;
+                        break;
+                case OPT_EXTRA_EVENTS:
+                        extra_events = arg ? strtoul(arg, &end, 10) : 0;
+                        if (!arg || *end != '\0') {
+                                fprintf(stderr, "Wrong number of events\n");
+                                ret = -EINVAL;
+                        }
+                        break;
+                case OPT_TICK:
+                        tick = arg ? strtoull(arg, &end, 10) : 0;
+                        if (!arg || *end != '\0' || tick == 0) {
+                                fprintf(stderr, "Wrong tick\n");
+                                ret = -EINVAL;
+                        }
+                        break;
+                case OPT_SEED:
+                        seed = arg ? strtoul(arg, &end, 10) : 0;
+                        if (!arg || *end != '\0') {
+                                fprintf(stderr, "Wrong seed\n");
+                                ret = -EINVAL;
+                        }
+                        break;
+                default:
+                        poptPrintHelp(pc, stderr, 0);
+                        ret = -EINVAL;
+                        break;
+                }
+                free(arg);
+        }
+
+        if (opt_output == NULL) {
+                poptPrintHelp(pc, stderr, 0);
+                ret = -EINVAL;
+        }
+
+        poptFreeContext(pc);
+
+        return ret;
+}
+
+int
+main(int argc, char **argv)
+{
+        struct stream s, u;
+        uint64_t nevents = 0, bytes = 0, lost = 0;
+        unsigned int cpu, i;
+        char *kernel_dir, *ust_dir;
+
+        if (parse_options(argc, argv) < 0) {
+                exit(EXIT_FAILURE);
+        }
+
+        srandom(seed);
+        for (i = 0; i < sizeof(uuid); i++) {
+                uuid[i] = rnd(256);
+        }
+
+        /* swapper, then nthreads threads in processes of a few threads */
+        threads_len = nthreads + 1;
+        threads = calloc(threads_len, sizeof(*threads));
+        strcpy(threads[0].comm, "swapper/0");
+        for (i = 1; i < threads_len; i++) {
+                threads[i].tid = 1000 + i;
+                threads[i].pid = 1000 + i - (i - 1) % THREADS_PER_PROCESS;
+                snprintf(threads[i].comm, COMM_LEN, "bench-%u",
+                    threads[i].pid);
+        }
+
+        /* laid out like a session directory with --ust */
+        kernel_dir = malloc(strlen(opt_output) + 32);
+        ust_dir = malloc(strlen(opt_output) + 32);
+        if (ust) {
+                sprintf(kernel_dir, "%s/kernel", opt_output);
+                sprintf(ust_dir, "%s/ust/uid/1000/64-bit", opt_output);
+        } else {
+                strcpy(kernel_dir, opt_output);
+        }
+        if (make_dirs(kernel_dir) < 0 || (ust && make_dirs(ust_dir) < 0)) {
+                exit(EXIT_FAILURE);
+        }
+        create_metadata(kernel_dir, true);
+        if (ust) {
+                create_metadata(ust_dir, false);
+        }
+
+        memset(&s, 0, sizeof(s));
+        memset(&u, 0, sizeof(u));
+        s.decls = events;
+        s.packet = malloc(packet_size);
+        u.decls = ust_events;
+        u.packet = malloc(packet_size);
+        for (cpu = 0; cpu < ncpus; cpu++) {
+                open_stream(&s, kernel_dir, cpu);
+                if (ust) {
+                        open_stream(&u, ust_dir, cpu);
+                        s.ust = &u;
+                }
+                write_cpu(&s, trace_size / ncpus);
+                fclose(s.fp);
+
+                nevents += s.events;
+                bytes += s.bytes;
+                lost += s.discarded;
+                if (ust) {
+                        fclose(u.fp);
+                        nevents += u.events;
+                        bytes += u.bytes;
+                        lost += u.discarded;
+                }
+        }
+
+        /* read by the benchmark harness */
+        printf("events=%" PRIu64 " bytes=%" PRIu64 " lost=%" PRIu64 "\n",
+            nevents, bytes, lost);
+
+        free(s.packet);
+        free(u.packet);
+        free(kernel_dir);
+        free(ust_dir);
+        free(threads);
+
+        return 0;
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,561 @@
+/*
+ * Micro-benchmarks of the per-event paths of lttng2prv.
+ *
+ * Times the functions run for every event against a trace made by
+ * generateTrace: event classification, packet contexts, arguments, record
+ * formatting, registry lookups and listEvents(). Functions that need a live
+ * babeltrace event are timed while iterating and reported net of the
+ * iteration; the others replay arrays recorded from the trace by a first
+ * pass. Figures are the best of --repeat runs, in ns per call, and can be
+ * saved as a baseline and checked against it.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <popt.h>
+#include <babeltrace/babeltrace.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf/iterator.h>
+
+#include "lttng2prv.h"
+#include "types.h"
+#include "classifyEvents.h"
+#include "fillArgTypes.h"
+#include "listEvents.h"
+#include "readPacketContext.h"
+#include "registerIds.h"
+#include "writeRecords.h"
+
+#define DEFAULT_REPEAT 5
+#define DEFAULT_TOLERANCE 25
+/* differences below this many ns are timer noise */
+#define NOISE_NS 1.0
+#define NAME_LEN 64
+
+bool verbose = false;
+unsigned int id_size = 32;
+size_t write_buffer_size = WRITER_DEFAULT_SIZE;
+
+/* after the OPT_* of types.h */
+enum
+{
+        OPT_SAVE_BASELINE = 1000,
+        OPT_CHECK_BASELINE,
+        OPT_TOLERANCE,
+        OPT_REPEAT
+};
+
+/* What is timed while iterating, on top of reading the events */
+enum
+{
+        ITER_ONLY = 0,
+        ITER_PACKET,
+        ITER_CLASSIFY,
+        ITER_ARGS
+};
+
+/* Recorded by the first pass, replayed by the in-memory benchmarks */
+struct fixture
+{
+        /* time, cpu, type and value of every event */
+        GArray *times;
+        GArray *cpus;
+        GArray *types;
+        GArray *values;
+        /* next tid of every sched_switch, irq of every irq_handler_entry */
+        GArray *tids;
+        GArray *irqs;
+};
+
+struct result
+{
+        char name[NAME_LEN];
+        double ns;
+};
+
+static const char *opt_save;
+static const char *opt_check;
+static unsigned int tolerance = DEFAULT_TOLERANCE;
+static unsigned int repeat = DEFAULT_REPEAT;
+static const char *trace_path;
+
+static struct bt_context *ctx;
+static GHashTable *event_class_ht;
+static GHashTable *arg_types_ht;
+static GHashTable *arg_plans_ht;
+static struct prvRegistry *reg;
+static struct prvWriter *sink;
+static struct fixture fixture;
+static GArray *results;
+
+static struct poptOption long_options[] =
+{
+        /* longName, shortName, argInfo, argPtr, value, descrip, argDesc */
+        {"save", 0, POPT_ARG_STRING, NULL, OPT_SAVE_BASELINE,
+            "Save the results as a baseline", "FILE" },
+        {"check", 0, POPT_ARG_STRING, NULL, OPT_CHECK_BASELINE,
+            "Fail on results slower than the baseline", "FILE" },
+        {"tolerance", 0, POPT_ARG_STRING, NULL, OPT_TOLERANCE,
+            "Slowdown allowed by --check, in percent (25)", "PCT" },
+        {"repeat", 0, POPT_ARG_STRING, NULL, OPT_REPEAT,
+            "Runs of each benchmark, the best one counts (5)", "N" },
+        POPT_AUTOHELP
+        { NULL, 0, 0, NULL, 0, NULL, NULL }
+};
+
+static int parse_options(int _argc, char **_argv);
+
+static double time_iteration(int _mode, uint64_t *_events);
+
+static void record_fixture(void);
+
+static void add_result(const char *_name, double _ns);
+
+static double best_iteration(int _mode, uint64_t *_events);
+
+static double bench_format_record(void);
+
+static double bench_lookup(const struct idTable *_t, GArray *_keys);
+
+static double bench_list_events(void);
+
+static int save_results(const char *_path);
+
+static int check_results(const char *_path);
+
+/*
+ * Reads the whole trace once, running the function of _mode on every event.
+ * Returns the ns per event and the event count in _events.
+ */
+static double
+time_iteration(int mode, uint64_t *events)
+{
+        struct bt_ctf_iter *iter;
+        struct bt_ctf_event *event;
+        struct packetCache packets;
+        const struct eventClass *class;
+        struct eventClass scratch;
+        uint64_t start, count = 0;
+        uintptr_t sum = 0;
+
+        initPacketCache(&packets);
+        iter = bt_ctf_iter_create(ctx, NULL, NULL);
+
+        start = monotonicTime();
+        while ((event = bt_ctf_iter_read_event(iter)) != NULL) {
+                switch (mode) {
+                case ITER_PACKET:
+                        sum += readPacketContext(&packets, event)->cpu_id;
+                        break;
+                case ITER_CLASSIFY:
+                        class = getEventClass(event_class_ht, event, &scratch);
+                        sum += class->event_type;
+                        break;
+                case ITER_ARGS:
+                        getArgValue(event, 0, arg_types_ht, arg_plans_ht,
+                            sink);
+                        sink->len = 0;
+                        break;
+                default:
+                        sum += (uintptr_t) bt_ctf_event_name(event);
+                        break;
+                }
+                count++;
+                if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+                        break;
+                }
+        }
+        start = monotonicTime() - start;
+
+        bt_ctf_iter_destroy(iter);
+        freePacketCache(&packets);
+
+        /* keeps the compiler from dropping the loop bodies */
+        if (sum == 1) {
+                fprintf(stderr, "\n");
+        }
+        *events = count;
+
+        return count ? (double) start / count : 0;
+}
+
+static double
+best_iteration(int mode, uint64_t *events)
+{
+        double ns, best = 0;
+        unsigned int i;
+
+        for (i = 0; i < repeat; i++) {
+                ns = time_iteration(mode, events);
+                if (i == 0 || ns < best) {
+                        best = ns;
+                }
+        }
+
+        return best;
+}
+
+/*
+ * First pass over the trace: records the fields the in-memory benchmarks
+ * replay and registers threads and irqs the way getThreadInfo() does.
+ */
+static void
+record_fixture(void)
+{
+        struct bt_ctf_iter *iter;
+        struct bt_ctf_event *event;
+        const struct bt_definition *scope;
+        struct packetCache packets;
+        const struct packetContext *packet;
+        const struct eventClass *class;
+        struct eventClass scratch;
+        uint64_t time, value;
+        uint32_t cpu, id;
+
+        fixture.times = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+        fixture.cpus = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+        fixture.types = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+        fixture.values = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+        fixture.tids = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+        fixture.irqs = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+
+        initPacketCache(&packets);
+        iter = bt_ctf_iter_create(ctx, NULL, NULL);
+        while ((event = bt_ctf_iter_read_event(iter)) != NULL) {
+                packet = readPacketContext(&packets, event);
+                class = getEventClass(event_class_ht, event, &scratch);
+
+                time = bt_ctf_get_timestamp(event);
+                cpu = packet->cpu_id;
+                value = class->event_value;
+                if (value == EVENT_VALUE_ID) {
+                        value = bt_ctf_get_decl_event_id(
+                            bt_ctf_event_get_decl(event)) + 1;
+                }
+                g_array_append_val(fixture.times, time);
+                g_array_append_val(fixture.cpus, cpu);
+                g_array_append_val(fixture.types, class->event_type);
+                g_array_append_val(fixture.values, value);
+
+                scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
+                if (class->flags & CLASS_SWITCH) {
+                        id = bt_get_signed_int(
+                            bt_ctf_get_field(event, scope, "_next_tid"));
+                        g_array_append_val(fixture.tids, id);
+                        addThread(reg, id, "");
+                } else if (class->handler == HANDLER_IRQ) {
+                        id = bt_get_signed_int(
+                            bt_ctf_get_field(event, scope, "_irq"));
+                        g_array_append_val(fixture.irqs, id);
+                        addIrq(reg, id, "");
+                }
+
+                if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+                        break;
+                }
+        }
+        bt_ctf_iter_destroy(iter);
+        freePacketCache(&packets);
+}
+
+/*
+ * Formats a "2:cpu:appl:task:thread:time:type:value" record for every
+ * recorded event, like iter_trace() does without spooling.
+ */
+static double
+bench_format_record(void)
+{
+        uint64_t start;
+        unsigned int i;
+
+        start = monotonicTime();
+        for (i = 0; i < fixture.times->len; i++) {
+                writeBytes(sink, "2:", 2);
+                writeField(sink, g_array_index(fixture.cpus, uint32_t, i) + 1);
+                writeField(sink, i & 63);
+                writeField(sink, 1);
+                writeField(sink, 1);
+                writeField(sink, g_array_index(fixture.times, uint64_t, i));
+                writeField(sink, g_array_index(fixture.types, uint64_t, i));
+                writeUint(sink, g_array_index(fixture.values, uint64_t, i));
+                writeChar(sink, '\n');
+                /* only the formatting is timed, not the output */
+                if (sink->len > sink->size / 2) {
+                        sink->len = 0;
+                }
+        }
+        start = monotonicTime() - start;
+        sink->len = 0;
+
+        return fixture.times->len ? (double) start / fixture.times->len : 0;
+}
+
+static double
+bench_lookup(const struct idTable *t, GArray *keys)
+{
+        uint64_t start;
+        uintptr_t sum = 0;
+        unsigned int i;
+
+        start = monotonicTime();
+        for (i = 0; i < keys->len; i++) {
+                sum += lookupId(t, g_array_index(keys, uint32_t, i));
+        }
+        start = monotonicTime() - start;
+
+        if (sum == 1) {
+                fprintf(stderr, "\n");
+        }
+
+        return keys->len ? (double) start / keys->len : 0;
+}
+
+static double
+bench_list_events(void)
+{
+        uint64_t start;
+        FILE *fp;
+
+        if (!(fp = fopen("/dev/null", "w"))) {
+                return 0;
+        }
+        start = monotonicTime();
+        listEvents(ctx, fp);
+        start = monotonicTime() - start;
+        fclose(fp);
+
+        return start;
+}
+
+static void
+add_result(const char *name, double ns)
+{
+        struct result r;
+
+        g_strlcpy(r.name, name, NAME_LEN);
+        r.ns = ns < 0 ? 0 : ns;
+        g_array_append_val(results, r);
+        printf("%-16s %14.1f\n", name, r.ns);
+}
+
+static int
+save_results(const char *path)
+{
+        struct result *r;
+        unsigned int i;
+        FILE *fp;
+
+        if (!(fp = fopen(path, "w"))) {
+                fprintf(stderr, "[error] Couldn't write %s\n", path);
+                return -1;
+        }
+        for (i = 0; i < results->len; i++) {
+                r = &g_array_index(results, struct result, i);
+                fprintf(fp, "%s %.1f\n", r->name, r->ns);
+        }
+        fclose(fp);
+
+        return 0;
+}
+
+/*
+ * Compares the results with the baseline in _path. Returns the number of
+ * benchmarks slower than the baseline by more than the tolerance.
+ */
+static int
+check_results(const char *path)
+{
+        char name[NAME_LEN];
+        double base;
+        struct result *r;
+        unsigned int i;
+        int regressions = 0;
+        FILE *fp;
+
+        if (!(fp = fopen(path, "r"))) {
+                fprintf(stderr, "[error] Couldn't read %s, run make "
+                    "bench-baseline first\n", path);
+                return -1;
+        }
+        while (fscanf(fp, "%63s %lf", name, &base) == 2) {
+                for (i = 0; i < results->len; i++) {
+                        r = &g_array_index(results, struct result, i);
+                        if (strcmp(r->name, name) != 0) {
+                                continue;
+                        }
+                        if (r->ns > base * (100 + tolerance) / 100 &&
+                            r->ns - base > NOISE_NS) {
+                                fprintf(stderr, "[regression] %s: %.1f ns, "
+                                    "baseline %.1f ns\n", name, r->ns, base);
+                                regressions++;
+                        }
+                        break;
+                }
+        }
+        fclose(fp);
+
+        return regressions;
+}
+
+static int
+parse_options(int argc, char **argv)
+{
+        poptContext pc;
+        int opt, ret = 0;
+        char *arg, *end;
+
+        pc = poptGetContext(NULL, argc, (const char **) argv, long_options, 0);
+        poptReadDefaultConfig(pc, 0);
+        poptSetOtherOptionHelp(pc, "[OPTIONS...] <trace_dir>");
+
+        while ((opt = poptGetNextOpt(pc)) != -1) {
+                arg = poptGetOptArg(pc);
+                switch (opt) {
+                case OPT_SAVE_BASELINE:
+                        opt_save = arg;
+                        arg = NULL;
+                        break;
+                case OPT_CHECK_BASELINE:
+                        opt_check = arg;
+                        arg = NULL;
+                        break;
+                case OPT_TOLERANCE:
+                        tolerance = arg ? strtoul(arg, &end, 10) : 0;
+                        if (!arg || *end != '\0') {
+                                fprintf(stderr, "Wrong tolerance\n");
+                                ret = -EINVAL;
+                        }
+                        break;
+                case OPT_REPEAT:
+                        repeat = arg ? strtoul(arg, &end, 10) : 0;
+                        if (!arg || *end != '\0' || repeat == 0) {
+                                fprintf(stderr, "Wrong number of runs\n");
+                                ret = -EINVAL;
+                        }
+                        break;
+                default:
+                        poptPrintHelp(pc, stderr, 0);
+                        ret = -EINVAL;
+                        break;
+                }
+                free(arg);
+                if (ret < 0) {
+                        goto end;
+                }
+        }
+
+        trace_path = poptGetArg(pc);
+        if (trace_path == NULL) {
+                poptPrintHelp(pc, stderr, 0);
+                ret = -EINVAL;
+        } else {
+                trace_path = strdup(trace_path);
+        }
+
+end:
+        poptFreeContext(pc);
+
+        return ret;
+}
+
+int
+main(int argc, char **argv)
+{
+        uint64_t events;
+        double iterate;
+        int fd, ret = 0;
+
+        if (parse_options(argc, argv) < 0) {
+                exit(EXIT_FAILURE);
+        }
+
+        ctx = bt_context_create();
+        if (bt_context_add_trace(ctx, trace_path, "ctf", NULL, NULL,
+                NULL) < 0) {
+                fprintf(stderr, "[error] Couldn't open trace \"%s\"\n",
+                    trace_path);
+                exit(EXIT_FAILURE);
+        }
+        if ((fd = open("/dev/null", O_WRONLY)) < 0 ||
+            !(sink = createWriter(fd, write_buffer_size))) {
+                fprintf(stderr, "[error] Couldn't open /dev/null\n");
+                exit(EXIT_FAILURE);
+        }
+
+        event_class_ht = createEventClasses();
+        fillEventClasses(ctx, event_class_ht);
+        arg_types_ht = g_hash_table_new_full(g_str_hash, g_str_equal, free,
+            NULL);
+        fillArgTypes(arg_types_ht);
+        arg_plans_ht = createArgPlans();
+        reg = createRegistry();
+        results = g_array_new(FALSE, FALSE, sizeof(struct result));
+
+        record_fixture();
+        printf("# %u events, %u switches, %u irqs, %u threads, %u runs\n",
+            fixture.times->len, fixture.tids->len, fixture.irqs->len,
+            reg->threads->len, repeat);
+        printf("%-16s %14s\n", "benchmark", "ns/call");
+
+        iterate = best_iteration(ITER_ONLY, &events);
+        add_result("iterate", iterate);
+        add_result("packet_context",
+            best_iteration(ITER_PACKET, &events) - iterate);
+        add_result("classify",
+            best_iteration(ITER_CLASSIFY, &events) - iterate);
+        add_result("arg_value",
+            best_iteration(ITER_ARGS, &events) - iterate);
+
+#define BEST_OF(name, call) do {                                        \
+        double ns, best = 0;                                            \
+        unsigned int i;                                                 \
+        for (i = 0; i < repeat; i++) {                                  \
+                ns = (call);                                            \
+                if (i == 0 || ns < best) {                              \
+                        best = ns;                                      \
+                }                                                       \
+        }                                                               \
+        add_result(name, best);                                         \
+} while (0)
+
+        BEST_OF("format_record", bench_format_record());
+        BEST_OF("tid_lookup", bench_lookup(&reg->tid_prv, fixture.tids));
+        BEST_OF("irq_lookup", bench_lookup(&reg->irq_prv, fixture.irqs));
+        BEST_OF("list_events", bench_list_events());
+
+#undef BEST_OF
+
+        if (opt_save != NULL && save_results(opt_save) < 0) {
+                ret = EXIT_FAILURE;
+        }
+        if (opt_check != NULL && check_results(opt_check) != 0) {
+                ret = EXIT_FAILURE;
+        }
+
+        g_array_free(fixture.times, TRUE);
+        g_array_free(fixture.cpus, TRUE);
+        g_array_free(fixture.types, TRUE);
+        g_array_free(fixture.values, TRUE);
+        g_array_free(fixture.tids, TRUE);
+        g_array_free(fixture.irqs, TRUE);
+        g_array_free(results, TRUE);
+        destroyRegistry(reg);
+        g_hash_table_destroy(arg_plans_ht);
+        g_hash_table_destroy(arg_types_ht);
+        g_hash_table_destroy(event_class_ht);
+        destroyWriter(sink);
+        close(fd);
+        bt_context_put(ctx);
+
+        return ret;
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
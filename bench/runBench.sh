@@ -0,0 +1,111 @@
+#!/bin/sh
+#
+# End-to-end throughput of lttng2prv on synthetic traces.
+#
+# Usage: runBench.sh <generateTrace> <lttng2prv>
+#
+# Converts traces of every size in BENCH_SIZES for every CPU count in
+# BENCH_CPUS, with compact and large event headers, and prints events/s,
+# MB/s of trace read and peak RSS of each run. Traces are generated once
+# into BENCH_DIR and reused. BENCH_ARGS is passed to lttng2prv, for
+# instance BENCH_ARGS="-j 4" or "--single-pass". With BENCH_REFERENCE set,
+# each trace is converted again with those arguments instead, untimed, and
+# the run fails if its .prv, past its header line and its date, .pcf or
+# .row differ. Both runs then leave out the thread cache, so the reference
+# doesn't reuse the first pass of the timed run.
+
+GENERATE=${1:-./generateTrace}
+LTTNG2PRV=${2:-../src/lttng2prv}
+
+BENCH_CPUS=${BENCH_CPUS:-"1 4 16"}
+BENCH_SIZES=${BENCH_SIZES:-"64M 256M"}
+BENCH_HEADERS=${BENCH_HEADERS:-"compact large"}
+BENCH_DIR=${BENCH_DIR:-bench-traces}
+BENCH_LOST_EVERY=${BENCH_LOST_EVERY:-50}
+BENCH_ARGS=${BENCH_ARGS:-}
+BENCH_REFERENCE=${BENCH_REFERENCE:-}
+
+TIME=/usr/bin/time
+
+CACHE_ARGS=
+if [ -n "$BENCH_REFERENCE" ]; then
+        CACHE_ARGS=--no-cache
+fi
+
+mkdir -p "$BENCH_DIR/out" || exit 1
+
+printf '%-8s %5s %6s %12s %12s %10s %8s %10s\n' \
+    header cpus size events events/s MB/s seconds rss_kb
+
+status=0
+for header in $BENCH_HEADERS; do
+        for cpus in $BENCH_CPUS; do
+                for size in $BENCH_SIZES; do
+                        name="$header-${cpus}cpu-$size"
+                        trace="$BENCH_DIR/$name"
+                        out="$BENCH_DIR/out/$name"
+
+                        if [ ! -f "$trace.stats" ]; then
+                                flags=""
+                                if [ "$header" = large ]; then
+                                        flags="--large-header"
+                                fi
+                                rm -rf "$trace"
+                                "$GENERATE" -o "$trace" --cpus="$cpus" \
+                                    --threads=$((cpus * 16)) \
+                                    --size="$size" \
+                                    --lost-every="$BENCH_LOST_EVERY" \
+                                    $flags > "$trace.stats.tmp" &&
+                                    mv "$trace.stats.tmp" "$trace.stats" ||
+                                    { status=1; continue; }
+                        fi
+                        events=$(sed -n 's/.*events=\([0-9]*\).*/\1/p' \
+                            "$trace.stats")
+                        bytes=$(sed -n 's/.*bytes=\([0-9]*\).*/\1/p' \
+                            "$trace.stats")
+
+                        # GNU time gives the peak RSS, otherwise time only
+                        if "$TIME" -f '%e %M' -o "$out.time" true \
+                            2> /dev/null; then
+                                "$TIME" -f '%e %M' -o "$out.time" \
+                                    "$LTTNG2PRV" $CACHE_ARGS $BENCH_ARGS \
+                                    -o "$out" "$trace" > /dev/null ||
+                                    status=1
+                                read seconds rss < "$out.time"
+                        else
+                                start=$(date +%s.%N)
+                                "$LTTNG2PRV" $CACHE_ARGS $BENCH_ARGS \
+                                    -o "$out" "$trace" > /dev/null ||
+                                    status=1
+                                seconds=$(echo "$start $(date +%s.%N)" |
+                                    awk '{ printf "%.2f", $2 - $1 }')
+                                rss=-
+                        fi
+                        if [ -n "$BENCH_REFERENCE" ]; then
+                                "$LTTNG2PRV" $CACHE_ARGS $BENCH_REFERENCE \
+                                    -o "$out.ref" "$trace" > /dev/null ||
+                                    status=1
+                                tail -n +2 "$out.prv" > "$out.body"
+                                tail -n +2 "$out.ref.prv" > "$out.ref.body"
+                                for ext in body pcf row; do
+                                        cmp -s "$out.$ext" "$out.ref.$ext" ||
+                                            { echo "$name: .$ext differs" \
+                                                "from BENCH_REFERENCE" >&2;
+                                            status=1; }
+                                done
+                        fi
+                        rm -f "$out".*
+
+                        awk -v h="$header" -v c="$cpus" -v s="$size" \
+                            -v e="$events" -v b="$bytes" -v t="$seconds" \
+                            -v r="$rss" 'BEGIN {
+                                if (t <= 0) t = 0.01
+                                printf "%-8s %5s %6s %12d %12.0f %10.1f " \
+                                    "%8.2f %10s\n", h, c, s, e, e / t,
+                                    b / t / 1048576, t, r
+                            }'
+                done
+        done
+done
+
+exit $status
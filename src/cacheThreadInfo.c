@@ -0,0 +1,197 @@
+/* Cache of the thread information of a trace, next to it */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "cacheThreadInfo.h"
+#include "lttng2prv.h"
+#include "streamFiles.h"
+#include "writeRecords.h"
+
+struct threadInfoCache thread_info_cache;
+
+static void add_key(GPtrArray *_lines, const char *_dir, const char *_name,
+    size_t _root_len);
+
+static gint compare_lines(gconstpointer _a, gconstpointer _b);
+
+/*
+ * Adds the key line of file _name of trace directory _dir, named relative
+ * to the input path so that a --cpus shadow trace has the same key
+ */
+static void
+add_key(GPtrArray *lines, const char *dir, const char *name, size_t root_len)
+{
+        struct stat sb;
+        char *fpath, *rel;
+
+        fpath = g_build_filename(dir, name, NULL);
+        if (stat(fpath, &sb) == 0) {
+                rel = g_strescape(fpath + MIN(root_len, strlen(dir)), NULL);
+                g_ptr_array_add(lines, g_strdup_printf("file %lld %lld %ld "
+                        "%s\n", (long long) sb.st_size,
+                        (long long) sb.st_mtim.tv_sec, sb.st_mtim.tv_nsec,
+                        rel));
+                g_free(rel);
+        }
+        g_free(fpath);
+}
+
+static gint
+compare_lines(gconstpointer a, gconstpointer b)
+{
+        return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/*
+ * The cache of trace _trace is <_trace>.lttng2prv-cache, keyed by the
+ * files under _path, the trace or its --cpus shadow
+ */
+void
+initCache(const char *trace, const char *path)
+{
+        GPtrArray *files, *lines;
+        const struct streamFile *file;
+        const char *dir = NULL;
+        size_t root_len = strlen(path);
+        char *real;
+        unsigned int i;
+
+        real = realpath(trace, NULL);
+        if (real == NULL) {
+                return;
+        }
+        thread_info_cache.path = g_strconcat(real, CACHE_SUFFIX, NULL);
+        free(real);
+
+        lines = g_ptr_array_new_with_free_func(g_free);
+        files = listStreamFiles(path);
+        for (i = 0; i < files->len; i++) {
+                file = g_ptr_array_index(files, i);
+                /* the streams of a trace are listed together */
+                if (dir == NULL || strcmp(dir, file->trace_dir) != 0) {
+                        dir = file->trace_dir;
+                        add_key(lines, dir, "metadata", root_len);
+                }
+                add_key(lines, file->trace_dir, file->name, root_len);
+        }
+        /* directories aren't always listed in the same order */
+        g_ptr_array_sort(lines, compare_lines);
+
+        thread_info_cache.key = g_string_new(NULL);
+        for (i = 0; i < lines->len; i++) {
+                g_string_append(thread_info_cache.key,
+                    g_ptr_array_index(lines, i));
+        }
+        g_ptr_array_free(lines, TRUE);
+        g_ptr_array_free(files, TRUE);
+        thread_info_cache.enabled = true;
+}
+
+/*
+ * Fills the registries, the resource counts and the trace times from the
+ * cache instead of getThreadInfo(). Returns -1, having changed nothing, if
+ * there is no cache of the trace as it is now.
+ */
+int
+loadCache(uint32_t *ncpus, uint32_t *nsoftirqs, struct prvRegistry *reg)
+{
+        GString *key;
+        char *line = NULL;
+        size_t size = 0;
+        int version = 0;
+        bool valid = false;
+        FILE *fp;
+
+        if (!thread_info_cache.enabled ||
+            !(fp = fopen(thread_info_cache.path, "r"))) {
+                return -1;
+        }
+
+        /* only a whole cache of the same files is read */
+        key = g_string_new(NULL);
+        while (getline(&line, &size, fp) > 0) {
+                if (sscanf(line, "lttng2prv-cache %d", &version) == 1) {
+                        continue;
+                } else if (strncmp(line, "file ", 5) == 0) {
+                        g_string_append(key, line);
+                } else if (strcmp(line, "end\n") == 0) {
+                        valid = version == CACHE_VERSION &&
+                            strcmp(key->str, thread_info_cache.key->str) == 0;
+                        break;
+                }
+        }
+        g_string_free(key, TRUE);
+
+        if (valid) {
+                rewind(fp);
+                while (getline(&line, &size, fp) > 0 &&
+                    strcmp(line, "end\n") != 0) {
+                        readThreadInfo(line, ncpus, nsoftirqs, reg);
+                }
+                debug("Thread information from %s\n", thread_info_cache.path);
+        } else {
+                debug("%s is out of date\n", thread_info_cache.path);
+        }
+        free(line);
+        fclose(fp);
+
+        return valid ? 0 : -1;
+}
+
+/*
+ * Writes what getThreadInfo() found to the cache, replacing it atomically.
+ * A trace in a read-only directory is just not cached.
+ */
+void
+saveCache(uint32_t ncpus, uint32_t nsoftirqs, const struct prvRegistry *reg)
+{
+        GString *s;
+        char *tmp;
+        int fd;
+
+        if (!thread_info_cache.enabled) {
+                return;
+        }
+
+        s = g_string_new(NULL);
+        g_string_append_printf(s, "lttng2prv-cache %d\n", CACHE_VERSION);
+        g_string_append(s, thread_info_cache.key->str);
+        formatThreadInfo(s, ncpus, nsoftirqs, reg);
+        g_string_append(s, "end\n");
+
+        /* conversions of the same trace may run at the same time */
+        tmp = g_strdup_printf("%s.XXXXXX", thread_info_cache.path);
+        fd = mkstemp(tmp);
+        if (fd < 0 || writeFully(fd, s->str, s->len) < 0 || close(fd) < 0 ||
+            rename(tmp, thread_info_cache.path) < 0) {
+                fprintf(stderr, "[warning] Couldn't write the thread "
+                    "information cache %s.\n", thread_info_cache.path);
+                if (fd >= 0) {
+                        unlink(tmp);
+                }
+        }
+        g_free(tmp);
+        g_string_free(s, TRUE);
+}
+
+void
+freeCache(void)
+{
+        g_free(thread_info_cache.path);
+        if (thread_info_cache.key != NULL) {
+                g_string_free(thread_info_cache.key, TRUE);
+        }
+        memset(&thread_info_cache, 0, sizeof(thread_info_cache));
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
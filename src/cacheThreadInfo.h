@@ -0,0 +1,49 @@
+#pragma once
+#ifndef CACHETHREADINFO_H
+#define CACHETHREADINFO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <glib.h>
+
+#include "types.h"
+#include "registerIds.h"
+
+#define CACHE_VERSION 1
+
+/* Appended to the trace directory for the name of its cache */
+#define CACHE_SUFFIX ".lttng2prv-cache"
+
+/*
+ * What getThreadInfo() found in a trace, kept in a file next to it so the
+ * next conversion of the same trace can skip the pass. It is keyed by the
+ * size and modification time of every stream and metadata file, and only
+ * used without --tids, --pids, --begin and --end, which change what the
+ * pass registers.
+ */
+struct threadInfoCache
+{
+        bool enabled;
+        char *path;
+        /* the sorted "file" lines of the trace being converted */
+        GString *key;
+};
+
+extern struct threadInfoCache thread_info_cache;
+
+void initCache(const char *_trace, const char *_path);
+
+int loadCache(uint32_t *_ncpus, uint32_t *_nsoftirqs,
+    struct prvRegistry *_reg);
+
+void saveCache(uint32_t _ncpus, uint32_t _nsoftirqs,
+    const struct prvRegistry *_reg);
+
+void freeCache(void);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,292 @@
+/* Checkpoints of the conversion and --resume */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "checkpointTrace.h"
+#include "lttng2prv.h"
+#include "seekWindow.h"
+
+struct traceCheckpoint trace_checkpoint;
+
+/*
+ * Checkpoints of the conversion of _trace go to <_prefix>.ckpt, every
+ * _interval ns of wall time.
+ */
+void
+initCheckpoint(const char *prefix, const char *trace, uint64_t interval)
+{
+        char *path;
+
+        trace_checkpoint.path = g_strconcat(prefix, ".ckpt", NULL);
+        path = realpath(trace, NULL);
+        trace_checkpoint.trace = g_strdup(path ? path : trace);
+        free(path);
+        trace_checkpoint.interval = interval;
+        trace_checkpoint.last = monotonicTime();
+}
+
+/*
+ * Keeps the registries and trace times for the checkpoints. They don't
+ * change once the conversion starts, so they are only formatted once.
+ */
+void
+setCheckpointRegistries(uint32_t ncpus, uint32_t nsoftirqs,
+    const struct prvRegistry *reg)
+{
+        if (trace_checkpoint.registries != NULL) {
+                g_string_free(trace_checkpoint.registries, TRUE);
+        }
+        trace_checkpoint.registries = g_string_new(NULL);
+        formatThreadInfo(trace_checkpoint.registries, ncpus, nsoftirqs, reg);
+}
+
+bool
+checkpointDue(void)
+{
+        return trace_checkpoint.interval != 0 &&
+            monotonicTime() - trace_checkpoint.last >=
+            trace_checkpoint.interval;
+}
+
+/*
+ * Writes a checkpoint before the event at _position, the first of the
+ * packet _current has just started. The records before it are flushed and
+ * synced first, the checkpoint replaces the previous one atomically.
+ */
+int
+saveCheckpoint(struct prvWriter *w, uint64_t position,
+    const uint64_t *appl_id, unsigned int nresources,
+    const struct packetCache *packets, const struct packetContext *current)
+{
+        GArray *states;
+        struct streamState *state;
+        char *trace, *tmp;
+        unsigned int i;
+        FILE *fp;
+        int ret = -1;
+
+        trace_checkpoint.last = monotonicTime();
+        if (flushWriter(w) < 0 || fdatasync(w->fd) < 0) {
+                fprintf(stderr, "[warning] Couldn't sync the trace file for "
+                    "a checkpoint.\n");
+                return -1;
+        }
+
+        tmp = g_strconcat(trace_checkpoint.path, ".tmp", NULL);
+        if (!(fp = fopen(tmp, "w"))) {
+                fprintf(stderr, "[warning] Couldn't write checkpoint %s.\n",
+                    tmp);
+                g_free(tmp);
+                return -1;
+        }
+
+        trace = g_strescape(trace_checkpoint.trace, NULL);
+        fprintf(fp, "lttng2prv-checkpoint %d\ntrace %s\n",
+            CHECKPOINT_VERSION, trace);
+        g_free(trace);
+        fputs(trace_checkpoint.registries->str, fp);
+        fprintf(fp, "position %" PRIu64 "\noutput %" PRIu64 "\n", position,
+            trace_checkpoint.output_offset + w->bytes);
+        for (i = 0; i < nresources; i++) {
+                if (appl_id[i] != 0) {
+                        fprintf(fp, "appl %u %" PRIu64 "\n", i, appl_id[i]);
+                }
+        }
+        states = g_array_new(FALSE, FALSE, sizeof(struct streamState));
+        getStreamStates(packets, current, states);
+        for (i = 0; i < states->len; i++) {
+                state = &g_array_index(states, struct streamState, i);
+                fprintf(fp, "stream %u %" PRIu64 " %" PRIu64 "\n",
+                    state->cpu_id, state->timestamp_begin,
+                    state->events_discarded);
+        }
+        g_array_free(states, TRUE);
+        fprintf(fp, "end\n");
+
+        if (fflush(fp) == 0 && fsync(fileno(fp)) == 0) {
+                ret = 0;
+        }
+        if (fclose(fp) != 0 || ret < 0 ||
+            rename(tmp, trace_checkpoint.path) < 0) {
+                fprintf(stderr, "[warning] Couldn't write checkpoint %s.\n",
+                    tmp);
+                unlink(tmp);
+                ret = -1;
+        } else {
+                debug("Checkpoint at %" PRIu64 "\n", position);
+        }
+        g_free(tmp);
+
+        return ret;
+}
+
+/*
+ * Reads the checkpoint left by a conversion of the same trace into the
+ * registries, instead of running getThreadInfo(), and keeps where the
+ * conversion stopped for iter_trace().
+ */
+int
+loadCheckpoint(uint32_t *ncpus, uint32_t *nsoftirqs,
+    struct prvRegistry *reg)
+{
+        char *line = NULL, *name;
+        size_t size = 0;
+        struct streamState state;
+        uint64_t value;
+        unsigned int idx;
+        int version = 0, n;
+        bool complete = false;
+        FILE *fp;
+
+        if (!(fp = fopen(trace_checkpoint.path, "r"))) {
+                fprintf(stderr, "[error] No checkpoint %s to resume from.\n",
+                    trace_checkpoint.path);
+                return -1;
+        }
+        trace_checkpoint.appl_id = g_array_new(FALSE, TRUE,
+            sizeof(uint64_t));
+        trace_checkpoint.streams = g_array_new(FALSE, FALSE,
+            sizeof(struct streamState));
+        state.used = false;
+
+        while (!complete && getline(&line, &size, fp) > 0) {
+                n = 0;
+                if (sscanf(line, "lttng2prv-checkpoint %d", &version) == 1) {
+                        continue;
+                }
+                if (sscanf(line, "trace %n", &n) == 0 && n > 0) {
+                        name = readEscaped(line + n);
+                        if (strcmp(name, trace_checkpoint.trace) != 0) {
+                                fprintf(stderr, "[error] Checkpoint %s is "
+                                    "of trace %s.\n", trace_checkpoint.path,
+                                    name);
+                                g_free(name);
+                                break;
+                        }
+                        g_free(name);
+                } else if (readThreadInfo(line, ncpus, nsoftirqs, reg)) {
+                        continue;
+                } else if (sscanf(line, "position %" SCNu64,
+                        &trace_checkpoint.position) == 1) {
+                        continue;
+                } else if (sscanf(line, "output %" SCNu64,
+                        &trace_checkpoint.output_offset) == 1) {
+                        continue;
+                } else if (sscanf(line, "appl %u %" SCNu64, &idx,
+                        &value) == 2) {
+                        if (idx >= trace_checkpoint.appl_id->len) {
+                                g_array_set_size(trace_checkpoint.appl_id,
+                                    idx + 1);
+                        }
+                        g_array_index(trace_checkpoint.appl_id, uint64_t,
+                            idx) = value;
+                } else if (sscanf(line, "stream %u %" SCNu64 " %" SCNu64,
+                        &state.cpu_id, &state.timestamp_begin,
+                        &state.events_discarded) == 3) {
+                        g_array_append_val(trace_checkpoint.streams, state);
+                } else if (strcmp(line, "end\n") == 0) {
+                        complete = version == CHECKPOINT_VERSION;
+                }
+        }
+        free(line);
+        fclose(fp);
+
+        if (!complete) {
+                fprintf(stderr, "[error] Couldn't read checkpoint %s.\n",
+                    trace_checkpoint.path);
+                return -1;
+        }
+        trace_checkpoint.resumed = true;
+        debug("Resuming at %" PRIu64 ", %" PRIu64 " bytes into the .prv\n",
+            trace_checkpoint.position, trace_checkpoint.output_offset);
+
+        return 0;
+}
+
+/*
+ * Opens the .prv of the conversion being resumed and drops what was
+ * written after the checkpoint.
+ */
+int
+openResumedOutput(const char *path)
+{
+        struct stat sb;
+        int fd;
+
+        if ((fd = open(path, O_WRONLY)) < 0) {
+                return -1;
+        }
+        if (fstat(fd, &sb) < 0 ||
+            (uint64_t) sb.st_size < trace_checkpoint.output_offset) {
+                fprintf(stderr, "[error] %s is shorter than its checkpoint.\n",
+                    path);
+                close(fd);
+                return -1;
+        }
+        if (ftruncate(fd, trace_checkpoint.output_offset) < 0 ||
+            lseek(fd, trace_checkpoint.output_offset, SEEK_SET) < 0) {
+                close(fd);
+                return -1;
+        }
+
+        return fd;
+}
+
+/* Iterator from the event the checkpoint was taken at */
+struct bt_ctf_iter *
+createResumeIter(struct bt_context *bt_ctx)
+{
+        struct bt_iter_pos begin_pos, end_pos;
+
+        begin_pos.type = BT_SEEK_TIME;
+        begin_pos.u.seek_time = trace_checkpoint.position;
+        if (!trace_window.enabled) {
+                return bt_ctf_iter_create(bt_ctx, &begin_pos, NULL);
+        }
+        end_pos.type = BT_SEEK_TIME;
+        end_pos.u.seek_time = trace_window.end;
+
+        return bt_ctf_iter_create(bt_ctx, &begin_pos, &end_pos);
+}
+
+/* Once the conversion is over the checkpoint is of no use */
+void
+removeCheckpoint(void)
+{
+        if (trace_checkpoint.path != NULL &&
+            unlink(trace_checkpoint.path) < 0 && errno != ENOENT) {
+                perror(trace_checkpoint.path);
+        }
+}
+
+void
+freeCheckpoint(void)
+{
+        g_free(trace_checkpoint.path);
+        g_free(trace_checkpoint.trace);
+        if (trace_checkpoint.registries != NULL) {
+                g_string_free(trace_checkpoint.registries, TRUE);
+        }
+        if (trace_checkpoint.appl_id != NULL) {
+                g_array_free(trace_checkpoint.appl_id, TRUE);
+        }
+        if (trace_checkpoint.streams != NULL) {
+                g_array_free(trace_checkpoint.streams, TRUE);
+        }
+        memset(&trace_checkpoint, 0, sizeof(trace_checkpoint));
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,71 @@
+#pragma once
+#ifndef CHECKPOINTTRACE_H
+#define CHECKPOINTTRACE_H
+
+#include <stdbool.h>
+#include <glib.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf/iterator.h>
+
+#include "types.h"
+#include "readPacketContext.h"
+#include "writeRecords.h"
+#include "registerIds.h"
+
+#define CHECKPOINT_VERSION 1
+
+/*
+ * Checkpoints of the two-pass conversion, written to <output>.ckpt. Each
+ * one is taken at a packet boundary, before the first event of the packet
+ * is converted, and holds the registries, the trace clock time of that
+ * event, the .prv bytes written before it, the appl_id of each resource
+ * and the lost event counters of each stream.
+ */
+struct traceCheckpoint
+{
+        /* wall time between checkpoints in ns, 0 if none are taken */
+        uint64_t interval;
+        uint64_t last;
+        char *path;
+        char *trace;
+        /* the registries part, the same in every checkpoint */
+        GString *registries;
+        /* read by loadCheckpoint() */
+        bool resumed;
+        uint64_t position;
+        uint64_t output_offset;
+        GArray *appl_id;
+        GArray *streams;
+};
+
+extern struct traceCheckpoint trace_checkpoint;
+
+void initCheckpoint(const char *_prefix, const char *_trace,
+    uint64_t _interval);
+
+void setCheckpointRegistries(uint32_t _ncpus, uint32_t _nsoftirqs,
+    const struct prvRegistry *_reg);
+
+bool checkpointDue(void);
+
+int saveCheckpoint(struct prvWriter *_w, uint64_t _position,
+    const uint64_t *_appl_id, unsigned int _nresources,
+    const struct packetCache *_packets, const struct packetContext *_current);
+
+int loadCheckpoint(uint32_t *_ncpus, uint32_t *_nsoftirqs,
+    struct prvRegistry *_reg);
+
+int openResumedOutput(const char *_path);
+
+struct bt_ctf_iter *createResumeIter(struct bt_context *_bt_ctx);
+
+void removeCheckpoint(void);
+
+void freeCheckpoint(void);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,206 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "classifyEvents.h"
+#include "filterEvents.h"
+
+/*
+ * Events outside the syscall, irq, softirq and network families that close
+ * a previous one and are printed with value 0.
+ */
+static const char *const exit_events[] =
+{
+        "sched_process_exit",
+        "hrtimer_expire_exit",
+        "timer_expire_exit",
+        "kvm_userspace_exit",
+        "kvm_exit",
+        "ext4_ind_map_blocks_exit",
+        "ext4_ext_map_blocks_exit",
+        "ext4_truncate_exit",
+        "ext4_unlink_exit",
+        "ext4_fallocate_exit",
+        "ext4_direct_IO_exit",
+        "ext4_sync_file_exit"
+};
+
+static void classify_event(const char *_event_name, struct eventClass *_class);
+
+/*
+ * Works out how events named _event_name are converted.
+ */
+static void
+classify_event(const char *event_name, struct eventClass *class)
+{
+        unsigned int i;
+
+        class->name = event_name;
+        /* Add 1 to the event id to reserve 0 for exit */
+        class->event_value = EVENT_VALUE_ID;
+        class->print = 1;
+        class->print_state = 1;
+        class->handler = HANDLER_DEFAULT;
+        class->nest = NEST_NONE;
+        class->flags = 0;
+        class->drop = 0;
+
+        if (strstr(event_name, "sched_switch") != NULL) {
+                class->flags |= CLASS_SWITCH;
+        }
+        if (strstr(event_name, "lttng_statedump_process_state") != NULL) {
+                class->flags |= CLASS_STATEDUMP_PROCESS;
+        }
+        if (strcmp(event_name, "softirq_entry") == 0) {
+                class->flags |= CLASS_SOFTIRQ_ENTRY;
+        }
+        if (strcmp(event_name, "irq_handler_entry") == 0) {
+                class->flags |= CLASS_IRQ_ENTRY;
+        }
+        if (strcmp(event_name, "lttng_statedump_end") == 0) {
+                class->flags |= CLASS_STATEDUMP_END;
+        }
+        if (strcmp(event_name, "sched_process_fork") == 0) {
+                class->flags |= CLASS_PROCESS_FORK;
+        }
+
+        if (strstr(event_name, "syscall_entry_") != NULL) {
+                class->event_type = 10000000;
+                class->state = STATE_SYSCALL;
+                if (strstr(event_name, "syscall_entry_exit") != NULL) {
+                        class->event_value = 0;
+                }
+        } else if (strstr(event_name, "syscall_exit_") != NULL) {
+                class->event_type = 10000000;
+                class->event_value = 0;
+                class->state = STATE_USERMODE;
+        /*
+         * For softirq and irq_handler types we manually specify the
+         * event_value IDs instead of using the one provided by lttng.
+         * This way we always use the same values for these events.
+         */
+        } else if (strstr(event_name, "irq_handler_") != NULL) {
+                class->event_type = 10200000;
+                class->event_value = 1;
+                class->state = STATE_IRQ;
+                class->handler = HANDLER_IRQ;
+                class->nest = NEST_ENTRY;
+                if (strstr(event_name, "irq_handler_exit") != NULL) {
+                        class->event_value = 0;
+                        class->state = STATE_USERMODE;
+                        class->nest = NEST_EXIT;
+                }
+        } else if (strstr(event_name, "softirq_") != NULL) {
+                class->event_type = 10100000;
+                class->event_value = 1;
+                class->state = STATE_SOFTIRQ;
+                class->handler = HANDLER_SOFTIRQ;
+                if (strstr(event_name, "softirq_raise") != NULL) {
+                        class->print = 0;
+                        class->event_value = 2;
+                } else if (strstr(event_name, "softirq_exit") != NULL) {
+                        class->event_value = 0;
+                        class->state = STATE_USERMODE;
+                        class->nest = NEST_EXIT;
+                } else {
+                        class->nest = NEST_ENTRY;
+                }
+        } else if ((strstr(event_name, "netif_") != NULL) ||
+            (strstr(event_name, "net_dev_") != NULL)) {
+                class->event_type = 10300000;
+                class->state = STATE_NETWORK;
+                class->print_state = 0;
+                class->handler = HANDLER_NETWORK;
+        } else if (strcmp(event_name, "sched_switch") == 0) {
+                class->event_type = 10900000;
+                class->state = STATE_USERMODE;
+                class->handler = HANDLER_SCHED_SWITCH;
+        } else if (strcmp(event_name, "sched_wakeup") == 0) {
+                class->event_type = 10900000;
+                class->state = STATE_USERMODE;
+                class->print_state = 0;
+                class->handler = HANDLER_SCHED_WAKEUP;
+        } else if (strcmp(event_name, "sched_process_fork") == 0) {
+                class->event_type = 10900000;
+                class->state = STATE_USERMODE;
+                class->print_state = 0;
+                class->handler = HANDLER_PROCESS_FORK;
+        } else {
+                class->event_type = 10900000;
+                class->state = STATE_USERMODE;
+                class->print_state = 0;
+                for (i = 0; i < G_N_ELEMENTS(exit_events); i++) {
+                        if (strcmp(event_name, exit_events[i]) == 0) {
+                                class->event_value = 0;
+                                break;
+                        }
+                }
+        }
+}
+
+/*
+ * Event classes are keyed by the event name as returned by babeltrace. It
+ * is interned, so the same pointer stands for the same name in every
+ * trace, stream class and context and a pointer lookup replaces string
+ * comparisons. Event ids can't be used, they are only unique per channel.
+ */
+GHashTable *
+createEventClasses(void)
+{
+        return g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+            g_free);
+}
+
+/*
+ * Classifies every event declared by the traces of _bt_ctx
+ */
+void
+fillEventClasses(struct bt_context *bt_ctx, GHashTable *event_class_ht)
+{
+        struct bt_ctf_event_decl *const *list;
+        unsigned int cnt, i;
+        int handle_id;
+        const char *event_name;
+        struct eventClass *class;
+
+        for (handle_id = 0; bt_ctf_get_event_decl_list(handle_id, bt_ctx,
+                &list, &cnt) == 0; handle_id++) {
+                for (i = 0; i < cnt; i++) {
+                        event_name = bt_ctf_get_decl_event_name(list[i]);
+                        if (g_hash_table_contains(event_class_ht,
+                                event_name)) {
+                                continue;
+                        }
+                        class = g_new(struct eventClass, 1);
+                        classify_event(event_name, class);
+                        g_hash_table_insert(event_class_ht,
+                            (gpointer) event_name, class);
+                }
+        }
+}
+
+/*
+ * Returns the class of _event. The table is only read, so it can be shared
+ * by parallel iterators; an event missing from it is classified into
+ * _scratch, which --events filters like the other classes.
+ */
+const struct eventClass *
+getEventClass(GHashTable *event_class_ht, const struct bt_ctf_event *event,
+    struct eventClass *scratch)
+{
+        const char *event_name = bt_ctf_event_name(event);
+        const struct eventClass *class;
+
+        class = g_hash_table_lookup(event_class_ht, event_name);
+        if (G_UNLIKELY(class == NULL)) {
+                classify_event(event_name, scratch);
+                scratch->drop = !keepEvent(event_name);
+                class = scratch;
+        }
+
+        return class;
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,73 @@
+#pragma once
+#ifndef CLASSIFYEVENTS_H
+#define CLASSIFYEVENTS_H
+
+#include <glib.h>
+#include <babeltrace/ctf/events.h>
+
+#include "types.h"
+
+/* event_value taken from the event id */
+#define EVENT_VALUE_ID UINT64_MAX
+
+/* How iter_trace() handles an event class */
+enum
+{
+        HANDLER_DEFAULT = 0,
+        HANDLER_IRQ,
+        HANDLER_SOFTIRQ,
+        HANDLER_NETWORK,
+        HANDLER_SCHED_SWITCH,
+        HANDLER_SCHED_WAKEUP,
+        HANDLER_PROCESS_FORK
+};
+
+/* Where an IRQ or softirq event leaves the handler, for --state-records */
+enum
+{
+        NEST_NONE = 0,
+        NEST_ENTRY,
+        NEST_EXIT
+};
+
+/* What updateThreadInfo() learns from an event class */
+#define CLASS_SWITCH            (1 << 0)
+#define CLASS_STATEDUMP_PROCESS (1 << 1)
+#define CLASS_SOFTIRQ_ENTRY     (1 << 2)
+#define CLASS_IRQ_ENTRY         (1 << 3)
+#define CLASS_STATEDUMP_END     (1 << 4)
+#define CLASS_PROCESS_FORK      (1 << 5)
+
+/*
+ * Conversion of every event of a given name, worked out once from the
+ * name instead of for each event.
+ */
+struct eventClass
+{
+        const char *name;
+        uint64_t event_type;
+        uint64_t event_value;
+        unsigned int state;
+        short int print;
+        short int print_state;
+        unsigned int handler;
+        unsigned int nest;
+        unsigned int flags;
+        /* left out by --events */
+        short int drop;
+};
+
+GHashTable *createEventClasses(void);
+
+void fillEventClasses(struct bt_context *_bt_ctx,
+    GHashTable *_event_class_ht);
+
+const struct eventClass *getEventClass(GHashTable *_event_class_ht,
+    const struct bt_ctf_event *_event, struct eventClass *_scratch);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
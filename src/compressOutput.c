@@ -0,0 +1,325 @@
+/* Streaming compression of the .prv output */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "compressOutput.h"
+#include "writeRecords.h"
+
+/* Smallest input worth a gzip member of its own */
+#define GZ_MIN_CHUNK (256 << 10)
+
+#define GZ_LEVEL 6
+#define ZSTD_LEVEL 3
+
+#ifdef HAVE_ZLIB
+/* Part of a buffer deflated by one thread */
+struct gzChunk
+{
+        int level;
+        const char *in;
+        size_t len;
+        char *out;
+        size_t cap;
+        size_t outlen;
+        int ret;
+        GThread *thread;
+};
+#endif
+
+struct prvCompressor
+{
+        int kind;
+        int fd;
+        unsigned int threads;
+        int finished;
+        uint64_t out_bytes;
+#ifdef HAVE_ZLIB
+        struct gzChunk *chunks;
+#endif
+#ifdef HAVE_ZSTD
+        ZSTD_CCtx *cctx;
+        char *out;
+        size_t cap;
+#endif
+};
+
+int
+compressAvailable(int kind)
+{
+        switch (kind) {
+        case COMPRESS_NONE:
+                return 1;
+#ifdef HAVE_ZLIB
+        case COMPRESS_GZ:
+                return 1;
+#endif
+#ifdef HAVE_ZSTD
+        case COMPRESS_ZSTD:
+                return 1;
+#endif
+        default:
+                return 0;
+        }
+}
+
+const char *
+compressSuffix(int kind)
+{
+        switch (kind) {
+        case COMPRESS_GZ:
+                return ".gz";
+        case COMPRESS_ZSTD:
+                return ".zst";
+        default:
+                return "";
+        }
+}
+
+static int
+write_out(struct prvCompressor *c, const char *buf, size_t len)
+{
+        c->out_bytes += len;
+
+        return writeFully(c->fd, buf, len);
+}
+
+#ifdef HAVE_ZLIB
+/*
+ * Deflates a chunk into a complete gzip member. Concatenated members are
+ * a valid gzip file, so chunks can be compressed independently.
+ */
+static gpointer
+deflate_chunk(gpointer data)
+{
+        struct gzChunk *chunk = data;
+        z_stream zs;
+        size_t bound;
+
+        memset(&zs, 0, sizeof(zs));
+        chunk->ret = -1;
+        if (deflateInit2(&zs, chunk->level, Z_DEFLATED, 15 + 16, 8,
+                Z_DEFAULT_STRATEGY) != Z_OK) {
+                return NULL;
+        }
+
+        bound = deflateBound(&zs, chunk->len);
+        if (bound > chunk->cap) {
+                free(chunk->out);
+                chunk->out = malloc(bound);
+                chunk->cap = chunk->out ? bound : 0;
+        }
+        if (chunk->out != NULL) {
+                zs.next_in = (Bytef *) chunk->in;
+                zs.avail_in = chunk->len;
+                zs.next_out = (Bytef *) chunk->out;
+                zs.avail_out = chunk->cap;
+                if (deflate(&zs, Z_FINISH) == Z_STREAM_END) {
+                        chunk->outlen = chunk->cap - zs.avail_out;
+                        chunk->ret = 0;
+                }
+        }
+        deflateEnd(&zs);
+
+        return NULL;
+}
+
+/* Splits _buf among the threads, one gzip member each */
+static int
+gz_write(struct prvCompressor *c, const char *buf, size_t len)
+{
+        unsigned int n, i;
+        size_t chunk_len;
+        int ret = 0;
+
+        n = MIN(c->threads, MAX(1, len / GZ_MIN_CHUNK));
+        chunk_len = (len + n - 1) / n;
+
+        for (i = 0; i < n; i++) {
+                struct gzChunk *chunk = &c->chunks[i];
+
+                chunk->level = GZ_LEVEL;
+                chunk->in = buf + i * chunk_len;
+                chunk->len = MIN(chunk_len, len - i * chunk_len);
+                chunk->thread = NULL;
+                if (i > 0) {
+                        chunk->thread = g_thread_new("lttng2prv-gzip",
+                            deflate_chunk, chunk);
+                }
+        }
+        /* the calling thread takes the first chunk */
+        deflate_chunk(&c->chunks[0]);
+
+        for (i = 0; i < n; i++) {
+                struct gzChunk *chunk = &c->chunks[i];
+
+                if (chunk->thread != NULL) {
+                        g_thread_join(chunk->thread);
+                }
+                if (ret == 0 && chunk->ret < 0) {
+                        fprintf(stderr, "[error] gzip compression failed.\n");
+                        ret = -1;
+                }
+                if (ret == 0) {
+                        ret = write_out(c, chunk->out, chunk->outlen);
+                }
+        }
+
+        return ret;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static int
+zstd_stream(struct prvCompressor *c, const char *buf, size_t len,
+    ZSTD_EndDirective mode)
+{
+        ZSTD_inBuffer in = { buf, len, 0 };
+        ZSTD_outBuffer out;
+        size_t rem;
+
+        do {
+                out.dst = c->out;
+                out.size = c->cap;
+                out.pos = 0;
+                rem = ZSTD_compressStream2(c->cctx, &out, &in, mode);
+                if (ZSTD_isError(rem)) {
+                        fprintf(stderr, "[error] zstd: %s\n",
+                            ZSTD_getErrorName(rem));
+                        return -1;
+                }
+                if (write_out(c, c->out, out.pos) < 0) {
+                        return -1;
+                }
+        } while (mode == ZSTD_e_end ? rem != 0 : in.pos < in.size);
+
+        return 0;
+}
+#endif
+
+/*
+ * Compressor writing a _kind stream to _fd with up to _threads threads.
+ * Returns NULL if _kind wasn't built in.
+ */
+struct prvCompressor *
+createCompressor(int kind, int fd, unsigned int threads)
+{
+        struct prvCompressor *c;
+
+        if (kind == COMPRESS_NONE || !compressAvailable(kind)) {
+                return NULL;
+        }
+
+        c = g_new0(struct prvCompressor, 1);
+        c->kind = kind;
+        c->fd = fd;
+        c->threads = MAX(1, threads);
+
+#ifdef HAVE_ZLIB
+        if (kind == COMPRESS_GZ) {
+                c->chunks = g_new0(struct gzChunk, c->threads);
+        }
+#endif
+#ifdef HAVE_ZSTD
+        if (kind == COMPRESS_ZSTD) {
+                c->cctx = ZSTD_createCCtx();
+                ZSTD_CCtx_setParameter(c->cctx, ZSTD_c_compressionLevel,
+                    ZSTD_LEVEL);
+                /* fails on a single-threaded libzstd, which is fine */
+                if (c->threads > 1) {
+                        ZSTD_CCtx_setParameter(c->cctx, ZSTD_c_nbWorkers,
+                            c->threads);
+                }
+                c->cap = ZSTD_CStreamOutSize();
+                c->out = malloc(c->cap);
+        }
+#endif
+
+        return c;
+}
+
+int
+compressWrite(struct prvCompressor *c, const char *buf, size_t len)
+{
+        if (len == 0) {
+                return 0;
+        }
+
+        switch (c->kind) {
+#ifdef HAVE_ZLIB
+        case COMPRESS_GZ:
+                return gz_write(c, buf, len);
+#endif
+#ifdef HAVE_ZSTD
+        case COMPRESS_ZSTD:
+                return zstd_stream(c, buf, len, ZSTD_e_continue);
+#endif
+        default:
+                return -1;
+        }
+}
+
+/* Ends the compressed stream, once everything has been written */
+int
+compressFinish(struct prvCompressor *c)
+{
+        if (c->finished) {
+                return 0;
+        }
+        c->finished = 1;
+
+#ifdef HAVE_ZSTD
+        if (c->kind == COMPRESS_ZSTD) {
+                return zstd_stream(c, NULL, 0, ZSTD_e_end);
+        }
+#endif
+
+        return 0;
+}
+
+uint64_t
+compressedBytes(const struct prvCompressor *c)
+{
+        return c->out_bytes;
+}
+
+void
+destroyCompressor(struct prvCompressor *c)
+{
+#ifdef HAVE_ZLIB
+        unsigned int i;
+#endif
+
+        if (c == NULL) {
+                return;
+        }
+#ifdef HAVE_ZLIB
+        if (c->chunks != NULL) {
+                for (i = 0; i < c->threads; i++) {
+                        free(c->chunks[i].out);
+                }
+                g_free(c->chunks);
+        }
+#endif
+#ifdef HAVE_ZSTD
+        ZSTD_freeCCtx(c->cctx);
+        free(c->out);
+#endif
+        g_free(c);
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,38 @@
+#pragma once
+#ifndef COMPRESSOUTPUT_H
+#define COMPRESSOUTPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Compression of the .prv output */
+enum
+{
+        COMPRESS_NONE = 0,
+        COMPRESS_GZ,
+        COMPRESS_ZSTD
+};
+
+struct prvCompressor;
+
+int compressAvailable(int _kind);
+
+const char *compressSuffix(int _kind);
+
+struct prvCompressor *createCompressor(int _kind, int _fd,
+    unsigned int _threads);
+
+int compressWrite(struct prvCompressor *_c, const char *_buf, size_t _len);
+
+int compressFinish(struct prvCompressor *_c);
+
+uint64_t compressedBytes(const struct prvCompressor *_c);
+
+void destroyCompressor(struct prvCompressor *_c);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
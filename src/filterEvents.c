@@ -0,0 +1,247 @@
+/* Selection of the CPUs, threads and events converted */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "filterEvents.h"
+#include "classifyEvents.h"
+
+struct traceFilter trace_filter;
+
+/* Event families --events accepts by name */
+static const struct
+{
+        const char *name;
+        const char *patterns;
+} event_categories[] =
+{
+        { "syscall", "*syscall_*" },
+        { "irq", "irq_handler_*" },
+        { "softirq", "softirq_*" },
+        { "net", "net_dev_*,netif_*" },
+        { "sched", "sched_*" },
+        { "timer", "timer_*,hrtimer_*" },
+        { "block", "block_*" },
+        { "statedump", "lttng_statedump_*" }
+};
+
+/*
+ * Parses a comma separated list of ids and ranges such as 0-3,8 into _set.
+ */
+int
+parseIdList(const char *arg, GHashTable **set)
+{
+        char *end;
+        uint64_t first, last, id;
+
+        if (arg == NULL || *arg == '\0') {
+                return -1;
+        }
+        if (*set == NULL) {
+                *set = g_hash_table_new(g_direct_hash, g_direct_equal);
+        }
+
+        while (*arg != '\0') {
+                first = strtoul(arg, &end, 10);
+                if (end == arg) {
+                        return -1;
+                }
+                last = first;
+                if (*end == '-') {
+                        arg = end + 1;
+                        last = strtoul(arg, &end, 10);
+                        if (end == arg || last < first) {
+                                return -1;
+                        }
+                }
+                for (id = first; id <= last; id++) {
+                        g_hash_table_add(*set, GINT_TO_POINTER(id));
+                }
+
+                if (*end == ',') {
+                        end++;
+                } else if (*end != '\0') {
+                        return -1;
+                }
+                arg = end;
+        }
+
+        return 0;
+}
+
+/*
+ * Parses a comma separated list of event name globs and categories.
+ */
+int
+parseEventList(const char *arg)
+{
+        gchar **items, **patterns;
+        unsigned int i, j;
+
+        if (arg == NULL || *arg == '\0') {
+                return -1;
+        }
+        if (trace_filter.events == NULL) {
+                trace_filter.events = g_ptr_array_new_with_free_func(
+                    (GDestroyNotify) g_pattern_spec_free);
+        }
+
+        items = g_strsplit(arg, ",", -1);
+        for (i = 0; items[i] != NULL; i++) {
+                if (*items[i] == '\0') {
+                        continue;
+                }
+                for (j = 0; j < G_N_ELEMENTS(event_categories); j++) {
+                        if (strcmp(items[i], event_categories[j].name) == 0) {
+                                break;
+                        }
+                }
+                if (j == G_N_ELEMENTS(event_categories)) {
+                        g_ptr_array_add(trace_filter.events,
+                            g_pattern_spec_new(items[i]));
+                        continue;
+                }
+                patterns = g_strsplit(event_categories[j].patterns, ",", -1);
+                for (j = 0; patterns[j] != NULL; j++) {
+                        g_ptr_array_add(trace_filter.events,
+                            g_pattern_spec_new(patterns[j]));
+                }
+                g_strfreev(patterns);
+        }
+        g_strfreev(items);
+
+        return 0;
+}
+
+/*
+ * For createShadowTrace(), keeps the stream files of the selected CPUs and
+ * those not tied to a CPU.
+ */
+gboolean
+keepStream(const struct streamFile *file, gpointer data)
+{
+        UNUSED(data);
+
+        return file->cpu < 0 || trace_filter.cpus == NULL ||
+            g_hash_table_contains(trace_filter.cpus,
+                GINT_TO_POINTER(file->cpu));
+}
+
+bool
+filterThreads(void)
+{
+        return trace_filter.tids != NULL || trace_filter.pids != NULL;
+}
+
+void
+learnThreadPid(uint32_t tid, uint32_t pid)
+{
+        if (trace_filter.pids == NULL) {
+                return;
+        }
+        if (trace_filter.tid_pid == NULL) {
+                trace_filter.tid_pid = g_hash_table_new(g_direct_hash,
+                    g_direct_equal);
+        }
+        g_hash_table_insert(trace_filter.tid_pid, GINT_TO_POINTER(tid),
+            GINT_TO_POINTER(pid));
+}
+
+/*
+ * A thread is kept if it was selected or its process was. The process of
+ * a thread is only known once its statedump or fork event has been seen.
+ */
+bool
+keepThread(uint32_t tid)
+{
+        gpointer pid;
+
+        if (!filterThreads()) {
+                return true;
+        }
+        if (trace_filter.tids != NULL &&
+            g_hash_table_contains(trace_filter.tids, GINT_TO_POINTER(tid))) {
+                return true;
+        }
+        if (trace_filter.pids != NULL && trace_filter.tid_pid != NULL &&
+            g_hash_table_lookup_extended(trace_filter.tid_pid,
+                GINT_TO_POINTER(tid), NULL, &pid)) {
+                return g_hash_table_contains(trace_filter.pids, pid);
+        }
+
+        return false;
+}
+
+/*
+ * An event is kept if --events wasn't given or one of its patterns matches
+ * the event name.
+ */
+bool
+keepEvent(const char *event_name)
+{
+        unsigned int i;
+
+        if (trace_filter.events == NULL) {
+                return true;
+        }
+        for (i = 0; i < trace_filter.events->len; i++) {
+                if (g_pattern_match_string(
+                        g_ptr_array_index(trace_filter.events, i),
+                        event_name)) {
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+/*
+ * Marks the classes left out by --events. Their events are still read for
+ * the thread information, but no record is made of them.
+ */
+void
+filterEventClasses(GHashTable *event_class_ht)
+{
+        GHashTableIter iter;
+        gpointer key, value;
+        struct eventClass *class;
+
+        if (trace_filter.events == NULL) {
+                return;
+        }
+
+        g_hash_table_iter_init(&iter, event_class_ht);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+                class = value;
+                class->drop = !keepEvent(class->name);
+                if (class->drop) {
+                        debug("Leaving out %s\n", class->name);
+                }
+        }
+}
+
+void
+freeFilter(void)
+{
+        if (trace_filter.cpus != NULL) {
+                g_hash_table_destroy(trace_filter.cpus);
+        }
+        if (trace_filter.tids != NULL) {
+                g_hash_table_destroy(trace_filter.tids);
+        }
+        if (trace_filter.pids != NULL) {
+                g_hash_table_destroy(trace_filter.pids);
+        }
+        if (trace_filter.tid_pid != NULL) {
+                g_hash_table_destroy(trace_filter.tid_pid);
+        }
+        if (trace_filter.events != NULL) {
+                g_ptr_array_free(trace_filter.events, TRUE);
+        }
+        memset(&trace_filter, 0, sizeof(trace_filter));
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
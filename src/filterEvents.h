@@ -0,0 +1,52 @@
+#pragma once
+#ifndef FILTEREVENTS_H
+#define FILTEREVENTS_H
+
+#include <stdbool.h>
+#include <glib.h>
+
+#include "types.h"
+#include "streamFiles.h"
+
+/*
+ * What --cpus, --tids, --pids and --events keep of the trace. NULL sets
+ * keep everything. Only written before the conversion starts, except
+ * tid_pid which is only filled by the pre-pass.
+ */
+struct traceFilter
+{
+        GHashTable *cpus;
+        GHashTable *tids;
+        GHashTable *pids;
+        /* glob patterns on event names */
+        GPtrArray *events;
+        /* process of each thread, learnt from statedump and fork events */
+        GHashTable *tid_pid;
+};
+
+extern struct traceFilter trace_filter;
+
+int parseIdList(const char *_arg, GHashTable **_set);
+
+int parseEventList(const char *_arg);
+
+gboolean keepStream(const struct streamFile *_file, gpointer _data);
+
+bool filterThreads(void);
+
+void learnThreadPid(uint32_t _tid, uint32_t _pid);
+
+bool keepThread(uint32_t _tid);
+
+bool keepEvent(const char *_event_name);
+
+void filterEventClasses(GHashTable *_event_class_ht);
+
+void freeFilter(void);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
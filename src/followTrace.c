@@ -0,0 +1,350 @@
+/* --follow, conversion of rotated trace chunks as they are archived */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "followTrace.h"
+#include "lttng2prv.h"
+#include "classifyEvents.h"
+#include "filterEvents.h"
+
+/* Time between two scans without inotify events, in ms */
+#define FOLLOW_POLL_INTERVAL 1000
+
+/* Scans an unopenable chunk is retried on before the run fails */
+#define FOLLOW_RETRIES 5
+
+struct traceFollow trace_follow;
+
+struct traceChunk
+{
+        unsigned long id;
+        char *path;
+};
+
+static volatile sig_atomic_t follow_stop;
+
+static void stop_following(int _signum);
+
+static bool chunk_id(const char *_name, unsigned long *_id);
+
+static gint compare_chunks(gconstpointer _a, gconstpointer _b);
+
+static void free_chunk(gpointer _chunk);
+
+static void list_chunks(const char *_dir, GPtrArray *_chunks);
+
+static bool wait_chunks(int _fd);
+
+static int convert_chunk(const struct traceChunk *_chunk,
+    struct bt_context **_ctx, FILE *_spool, struct prvRegistry *_reg,
+    uint32_t *_ncpus, uint32_t *_nsoftirqs, GHashTable *_arg_types_ht,
+    GHashTable *_event_class_ht);
+
+static void
+stop_following(int signum)
+{
+        UNUSED(signum);
+
+        follow_stop = 1;
+}
+
+/*
+ * Archived chunks are named <begin>-<end>-<id>, with both times as
+ * YYYYmmddTHHMMSS+HHMM. The chunk being written has no end time.
+ */
+static bool
+chunk_id(const char *name, unsigned long *id)
+{
+        const char *p;
+        char *end;
+        unsigned int times = 0;
+
+        for (p = name; *p != '\0'; p++) {
+                if (*p == 'T') {
+                        times++;
+                }
+        }
+        p = strrchr(name, '-');
+        if (times != 2 || p == NULL || p[1] == '\0') {
+                return false;
+        }
+        *id = strtoul(p + 1, &end, 10);
+
+        return *end == '\0';
+}
+
+static gint
+compare_chunks(gconstpointer a, gconstpointer b)
+{
+        const struct traceChunk *ca = *(struct traceChunk *const *) a;
+        const struct traceChunk *cb = *(struct traceChunk *const *) b;
+
+        return (ca->id > cb->id) - (ca->id < cb->id);
+}
+
+static void
+free_chunk(gpointer chunk)
+{
+        g_free(((struct traceChunk *) chunk)->path);
+        g_free(chunk);
+}
+
+/* Adds the archived chunks in _dir to _chunks */
+static void
+list_chunks(const char *dir, GPtrArray *chunks)
+{
+        DIR *d;
+        struct dirent *entry;
+        struct traceChunk *chunk;
+        unsigned long id;
+        char *path;
+
+        if (!(d = opendir(dir))) {
+                return;
+        }
+        while ((entry = readdir(d)) != NULL) {
+                if (!chunk_id(entry->d_name, &id)) {
+                        continue;
+                }
+                path = g_build_filename(dir, entry->d_name, NULL);
+                if (!g_file_test(path, G_FILE_TEST_IS_DIR)) {
+                        g_free(path);
+                        continue;
+                }
+                chunk = g_new(struct traceChunk, 1);
+                chunk->id = id;
+                chunk->path = path;
+                g_ptr_array_add(chunks, chunk);
+        }
+        closedir(d);
+}
+
+/*
+ * Waits for something to change in the watched directories, or a signal.
+ * Returns false once the session directory is gone.
+ */
+static bool
+wait_chunks(int fd)
+{
+        char buf[4096]
+            __attribute__ ((aligned(__alignof__(struct inotify_event))));
+        const struct inotify_event *ev;
+        struct pollfd pfd;
+        ssize_t len;
+        char *p;
+        bool alive = true;
+
+        if (fd < 0) {
+                usleep(FOLLOW_POLL_INTERVAL * 1000);
+                return true;
+        }
+
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        /* a signal just before poll() would not interrupt it */
+        if (poll(&pfd, 1, FOLLOW_POLL_INTERVAL) <= 0) {
+                return true;
+        }
+        while ((len = read(fd, buf, sizeof(buf))) > 0) {
+                for (p = buf; p < buf + len;
+                    p += sizeof(struct inotify_event) + ev->len) {
+                        ev = (const struct inotify_event *) p;
+                        if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF) &&
+                            ev->wd == 1) {
+                                alive = false;
+                        }
+                }
+        }
+
+        return alive;
+}
+
+/*
+ * Converts one chunk into the spool, keeping its context in *_ctx for the
+ * .pcf once it is the last one. Returns -1, having spooled nothing, if it
+ * can't be opened.
+ */
+static int
+convert_chunk(const struct traceChunk *chunk, struct bt_context **ctx,
+    FILE *spool, struct prvRegistry *reg, uint32_t *ncpus,
+    uint32_t *nsoftirqs, GHashTable *arg_types_ht,
+    GHashTable *event_class_ht)
+{
+        struct bt_context *chunk_ctx;
+
+        chunk_ctx = bt_context_create();
+        if (bt_context_add_traces_recursive(chunk_ctx, chunk->path, "ctf",
+                NULL) < 0) {
+                fprintf(stderr, "[warning] Couldn't open chunk %s.\n",
+                    chunk->path);
+                bt_context_put(chunk_ctx);
+                return -1;
+        }
+        fillEventClasses(chunk_ctx, event_class_ht);
+        filterEventClasses(event_class_ht);
+
+        iter_trace(chunk_ctx, NULL, spool, NULL, true, reg, ncpus,
+            nsoftirqs, arg_types_ht, event_class_ht);
+        trace_follow.chunks++;
+        debug("Converted chunk %lu, %s\n", chunk->id, chunk->path);
+
+        bt_context_put(*ctx);
+        *ctx = chunk_ctx;
+
+        return 0;
+}
+
+/*
+ * Converts the chunks archived under _session, or in _session itself,
+ * in order as they show up until SIGINT or SIGTERM, or until the session
+ * directory is removed. Chunks archived before the signal are converted.
+ * A chunk that can't be opened, maybe not fully archived yet, is tried
+ * again on the next scans before the chunks after it; the run fails if it
+ * never opens.
+ */
+int
+followTrace(const char *session, struct bt_context **ctx, FILE *spool,
+    struct prvRegistry *reg, uint32_t *ncpus, uint32_t *nsoftirqs,
+    GHashTable *arg_types_ht, GHashTable *event_class_ht)
+{
+        struct sigaction sa, old_int, old_term;
+        GPtrArray *chunks;
+        struct traceChunk *chunk;
+        char *archives;
+        unsigned long next = 0, failed = 0;
+        unsigned int i, retries = 0;
+        int fd, archives_wd = -1;
+        bool stop, alive = true;
+
+        trace_follow.enabled = true;
+        trace_follow.cpu_appl = g_array_new(FALSE, TRUE, sizeof(uint64_t));
+
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = stop_following;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGINT, &sa, &old_int);
+        sigaction(SIGTERM, &sa, &old_term);
+
+        /* the session directory is always the first watch */
+        archives = g_build_filename(session, "archives", NULL);
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd >= 0 && inotify_add_watch(fd, session, IN_CREATE |
+                IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF) < 0) {
+                close(fd);
+                fd = -1;
+        }
+        if (fd < 0) {
+                fprintf(stderr, "[warning] Couldn't watch %s, checking it "
+                    "every %d ms.\n", session, FOLLOW_POLL_INTERVAL);
+        }
+
+        do {
+                stop = follow_stop;
+
+                /* archives/ is created by the first rotation */
+                if (fd >= 0 && archives_wd < 0) {
+                        archives_wd = inotify_add_watch(fd, archives,
+                            IN_CREATE | IN_MOVED_TO);
+                }
+
+                chunks = g_ptr_array_new_with_free_func(free_chunk);
+                list_chunks(session, chunks);
+                list_chunks(archives, chunks);
+                g_ptr_array_sort(chunks, compare_chunks);
+                for (i = 0; i < chunks->len; i++) {
+                        chunk = g_ptr_array_index(chunks, i);
+                        if (chunk->id < next) {
+                                continue;
+                        }
+                        if (convert_chunk(chunk, ctx, spool, reg, ncpus,
+                                nsoftirqs, arg_types_ht,
+                                event_class_ht) < 0) {
+                                retries = chunk->id == failed ?
+                                    retries + 1 : 1;
+                                failed = chunk->id;
+                                break;
+                        }
+                        retries = 0;
+                        next = chunk->id + 1;
+                }
+                g_ptr_array_free(chunks, TRUE);
+
+                if (!stop && alive && retries <= FOLLOW_RETRIES) {
+                        alive = wait_chunks(fd);
+                }
+        } while (!stop && alive && retries <= FOLLOW_RETRIES);
+
+        if (fd >= 0) {
+                close(fd);
+        }
+        g_free(archives);
+        sigaction(SIGINT, &old_int, NULL);
+        sigaction(SIGTERM, &old_term, NULL);
+
+        if (retries > 0) {
+                fprintf(stderr, "[error] Couldn't open chunk %lu of %s.\n",
+                    failed, session);
+                return -1;
+        }
+        if (trace_follow.chunks == 0) {
+                fprintf(stderr, "[error] No trace chunk was archived in "
+                    "%s.\n", session);
+                return -1;
+        }
+
+        return 0;
+}
+
+/*
+ * Keeps the lost event counters of the streams of the chunk just read, and
+ * those of the streams it didn't have, for the next chunk
+ */
+void
+keepFollowStreams(const struct packetCache *packets)
+{
+        GArray *states;
+        struct streamState *state;
+        unsigned int i;
+
+        states = g_array_new(FALSE, FALSE, sizeof(struct streamState));
+        getStreamStates(packets, NULL, states);
+        for (i = 0; trace_follow.streams != NULL &&
+            i < trace_follow.streams->len; i++) {
+                state = &g_array_index(trace_follow.streams,
+                    struct streamState, i);
+                if (!state->used) {
+                        g_array_append_val(states, *state);
+                }
+        }
+        if (trace_follow.streams != NULL) {
+                g_array_free(trace_follow.streams, TRUE);
+        }
+        trace_follow.streams = states;
+}
+
+void
+freeFollow(void)
+{
+        if (trace_follow.cpu_appl != NULL) {
+                g_array_free(trace_follow.cpu_appl, TRUE);
+        }
+        if (trace_follow.streams != NULL) {
+                g_array_free(trace_follow.streams, TRUE);
+        }
+        memset(&trace_follow, 0, sizeof(trace_follow));
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,48 @@
+#pragma once
+#ifndef FOLLOWTRACE_H
+#define FOLLOWTRACE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <glib.h>
+#include <babeltrace/ctf/events.h>
+
+#include "types.h"
+#include "registerIds.h"
+#include "readPacketContext.h"
+
+/*
+ * Conversion of a session rotated with "lttng rotate", one trace chunk at
+ * a time as they are archived. Chunks are spooled like a single-pass
+ * conversion: the registries only grow, and the application running on
+ * each CPU and the lost event counters of each stream are carried from one
+ * chunk to the next through this state, read by iter_trace().
+ */
+struct traceFollow
+{
+        bool enabled;
+        /* chunks converted so far */
+        unsigned int chunks;
+        /* spooled appl_id of each CPU at the end of the last chunk */
+        GArray *cpu_appl;
+        /* struct streamState of each stream at the end of the last chunk */
+        GArray *streams;
+};
+
+extern struct traceFollow trace_follow;
+
+int followTrace(const char *_session, struct bt_context **_ctx,
+    FILE *_spool, struct prvRegistry *_reg, uint32_t *_ncpus,
+    uint32_t *_nsoftirqs, GHashTable *_arg_types_ht,
+    GHashTable *_event_class_ht);
+
+void keepFollowStreams(const struct packetCache *_packets);
+
+void freeFollow(void);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
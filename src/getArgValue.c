@@ -4,61 +4,125 @@
 #include <string.h>
 #include <babeltrace/ctf/events.h>
 
+#include "writeRecords.h"
+
+/* An argument printed for every event of a declaration */
+struct argField
+{
+        unsigned int index;
+        uint64_t type;
+        int is_signed;
+};
+
+/*
+ * Arguments of an event declaration, resolved from the first event seen.
+ * The field list of a declaration has always the same layout, so the
+ * fields to print are kept by index.
+ */
+struct argPlan
+{
+        unsigned int count;
+        unsigned int nargs;
+        struct argField args[];
+};
+
+/*
+ * Plans are keyed by event declaration, which belongs to the context that
+ * read it: each iterator keeps its own table and nothing is shared between
+ * parallel iterators.
+ */
+GHashTable *
+createArgPlans(void)
+{
+        return g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+            g_free);
+}
+
+static struct argPlan *
+build_plan(struct bt_definition *const *fieldList, unsigned int count,
+    GHashTable *arg_types_ht)
+{
+        struct argPlan *plan;
+        unsigned int iter;
+        gpointer type;
+        const struct bt_declaration *fieldDecl;
+
+        plan = g_malloc(sizeof(struct argPlan) +
+            count * sizeof(struct argField));
+        plan->count = count;
+        plan->nargs = 0;
+
+        for (iter = 0; iter < count; iter++)
+        {
+                type = g_hash_table_lookup(arg_types_ht,
+                    bt_ctf_field_name(fieldList[iter]));
+                fieldDecl = bt_ctf_get_decl_from_def(fieldList[iter]);
+
+                /*
+                 * Only integers are printed. Checking the type up front
+                 * instead of relying on the field error, which is global
+                 * to babeltrace, keeps this safe when several iterators
+                 * run in parallel.
+                 */
+                if ((type != NULL) &&
+                    (bt_ctf_field_type(fieldDecl) == CTF_TYPE_INTEGER))
+                {
+                        plan->args[plan->nargs].index = iter;
+                        plan->args[plan->nargs].type = GPOINTER_TO_INT(type);
+                        plan->args[plan->nargs].is_signed =
+                            bt_ctf_get_int_signedness(fieldDecl);
+                        plan->nargs++;
+                }
+        }
+
+        return plan;
+}
+
+/*
+ * Appends the ":<type>:<value>" pairs of the arguments of _event to the
+ * record being written to _w.
+ */
 void
 getArgValue(struct bt_ctf_event *event, uint64_t event_type,
-    GHashTable *arg_types_ht, char *fields)
+    GHashTable *arg_types_ht, GHashTable *arg_plans_ht, struct prvWriter *w)
 {
         const struct bt_definition *scope;
         struct bt_definition **fieldList;
         unsigned int count = 0;
         unsigned int iter;
-        gpointer type;
-        const struct bt_declaration *fieldDecl;
-        int64_t intval = 0;
-        uint64_t uintval = 0;
-
+        struct bt_ctf_event_decl *decl;
+        struct argPlan *plan;
+        const struct argField *arg;
 
         scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
-        bt_ctf_get_field_list(event, scope,
-            (const struct bt_definition * const **)&fieldList, &count);
 
-        if (!bt_ctf_field_get_error())
+        if (bt_ctf_get_field_list(event, scope,
+                (const struct bt_definition * const **)&fieldList,
+                &count) != 0)
         {
-                for (iter = 0; iter < count; iter++)
-                {
-                        type = g_hash_table_lookup(arg_types_ht,
-                            bt_ctf_field_name(fieldList[iter]));
-                        fieldDecl = bt_ctf_get_decl_from_def(fieldList[iter]);
-
-                        if (type != NULL)
-                        {
-                                if (bt_ctf_get_int_signedness(fieldDecl))
-                                {
-                                        intval = bt_ctf_get_int64(fieldList[iter]);
-                                        if (!bt_ctf_field_get_error())
-                                        {
-                                                sprintf(
-                                                    fields + strlen(fields),
-                                                    ":%lu:%li",
-                                                    event_type +
-                                                    GPOINTER_TO_INT(type),
-                                                    intval);
-                                        }
-                                }else
-                                {
-                                        uintval = bt_ctf_get_uint64(fieldList[iter]);
-                                        if (!bt_ctf_field_get_error())
-                                        {
-                                                sprintf(
-                                                    fields + strlen(fields),
-                                                    ":%lu:%lu",
-                                                    event_type +
-                                                    GPOINTER_TO_INT(type),
-                                                    uintval);
-                                        }
-                                }
-                        }
-                }
+                return;
+        }
+
+        decl = bt_ctf_event_get_decl(event);
+        plan = g_hash_table_lookup(arg_plans_ht, decl);
+        if (G_UNLIKELY(plan == NULL))
+        {
+                plan = build_plan(fieldList, count, arg_types_ht);
+                g_hash_table_insert(arg_plans_ht, decl, plan);
+        }
+
+        if (G_UNLIKELY(plan->count != count))
+                return;
+
+        for (iter = 0; iter < plan->nargs; iter++)
+        {
+                arg = &plan->args[iter];
+                writeChar(w, ':');
+                writeField(w, event_type + arg->type);
+                if (arg->is_signed)
+                        writeInt(w, bt_ctf_get_int64(fieldList[arg->index]));
+                else
+                        writeUint(w, bt_ctf_get_uint64(fieldList[arg->index]));
         }
 }
 
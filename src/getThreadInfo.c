@@ -1,11 +1,23 @@
+#include <inttypes.h>
+#include <stdio.h>
+
 #include "types.h"
 #include "getThreadInfo.h"
+#include "lttng2prv.h"
+#include "classifyEvents.h"
+#include "readPacketContext.h"
+#include "seekWindow.h"
+#include "filterEvents.h"
+#include "reportProgress.h"
+#include "registerIds.h"
+#include "readEvents.h"
+#include "mapTrace.h"
 
 enum bt_cb_ret
 handle_exit_syscall(struct bt_ctf_event *call_data, void *private_data)
 {
         UNUSED(private_data);
-        static const struct bt_definition *scope;
+        const struct bt_definition *scope;
         uint64_t ret;
 
         scope = bt_ctf_get_top_level_scope(call_data, BT_EVENT_FIELDS);
@@ -25,152 +37,216 @@ error:
         return BT_CB_ERROR_STOP;
 }
 
+/*
+ * Registers thread _tid named _name if it is not filtered out. Paraver
+ * identifiers are assigned in order of appearance, a known thread takes
+ * the new name.
+ */
 void
-getThreadInfo(struct bt_context *ctx, uint32_t *ncpus,
-    GHashTable *tid_info_ht, GHashTable *tid_prv_ht, GList **tid_prv_l,
-    GHashTable *irq_name_ht, uint32_t *nsoftirqs, GHashTable *irq_prv_ht,
-    GList **irq_prv_l, GHashTable *lost_events_ht)
+registerThread(uint32_t tid, const char *name, struct prvRegistry *reg)
 {
+        if (!keepThread(tid)) {
+                return;
+        }
+        addThread(reg, tid, name);
+}
+
+/*
+ * Appends what getThreadInfo() found to _s, one line each for the trace
+ * times, the resource counts and every thread and IRQ in Paraver id order.
+ * Read back by readThreadInfo(), for checkpoints and the discovery cache.
+ */
+void
+formatThreadInfo(GString *s, uint32_t ncpus, uint32_t nsoftirqs,
+    const struct prvRegistry *reg)
+{
+        const struct prvThread *thread;
+        const struct prvIrq *irq;
+        gchar *name;
+        unsigned int i;
+
+        g_string_append_printf(s, "times %" PRIu64 " %" PRIu64 "\n",
+            trace_times.first_stream_timestamp,
+            trace_times.last_stream_timestamp);
+        g_string_append_printf(s, "resources %u %u\n", ncpus, nsoftirqs);
+        for (i = 0; i < reg->threads->len; i++) {
+                thread = &g_array_index(reg->threads, struct prvThread, i);
+                name = g_strescape(thread->name, NULL);
+                g_string_append_printf(s, "thread %d %s\n",
+                    (int) thread->tid, name);
+                g_free(name);
+        }
+        for (i = 0; i < reg->irqs->len; i++) {
+                irq = &g_array_index(reg->irqs, struct prvIrq, i);
+                name = g_strescape(irq->name, NULL);
+                g_string_append_printf(s, "irq %d %s\n", (int) irq->irq,
+                    name);
+                g_free(name);
+        }
+}
+
+/*
+ * Reads a line written by formatThreadInfo() back, returns false if _line
+ * is not one of them
+ */
+bool
+readThreadInfo(const char *line, uint32_t *ncpus, uint32_t *nsoftirqs,
+    struct prvRegistry *reg)
+{
+        char *name;
+        int id, n = 0;
+
+        if (sscanf(line, "times %" SCNu64 " %" SCNu64,
+                &trace_times.first_stream_timestamp,
+                &trace_times.last_stream_timestamp) == 2) {
+                return true;
+        } else if (sscanf(line, "resources %u %u", ncpus, nsoftirqs) == 2) {
+                return true;
+        } else if (sscanf(line, "thread %d %n", &id, &n) == 1 && n > 0) {
+                name = readEscaped(line + n);
+                addThread(reg, id, name);
+                g_free(name);
+                return true;
+        } else if (sscanf(line, "irq %d %n", &id, &n) == 1 && n > 0) {
+                name = readEscaped(line + n);
+                addIrq(reg, id, name);
+                g_free(name);
+                return true;
+        }
+
+        return false;
+}
+
+/* Unescapes the string ending _line, written with g_strescape() */
+char *
+readEscaped(const char *line)
+{
+        char *copy, *name;
+
+        copy = g_strdup(line);
+        copy[strcspn(copy, "\n")] = '\0';
+        name = g_strcompress(copy);
+        g_free(copy);
+
+        return name;
+}
+
+/*
+ * Collects the thread, IRQ, CPU and time information carried by the event
+ * read from _src. Shared by the getThreadInfo() pre-pass and the
+ * single-pass mode of iter_trace(), so both discover the same registries
+ * in the same order.
+ */
+void
+updateThreadInfo(const struct eventSource *src, uint32_t *ncpus,
+    struct prvRegistry *reg, uint32_t *nsoftirqs)
+{
+        const struct eventClass *class = src->class;
         uint32_t ncpus_cmp = 0;
         uint32_t tid;
         char name[16];
-        char *irqname;
-
-        struct bt_iter_pos begin_pos;
-        struct bt_ctf_iter *iter;
-        struct bt_ctf_event *event;
-        int flags;
-        int ret = 0;
-        uint prvtid = 1;
-        uint irqprv = 1;
 
         uint64_t timestamp_begin;
         uint64_t timestamp_end;
 
+        ncpus_cmp = src->packet->cpu_id;
+        if (ncpus_cmp > *ncpus) {
+                *ncpus = ncpus_cmp;
+        }
 
-        trace_times.first_stream_timestamp = 0;
-        trace_times.last_stream_timestamp = 0;
-//        *offset = 0;
+        /* Get Timestamps  and offset */
+        timestamp_begin = src->timestamp;
+        timestamp_end = src->timestamp;
 
-        const struct bt_definition *scope;
+        if (trace_times.first_stream_timestamp > timestamp_begin ||
+            trace_times.first_stream_timestamp == 0) {
+                trace_times.first_stream_timestamp = timestamp_begin;
+        }
+        if (trace_times.last_stream_timestamp < timestamp_end ||
+            trace_times.last_stream_timestamp == 0) {
+                trace_times.last_stream_timestamp = timestamp_end;
+        }
 
-        begin_pos.type = BT_SEEK_BEGIN;
-        iter = bt_ctf_iter_create(ctx, &begin_pos, NULL);
-        bt_ctf_iter_add_callback(iter,
-            g_quark_from_static_string("exit_syscall"), NULL, 0,
-            handle_exit_syscall, NULL, NULL, NULL);
-
-        while ((event = bt_ctf_iter_read_event_flags(iter, &flags)) != NULL) {
-                scope = bt_ctf_get_top_level_scope(
-                    event, BT_STREAM_PACKET_CONTEXT);
-                ncpus_cmp = bt_ctf_get_uint64(
-                    bt_ctf_get_field(event, scope, "cpu_id"));
-                if (ncpus_cmp > *ncpus) {
-                        *ncpus = ncpus_cmp;
+        /* Get thread names */
+        if (class->flags & CLASS_STATEDUMP_PROCESS) {
+                tid = eventField(src, FIELD_TID);
+                if (trace_filter.pids != NULL) {
+                        learnThreadPid(tid, eventField(src, FIELD_PID));
                 }
 
-                /* Get Timestamps  and offset */
-                timestamp_begin = bt_ctf_get_timestamp(event);
-                timestamp_end = bt_ctf_get_timestamp(event);
+                /* Insert thread info into the registry */
+                registerThread(tid, eventText(src, FIELD_NAME, name,
+                        sizeof(name)), reg);
+        }
 
-                if (trace_times.first_stream_timestamp > timestamp_begin ||
-                    trace_times.first_stream_timestamp == 0) {
-                        trace_times.first_stream_timestamp = timestamp_begin;
-                }
-                if (trace_times.last_stream_timestamp < timestamp_end ||
-                    trace_times.last_stream_timestamp == 0) {
-                        trace_times.last_stream_timestamp = timestamp_end;
-                }
+        /* threads forked during the trace, for --pids */
+        if ((class->flags & CLASS_PROCESS_FORK) && trace_filter.pids != NULL &&
+            hasEventField(src, FIELD_CHILD_PID)) {
+                learnThreadPid(eventField(src, FIELD_CHILD_TID),
+                    eventField(src, FIELD_CHILD_PID));
+        }
 
-                /* Get thread names */
-                if (strstr(
-                        bt_ctf_event_name(event),
-                        "lttng_statedump_process_state")
-                    != NULL) {
-
-                        scope = bt_ctf_get_top_level_scope(
-                            event, BT_EVENT_FIELDS);
-                        tid = bt_get_signed_int(
-                            bt_ctf_get_field(event, scope, "_tid"));
-
-                        strcpy(name, bt_ctf_get_char_array(
-                                bt_ctf_get_field(event, scope, "_name")));
-
-                        /* Insert thread info into hash table */
-                        if (g_hash_table_insert(
-                                tid_info_ht, GINT_TO_POINTER(tid), g_strdup(name))) {
-
-                                g_hash_table_insert(tid_prv_ht,
-                                    GINT_TO_POINTER(tid),
-                                    GINT_TO_POINTER(prvtid));
-                                *tid_prv_l = g_list_append(*tid_prv_l,
-                                    GINT_TO_POINTER(tid));
-                                prvtid++;
-                        }
-                }
+        if (class->flags & CLASS_SWITCH) {
+                registerThread(eventField(src, FIELD_NEXT_TID),
+                    eventText(src, FIELD_NEXT_COMM, name, sizeof(name)),
+                    reg);
+        }
 
-                if (strstr(bt_ctf_event_name(event), "sched_switch") != NULL) {
-                        scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
-                        tid = bt_get_signed_int(
-                            bt_ctf_get_field(event, scope, "_next_tid"));
-                        strcpy(name, bt_ctf_get_char_array(
-                                bt_ctf_get_field(event, scope, "_next_comm")));
-                        if (g_hash_table_insert(tid_info_ht,
-                                GINT_TO_POINTER(tid), g_strdup(name))) {
-
-                                g_hash_table_insert(tid_prv_ht,
-                                    GINT_TO_POINTER(tid),
-                                    GINT_TO_POINTER(prvtid));
-                                *tid_prv_l = g_list_append(*tid_prv_l,
-                                    GINT_TO_POINTER(tid));
-                                prvtid++;
-                        }
-                }
+        if (class->flags & CLASS_SOFTIRQ_ENTRY) {
+                tid = eventField(src, FIELD_VEC);
+                if (tid > *nsoftirqs) *nsoftirqs = tid;
+        }
 
-                if (strcmp(bt_ctf_event_name(event), "softirq_entry") == 0) {
-                        scope = bt_ctf_get_top_level_scope(
-                            event, BT_EVENT_FIELDS);
-                        tid = bt_get_unsigned_int(
-                            bt_ctf_get_field(event, scope, "_vec"));
-                        if (tid > *nsoftirqs) *nsoftirqs = tid;
-                }
+        if (class->flags & CLASS_IRQ_ENTRY) {
+                addIrq(reg, eventField(src, FIELD_IRQ),
+                    eventText(src, FIELD_NAME, name, sizeof(name)));
+        }
+}
 
-                if (strcmp(
-                        bt_ctf_event_name(event), "irq_handler_entry") == 0) {
-
-                        scope = bt_ctf_get_top_level_scope(
-                            event, BT_EVENT_FIELDS);
-                        tid = bt_get_signed_int(
-                            bt_ctf_get_field(event, scope, "_irq"));
-                        irqname = (char *) malloc(sizeof(char *) *
-                            (strlen(bt_ctf_get_string(bt_ctf_get_field(event, scope, "_name"))) + 1 ));
-                        strcpy(irqname, bt_ctf_get_string(bt_ctf_get_field(event, scope, "_name")));
-                        if (g_hash_table_insert(
-                                irq_name_ht, GINT_TO_POINTER(tid), irqname)) {
-
-                                g_hash_table_insert(irq_prv_ht,
-                                    GINT_TO_POINTER(tid),
-                                    GINT_TO_POINTER(irqprv));
-                                *irq_prv_l = g_list_append(*irq_prv_l,
-                                    GINT_TO_POINTER(tid));
-                                irqprv++;
-                        }
-                }
+/*
+ * First pass over the trace, with babeltrace or the native decoder, for
+ * the registries, the resource counts and the times of the trace
+ */
+void
+getThreadInfo(struct bt_context *ctx, uint32_t *ncpus,
+    struct prvRegistry *reg, uint32_t *nsoftirqs,
+    GHashTable *event_class_ht)
+{
+        struct bt_ctf_iter *iter = NULL;
+        struct eventSource src;
+        struct progressCounter progress;
 
-                if (bt_ctf_get_lost_events_count(iter) > 0) {
-                        g_hash_table_insert(lost_events_ht,
-                            GINT_TO_POINTER(bt_ctf_get_timestamp(event)),
-                            GINT_TO_POINTER(bt_ctf_get_lost_events_count(iter)));
-                }
+        trace_times.first_stream_timestamp = 0;
+        trace_times.last_stream_timestamp = 0;
+//        *offset = 0;
+
+        /* statedump first, then straight to the window if there is one */
+        if (!native_decoder.enabled) {
+                iter = createWindowIter(ctx, true);
+                bt_ctf_iter_add_callback(iter,
+                    g_quark_from_static_string("exit_syscall"), NULL, 0,
+                    handle_exit_syscall, NULL, NULL, NULL);
+        }
+
+        openEventSource(&src, iter, event_class_ht);
+        initProgressCounter(&progress);
 
-                ret = bt_iter_next(bt_ctf_get_iter(iter));
+        while (readEvent(&src)) {
+                countProgressAt(&progress, src.packet, src.timestamp);
+                updateThreadInfo(&src, ncpus, reg, nsoftirqs);
+
+                if (trace_window.enabled &&
+                    skipToWindow(iter, src.class->flags, src.timestamp)) {
+                        continue;
+                }
 
-                if (ret < 0)
+                if (!nextEvent(&src))
                         goto end_iter;
         }
 
 end_iter:
-        bt_ctf_iter_destroy(iter);
+        closeEventSource(&src);
+        publishProgress(&progress, 0);
 }
 
 /*
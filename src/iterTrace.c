@@ -0,0 +1,742 @@
+#include <stdlib.h>
+#include <string.h>
+#include <babeltrace/trace-handle.h>
+
+#include "types.h"
+#include "lttng2prv.h"
+#include "classifyEvents.h"
+#include "spoolBody.h"
+#include "readPacketContext.h"
+#include "writeRecords.h"
+#include "seekWindow.h"
+#include "filterEvents.h"
+#include "reportStats.h"
+#include "reportProgress.h"
+#include "checkpointTrace.h"
+#include "followTrace.h"
+#include "splitOutput.h"
+#include "trackStates.h"
+#include "scanIndex.h"
+#include "readEvents.h"
+#include "mapTrace.h"
+
+/*
+ * Where the records of the event loop go. In the two-pass flow the
+ * registries and resource counts are known beforehand and records are
+ * printed straight to the .prv file. In single-pass mode they are spooled
+ * with symbolic resources and applications, see spoolBody.h.
+ */
+struct recordSink
+{
+        /* the .prv body, or the spool in single-pass mode */
+        struct prvWriter *out;
+        bool spool;
+        /* two-pass: independent appl_id for each resource (CPU or IRQ) */
+        uint64_t *appl_id;
+        /* single-pass: appl_id of each CPU, grown as CPUs show up */
+        GArray *cpu_appl;
+};
+
+static uint64_t cpu_appl(struct recordSink *_sink, uint32_t _cpu);
+
+static struct prvWriter *record_head(struct recordSink *_sink,
+    int _drop_zero, uint64_t _key, uint32_t _cpu_id, char _res_kind,
+    uint64_t _res_idx, uint32_t _src_cpu);
+
+static bool keep_thread_record(struct recordSink *_sink, uint32_t _prvTID);
+
+static struct prvWriter *thread_head(struct recordSink *_sink, uint64_t _key,
+    uint32_t _cpu_id, uint32_t _systemTID, uint32_t _prvTID);
+
+static void lazy_register(struct recordSink *_sink,
+    unsigned int *_nresources, const struct eventSource *_src,
+    struct prvRegistry *_reg, uint32_t _ncpus, uint32_t _nsoftirqs);
+
+static uint32_t lazy_thread(struct prvRegistry *_reg,
+    const struct eventSource *_src, uint32_t _tid, int _comm);
+
+static void record_state(struct recordSink *_sink, unsigned int _nest,
+    uint32_t _src_cpu, uint32_t _cpu_id, unsigned int _state,
+    uint64_t _time);
+
+static int stream_rank(struct bt_context *_bt_ctx,
+    const struct eventSource *_src, const struct streamSpool *_streams,
+    GHashTable *_ranks);
+
+static uint64_t
+cpu_appl(struct recordSink *sink, uint32_t cpu)
+{
+        if (cpu >= sink->cpu_appl->len) {
+                g_array_set_size(sink->cpu_appl, cpu + 1);
+        }
+
+        return g_array_index(sink->cpu_appl, uint64_t, cpu);
+}
+
+/*
+ * Prints the "2:cpu:appl:" head of a record. _cpu_id is the resource index
+ * used in the two-pass flow, _res_kind/_res_idx its symbolic counterpart
+ * and _src_cpu the CPU the application is taken from.
+ */
+static struct prvWriter *
+record_head(struct recordSink *sink, int drop_zero, uint64_t key,
+    uint32_t cpu_id, char res_kind, uint64_t res_idx, uint32_t src_cpu)
+{
+        struct prvWriter *w = sink->out;
+
+        if (!sink->spool) {
+                writeBytes(w, "2:", 2);
+                writeField(w, cpu_id + 1);
+                writeField(w, sink->appl_id[cpu_id]);
+                return w;
+        }
+
+        writeChar(w, drop_zero ? SPOOL_RECORD_NONZERO : SPOOL_RECORD);
+        writeField(w, key);
+        writeChar(w, res_kind);
+        writeField(w, res_idx);
+        writeChar(w, 'a');
+        writeUint(w, src_cpu);
+        writeChar(w, '.');
+        writeField(w, cpu_appl(sink, src_cpu));
+        return w;
+}
+
+/*
+ * Records about a thread left out by --tids/--pids are dropped. Spooled
+ * ones are dropped when resolved, see thread_head().
+ */
+static bool
+keep_thread_record(struct recordSink *sink, uint32_t prvTID)
+{
+        return sink->spool || prvTID != 0 || !filterThreads();
+}
+
+/*
+ * Prints the "2:cpu:appl:" head of a record whose application is the
+ * thread _systemTID rather than the one running on the CPU.
+ */
+static struct prvWriter *
+thread_head(struct recordSink *sink, uint64_t key, uint32_t cpu_id,
+    uint32_t systemTID, uint32_t prvTID)
+{
+        struct prvWriter *w = sink->out;
+
+        if (!sink->spool) {
+                writeBytes(w, "2:", 2);
+                writeField(w, cpu_id + 1);
+                writeField(w, prvTID);
+                return w;
+        }
+
+        writeChar(w, filterThreads() ? SPOOL_RECORD_NONZERO : SPOOL_RECORD);
+        writeField(w, key);
+        writeChar(w, SPOOL_RES_CPU);
+        writeField(w, cpu_id);
+        writeChar(w, 't');
+        writeField(w, systemTID);
+        return w;
+}
+
+/*
+ * --index: registers the threads and IRQs the event of _src brings, as
+ * updateThreadInfo() does before the conversion without it, and makes room
+ * for the applications of new IRQ resources. CPUs and softirqs are laid
+ * out beforehand, see scanIndex.h.
+ */
+static void
+lazy_register(struct recordSink *sink, unsigned int *nresources,
+    const struct eventSource *src, struct prvRegistry *reg, uint32_t ncpus,
+    uint32_t nsoftirqs)
+{
+        uint32_t cpus = ncpus, softirqs = nsoftirqs;
+        unsigned int n;
+
+        updateThreadInfo(src, &cpus, reg, &softirqs);
+        n = ncpus + nsoftirqs + reg->irqs->len;
+        if (n > *nresources) {
+                sink->appl_id = (uint64_t *) realloc(sink->appl_id,
+                    n * sizeof(uint64_t));
+                memset(sink->appl_id + *nresources, 0,
+                    (n - *nresources) * sizeof(uint64_t));
+                *nresources = n;
+        }
+}
+
+/*
+ * --index: the Paraver id of thread _tid, registered first with the name
+ * in the _comm field of the event of _src if it is new
+ */
+static uint32_t
+lazy_thread(struct prvRegistry *reg, const struct eventSource *src,
+    uint32_t tid, int comm)
+{
+        uint32_t prvTID = lookupThread(reg, tid);
+        char name[16];
+
+        if (prvTID == 0 && tid != 0 && hasEventField(src, comm)) {
+                registerThread(tid, eventText(src, comm, name, sizeof(name)),
+                    reg);
+                prvTID = lookupThread(reg, tid);
+        }
+
+        return prvTID;
+}
+
+/*
+ * --state-records: the state the event printed on resource _cpu_id brings
+ * to the thread running on _src_cpu. IRQ and softirq handlers interrupt
+ * it until they exit, see trackStates.h.
+ */
+static void
+record_state(struct recordSink *sink, unsigned int nest, uint32_t src_cpu,
+    uint32_t cpu_id, unsigned int state, uint64_t time)
+{
+        uint64_t appl = sink->appl_id[src_cpu];
+
+        switch (nest) {
+        case NEST_ENTRY:
+                enterHandler(sink->out, appl, src_cpu, cpu_id, state, time);
+                break;
+        case NEST_EXIT:
+                exitHandler(sink->out, appl, src_cpu, cpu_id, time);
+                break;
+        default:
+                changeState(sink->out, sink->appl_id[cpu_id], cpu_id, state,
+                    time);
+                break;
+        }
+}
+
+/*
+ * The rank in _streams of the stream of the event of _src, looked up in
+ * _ranks by packet context once per stream. Only babeltrace's iterators
+ * are spooled by stream, see parallelTrace().
+ */
+static int
+stream_rank(struct bt_context *bt_ctx, const struct eventSource *src,
+    const struct streamSpool *streams, GHashTable *ranks)
+{
+        const struct bt_ctf_event *event = src->event;
+        const struct packetContext *packet = src->packet;
+        const struct bt_definition *scope, *field;
+        gpointer value;
+        uint64_t stream_id = 0;
+        int rank;
+
+        if (g_hash_table_lookup_extended(ranks, packet, NULL, &value)) {
+                return GPOINTER_TO_INT(value);
+        }
+
+        scope = bt_ctf_get_top_level_scope(event, BT_TRACE_PACKET_HEADER);
+        if (scope != NULL &&
+            (field = bt_ctf_get_field(event, scope, "stream_id")) != NULL) {
+                stream_id = bt_get_unsigned_int(field);
+        }
+        rank = spoolStreamRank(streams, bt_trace_handle_get_path(bt_ctx,
+                bt_ctf_event_get_handle_id(event)), stream_id,
+            packet->cpu_id);
+        g_hash_table_insert(ranks, (gpointer) packet, GINT_TO_POINTER(rank));
+
+        return rank;
+}
+
+/* Writes the "task:thread:time:" fields that follow the head */
+static void
+write_thread_time(struct prvWriter *w, uint64_t task_id, uint64_t thread_id,
+    uint64_t event_time)
+{
+        writeField(w, task_id);
+        writeField(w, thread_id);
+        writeField(w, event_time);
+}
+
+/* Writes a "<type>:<value>" pair */
+static void
+write_type_value(struct prvWriter *w, uint64_t type, uint64_t value)
+{
+        writeField(w, type);
+        writeUint(w, value);
+}
+
+/*
+ * Iterates through all events of the trace
+ *
+ * With a NULL _spool records are printed to _prv, otherwise they are
+ * spooled for resolveSpool(). With _streams they are spooled by stream for
+ * mergeStreamSpools() instead. With _discover the registries, _ncpus and
+ * _nsoftirqs are filled here through updateThreadInfo(), otherwise they
+ * must come from getThreadInfo() and are only read, so several iterators
+ * can share them, or from scanIndex() and only grow.
+ */
+void
+iter_trace(struct bt_context *bt_ctx, struct prvWriter *prv, FILE *spool,
+    struct streamSpool *streams, const bool discover, struct prvRegistry *reg,
+    uint32_t *ncpus, uint32_t *nsoftirqs,
+    GHashTable *arg_types_ht, GHashTable *event_class_ht)
+{
+        struct bt_ctf_iter *iter = NULL;
+        struct eventSource src;
+        unsigned int nresources = *ncpus + *nsoftirqs +
+            reg->irqs->len;
+        struct recordSink sink;
+        struct prvWriter *w;
+        uint64_t task_id, thread_id, event_time, last_time = 0;
+        uint32_t cpu_id, irq_id, src_cpu;
+        uint64_t event_type, event_value, offset_stream;
+        char res_kind;
+        uint64_t res_idx;
+
+        unsigned int state, handler;
+        uint64_t prev_state;
+        const struct eventClass *class;
+        uint32_t systemTID, prvTID, swapper;
+
+        GHashTable *arg_plans_ht = createArgPlans();
+        const struct packetContext *packet;
+        /* the rank of each stream in _streams, by packet context */
+        GHashTable *ranks = NULL;
+
+        short int print = 0;
+        short int print_state = 0;
+
+        /* events read of each event_type, for --stats */
+        uint64_t type_counts[STATS_NTYPES] = { 0 };
+        struct progressCounter progress;
+
+        size_t lost_ini, lost_fi;
+
+        const bool spooled = (spool != NULL || streams != NULL);
+        /* slices are cut in the sequential two-pass flow */
+        const bool split = output_split.enabled && !spooled && !discover;
+        /* and so are state records */
+        const bool states = thread_states.enabled && !spooled && !discover;
+        /* --index registers the threads after the statedump here */
+        const bool lazy = trace_index.enabled && !spooled && !discover;
+
+        sink.spool = spooled;
+        sink.appl_id = NULL;
+        sink.cpu_appl = NULL;
+        if (!spooled) {
+                sink.out = prv;
+                sink.appl_id = (uint64_t *) calloc(nresources,
+                    sizeof(uint64_t));
+        } else {
+                /* what comes before the first event opens the spool */
+                sink.out = streams != NULL ? streams->current->w :
+                    createWriter(fileno(spool), write_buffer_size);
+                if (sink.out == NULL) {
+                        fprintf(stderr,
+                            "[error] Couldn't allocate the spool buffer.\n");
+                        g_hash_table_destroy(arg_plans_ht);
+                        return;
+                }
+                /* --follow carries the applications to the next chunk */
+                sink.cpu_appl = trace_follow.enabled ? trace_follow.cpu_appl :
+                    g_array_new(FALSE, TRUE, sizeof(uint64_t));
+        }
+        if (streams != NULL) {
+                ranks = g_hash_table_new(g_direct_hash, g_direct_equal);
+        }
+        if (discover && trace_follow.chunks == 0) {
+                trace_times.first_stream_timestamp = 0;
+                trace_times.last_stream_timestamp = 0;
+        }
+
+        /* the jobs of parallelTrace() always read with babeltrace */
+        if (!native_decoder.enabled || streams != NULL) {
+                if (trace_checkpoint.resumed) {
+                        iter = createResumeIter(bt_ctx);
+                } else {
+                        iter = createWindowIter(bt_ctx, false);
+                }
+                bt_ctf_iter_add_callback(iter,
+                    g_quark_from_static_string("exit_syscall"), NULL, 0,
+                    handle_exit_syscall, NULL, NULL, NULL);
+        }
+
+        task_id = 1;
+        thread_id = 1;
+
+        openEventSource(&src, iter, event_class_ht);
+
+        swapper = lookupThread(reg, 0);
+
+        /* the applications running when the checkpoint was taken */
+        if (trace_checkpoint.resumed && !spooled) {
+                for (cpu_id = 0; cpu_id < nresources &&
+                    cpu_id < trace_checkpoint.appl_id->len; cpu_id++) {
+                        sink.appl_id[cpu_id] = g_array_index(
+                            trace_checkpoint.appl_id, uint64_t, cpu_id);
+                }
+                src.packets.resume = trace_checkpoint.streams;
+        }
+        if (trace_follow.enabled) {
+                src.packets.resume = trace_follow.streams;
+        }
+
+        /* threads already running when the window begins */
+        for (cpu_id = 0; !trace_checkpoint.resumed &&
+            trace_window.cpu_tids != NULL &&
+            cpu_id < trace_window.cpu_tids->len; cpu_id++) {
+                if (g_array_index(trace_window.cpu_tids, int64_t,
+                        cpu_id) < 0) {
+                        continue;
+                }
+                systemTID = g_array_index(trace_window.cpu_tids, int64_t,
+                    cpu_id);
+                prvTID = lookupThread(reg, systemTID);
+                if (systemTID == 0) {
+                        prvTID = swapper;
+                }
+                if (!spooled) {
+                        if (cpu_id < nresources) {
+                                sink.appl_id[cpu_id] = prvTID;
+                        }
+                } else {
+                        cpu_appl(&sink, cpu_id);
+                        g_array_index(sink.cpu_appl, uint64_t,
+                            cpu_id) = prvTID;
+                        writeChar(sink.out, SPOOL_SWITCH);
+                        writeField(sink.out, 0);
+                        writeUint(sink.out, cpu_id);
+                        writeChar(sink.out, '.');
+                        writeUint(sink.out, prvTID);
+                        writeChar(sink.out, '\n');
+                }
+        }
+
+        initProgressCounter(&progress);
+
+        while (readEvent(&src)) {
+                packet = src.packet;
+                countProgressAt(&progress, packet, src.timestamp);
+                if (streams != NULL) {
+                        sink.out = spoolStreamEvent(streams,
+                            stream_rank(bt_ctx, &src, streams, ranks),
+                            src.timestamp);
+                }
+
+                if (discover) {
+                        updateThreadInfo(&src, ncpus, reg, nsoftirqs);
+                } else if (lazy) {
+                        lazy_register(&sink, &nresources, &src, reg,
+                            *ncpus, *nsoftirqs);
+                }
+                /* tid 0 is registered by its first sched_switch */
+                if ((discover || lazy) && swapper == 0) {
+                        swapper = lookupThread(reg, 0);
+                }
+
+                cpu_id = packet->cpu_id;
+                src_cpu = cpu_id;
+                res_kind = SPOOL_RES_CPU;
+                res_idx = cpu_id;
+
+                class = src.class;
+
+                offset_stream = trace_times.first_stream_timestamp +
+                    output_split.begin;
+                event_time = src.timestamp - offset_stream;
+                if (split && splitDue(sink.out, event_time)) {
+                        nextSlice(bt_ctx, sink.out, reg, nresources,
+                            event_time);
+                        offset_stream = trace_times.first_stream_timestamp +
+                            output_split.begin;
+                        event_time = src.timestamp - offset_stream;
+                }
+
+                /*
+                 * Every event before this one has been printed and a
+                 * seek to its time finds no other, see checkpointTrace.h
+                 */
+                if (packet->new_packet && !spooled && !discover &&
+                    event_time > last_time && checkpointDue()) {
+                        saveCheckpoint(sink.out, event_time + offset_stream,
+                            sink.appl_id, nresources, &src.packets, packet);
+                }
+                last_time = event_time;
+
+                /* State Records */
+
+                if (class->flags & CLASS_SWITCH) {
+                        systemTID = eventField(&src, FIELD_NEXT_TID);
+                        prvTID = lookupThread(reg, systemTID);
+
+                        if (systemTID == 0) {
+                                prvTID = swapper;
+                        }
+                        if (!spooled) {
+                                sink.appl_id[cpu_id] = prvTID;
+                        } else {
+                                cpu_appl(&sink, cpu_id);
+                                g_array_index(sink.cpu_appl, uint64_t,
+                                    cpu_id) = prvTID;
+                                writeChar(sink.out, SPOOL_SWITCH);
+                                writeField(sink.out, event_time);
+                                writeUint(sink.out, cpu_id);
+                                writeChar(sink.out, '.');
+                                writeUint(sink.out, prvTID);
+                                writeChar(sink.out, '\n');
+                        }
+                }
+
+                /* /State Records */
+
+                /* Event Records */
+
+                event_type = class->event_type;
+                event_value = class->event_value;
+                type_counts[statsTypeIndex(event_type)]++;
+                state = class->state;
+                print = class->print;
+                print_state = class->print_state;
+                handler = class->handler;
+                if (class->drop) {
+                        /* only its lost events are printed */
+                        print = 0;
+                        handler = HANDLER_DEFAULT;
+                }
+
+                if (print != 0 && event_value == EVENT_VALUE_ID) {
+                        /* Add 1 to the event_value to reserve 0 for exit */
+                        event_value = eventId(&src) + 1;
+                }
+
+                switch (handler) {
+                case HANDLER_IRQ:
+                        irq_id = eventField(&src, FIELD_IRQ);
+                        res_kind = SPOOL_RES_IRQ;
+                        res_idx = irq_id;
+                        if (!spooled) {
+                                irq_id = *ncpus + *nsoftirqs +
+                                    lookupIrq(reg, irq_id) - 1;
+                                /* assign the same thread_id of the calling
+                                 * process to the irq position
+                                 */
+                                sink.appl_id[irq_id] = sink.appl_id[cpu_id];
+                        }
+                        /* we need cpu_id to be the identifier of the irq
+                         * to properly print the prv line
+                         */
+                        cpu_id = irq_id;
+                        break;
+                case HANDLER_SOFTIRQ:
+                        irq_id = eventField(&src, FIELD_VEC);
+                        res_kind = SPOOL_RES_SOFTIRQ;
+                        res_idx = irq_id;
+                        if (!spooled) {
+                                irq_id = *ncpus - 1 + irq_id;
+                                /* Assign the same thread_id of the calling
+                                 * process to the irq position
+                                 */
+                                sink.appl_id[irq_id] = sink.appl_id[cpu_id];
+                        } else if (irq_id == 0) {
+                                /* Vector 0 shares its slot with the last CPU */
+                                writeChar(sink.out, SPOOL_OVERRIDE);
+                                writeField(sink.out, event_time);
+                                writeUint(sink.out, cpu_id);
+                                writeChar(sink.out, '.');
+                                writeUint(sink.out, cpu_appl(&sink, cpu_id));
+                                writeChar(sink.out, '\n');
+                        }
+                        /* We need cpu_id to be the identifier of the irq
+                         * to properly print the prv line
+                         */
+                        cpu_id = irq_id;
+                        break;
+                case HANDLER_SCHED_SWITCH:
+                        systemTID = eventField(&src, FIELD_PREV_TID);
+                        prvTID = lazy ? lazy_thread(reg, &src, systemTID,
+                            FIELD_PREV_COMM) :
+                            lookupThread(reg, systemTID);
+                        if (systemTID == 0) {
+                                prvTID = swapper;
+                        }
+
+                        prev_state = eventField(&src, FIELD_PREV_STATE);
+                        if (prev_state == 0) {
+                                state = STATE_WAIT_CPU;
+                        } else {
+                                state = STATE_WAIT_BLOCK;
+                        }
+
+                        if (states) {
+                                changeState(sink.out, prvTID, cpu_id, state,
+                                    event_time);
+                        } else if (keep_thread_record(&sink, prvTID)) {
+                                w = thread_head(&sink, event_time, cpu_id,
+                                    systemTID, prvTID);
+                                write_thread_time(w, task_id, thread_id,
+                                    event_time);
+                                write_type_value(w, 20000000, state);
+                                writeChar(w, '\n');
+                                if (split) {
+                                        keepSliceState(prvTID, cpu_id,
+                                            state);
+                                }
+                        }
+
+                        state = class->state;
+                        break;
+                case HANDLER_SCHED_WAKEUP:
+                        systemTID = eventField(&src, FIELD_TID);
+                        prvTID = lazy ? lazy_thread(reg, &src, systemTID,
+                            FIELD_COMM) :
+                            lookupThread(reg, systemTID);
+                        if (systemTID == 0) {
+                                prvTID = swapper;
+                        }
+                        if (states) {
+                                changeState(sink.out, prvTID, cpu_id,
+                                    STATE_WAIT_CPU, event_time);
+                                break;
+                        }
+                        if (!keep_thread_record(&sink, prvTID)) {
+                                break;
+                        }
+                        w = thread_head(&sink, event_time, cpu_id,
+                            systemTID, prvTID);
+                        write_thread_time(w, task_id, thread_id, event_time);
+                        write_type_value(w, 20000000, STATE_USERMODE);
+                        writeChar(w, ':');
+                        write_type_value(w, 20000000, STATE_WAIT_CPU);
+                        writeChar(w, '\n');
+                        if (split) {
+                                keepSliceState(prvTID, cpu_id,
+                                    STATE_WAIT_CPU);
+                        }
+                        break;
+                case HANDLER_PROCESS_FORK:
+                        systemTID = eventField(&src, FIELD_CHILD_TID);
+                        prvTID = lazy ? lazy_thread(reg, &src, systemTID,
+                            FIELD_CHILD_COMM) :
+                            lookupThread(reg, systemTID);
+                        if (systemTID == 0) {
+                                prvTID = swapper;
+                        }
+                        if (states) {
+                                changeState(sink.out, prvTID, cpu_id,
+                                    STATE_WAIT_CPU, event_time);
+                                break;
+                        }
+                        if (!keep_thread_record(&sink, prvTID)) {
+                                break;
+                        }
+                        w = thread_head(&sink, event_time, cpu_id,
+                            systemTID, prvTID);
+                        write_thread_time(w, task_id, thread_id, event_time);
+                        write_type_value(w, 20000000, STATE_WAIT_CPU);
+                        writeChar(w, '\n');
+                        if (split) {
+                                keepSliceState(prvTID, cpu_id,
+                                    STATE_WAIT_CPU);
+                        }
+                        break;
+                default:
+                        break;
+                }
+
+                /*
+                 * Prints the events lost before a packet on its first event,
+                 * assigned to the same application and CPU. Those before the
+                 * first packet of a window were lost outside of it.
+                 */
+                if (packet->new_packet && packet->lost_events > 0 &&
+                    !(packet->first_packet && trace_window.enabled)) {
+                        lost_ini = event_time;
+                        lost_fi = packet->timestamp_end + packet->clock_offset -
+                            offset_stream;
+
+                        w = record_head(&sink, 0, event_time, cpu_id,
+                            res_kind, res_idx, src_cpu);
+                        write_thread_time(w, 1, 1, lost_ini);
+                        writeField(w, 99999999);
+                        writeUint(w, packet->lost_events);
+                        writeChar(w, '\n');
+
+                        w = record_head(&sink, 0, event_time, cpu_id,
+                            res_kind, res_idx, src_cpu);
+                        write_thread_time(w, 1, 1, lost_fi);
+                        write_type_value(w, 99999999, 0);
+                        writeChar(w, '\n');
+                }
+
+                /*
+                 * print only if we know the appl_id of the event, when
+                 * spooling this is only known once the spool is resolved
+                 */
+                if ((print != 0) &&
+                    (spooled || (sink.appl_id[cpu_id] != 0))) {
+                        if (states && print_state == 1) {
+                                record_state(&sink, class->nest, src_cpu,
+                                    cpu_id, state, event_time);
+                        }
+                        w = record_head(&sink, 1, event_time, cpu_id,
+                            res_kind, res_idx, src_cpu);
+                        write_thread_time(w, task_id, thread_id, event_time);
+                        if (print_state == 1 && !states) {
+                                write_type_value(w, 20000000, state);
+                                writeChar(w, ':');
+                                if (split) {
+                                        keepSliceState(sink.appl_id[cpu_id],
+                                            cpu_id, state);
+                                }
+                        }
+                        write_type_value(w, event_type, event_value);
+                        /* Call Arguments */
+                        writeEventArgs(&src, event_type, arg_types_ht,
+                            arg_plans_ht, w);
+                        writeChar(w, '\n');
+
+                        if (event_type == 10300000) {
+                                w = record_head(&sink, 1, event_time, cpu_id,
+                                    res_kind, res_idx, src_cpu);
+                                write_thread_time(w, task_id, thread_id,
+                                    event_time + 1);
+                                write_type_value(w, event_type, 0);
+                                writeChar(w, '\n');
+                        }
+                }
+
+
+                /* /Event Records */
+
+                if (src.lost) {
+                        fprintf(stderr, "LOST : %" PRIu64 "\n",
+                            src.lost_count);
+                }
+
+                if (!nextEvent(&src))
+                        goto end_iter;
+        }
+
+end_iter:
+        if (states) {
+                closeStates(sink.out, trace_times.last_stream_timestamp -
+                    trace_times.first_stream_timestamp);
+        }
+        addEventCounts(type_counts);
+        publishProgress(&progress, 0);
+
+        g_hash_table_destroy(arg_plans_ht);
+        if (trace_follow.enabled) {
+                keepFollowStreams(&src.packets);
+        }
+        closeEventSource(&src);
+        if (spool != NULL) {
+                destroyWriter(sink.out);
+        }
+        if (ranks != NULL) {
+                g_hash_table_destroy(ranks);
+        }
+        free(sink.appl_id);
+        if (sink.cpu_appl != NULL && !trace_follow.enabled) {
+                g_array_free(sink.cpu_appl, TRUE);
+        }
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
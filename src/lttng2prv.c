@@ -1,19 +1,107 @@
 #define _DEFAULT_SOURCE
 #define _XOPEN_SOURCE 700
 
+#include <unistd.h>
+
 #include "types.h"
 #include "lttng2prv.h"
 #include "fillArgTypes.h"
 #include "listEvents.h"
+#include "classifyEvents.h"
+#include "parallelTrace.h"
+#include "spoolBody.h"
+#include "writeRecords.h"
+#include "compressOutput.h"
+#include "seekWindow.h"
+#include "filterEvents.h"
+#include "streamFiles.h"
+#include "reportStats.h"
+#include "reportProgress.h"
+#include "checkpointTrace.h"
+#include "followTrace.h"
+#include "splitOutput.h"
+#include "readMetadata.h"
+#include "sortRecords.h"
+#include "trackStates.h"
+#include "scanIndex.h"
+#include "cacheThreadInfo.h"
+#include "mapTrace.h"
 
 static int parse_options(int _argc, char **_argv);
 
+static int parse_size(const char *_arg, size_t *_size);
+
 static struct poptOption long_options[] =
 {
         {"output", 'o', POPT_ARG_STRING, NULL, OPT_OUTPUT,
-            "Output file name", "FILE" },
+            "Output file name, - writes the .prv to stdout", "FILE" },
+        {"compress", 0, POPT_ARG_STRING, NULL, OPT_COMPRESS,
+            "Compress the .prv output", "gz|zstd" },
+        {"compress-threads", 0, POPT_ARG_STRING, NULL, OPT_COMPRESS_THREADS,
+            "Threads compressing the output, all CPUs by default", "N" },
+        {"begin", 0, POPT_ARG_STRING, NULL, OPT_BEGIN,
+            "Convert from TIME, since the first event or @ for trace clock "
+            "time, with an optional ns, us, ms or s suffix", "TIME" },
+        {"end", 0, POPT_ARG_STRING, NULL, OPT_END,
+            "Convert up to TIME, like --begin", "TIME" },
+        {"cpus", 0, POPT_ARG_STRING, NULL, OPT_CPUS,
+            "Only convert these CPUs, such as 0-3,8", "LIST" },
+        {"tids", 0, POPT_ARG_STRING, NULL, OPT_TIDS,
+            "Only convert these threads", "LIST" },
+        {"pids", 0, POPT_ARG_STRING, NULL, OPT_PIDS,
+            "Only convert the threads of these processes", "LIST" },
+        {"events", 0, POPT_ARG_STRING, NULL, OPT_EVENTS,
+            "Only convert events matching these globs or categories: "
+            "syscall, irq, softirq, net, sched, timer, block, statedump",
+            "LIST" },
         {"print-timestamps", 0, POPT_ARG_NONE, NULL, OPT_TIMESTAMPS,
             "Print trace start and end timestamps as unix time", NULL },
+        {"jobs", 'j', POPT_ARG_STRING, NULL, OPT_JOBS,
+            "Decode the per-CPU streams with N parallel jobs", "N" },
+        {"buffer-size", 0, POPT_ARG_STRING, NULL, OPT_BUFFER_SIZE,
+            "Size of the output buffer, with an optional K, M or G suffix",
+            "SIZE" },
+        {"async", 0, POPT_ARG_STRING, NULL, OPT_ASYNC,
+            "Write the output from a background thread or io_uring",
+            "thread|uring" },
+        {"queue-depth", 0, POPT_ARG_STRING, NULL, OPT_QUEUE_DEPTH,
+            "Full buffers queued to the asynchronous output", "N" },
+        {"single-pass", 0, POPT_ARG_NONE, NULL, OPT_SINGLE_PASS,
+            "Discover threads while converting, in a single pass", NULL },
+        {"stats", 0, POPT_ARG_STRING, NULL, OPT_STATS,
+            "Print timings, event counts, output sizes and peak memory to "
+            "stderr at exit", "text|json" },
+        {"progress", 0, POPT_ARG_STRING, NULL, OPT_PROGRESS,
+            "Show the progress on stderr, when it is a terminal or always",
+            "auto|always" },
+        {"checkpoint", 0, POPT_ARG_STRING, NULL, OPT_CHECKPOINT,
+            "Save a checkpoint of the conversion every SECONDS", "SECONDS" },
+        {"resume", 0, POPT_ARG_NONE, NULL, OPT_RESUME,
+            "Resume the conversion from its last checkpoint", NULL },
+        {"follow", 0, POPT_ARG_NONE, NULL, OPT_FOLLOW,
+            "Convert the chunks of a rotated session as they are archived, "
+            "until interrupted", NULL },
+        {"split-by-time", 0, POPT_ARG_STRING, NULL, OPT_SPLIT_TIME,
+            "Write the .prv as self-contained slices of TIME each, with an "
+            "optional ns, us, ms or s suffix", "TIME" },
+        {"split-by-size", 0, POPT_ARG_STRING, NULL, OPT_SPLIT_SIZE,
+            "Write the .prv as self-contained slices of about SIZE each, "
+            "with an optional K, M or G suffix", "SIZE" },
+        {"sort-mem", 0, POPT_ARG_STRING, NULL, OPT_SORT_MEM,
+            "Sort the .prv records by time using up to SIZE of memory, "
+            "with an optional K, M or G suffix", "SIZE" },
+        {"state-records", 0, POPT_ARG_NONE, NULL, OPT_STATE_RECORDS,
+            "Write thread states as Paraver state records instead of "
+            "events", NULL },
+        {"index", 0, POPT_ARG_NONE, NULL, OPT_INDEX,
+            "Read the CPUs and trace times from the packet indexes and only "
+            "the statedump before converting", NULL },
+        {"no-cache", 0, POPT_ARG_NONE, NULL, OPT_NO_CACHE,
+            "Don't read or write the thread information cache next to the "
+            "trace", NULL },
+        {"decoder", 0, POPT_ARG_STRING, NULL, OPT_DECODER,
+            "Decode the trace with babeltrace or the native decoder",
+            "babeltrace|native" },
         {"verbose", 'v', POPT_ARG_NONE, NULL, OPT_VERBOSE,
             "Be verbose", NULL },
         POPT_AUTOHELP
@@ -23,45 +111,58 @@ static struct poptOption long_options[] =
 static int traverse_trace_dir(const char *_fpath, const struct stat *_sb,
     int _tflag, struct FTW *_ftwbuf);
 
-static int bt_context_add_traces_recursive(struct bt_context *_ctx,
-    const char *_path, const char *_format_str,
-    void (*packet_seek)(struct bt_stream_pos *pos, size_t offset, int whence));
-
-static void iter_trace(struct bt_context *_bt_ctx, uint64_t *_offset, FILE *_fp,
-    GHashTable *_tid_info_ht, GHashTable *_tid_prv_ht, GHashTable *_irq_name_ht,
-    GHashTable *_irq_prv_ht, const uint32_t _ncpus, const uint32_t _nsoftirqs,
-    GHashTable *_arg_types_ht, GHashTable *_lost_events_ht);
-
 static void key_destroy_func(gpointer _key);
 
 static char *opt_output;
 const char *inputTrace;
 static bool print_timestamps = false;
+static bool prv_stdout = false;
+static int compress_kind = COMPRESS_NONE;
+static unsigned int compress_threads = 0;
+static bool single_pass = false;
+static struct timeSpec window_begin;
+static struct timeSpec window_end;
+static unsigned int jobs = 1;
+static int progress_mode = PROGRESS_NONE;
+static unsigned long checkpoint_interval = 0;
+static bool resume = false;
+static bool follow = false;
+static struct timeSpec split_time;
+static size_t split_size = 0;
+static size_t sort_mem = 0;
+static bool state_records = false;
+static bool index_scan = false;
+static bool no_cache = false;
+static int decoder = DECODER_BABELTRACE;
 bool verbose = false;
 unsigned int id_size = 32;
+size_t write_buffer_size = WRITER_DEFAULT_SIZE;
+static int write_mode = WRITER_SYNC;
+static unsigned int write_queue_depth = WRITER_DEFAULT_DEPTH;
 
 int
 main(int argc, char **argv)
 {
         int ret = 0;
+        /* until the body is written, see below */
+        int status = EXIT_FAILURE;
         struct bt_context *ctx;
         int nresources;
         uint32_t nsoftirqs = 0;
         uint32_t ncpus = 0;
-        size_t trace_offset = 0;
-        char *ofilename, *metadatafn;
+        char *ofilename, *slice;
 
-        FILE *prv, *pcf, *row, *metadatafp;
+        FILE *pcf, *row, *spool = NULL;
+        const char *trace_path;
+        char *shadow = NULL;
+        GPtrArray *files;
+        int prv = -1;
+        struct prvWriter *body = NULL;
 
-        GHashTable *tid_info_ht = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, key_destroy_func);
-        GHashTable *tid_prv_ht = g_hash_table_new(g_direct_hash, g_direct_equal);
-        GList *tid_prv_l = NULL;
-        GHashTable *irq_name_ht = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, key_destroy_func);
-        GHashTable *irq_prv_ht = g_hash_table_new(g_direct_hash, g_direct_equal);
-        GList *irq_prv_l = NULL;
+        struct prvRegistry *reg = createRegistry();
         GHashTable *arg_types_ht = g_hash_table_new_full(
             g_str_hash, g_str_equal, (GDestroyNotify) key_destroy_func, NULL);
-        GHashTable *lost_events_ht = g_hash_table_new(g_direct_hash, g_direct_equal);
+        GHashTable *event_class_ht = createEventClasses();
 
         ret = parse_options(argc, argv);
         if (ret < 0) {
@@ -78,40 +179,65 @@ main(int argc, char **argv)
                     sizeof(char *));
                 strncpy(opt_output, basename(it), strlen(basename(it)));
         }
-        ofilename = (char *)calloc(strlen(opt_output) + 5, sizeof(char *));
+        ofilename = (char *)calloc(strlen(opt_output) + 9, sizeof(char *));
         strncpy(ofilename, opt_output, strlen(opt_output) + 1);
 
-        metadatafn = (char *)calloc(strlen(inputTrace) + 9, sizeof(char *));
-        strncat(metadatafn, inputTrace, strlen(inputTrace));
-        strncat(metadatafn, "/metadata", strlen("/metadata"));
+        if (checkpoint_interval > 0 || resume) {
+                initCheckpoint(opt_output, inputTrace,
+                    (uint64_t) checkpoint_interval * 1000000000);
+        }
+        if (resume && loadCheckpoint(&ncpus, &nsoftirqs, reg) < 0) {
+                goto endprv;
+        }
 
-        char *tmp = malloc(512 * sizeof(char *));
-        if (!(metadatafp = fopen(metadatafn, "r"))) {
-                fprintf(stderr, "[error] Couldn't open metadata file.\n");
-                goto endmeta;
+        if (split_time.set || split_size > 0) {
+                initSplit(opt_output, split_time.ns, split_size);
+        }
+        if (state_records) {
+                initStates();
         }
 
-        while (fgets(tmp, 512, metadatafp) != NULL) {
-                if (strstr(tmp, "event.header := struct event_header_large")) {
-                        debug("Extended header.\n");
-                        id_size = 65536;
+        if (prv_stdout) {
+                prv = STDOUT_FILENO;
+        } else {
+                strcat(ofilename, ".prv");
+                strcat(ofilename, compressSuffix(compress_kind));
+                if (trace_checkpoint.resumed) {
+                        prv = openResumedOutput(ofilename);
+                } else if (output_split.enabled) {
+                        slice = sliceName(1, ".prv");
+                        prv = open(slice, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+                        g_free(slice);
+                } else {
+                        prv = open(ofilename, O_WRONLY | O_CREAT | O_TRUNC,
+                            0666);
                 }
-                if (strstr(tmp, "offset = ")) {
-                        strtok(tmp, "=");
-                        trace_offset = strtoul(strtok(NULL, "="), NULL, 10);
-                        debug("Trace offset = %lu\n", trace_offset);
+                if (prv < 0) {
+                        fprintf(stderr,
+                            "[error] Couldn't open trace file for writing.\n");
+                        goto endprv;
                 }
         }
-        fclose(metadatafp);
-        free(tmp);
-        free(metadatafn);
 
-        strcat(ofilename, ".prv");
-        if (!(prv = fopen(ofilename, "w"))) {
+        /* Header and body go through the same writer and compressor */
+        if (!(body = createWriter(prv, write_buffer_size))) {
+                fprintf(stderr,
+                    "[error] Couldn't allocate the output buffer.\n");
+                goto endprv;
+        }
+        body->count_records = (run_stats.format != STATS_NONE);
+        if (compress_threads == 0) {
+                compress_threads = MAX(1, sysconf(_SC_NPROCESSORS_ONLN));
+        }
+        if (setWriterCompression(body, compress_kind, compress_threads) < 0) {
                 fprintf(stderr,
-                    "[error] Couldn't open trace file for writing.\n");
+                    "[error] Couldn't set up the output compression.\n");
                 goto endprv;
         }
+        if (startAsyncWriter(body, write_mode, write_queue_depth) < 0) {
+                fprintf(stderr, "[warning] Couldn't start the asynchronous "
+                    "output, writing synchronously.\n");
+        }
 
         ofilename[strlen(opt_output)] = 0;
         strcat(ofilename, ".pcf");
@@ -135,46 +261,244 @@ main(int argc, char **argv)
                 goto end;
         }
 
-        ret = bt_context_add_traces_recursive(ctx, inputTrace, "ctf", NULL);
+        /* streams of the CPUs left out are never opened */
+        trace_path = inputTrace;
+        if (trace_filter.cpus != NULL) {
+                files = listStreamFiles(inputTrace);
+                shadow = createShadowTrace(opt_output, inputTrace, files,
+                    keepStream, NULL);
+                g_ptr_array_free(files, TRUE);
+                if (!shadow) {
+                        fprintf(stderr,
+                            "[error] Couldn't select the CPU streams.\n");
+                        goto end;
+                }
+                trace_path = shadow;
+        }
+
+        startPhase(PHASE_DISCOVERY);
+        /* with --follow each chunk is opened once it is archived */
+        ret = follow ? 0 :
+            bt_context_add_traces_recursive(ctx, trace_path, "ctf", NULL);
+        endPhase(PHASE_DISCOVERY);
         if (ret < 0) {
                 fprintf(stderr,
                     "Couldn't open trace \"%s\" for reading.\n", inputTrace);
                 goto end;
         }
 
-        getThreadInfo(ctx, &ncpus, tid_info_ht, tid_prv_ht,
-            &tid_prv_l, irq_name_ht, &nsoftirqs, irq_prv_ht, &irq_prv_l,
-            lost_events_ht);
+        if (resolveWindow(ctx, &window_begin, &window_end) < 0) {
+                goto end;
+        }
+
+        startProgressThread(progress_mode, trace_path);
+
+        fillArgTypes(arg_types_ht);
+        fillEventClasses(ctx, event_class_ht);
+        filterEventClasses(event_class_ht);
+        if (decoder == DECODER_NATIVE &&
+            mapTrace(trace_path, event_class_ht, arg_types_ht) < 0) {
+                fprintf(stderr, "[warning] The native decoder can't read %s, "
+                    "decoding it with babeltrace.\n", inputTrace);
+        }
+
+        if (single_pass) {
+                if (!(spool = createSpool(opt_output))) {
+                        fprintf(stderr,
+                            "[error] Couldn't create body spool file.\n");
+                        goto end;
+                }
+                startPhase(PHASE_CONVERSION);
+                startProgress("converting", 0, 0);
+                if (follow) {
+                        ret = followTrace(inputTrace, &ctx, spool, reg,
+                            &ncpus, &nsoftirqs, arg_types_ht, event_class_ht);
+                } else {
+                        iter_trace(ctx, NULL, spool, NULL, true, reg,
+                            &ncpus, &nsoftirqs, arg_types_ht,
+                            event_class_ht);
+                }
+                endProgress();
+                endPhase(PHASE_CONVERSION);
+                if (ret < 0) {
+                        fclose(spool);
+                        goto end;
+                }
+        } else if (!trace_checkpoint.resumed) {
+                startPhase(PHASE_THREAD_INFO);
+                startProgress("threads", 0, 0);
+                /* filters and windows change what the pass registers */
+                if (!no_cache && trace_filter.tids == NULL &&
+                    trace_filter.pids == NULL && !window_begin.set &&
+                    !window_end.set) {
+                        initCache(inputTrace, trace_path);
+                }
+                /* a --index registry is partial, it isn't cached */
+                if (loadCache(&ncpus, &nsoftirqs, reg) < 0 &&
+                    (!index_scan || scanIndex(ctx, trace_path, &ncpus, reg,
+                        event_class_ht) < 0)) {
+                        getThreadInfo(ctx, &ncpus, reg, &nsoftirqs,
+                            event_class_ht);
+                        saveCache(ncpus, nsoftirqs, reg);
+                }
+                endProgress();
+                bootstrapWindow(ctx, trace_path, ncpus, reg,
+                    event_class_ht);
+                clipTraceTimes();
+                endPhase(PHASE_THREAD_INFO);
+        }
+
+        if (trace_checkpoint.interval > 0) {
+                setCheckpointRegistries(ncpus, nsoftirqs, reg);
+        }
 
         /* lttng starts cpu counting from 0, paraver from 1 */
         ncpus = ncpus + 1;
-        nresources = ncpus + nsoftirqs + g_hash_table_size(irq_name_ht);
-        printPRVHeader(ctx, prv, tid_info_ht, nresources);
+        if (trace_index.enabled) {
+                /* the header counts the threads found while converting */
+                nsoftirqs = INDEX_SOFTIRQS;
+                if (createIndexBody(opt_output) < 0) {
+                        fprintf(stderr,
+                            "[error] Couldn't create body spool file.\n");
+                        goto end;
+                }
+                startPhase(PHASE_CONVERSION);
+                startProgress("converting", trace_times.first_stream_timestamp,
+                    trace_times.last_stream_timestamp);
+                iter_trace(ctx, trace_index.body, NULL, NULL, false, reg,
+                    &ncpus, &nsoftirqs, arg_types_ht, event_class_ht);
+                endProgress();
+                endPhase(PHASE_CONVERSION);
+        }
+        nresources = ncpus + nsoftirqs + reg->irqs->len;
+        /* a resumed .prv already has its header */
+        if (!trace_checkpoint.resumed) {
+                printPRVHeader(ctx, body, reg, nresources);
+        }
+        if (sort_mem > 0 && startSort(body, sort_mem, opt_output) < 0) {
+                fprintf(stderr, "[warning] Couldn't sort the records, "
+                    "writing them in trace order.\n");
+        }
         printPCFHeader(pcf);
-        printROW(row, tid_info_ht, tid_prv_l, irq_name_ht, irq_prv_l,
-            ncpus, nsoftirqs);
-
-        fillArgTypes(arg_types_ht);
+        printROW(row, reg, ncpus, nsoftirqs);
 
         /* This two, have to be in this order, if not we remove the string
          * syscall_entry_ before traversing the trace and the events don't
          * get listed properly.
         */
-        iter_trace(ctx, &trace_offset, prv, tid_info_ht, tid_prv_ht,
-            irq_name_ht, irq_prv_ht, ncpus, nsoftirqs, arg_types_ht,
-            lost_events_ht);
+        status = EXIT_SUCCESS;
+        startPhase(PHASE_CONVERSION);
+        if (single_pass) {
+                if (resolveSpool(spool, body, reg, ncpus, nsoftirqs) < 0) {
+                        fprintf(stderr,
+                            "[error] Couldn't read back body spool file.\n");
+                        status = EXIT_FAILURE;
+                }
+                fclose(spool);
+        } else if (trace_index.enabled) {
+                if (copyIndexBody(body) < 0) {
+                        fprintf(stderr,
+                            "[error] Couldn't read back body spool file.\n");
+                        status = EXIT_FAILURE;
+                }
+        } else {
+                startProgress("converting", trace_times.first_stream_timestamp,
+                    trace_times.last_stream_timestamp);
+                /* 1: the jobs can't keep the order, see parallelTrace() */
+                ret = jobs > 1 ? parallelTrace(trace_path, opt_output, jobs,
+                    body, reg, ncpus, nsoftirqs, arg_types_ht,
+                    event_class_ht) : 1;
+                if (ret < 0) {
+                        fprintf(stderr,
+                            "[error] Parallel conversion failed.\n");
+                        status = EXIT_FAILURE;
+                } else if (ret > 0) {
+                        iter_trace(ctx, body, NULL, NULL, false, reg, &ncpus,
+                            &nsoftirqs, arg_types_ht, event_class_ht);
+                }
+                endProgress();
+        }
+        if (closeWriter(body) < 0) {
+                fprintf(stderr, "[error] Couldn't write the trace file.\n");
+                status = EXIT_FAILURE;
+        }
+        if (output_split.enabled && finishSplit(body) < 0) {
+                fprintf(stderr, "[error] Couldn't write the trace file.\n");
+                status = EXIT_FAILURE;
+        }
+        /* a failed conversion can still be resumed */
+        if (status == EXIT_SUCCESS) {
+                removeCheckpoint();
+        }
+        endPhase(PHASE_CONVERSION);
+        if (body->comp != NULL) {
+                debug("Compressed to %lu bytes\n",
+                    compressedBytes(body->comp));
+        }
+        if (run_stats.format != STATS_NONE) {
+                ofilename[strlen(opt_output)] = 0;
+                strcat(ofilename, output_split.enabled ? ".*.prv" : ".prv");
+                strcat(ofilename, compressSuffix(compress_kind));
+                statsOutput(prv_stdout ? "stdout" : ofilename, body->records,
+                    body->bytes, body->comp != NULL ?
+                    compressedBytes(body->comp) : body->bytes);
+                statsWrites(body->bytes, body->writes, body->wait_ns);
+        }
+        destroyWriter(body);
+        body = NULL;
+        startPhase(PHASE_LIST_EVENTS);
         listEvents(ctx, pcf);
+        endPhase(PHASE_LIST_EVENTS);
+
+        if (print_timestamps) {
+                /* stdout may be carrying the trace */
+                fprintf(prv_stdout ? stderr : stdout, "LTTNG2PRV_INI=%lu\n",
+                    (trace_times.first_stream_timestamp) / 1000000000);
+                fprintf(prv_stdout ? stderr : stdout, "LTTNG2PRV_FIN=%lu\n",
+                    (trace_times.last_stream_timestamp) / 1000000000);
+        }
+
+        if (run_stats.format != STATS_NONE) {
+                ofilename[strlen(opt_output)] = 0;
+                strcat(ofilename, ".pcf");
+                fflush(pcf);
+                statsOutput(ofilename, -1, ftell(pcf), ftell(pcf));
+                ofilename[strlen(opt_output)] = 0;
+                strcat(ofilename, ".row");
+                fflush(row);
+                statsOutput(ofilename, -1, ftell(row), ftell(row));
+                statsTable("threads", reg->threads->len);
+                statsTable("tid_prv", countIds(&reg->tid_prv));
+                statsTable("irqs", reg->irqs->len);
+                statsTable("irq_prv", countIds(&reg->irq_prv));
+                statsTable("arg_types_ht", g_hash_table_size(arg_types_ht));
+                statsTable("event_class_ht",
+                    g_hash_table_size(event_class_ht));
+                printStats(stderr);
+        }
 
 end:
+        stopProgressThread();
         bt_context_put(ctx);
-
-        g_hash_table_destroy(tid_info_ht);
-        g_hash_table_destroy(tid_prv_ht);
-        g_list_free(tid_prv_l);
-        g_hash_table_destroy(irq_name_ht);
-        g_hash_table_destroy(irq_prv_ht);
-        g_list_free(irq_prv_l);
+        freeWindow();
+        if (shadow) {
+                removeShadowTrace(shadow);
+                g_free(shadow);
+        }
+        freeFilter();
+        freeStats();
+        freeCheckpoint();
+        freeFollow();
+        freeSplit();
+        freeTraceMetadata();
+        freeStates();
+        freeIndex();
+        freeCache();
+        unmapTrace();
+
+        destroyRegistry(reg);
         g_hash_table_destroy(arg_types_ht);
+        g_hash_table_destroy(event_class_ht);
 
         free(ofilename);
 
@@ -187,11 +511,12 @@ endpcf:
         fclose(pcf);
 
 endprv:
-        fflush(prv);
-        fclose(prv);
+        destroyWriter(body);
+        if (prv >= 0 && prv != STDOUT_FILENO) {
+                close(prv);
+        }
 
-endmeta:
-        return 0;
+        return status;
 }
 
 static void
@@ -205,6 +530,7 @@ parse_options(int argc, char **argv)
 {
         poptContext pc;
         int opt, ret = 0;
+        char *arg, *end;
 
         pc = poptGetContext(NULL, argc, (const char **) argv, long_options, 0);
         poptReadDefaultConfig(pc, 0);
@@ -222,11 +548,207 @@ parse_options(int argc, char **argv)
                         if (!opt_output) {
                                 fprintf(stderr, "Wrong file name\n");
                                 ret = -EINVAL;
+                        } else if (strcmp(opt_output, "-") == 0) {
+                                /* .pcf and .row are named after the trace */
+                                prv_stdout = true;
+                                free(opt_output);
+                                opt_output = NULL;
+                        }
+                        break;
+                case OPT_COMPRESS:
+                        arg = poptGetOptArg(pc);
+                        if (arg && strcmp(arg, "gz") == 0) {
+                                compress_kind = COMPRESS_GZ;
+                        } else if (arg && strcmp(arg, "zstd") == 0) {
+                                compress_kind = COMPRESS_ZSTD;
+                        } else {
+                                fprintf(stderr, "Wrong compression, "
+                                    "use gz or zstd\n");
+                                ret = -EINVAL;
+                        }
+                        if (!compressAvailable(compress_kind)) {
+                                fprintf(stderr, "lttng2prv was built without "
+                                    "%s support\n", arg);
+                                ret = -EINVAL;
+                        }
+                        free(arg);
+                        break;
+                case OPT_COMPRESS_THREADS:
+                        arg = poptGetOptArg(pc);
+                        compress_threads = arg ? strtoul(arg, &end, 10) : 0;
+                        if (!arg || *end != '\0' || compress_threads == 0) {
+                                fprintf(stderr,
+                                    "Wrong number of compression threads\n");
+                                ret = -EINVAL;
+                        }
+                        free(arg);
+                        break;
+                case OPT_BEGIN:
+                case OPT_END:
+                        arg = poptGetOptArg(pc);
+                        if (parseTimeSpec(arg, opt == OPT_BEGIN ?
+                                &window_begin : &window_end) < 0) {
+                                fprintf(stderr, "Wrong time %s\n",
+                                    arg ? arg : "");
+                                ret = -EINVAL;
                         }
+                        free(arg);
+                        break;
+                case OPT_CPUS:
+                case OPT_TIDS:
+                case OPT_PIDS:
+                        arg = poptGetOptArg(pc);
+                        if (parseIdList(arg, opt == OPT_CPUS ?
+                                &trace_filter.cpus : opt == OPT_TIDS ?
+                                &trace_filter.tids : &trace_filter.pids) < 0) {
+                                fprintf(stderr, "Wrong list %s\n",
+                                    arg ? arg : "");
+                                ret = -EINVAL;
+                        }
+                        free(arg);
+                        break;
+                case OPT_EVENTS:
+                        arg = poptGetOptArg(pc);
+                        if (parseEventList(arg) < 0) {
+                                fprintf(stderr, "Wrong event list\n");
+                                ret = -EINVAL;
+                        }
+                        free(arg);
                         break;
                 case OPT_TIMESTAMPS:
                         print_timestamps = true;
                         break;
+                case OPT_JOBS:
+                        arg = poptGetOptArg(pc);
+                        jobs = arg ? strtoul(arg, &end, 10) : 0;
+                        if (!arg || *end != '\0' || jobs == 0) {
+                                fprintf(stderr, "Wrong number of jobs\n");
+                                ret = -EINVAL;
+                        }
+                        free(arg);
+                        break;
+                case OPT_BUFFER_SIZE:
+                        arg = poptGetOptArg(pc);
+                        if (parse_size(arg, &write_buffer_size) < 0) {
+                                fprintf(stderr, "Wrong buffer size\n");
+                                ret = -EINVAL;
+                        }
+                        free(arg);
+                        break;
+                case OPT_ASYNC:
+                        arg = poptGetOptArg(pc);
+                        if (arg && strcmp(arg, "thread") == 0) {
+                                write_mode = WRITER_THREAD;
+                        } else if (arg && strcmp(arg, "uring") == 0) {
+                                write_mode = WRITER_URING;
+                        } else {
+                                fprintf(stderr, "Wrong asynchronous output, "
+                                    "use thread or uring\n");
+                                ret = -EINVAL;
+                        }
+                        free(arg);
+                        break;
+                case OPT_QUEUE_DEPTH:
+                        arg = poptGetOptArg(pc);
+                        write_queue_depth = arg ? strtoul(arg, &end, 10) : 0;
+                        if (!arg || *end != '\0' || write_queue_depth == 0) {
+                                fprintf(stderr, "Wrong queue depth\n");
+                                ret = -EINVAL;
+                        }
+                        free(arg);
+                        break;
+                case OPT_SINGLE_PASS:
+                        single_pass = true;
+                        break;
+                case OPT_STATS:
+                        arg = poptGetOptArg(pc);
+                        if (arg && strcmp(arg, "text") == 0) {
+                                run_stats.format = STATS_TEXT;
+                        } else if (arg && strcmp(arg, "json") == 0) {
+                                run_stats.format = STATS_JSON;
+                        } else {
+                                fprintf(stderr, "Wrong stats format, "
+                                    "use text or json\n");
+                                ret = -EINVAL;
+                        }
+                        free(arg);
+                        break;
+                case OPT_PROGRESS:
+                        arg = poptGetOptArg(pc);
+                        if (arg && strcmp(arg, "auto") == 0) {
+                                progress_mode = PROGRESS_AUTO;
+                        } else if (arg && strcmp(arg, "always") == 0) {
+                                progress_mode = PROGRESS_ALWAYS;
+                        } else {
+                                fprintf(stderr, "Wrong progress mode, "
+                                    "use auto or always\n");
+                                ret = -EINVAL;
+                        }
+                        free(arg);
+                        break;
+                case OPT_CHECKPOINT:
+                        arg = poptGetOptArg(pc);
+                        checkpoint_interval = arg ? strtoul(arg, &end, 10) : 0;
+                        if (!arg || *end != '\0' || checkpoint_interval == 0) {
+                                fprintf(stderr, "Wrong checkpoint interval\n");
+                                ret = -EINVAL;
+                        }
+                        free(arg);
+                        break;
+                case OPT_RESUME:
+                        resume = true;
+                        break;
+                case OPT_FOLLOW:
+                        follow = true;
+                        break;
+                case OPT_SPLIT_TIME:
+                        arg = poptGetOptArg(pc);
+                        if (parseTimeSpec(arg, &split_time) < 0 ||
+                            split_time.absolute || split_time.ns == 0) {
+                                fprintf(stderr, "Wrong slice time %s\n",
+                                    arg ? arg : "");
+                                ret = -EINVAL;
+                        }
+                        free(arg);
+                        break;
+                case OPT_SPLIT_SIZE:
+                        arg = poptGetOptArg(pc);
+                        if (parse_size(arg, &split_size) < 0) {
+                                fprintf(stderr, "Wrong slice size\n");
+                                ret = -EINVAL;
+                        }
+                        free(arg);
+                        break;
+                case OPT_SORT_MEM:
+                        arg = poptGetOptArg(pc);
+                        if (parse_size(arg, &sort_mem) < 0) {
+                                fprintf(stderr, "Wrong sort memory size\n");
+                                ret = -EINVAL;
+                        }
+                        free(arg);
+                        break;
+                case OPT_STATE_RECORDS:
+                        state_records = true;
+                        break;
+                case OPT_INDEX:
+                        index_scan = true;
+                        break;
+                case OPT_NO_CACHE:
+                        no_cache = true;
+                        break;
+                case OPT_DECODER:
+                        arg = poptGetOptArg(pc);
+                        if (arg && strcmp(arg, "babeltrace") == 0) {
+                                decoder = DECODER_BABELTRACE;
+                        } else if (arg && strcmp(arg, "native") == 0) {
+                                decoder = DECODER_NATIVE;
+                        } else {
+                                fprintf(stderr, "Wrong decoder, use "
+                                    "babeltrace or native\n");
+                                ret = -EINVAL;
+                        }
+                        free(arg);
+                        break;
                 case OPT_VERBOSE:
                         verbose = true;
                         break;
@@ -242,6 +764,99 @@ parse_options(int argc, char **argv)
                 ret = -EINVAL;
         }
 
+        if (follow && (jobs > 1 || window_begin.set || window_end.set ||
+                trace_filter.cpus != NULL || checkpoint_interval > 0 ||
+                resume || progress_mode != PROGRESS_NONE)) {
+                fprintf(stderr,
+                    "--follow converts each chunk in a single pass as it is "
+                    "archived, it can't be used with --jobs, --begin, --end, "
+                    "--cpus, --checkpoint, --resume or --progress\n");
+                ret = -EINVAL;
+        }
+        /* chunks are spooled until the session ends */
+        single_pass = single_pass || follow;
+
+        if (single_pass && jobs > 1) {
+                fprintf(stderr,
+                    "--jobs needs the thread information of the two-pass "
+                    "conversion, it can't be used with --single-pass\n");
+                ret = -EINVAL;
+        }
+
+        if (single_pass && (window_begin.set || window_end.set)) {
+                fprintf(stderr,
+                    "--begin and --end seek past the thread information "
+                    "gathered in a single pass, they can't be used with "
+                    "--single-pass\n");
+                ret = -EINVAL;
+        }
+
+        if ((checkpoint_interval > 0 || resume) && (single_pass || jobs > 1 ||
+                prv_stdout || compress_kind != COMPRESS_NONE ||
+                write_mode != WRITER_SYNC)) {
+                fprintf(stderr,
+                    "--checkpoint and --resume need the sequential two-pass "
+                    "conversion to a plain .prv file, they can't be used with "
+                    "--single-pass, --jobs, -o -, --compress or --async\n");
+                ret = -EINVAL;
+        }
+
+        if ((split_time.set || split_size > 0) && (single_pass ||
+                jobs > 1 || prv_stdout || compress_kind != COMPRESS_NONE ||
+                write_mode != WRITER_SYNC || checkpoint_interval > 0 ||
+                resume)) {
+                fprintf(stderr,
+                    "--split-by-time and --split-by-size rewrite the header "
+                    "of each slice of the sequential two-pass conversion, "
+                    "they can't be used with --single-pass, --follow, "
+                    "--jobs, -o -, --compress, --async, --checkpoint or "
+                    "--resume\n");
+                ret = -EINVAL;
+        }
+
+        if (sort_mem > 0 && (split_time.set || split_size > 0 ||
+                checkpoint_interval > 0 || resume)) {
+                fprintf(stderr,
+                    "--sort-mem only writes the .prv once all of it is "
+                    "sorted, it can't be used with --split-by-time, "
+                    "--split-by-size, --checkpoint or --resume\n");
+                ret = -EINVAL;
+        }
+
+        if (state_records && (single_pass || jobs > 1 || split_time.set ||
+                split_size > 0 || checkpoint_interval > 0 || resume)) {
+                fprintf(stderr,
+                    "--state-records follows every thread through the "
+                    "sequential two-pass conversion, it can't be used with "
+                    "--single-pass, --follow, --jobs, --split-by-time, "
+                    "--split-by-size, --checkpoint or --resume\n");
+                ret = -EINVAL;
+        }
+        /* intervals are printed as they end, out of time order */
+        if (state_records && sort_mem == 0) {
+                sort_mem = SORT_STATES_MEM;
+        }
+
+        if (index_scan && (single_pass || jobs > 1 || split_time.set ||
+                split_size > 0 || checkpoint_interval > 0 || resume)) {
+                fprintf(stderr,
+                    "--index registers the threads found after the statedump "
+                    "in the sequential two-pass conversion, it can't be used "
+                    "with --single-pass, --follow, --jobs, --split-by-time, "
+                    "--split-by-size, --checkpoint or --resume\n");
+                ret = -EINVAL;
+        }
+
+        if (decoder == DECODER_NATIVE && (follow || jobs > 1 ||
+                window_begin.set || window_end.set ||
+                checkpoint_interval > 0 || resume)) {
+                fprintf(stderr,
+                    "--decoder=native reads the trace from its beginning "
+                    "without seeking, it can't be used with --follow, "
+                    "--jobs, --begin, --end, --checkpoint or --resume\n");
+                ret = -EINVAL;
+        }
+
         if (pc) {
                 poptFreeContext(pc);
         }
@@ -249,6 +864,44 @@ parse_options(int argc, char **argv)
         return ret;
 }
 
+/*
+ * Parses a size in bytes with an optional K, M or G binary suffix
+ */
+static int
+parse_size(const char *arg, size_t *size)
+{
+        char *end;
+        unsigned long long val;
+
+        if (arg == NULL) {
+                return -1;
+        }
+        val = strtoull(arg, &end, 10);
+        switch (*end) {
+        case 'G':
+        case 'g':
+                val <<= 10;
+                /* FALLTHROUGH */
+        case 'M':
+        case 'm':
+                val <<= 10;
+                /* FALLTHROUGH */
+        case 'K':
+        case 'k':
+                val <<= 10;
+                end++;
+                break;
+        default:
+                break;
+        }
+        if (end == arg || *end != '\0' || val == 0) {
+                return -1;
+        }
+        *size = val;
+
+        return 0;
+}
+
 static GPtrArray *traversed_paths = 0;
 
 static int
@@ -301,7 +954,7 @@ traverse_trace_dir(const char *fpath, const struct stat *sb, int tflag,
         return 0;
 }
 
-static int
+int
 bt_context_add_traces_recursive(struct bt_context *ctx,
     const char *path, const char *format_str,
     void (*packet_seek)(struct bt_stream_pos *pos, size_t offset, int whence))
@@ -334,6 +987,10 @@ bt_context_add_traces_recursive(struct bt_context *ctx,
                                 ret = 1;
                         } else {
                                 debug("Adding trace # : %d\n", trace_id);
+                                startPhase(PHASE_METADATA);
+                                addTraceMetadata(ctx, trace_id,
+                                    trace_path->str);
+                                endPhase(PHASE_METADATA);
                                 g_array_append_val(trace_ids, trace_id);
                         }
                         g_string_free(trace_path, TRUE);
@@ -350,358 +1007,6 @@ bt_context_add_traces_recursive(struct bt_context *ctx,
         return ret;
 }
 
-/*
- * Iterates through all events of the trace
- */
-static void
-iter_trace(struct bt_context *bt_ctx, uint64_t *trace_offset, FILE *fp,
-    GHashTable *tid_info_ht, GHashTable *tid_prv_ht, GHashTable *irq_name_ht,
-    GHashTable *irq_prv_ht, const uint32_t ncpus, const uint32_t nsoftirqs,
-    GHashTable *arg_types_ht, GHashTable *lost_events_ht)
-{
-        UNUSED(tid_info_ht);
-        struct bt_ctf_iter *iter;
-        struct bt_iter_pos begin_pos;
-        struct bt_ctf_event *event;
-        const struct bt_definition *scope;
-        int ret = 0;
-        int flags;
-        unsigned int nresources = ncpus + nsoftirqs +
-            g_hash_table_size(irq_name_ht);
-        /* independent appl_id for each resource (CPU or IRQ) */
-        uint64_t appl_id[nresources];
-        uint64_t task_id, thread_id, event_time;
-        uint32_t cpu_id, irq_id;
-        uint64_t event_type, event_value, offset_stream;
-
-        unsigned int state;
-        uint64_t prev_state;
-        char *event_name;
-        uint32_t systemTID, prvTID, swapper;
-
-        char fields[256];
-
-        short int print = 0;
-        short int print_state = 0;
-
-        void *lostEvents = NULL;
-        size_t lost_ini, lost_fi;
-
-        begin_pos.type = BT_SEEK_BEGIN;
-        iter = bt_ctf_iter_create(bt_ctx, &begin_pos, NULL);
-        bt_ctf_iter_add_callback(iter,
-            g_quark_from_static_string("exit_syscall"), NULL, 0,
-            handle_exit_syscall, NULL, NULL, NULL);
-
-        task_id = 1;
-        thread_id = 1;
-
-        for (unsigned int i = 0; i < nresources; i++) {
-                appl_id[i] = 0;
-        }
-
-        swapper = GPOINTER_TO_INT(g_hash_table_lookup(tid_prv_ht,
-            GINT_TO_POINTER(0)));
-
-        while ((event = bt_ctf_iter_read_event_flags(iter, &flags)) != NULL) {
-                print = 1;
-                print_state = 1;
-                scope = bt_ctf_get_top_level_scope(event,
-                    BT_STREAM_PACKET_CONTEXT);
-                cpu_id = bt_get_unsigned_int(bt_ctf_get_field(event, scope,
-                    "cpu_id"));
-
-                event_name = (char *) malloc(sizeof(char *) *
-                    strlen(bt_ctf_event_name(event) + 1));
-                strcpy(event_name, bt_ctf_event_name(event));
-
-                /* State Records */
-
-                if (strstr(event_name, "sched_switch") != NULL) {
-                        offset_stream = trace_times.first_stream_timestamp;
-
-                        scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
-                        systemTID = bt_get_signed_int(
-                            bt_ctf_get_field(event, scope, "_next_tid"));
-                        prvTID = GPOINTER_TO_INT(
-                            g_hash_table_lookup(
-                                tid_prv_ht, GINT_TO_POINTER(systemTID)));
-
-                        if (systemTID == 0) {
-                                prvTID = swapper;
-                        }
-                        appl_id[cpu_id] = prvTID;
-                }
-
-                if (strcmp(event_name, "syscall_entry") == 0) {
-                        offset_stream = trace_times.first_stream_timestamp;
-                        //      state = 4; // SYSCALL
-
-                        //appl_id = prvTID;
-                }
-
-                if (strcmp(event_name, "syscall_exit") == 0) {
-                        offset_stream = trace_times.first_stream_timestamp;
-                        //      state = 2;
-
-                        //appl_id = prvTID;
-                }
-
-                /* /State Records */
-
-                /* Event Records */
-
-                offset_stream = trace_times.first_stream_timestamp;
-
-                // scope = bt_ctf_get_top_level_scope(event,
-                //    BT_STREAM_PACKET_CONTEXT);
-
-                event_time = bt_ctf_get_timestamp(event) - offset_stream;
-
-                scope = bt_ctf_get_top_level_scope(event,
-                    BT_STREAM_EVENT_HEADER);
-
-                /* Add 1 to the event_value to reserve 0 for exit */
-                event_value = bt_ctf_get_uint64(
-                    bt_ctf_get_enum_int(
-                        bt_ctf_get_field(event, scope, "id"))) + 1;
-                if (strstr(event_name, "syscall_entry_") != NULL) {
-                        event_type = 10000000;
-                        state = STATE_SYSCALL;
-                        if (strstr(event_name, "syscall_entry_exit") != NULL) {
-                                event_value = 0;
-                        }
-                } else if (strstr(event_name, "syscall_exit_") != NULL) {
-                        event_type = 10000000;
-                        event_value = 0;
-                        state = STATE_USERMODE;
-                /*
-                 * For softirq and irq_handler types we manually specify the
-                 * event_value IDs instead of using the one provided by lttng.
-                 * This way we always use the same values for these events.
-                 */
-                } else if (strstr(event_name, "irq_handler_") != NULL) {
-                        event_type = 10200000;
-                        event_value = 1;
-                        state = STATE_IRQ;
-                        //appl_id = 1;
-                        if (strstr(event_name, "irq_handler_exit") != NULL) {
-                                event_value = 0;
-                                state = STATE_USERMODE;
-                        }
-                        scope = bt_ctf_get_top_level_scope(event,
-                            BT_EVENT_FIELDS);
-                        irq_id = bt_get_signed_int(
-                            bt_ctf_get_field(event, scope, "_irq"));
-                        irq_id = ncpus + nsoftirqs +
-                            GPOINTER_TO_INT(g_hash_table_lookup(
-                                    irq_prv_ht, GINT_TO_POINTER(irq_id))) - 1;
-                        /* assign the same thread_id of the calling process
-                         * to the irq position
-                         */
-                        appl_id[irq_id] = appl_id[cpu_id];
-                        /* we need cpu_id to be the identifier of the irq
-                         * to properly print the prv line
-                         */
-                        cpu_id = irq_id;
-                } else if (strstr(event_name, "softirq_") != NULL) {
-                        event_type = 10100000;
-                        state = STATE_SOFTIRQ;
-                        event_value = 1;
-                        //appl_id = 1;
-                        if (strstr(event_name, "softirq_raise") != NULL) {
-                                print = 0;
-                                event_value = 2;
-                        } else if (strstr(event_name, "softirq_exit") != NULL) {
-                                event_value = 0;
-                                state = STATE_USERMODE;
-                        }
-                        scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
-                        irq_id = ncpus - 1 + bt_get_unsigned_int(
-                            bt_ctf_get_field(event, scope, "_vec"));
-                        /* Assign the same thread_id of the calling process
-                         * to the irq position
-                         */
-                        appl_id[irq_id] = appl_id[cpu_id];
-                        /* We need cpu_id to be the identifier of the irq
-                         * to properly print the prv line
-                         */
-                        cpu_id = irq_id;
-                } else if ((strstr(event_name, "netif_") != NULL) ||
-                            (strstr(event_name, "net_dev_") != NULL)) {
-                        event_type = 10300000;
-                        state = STATE_NETWORK;
-                        print_state = 0;
-                } else if (strcmp(event_name, "sched_switch") == 0) {
-                        event_type = 10900000;
-                        scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
-                        systemTID = bt_get_signed_int(
-                        bt_ctf_get_field(event, scope, "_prev_tid"));
-                        prvTID = GPOINTER_TO_INT(
-                            g_hash_table_lookup(
-                                tid_prv_ht, GINT_TO_POINTER(systemTID)));
-                        if (systemTID == 0) {
-                                prvTID = swapper;
-                        }
-
-                        prev_state = bt_get_signed_int(
-                            bt_ctf_get_field(event, scope, "_prev_state"));
-                        if (prev_state == 0) {
-                                state = STATE_WAIT_CPU;
-                        } else {
-                                state = STATE_WAIT_BLOCK;
-                        }
-
-                        fprintf(fp, "2:%u:%u:%lu:%lu:%lu:20000000:%u\n",
-                            cpu_id + 1, prvTID, task_id, thread_id,
-                            event_time, state);
-
-                        state = STATE_USERMODE;
-                } else if (strcmp(event_name, "sched_wakeup") == 0) {
-                        event_type = 10900000;
-                        state = STATE_WAIT_CPU;
-                        scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
-                        systemTID = bt_get_signed_int(
-                            bt_ctf_get_field(event, scope, "_tid"));
-                        prvTID = GPOINTER_TO_INT(
-                        g_hash_table_lookup(
-                            tid_prv_ht, GINT_TO_POINTER(systemTID)));
-                        if (systemTID == 0) {
-                                prvTID = swapper;
-                        }
-                        fprintf(fp, "2:%u:%u:%lu:%lu:%lu:20000000:%d:20000000:%u\n",
-                            cpu_id + 1, prvTID, task_id,
-                            thread_id, event_time, STATE_USERMODE, state);
-                        state = STATE_USERMODE;
-                        print_state = 0;
-                } else if (strcmp(event_name, "sched_process_fork") == 0) {
-                        event_type = 10900000;
-                        state = STATE_WAIT_CPU;
-                        scope = bt_ctf_get_top_level_scope(event, BT_EVENT_FIELDS);
-                        systemTID = bt_get_signed_int(
-                            bt_ctf_get_field(event, scope, "_child_tid"));
-                        prvTID = GPOINTER_TO_INT(
-                        g_hash_table_lookup(
-                            tid_prv_ht, GINT_TO_POINTER(systemTID)));
-                        if (systemTID == 0) {
-                                prvTID = swapper;
-                        }
-                        fprintf(fp, "2:%u:%u:%lu:%lu:%lu:20000000:%u\n",
-                            cpu_id + 1, prvTID, task_id,
-                            thread_id, event_time, state);
-                        state = STATE_USERMODE;
-                        print_state = 0;
-                } else {
-                        event_type = 10900000;
-                        state = STATE_USERMODE;
-                        if ((strcmp(event_name, "sched_process_exit") == 0) ||
-                            (strcmp(event_name, "hrtimer_expire_exit") == 0) ||
-                            (strcmp(event_name, "timer_expire_exit") == 0) ||
-                            (strcmp(event_name, "kvm_userspace_exit") == 0) ||
-                            (strcmp(event_name, "kvm_exit") == 0) ||
-                            (strcmp(event_name, "ext4_ind_map_blocks_exit") == 0) ||
-                            (strcmp(event_name, "ext4_ext_map_blocks_exit") == 0) ||
-                            (strcmp(event_name, "ext4_truncate_exit") == 0) ||
-                            (strcmp(event_name, "ext4_unlink_exit") == 0) ||
-                            (strcmp(event_name, "ext4_fallocate_exit") == 0) ||
-                            (strcmp(event_name, "ext4_direct_IO_exit") == 0) ||
-                            (strcmp(event_name, "ext4_sync_file_exit") == 0)) {
-//                        if (strstr(event_name, "_exit") != 0) {
-                                event_value = 0;
-                                state = STATE_USERMODE;
-                        }
-                        print_state = 0;
-                }
-
-                /* ID for value == 65536 in extended metadata */
-                if (event_value == id_size) {
-                        // Add 1 to the new event_value to reserve 0 for exit
-                        event_value = bt_ctf_get_uint64(
-                            bt_ctf_get_struct_field_index(
-                                bt_ctf_get_field(event, scope, "v"), 0)) + 1;
-                }
-
-                /* Get Call Arguments */
-                fields[0] = '\0';
-                getArgValue(event, event_type, arg_types_ht, &fields[0]);
-
-                /*
-                 * Prints lost events if found assigned to the same application
-                 * and CPU as the last recorded event.
-                 */
-                if ((lostEvents = g_hash_table_lookup(lost_events_ht, GINT_TO_POINTER(bt_ctf_get_timestamp(event))))) {
-                        scope = bt_ctf_get_top_level_scope(event,
-                            BT_STREAM_PACKET_CONTEXT);
-                        lost_ini = event_time;
-                        lost_fi = bt_ctf_get_uint64(
-                            bt_ctf_get_field(event, scope, "timestamp_end")) +
-                            *trace_offset - trace_times.first_stream_timestamp;
-
-                        fprintf(fp,
-                            "2:%u:%lu:1:1:%" PRIu64 ":99999999:%d\n",
-                            cpu_id + 1,
-                            appl_id[cpu_id],
-                            lost_ini,
-                            GPOINTER_TO_INT(lostEvents));
-
-                        fprintf(fp,
-                            "2:%u:%lu:1:1:%" PRIu64 ":99999999:%d\n",
-                            cpu_id + 1,
-                            appl_id[cpu_id],
-                            lost_fi,
-                            0);
-                }
-
-                /* print only if we know the appl_id of the event */
-                if ((print != 0) && (appl_id[cpu_id] != 0)) {
-                        if (print_state == 1) {
-                                fprintf(fp, "2:%u:%lu:%lu:%lu:%lu:20000000:%u:%lu:%lu%s\n", 
-                                    cpu_id + 1, appl_id[cpu_id], task_id,
-                                    thread_id, event_time, state, event_type,
-                                    event_value, fields);
-                        } else {
-                                fprintf(fp, 
-                                    "2:%u:%lu:%lu:%lu:%lu:%lu:%lu%s\n", 
-                                    cpu_id + 1, appl_id[cpu_id], task_id,
-                                    thread_id, event_time, event_type,
-                                    event_value, fields);
-                        }
-
-                        if (event_type == 10300000) {
-                                fprintf(fp,
-                                    "2:%u:%lu:%lu:%lu:%lu:%lu:%d\n",
-                                    cpu_id + 1, appl_id[cpu_id], task_id,
-                                    thread_id, event_time + 1, event_type, 0);
-                        }
-                }
-                free(event_name);
-
-
-                /* /Event Records */
-
-                if (flags) {
-                        fprintf(stderr, "LOST : %" PRIu64 "\n",
-                            bt_ctf_get_lost_events_count(iter));
-                }
-
-                ret = bt_iter_next(bt_ctf_get_iter(iter));
-
-                if (ret < 0)
-                        goto end_iter;
-        }
-
-end_iter:
-        bt_ctf_iter_destroy(iter);
-
-        if (print_timestamps) {
-                // fprintf(stdout, ...) prints unwanted characters
-                printf("LTTNG2PRV_INI=%lu\n",
-                    (trace_times.first_stream_timestamp) / 1000000000);
-                printf("LTTNG2PRV_FIN=%lu\n",
-                    (trace_times.last_stream_timestamp) / 1000000000);
-        }
-}
-
 /*
  * Modeline for space only BSD KNF code style
  */
@@ -2,9 +2,8 @@
 #ifndef LTTNG2PRV_H
 #define LTTNG2PRV_H
 
-#define UNUSED(x) (void)(x)
-
 #include <errno.h>
+#include <stdbool.h>
 #include <fcntl.h>
 #include <ftw.h>
 #include <glib.h>
@@ -14,20 +13,47 @@
 #include <babeltrace/ctf/events.h>
 #include <babeltrace/ctf/callbacks.h>
 
+#include "readPacketContext.h"
+#include "readEvents.h"
+#include "writeRecords.h"
+#include "registerIds.h"
+#include "spoolBody.h"
+
 enum bt_cb_ret handle_exit_syscall(struct bt_ctf_event *_call_data,
     void *_private_data);
 
+int bt_context_add_traces_recursive(struct bt_context *_ctx,
+    const char *_path, const char *_format_str,
+    void (*packet_seek)(struct bt_stream_pos *pos, size_t offset, int whence));
+
 void getThreadInfo(struct bt_context *_ctx, uint32_t *_ncpus,
-    GHashTable *_tid_info_ht, GHashTable *_tid_prv_ht, GList **_tid_prv_l,
-    GHashTable *_irq_name_ht, uint32_t *_nsoftirqs,
-    GHashTable *_irq_prv_ht, GList **_irq_prv_l, GHashTable *_lost_events_ht);
+    struct prvRegistry *_reg, uint32_t *_nsoftirqs,
+    GHashTable *_event_class_ht);
+
+void updateThreadInfo(const struct eventSource *_src, uint32_t *_ncpus,
+    struct prvRegistry *_reg, uint32_t *_nsoftirqs);
+
+void registerThread(uint32_t _tid, const char *_name,
+    struct prvRegistry *_reg);
 
-void printPRVHeader(struct bt_context *_ctx, FILE *_fp,
-    GHashTable *_tid_info_ht, int _nresources);
+void formatThreadInfo(GString *_s, uint32_t _ncpus, uint32_t _nsoftirqs,
+    const struct prvRegistry *_reg);
 
-void printROW(FILE *_fp, GHashTable *_tid_info_ht, GList *_tid_prv_l,
-    GHashTable *_irq_name_ht, GList *_irq_prv_l, const uint32_t _ncpus,
-    const uint32_t _nsoftirqs);
+bool readThreadInfo(const char *_line, uint32_t *_ncpus,
+    uint32_t *_nsoftirqs, struct prvRegistry *_reg);
+
+char *readEscaped(const char *_line);
+
+void iter_trace(struct bt_context *_bt_ctx, struct prvWriter *_prv,
+    FILE *_spool, struct streamSpool *_streams, const bool _discover,
+    struct prvRegistry *_reg, uint32_t *_ncpus, uint32_t *_nsoftirqs,
+    GHashTable *_arg_types_ht, GHashTable *_event_class_ht);
+
+void printPRVHeader(struct bt_context *_ctx, struct prvWriter *_w,
+    const struct prvRegistry *_reg, int _nresources);
+
+void printROW(FILE *_fp, const struct prvRegistry *_reg,
+    const uint32_t _ncpus, const uint32_t _nsoftirqs);
 
 void printPCFHeader(FILE *_fp);
 
@@ -35,8 +61,11 @@ uint64_t bt_get_unsigned_int(const struct bt_definition *_field);
 
 int64_t bt_get_signed_int(const struct bt_definition *_field);
 
+GHashTable *createArgPlans(void);
+
 void getArgValue(struct bt_ctf_event *_event, uint64_t _event_type,
-    GHashTable *_arg_types_ht, char *_fields);
+    GHashTable *_arg_types_ht, GHashTable *_arg_plans_ht,
+    struct prvWriter *_w);
 
 #endif
 
@@ -0,0 +1,1756 @@
+/* Native decoder of the stream files of a trace, for --decoder=native */
+
+#define _DEFAULT_SOURCE
+
+#include <endian.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mapTrace.h"
+#include "parseMetadata.h"
+#include "lttng2prv.h"
+#include "classifyEvents.h"
+#include "readMetadata.h"
+#include "streamFiles.h"
+
+/* Magic number of every CTF packet */
+#define CTF_MAGIC 0xC1FC1FC1
+
+/* Event and stream ids index arrays */
+#define MAX_ID (1 << 20)
+
+/* Arguments kept for the record of an event, see getArgValue() */
+#define MAX_ARGS 32
+
+#define ALIGN_BITS(pos, align) \
+        (((pos) + (align) - 1) & ~((uint64_t) (align) - 1))
+
+/* Where a struct is compiled for, which decides the fields it captures */
+enum
+{
+        SCOPE_NONE = 0,
+        SCOPE_PACKET_HEADER,
+        SCOPE_PACKET_CONTEXT,
+        SCOPE_EVENT_HEADER,
+        /* an option of the variant of the event header */
+        SCOPE_HEADER_OPTION,
+        SCOPE_PAYLOAD
+};
+
+/* Fields read while decoding, by what they are read for */
+enum
+{
+        CAP_NONE = 0,
+        CAP_MAGIC,
+        CAP_STREAM_ID,
+        CAP_TIMESTAMP_BEGIN,
+        CAP_TIMESTAMP_END,
+        CAP_CONTENT_SIZE,
+        CAP_PACKET_SIZE,
+        CAP_EVENTS_DISCARDED,
+        CAP_CPU_ID,
+        CAP_ID,
+        CAP_EXTENDED_ID,
+        CAP_TIMESTAMP,
+        /* the payload fields, FIELD_* of readEvents.h */
+        CAP_FIELDS,
+        NCAPS = CAP_FIELDS + NFIELDS
+};
+
+static const struct
+{
+        int scope;
+        const char *name;
+        int cap;
+} capture_names[] = {
+        { SCOPE_PACKET_HEADER, "magic", CAP_MAGIC },
+        { SCOPE_PACKET_HEADER, "stream_id", CAP_STREAM_ID },
+        { SCOPE_PACKET_CONTEXT, "timestamp_begin", CAP_TIMESTAMP_BEGIN },
+        { SCOPE_PACKET_CONTEXT, "timestamp_end", CAP_TIMESTAMP_END },
+        { SCOPE_PACKET_CONTEXT, "content_size", CAP_CONTENT_SIZE },
+        { SCOPE_PACKET_CONTEXT, "packet_size", CAP_PACKET_SIZE },
+        { SCOPE_PACKET_CONTEXT, "events_discarded", CAP_EVENTS_DISCARDED },
+        { SCOPE_PACKET_CONTEXT, "cpu_id", CAP_CPU_ID },
+        { SCOPE_EVENT_HEADER, "id", CAP_ID },
+        { SCOPE_EVENT_HEADER, "timestamp", CAP_TIMESTAMP },
+        { SCOPE_HEADER_OPTION, "id", CAP_EXTENDED_ID },
+        { SCOPE_HEADER_OPTION, "timestamp", CAP_TIMESTAMP }
+};
+
+/* Event headers with a decoder of their own */
+enum
+{
+        HEADER_NONE = 0,
+        /* a 5-bit id and 27-bit timestamp, LTTng's compact header */
+        HEADER_COMPACT,
+        /* a 16-bit id and 32-bit timestamp, LTTng's large header */
+        HEADER_LARGE,
+        /* anything else, walked as any struct */
+        HEADER_GENERIC
+};
+
+/* The option of a variant selected by a range of tag values */
+struct tagRange
+{
+        uint64_t begin;
+        uint64_t end;
+        unsigned int option;
+};
+
+/*
+ * A type of the metadata compiled for decoding. Fixed-size nodes always
+ * take _size bits, and a fixed-size struct has the offset of each of its
+ * fields worked out, so only the fields captured are read. Everything else
+ * is walked field by field.
+ */
+struct node
+{
+        int kind;
+        unsigned int align;
+        /* integers, floats and enums */
+        unsigned int bits;
+        bool is_signed;
+        bool big_endian;
+        /* strings, and arrays and sequences of characters */
+        bool text;
+        bool fixed;
+        uint64_t size;
+        /* arrays and sequences, fixed-size elements are _stride apart */
+        struct node *elem;
+        uint64_t length;
+        uint64_t stride;
+        /* sequences and variants: the field of the parent holding the
+         * length or the tag */
+        unsigned int ref;
+        /* the fields of structs and the options of variants */
+        unsigned int n;
+        struct node **members;
+        /* structs: offset of each field if fixed, what it is read for */
+        uint64_t *offsets;
+        int *caps;
+        unsigned int *args;
+        bool *keep;
+        bool has_refs;
+        /* structs: the fields with a capture or an argument */
+        unsigned int nreads;
+        unsigned int *reads;
+        /* variants */
+        bool tag_signed;
+        unsigned int nranges;
+        struct tagRange *ranges;
+};
+
+/* What was read of the current event of a stream */
+struct capture
+{
+        uint64_t have;
+        /* the texts that are NUL-terminated strings */
+        uint64_t strings;
+        uint64_t values[NCAPS];
+        const char *texts[NCAPS];
+        size_t lengths[NCAPS];
+        unsigned int ts_bits;
+        /* integer fields printed as arguments, in field order */
+        unsigned int nargs;
+        uint64_t args[MAX_ARGS];
+        unsigned int arg_types[MAX_ARGS];
+        bool arg_signed[MAX_ARGS];
+};
+
+struct mappedEvent
+{
+        const struct eventClass *class;
+        struct node *context;
+        struct node *fields;
+};
+
+/* A stream class of a trace */
+struct mappedClass
+{
+        int header;
+        struct node *packet_context;
+        struct node *event_header;
+        struct node *event_context;
+        /* struct mappedEvent by id, NULL for the ids not declared */
+        GPtrArray *events;
+};
+
+struct mappedTrace
+{
+        char *dir;
+        /* added to the clock of the events for their timestamps */
+        int64_t clock_offset;
+        /* as babeltrace's flow reads it for the packet contexts */
+        struct traceMetadata meta;
+        struct node *packet_header;
+        /* struct mappedClass by stream id */
+        GPtrArray *classes;
+        /* every node and event of the trace */
+        GPtrArray *nodes;
+        GPtrArray *events;
+};
+
+struct mappedStream
+{
+        const struct mappedTrace *trace;
+        const struct mappedClass *sc;
+        /* in the list being mapped, only while it is */
+        const struct streamFile *file;
+        char *path;
+        const uint8_t *map;
+        size_t size;
+        /* the packet being read, _content and _pos in bits from _base */
+        size_t packet_offset;
+        const uint8_t *base;
+        uint64_t packet_bits;
+        uint64_t content;
+        uint64_t pos;
+        /* the packet context of the packet being read */
+        uint64_t context_have;
+        uint64_t context[CAP_CPU_ID + 1];
+        /* the clock, in cycles */
+        uint64_t cycles;
+        /* the event read next */
+        const struct mappedEvent *event;
+        uint64_t timestamp;
+        uint64_t id;
+        uint64_t extended_id;
+        struct capture cap;
+        /* what readPacketContext() keeps for a stream */
+        struct packetContext packet;
+        bool seen;
+};
+
+struct nativeDecoder native_decoder;
+
+static inline uint64_t read_bits(const uint8_t *_base, uint64_t _pos,
+    unsigned int _bits, bool _big_endian);
+
+static inline uint64_t extend(uint64_t _value, unsigned int _bits,
+    bool _is_signed);
+
+static inline uint64_t cap_value(const struct capture *_cap, int _c);
+
+static const char *cap_text(const struct capture *_cap, int _c, char *_buf,
+    size_t _size);
+
+static const struct node *select_option(const struct node *_node,
+    uint64_t _tag);
+
+static void capture_field(const struct mappedStream *_s,
+    const struct node *_node, unsigned int _i, uint64_t _from, uint64_t _to,
+    struct capture *_cap);
+
+static bool walk_node(struct mappedStream *_s, const struct node *_node,
+    uint64_t *_pos, const uint64_t *_vals, struct capture *_cap);
+
+static bool walk_struct(struct mappedStream *_s, const struct node *_node,
+    uint64_t *_pos, struct capture *_cap);
+
+static inline void update_clock(struct mappedStream *_s, uint64_t _value,
+    unsigned int _bits);
+
+static bool read_compact_header(struct mappedStream *_s);
+
+static bool read_large_header(struct mappedStream *_s);
+
+static bool read_generic_header(struct mappedStream *_s);
+
+static bool read_event(struct mappedStream *_s);
+
+static int open_packet(struct mappedStream *_s);
+
+static bool next_event(struct mappedStream *_s);
+
+static void read_context(const struct mappedStream *_s,
+    struct packetContext *_packet);
+
+static const struct packetContext *stream_packet(struct mappedStream *_s);
+
+static bool stream_gt(const struct mappedStream *_a,
+    const struct mappedStream *_b);
+
+static void heapify(unsigned int _i);
+
+static void heap_insert(struct mappedStream *_s);
+
+static void heap_remove(void);
+
+static void advance(struct mappedStream *_s);
+
+static int capture_of(int _scope, const char *_name);
+
+static struct node *compile(struct mappedTrace *_t,
+    const struct ctfType *_type, int _scope, GHashTable *_arg_types_ht);
+
+static bool compile_struct(struct mappedTrace *_t, struct node *_node,
+    const struct ctfType *_type, int _scope, GHashTable *_arg_types_ht);
+
+static bool compile_ranges(struct node *_node, const struct ctfType *_variant,
+    const struct ctfType *_tag);
+
+static bool compile_scope(struct mappedTrace *_t, const struct ctfType *_type,
+    int _scope, GHashTable *_arg_types_ht, struct node **_node);
+
+static const struct ctfType *option_type(const struct ctfType *_variant,
+    const char *_name);
+
+static bool is_field(const struct ctfType *_type, unsigned int _i,
+    const char *_name, int _kind, unsigned int _size, unsigned int _align);
+
+static int header_kind(const struct ctfType *_header);
+
+static struct mappedTrace *map_metadata(const char *_dir,
+    GHashTable *_event_class_ht, GHashTable *_arg_types_ht);
+
+static struct mappedStream *map_stream(struct mappedTrace *_t,
+    const struct streamFile *_file);
+
+static void free_node(gpointer _node);
+
+static void free_class(gpointer _sc);
+
+static void free_trace(gpointer _t);
+
+static void free_stream(gpointer _s);
+
+static int map_streams(GPtrArray *_files, GHashTable *_event_class_ht,
+    GHashTable *_arg_types_ht, GPtrArray *_traces, GPtrArray *_streams);
+
+/* Reads an integer of _bits at bit _pos, CTF bit fields included */
+static inline uint64_t
+read_bits(const uint8_t *base, uint64_t pos, unsigned int bits,
+    bool big_endian)
+{
+        const uint8_t *p = base + (pos >> 3);
+        uint64_t v = 0, v64;
+        uint32_t v32;
+        uint16_t v16;
+        unsigned int got, take, shift;
+
+        if ((pos & 7) == 0) {
+                switch (bits) {
+                case 8:
+                        return *p;
+                case 16:
+                        memcpy(&v16, p, sizeof(v16));
+                        return big_endian ? be16toh(v16) : le16toh(v16);
+                case 32:
+                        memcpy(&v32, p, sizeof(v32));
+                        return big_endian ? be32toh(v32) : le32toh(v32);
+                case 64:
+                        memcpy(&v64, p, sizeof(v64));
+                        return big_endian ? be64toh(v64) : le64toh(v64);
+                default:
+                        break;
+                }
+        }
+
+        /* little-endian fields start at the lowest bit of a byte */
+        for (got = 0; got < bits; got += take) {
+                shift = (pos + got) & 7;
+                take = MIN(8 - shift, bits - got);
+                p = base + ((pos + got) >> 3);
+                if (big_endian) {
+                        v = (v << take) |
+                            ((*p >> (8 - shift - take)) & ((1U << take) - 1));
+                } else {
+                        v |= (uint64_t) ((*p >> shift) &
+                            ((1U << take) - 1)) << got;
+                }
+        }
+
+        return v;
+}
+
+static inline uint64_t
+extend(uint64_t value, unsigned int bits, bool is_signed)
+{
+        if (is_signed && bits < 64 && (value >> (bits - 1)) & 1) {
+                value |= ~(uint64_t) 0 << bits;
+        }
+
+        return value;
+}
+
+/* Captured value _c, 0 when the event has no such field */
+static inline uint64_t
+cap_value(const struct capture *cap, int c)
+{
+        return (cap->have >> c) & 1 ? cap->values[c] : 0;
+}
+
+/*
+ * Captured text _c. A char array is copied to _buf up to its first NUL,
+ * as babeltrace reads them; a string is returned as it is in the trace.
+ */
+static const char *
+cap_text(const struct capture *cap, int c, char *buf, size_t size)
+{
+        size_t len;
+
+        if (!((cap->have >> c) & 1)) {
+                buf[0] = '\0';
+                return buf;
+        }
+        if ((cap->strings >> c) & 1) {
+                return cap->texts[c];
+        }
+        len = strnlen(cap->texts[c], MIN(cap->lengths[c], size - 1));
+        memcpy(buf, cap->texts[c], len);
+        buf[len] = '\0';
+
+        return buf;
+}
+
+static const struct node *
+select_option(const struct node *node, uint64_t tag)
+{
+        const struct tagRange *r;
+        unsigned int i;
+
+        for (i = 0; i < node->nranges; i++) {
+                r = &node->ranges[i];
+                if (node->tag_signed ? (int64_t) tag >= (int64_t) r->begin &&
+                    (int64_t) tag <= (int64_t) r->end :
+                    tag >= r->begin && tag <= r->end) {
+                        return node->members[r->option];
+                }
+        }
+
+        return NULL;
+}
+
+/* Keeps field _i of struct _node, found from bit _from to bit _to */
+static void
+capture_field(const struct mappedStream *s, const struct node *node,
+    unsigned int i, uint64_t from, uint64_t to, struct capture *cap)
+{
+        const struct node *m = node->members[i];
+        int c = node->caps[i];
+        uint64_t v;
+
+        if (m->kind == CTF_INTEGER || m->kind == CTF_ENUM) {
+                v = extend(read_bits(s->base, from, m->bits, m->big_endian),
+                    m->bits, m->is_signed);
+                if (node->args[i] != 0 && cap->nargs < MAX_ARGS) {
+                        cap->args[cap->nargs] = v;
+                        cap->arg_types[cap->nargs] = node->args[i];
+                        cap->arg_signed[cap->nargs] = m->is_signed;
+                        cap->nargs++;
+                }
+                if (c == CAP_NONE) {
+                        return;
+                }
+                cap->values[c] = v;
+                if (c == CAP_TIMESTAMP) {
+                        cap->ts_bits = m->bits;
+                }
+        } else if (m->text && c != CAP_NONE) {
+                cap->texts[c] = (const char *) s->base + from / 8;
+                cap->lengths[c] = (to - from) / 8;
+                if (m->kind == CTF_STRING) {
+                        cap->lengths[c]--;
+                        cap->strings |= (uint64_t) 1 << c;
+                } else {
+                        cap->strings &= ~((uint64_t) 1 << c);
+                }
+        } else {
+                return;
+        }
+        cap->have |= (uint64_t) 1 << c;
+}
+
+/*
+ * Moves _pos past a value of _node. _vals are the integers of the struct
+ * holding it, for the lengths of sequences and the tags of variants.
+ */
+static bool
+walk_node(struct mappedStream *s, const struct node *node, uint64_t *pos,
+    const uint64_t *vals, struct capture *cap)
+{
+        uint64_t p = ALIGN_BITS(*pos, node->align), n, i;
+        const struct node *option;
+        const uint8_t *end;
+
+        /* fixed-size structs are only walked for what they capture */
+        if (node->fixed && (node->nreads == 0 || cap == NULL)) {
+                p += node->size;
+        } else {
+                switch (node->kind) {
+                case CTF_STRING:
+                        if (p >= s->content) {
+                                return false;
+                        }
+                        end = memchr(s->base + p / 8, '\0',
+                            (s->content - p) / 8);
+                        if (end == NULL) {
+                                return false;
+                        }
+                        p = (uint64_t) (end - s->base + 1) * 8;
+                        break;
+                case CTF_STRUCT:
+                        if (!walk_struct(s, node, &p, cap)) {
+                                return false;
+                        }
+                        break;
+                case CTF_ARRAY:
+                case CTF_SEQUENCE:
+                        n = node->kind == CTF_ARRAY ? node->length :
+                            vals[node->ref];
+                        if (n == 0) {
+                                break;
+                        } else if (!node->elem->fixed) {
+                                for (i = 0; i < n; i++) {
+                                        if (!walk_node(s, node->elem, &p,
+                                                vals, NULL)) {
+                                                return false;
+                                        }
+                                }
+                                break;
+                        }
+                        /* a corrupt length mustn't wrap around */
+                        if (p > s->content || (node->stride > 0 && n - 1 >
+                                (s->content - p) / node->stride)) {
+                                return false;
+                        }
+                        p += (n - 1) * node->stride + node->elem->size;
+                        break;
+                case CTF_VARIANT:
+                        option = select_option(node, vals[node->ref]);
+                        if (option == NULL ||
+                            !walk_node(s, option, &p, vals, cap)) {
+                                return false;
+                        }
+                        break;
+                default:
+                        return false;
+                }
+        }
+        if (p > s->content) {
+                return false;
+        }
+        *pos = p;
+
+        return true;
+}
+
+static bool
+walk_struct(struct mappedStream *s, const struct node *node, uint64_t *pos,
+    struct capture *cap)
+{
+        uint64_t start = ALIGN_BITS(*pos, node->align), p, from;
+        uint64_t vals[node->has_refs ? node->n : 1];
+        const struct node *m;
+        unsigned int i;
+
+        if (node->fixed) {
+                if (start + node->size > s->content) {
+                        return false;
+                }
+                for (i = 0; cap != NULL && i < node->nreads; i++) {
+                        from = start + node->offsets[node->reads[i]];
+                        capture_field(s, node, node->reads[i], from,
+                            from + node->members[node->reads[i]]->size, cap);
+                }
+                *pos = start + node->size;
+                return true;
+        }
+
+        p = start;
+        for (i = 0; i < node->n; i++) {
+                m = node->members[i];
+                from = p = ALIGN_BITS(p, m->align);
+                if (!walk_node(s, m, &p, vals, cap)) {
+                        return false;
+                }
+                if (node->has_refs && node->keep[i]) {
+                        vals[i] = extend(read_bits(s->base, from, m->bits,
+                                m->big_endian), m->bits, m->is_signed);
+                }
+                if (cap != NULL && (node->caps[i] != CAP_NONE ||
+                        node->args[i] != 0)) {
+                        capture_field(s, node, i, from, p, cap);
+                }
+        }
+        *pos = p;
+
+        return true;
+}
+
+/* Extends the clock with a timestamp of _bits, as babeltrace does */
+static inline void
+update_clock(struct mappedStream *s, uint64_t value, unsigned int bits)
+{
+        uint64_t mask;
+
+        if (bits >= 64) {
+                s->cycles = value;
+                return;
+        }
+        mask = ((uint64_t) 1 << bits) - 1;
+        if (value < (s->cycles & mask)) {
+                value += (uint64_t) 1 << bits;
+        }
+        s->cycles = (s->cycles & ~mask) + value;
+}
+
+/* id:5, then timestamp:27 or, for id 31, a 32-bit id and 64-bit timestamp */
+static bool
+read_compact_header(struct mappedStream *s)
+{
+        uint64_t p = ALIGN_BITS(s->pos, 8), ts;
+        const uint8_t *h = s->base + p / 8;
+        uint32_t word, id;
+
+        if (p + 32 > s->content) {
+                return false;
+        }
+        memcpy(&word, h, sizeof(word));
+        word = le32toh(word);
+        s->id = word & 31;
+        if (s->id != 31) {
+                s->extended_id = s->id;
+                update_clock(s, word >> 5, 27);
+                s->pos = p + 32;
+                return true;
+        }
+        if (p + 104 > s->content) {
+                return false;
+        }
+        memcpy(&id, h + 1, sizeof(id));
+        memcpy(&ts, h + 5, sizeof(ts));
+        s->extended_id = le32toh(id);
+        update_clock(s, le64toh(ts), 64);
+        s->pos = p + 104;
+
+        return true;
+}
+
+/* id:16, then timestamp:32 or, for id 65535, as the compact header */
+static bool
+read_large_header(struct mappedStream *s)
+{
+        uint64_t p = ALIGN_BITS(s->pos, 8), ts;
+        const uint8_t *h = s->base + p / 8;
+        uint32_t ts32, id;
+        uint16_t id16;
+
+        if (p + 48 > s->content) {
+                return false;
+        }
+        memcpy(&id16, h, sizeof(id16));
+        s->id = le16toh(id16);
+        if (s->id != 65535) {
+                memcpy(&ts32, h + 2, sizeof(ts32));
+                s->extended_id = s->id;
+                update_clock(s, le32toh(ts32), 32);
+                s->pos = p + 48;
+                return true;
+        }
+        if (p + 112 > s->content) {
+                return false;
+        }
+        memcpy(&id, h + 2, sizeof(id));
+        memcpy(&ts, h + 6, sizeof(ts));
+        s->extended_id = le32toh(id);
+        update_clock(s, le64toh(ts), 64);
+        s->pos = p + 112;
+
+        return true;
+}
+
+/*
+ * The id is the "id" of the header, or the one of its variant option if
+ * it has one, and the timestamp either of them, as babeltrace reads them
+ */
+static bool
+read_generic_header(struct mappedStream *s)
+{
+        struct capture *cap = &s->cap;
+
+        if (!walk_struct(s, s->sc->event_header, &s->pos, cap)) {
+                return false;
+        }
+        s->id = cap_value(cap, CAP_ID);
+        s->extended_id = (cap->have >> CAP_EXTENDED_ID) & 1 ?
+            cap->values[CAP_EXTENDED_ID] : s->id;
+        if ((cap->have >> CAP_TIMESTAMP) & 1) {
+                update_clock(s, cap->values[CAP_TIMESTAMP], cap->ts_bits);
+        }
+
+        return true;
+}
+
+/* Decodes the event at the position of _s, up to the end of its payload */
+static bool
+read_event(struct mappedStream *s)
+{
+        const struct mappedClass *sc = s->sc;
+        struct capture *cap = &s->cap;
+
+        cap->have = 0;
+        cap->nargs = 0;
+        switch (sc->header) {
+        case HEADER_COMPACT:
+                if (!read_compact_header(s)) {
+                        return false;
+                }
+                break;
+        case HEADER_LARGE:
+                if (!read_large_header(s)) {
+                        return false;
+                }
+                break;
+        case HEADER_GENERIC:
+                if (!read_generic_header(s)) {
+                        return false;
+                }
+                break;
+        default:
+                s->id = 0;
+                s->extended_id = 0;
+                break;
+        }
+        s->timestamp = s->cycles + s->trace->clock_offset;
+
+        if (s->extended_id >= sc->events->len ||
+            !(s->event = g_ptr_array_index(sc->events, s->extended_id))) {
+                return false;
+        }
+        if (sc->event_context != NULL &&
+            !walk_struct(s, sc->event_context, &s->pos, NULL)) {
+                return false;
+        }
+        if (s->event->context != NULL &&
+            !walk_struct(s, s->event->context, &s->pos, NULL)) {
+                return false;
+        }
+        if (s->event->fields != NULL &&
+            !walk_struct(s, s->event->fields, &s->pos, cap)) {
+                return false;
+        }
+
+        return true;
+}
+
+/*
+ * Reads the packet header and context of the packet at _packet_offset, or
+ * of the first one after it with events. Returns 1 at the end of the
+ * stream and -1 on a packet that can't be decoded.
+ */
+static int
+open_packet(struct mappedStream *s)
+{
+        const struct mappedTrace *t = s->trace;
+        struct capture *cap = &s->cap;
+        uint64_t avail, pos;
+
+        while (s->packet_offset < s->size) {
+                s->base = s->map + s->packet_offset;
+                avail = (uint64_t) (s->size - s->packet_offset) * 8;
+                s->content = avail;
+                pos = 0;
+                cap->have = 0;
+                if (t->packet_header != NULL &&
+                    !walk_struct(s, t->packet_header, &pos, cap)) {
+                        return -1;
+                }
+                if ((cap->have >> CAP_MAGIC) & 1 &&
+                    cap->values[CAP_MAGIC] != CTF_MAGIC) {
+                        return -1;
+                }
+                if (s->sc->packet_context != NULL &&
+                    !walk_struct(s, s->sc->packet_context, &pos, cap)) {
+                        return -1;
+                }
+
+                s->packet_bits = (cap->have >> CAP_PACKET_SIZE) & 1 ?
+                    cap->values[CAP_PACKET_SIZE] : avail;
+                s->content = (cap->have >> CAP_CONTENT_SIZE) & 1 ?
+                    cap->values[CAP_CONTENT_SIZE] : s->packet_bits;
+                if (s->packet_bits == 0 || s->packet_bits % 8 != 0 ||
+                    s->packet_bits > avail || s->content > s->packet_bits ||
+                    pos > s->content) {
+                        return -1;
+                }
+                s->context_have = cap->have;
+                memcpy(s->context, cap->values, sizeof(s->context));
+                s->cycles = cap_value(cap, CAP_TIMESTAMP_BEGIN);
+                s->pos = pos;
+                if (pos < s->content) {
+                        return 0;
+                }
+                s->packet_offset += s->packet_bits / 8;
+        }
+
+        return 1;
+}
+
+/* Reads the next event of _s, returns false at the end of the stream */
+static bool
+next_event(struct mappedStream *s)
+{
+        int ret = 0;
+
+        if (s->pos >= s->content) {
+                s->packet_offset += s->packet_bits / 8;
+                ret = open_packet(s);
+        }
+        if (ret == 0 && read_event(s)) {
+                return true;
+        } else if (ret <= 0) {
+                fprintf(stderr, "[warning] Couldn't decode %s past byte "
+                    "%zu, the rest of the stream is left out.\n", s->path,
+                    s->packet_offset);
+        }
+
+        return false;
+}
+
+/* read_packet() of readPacketContext.c */
+static void
+read_context(const struct mappedStream *s, struct packetContext *packet)
+{
+        uint64_t events_discarded;
+
+        packet->timestamp_end = 0;
+        packet->cpu_id = 0;
+        packet->lost_events = 0;
+        packet->packet_size = 0;
+
+        if ((s->context_have >> CAP_TIMESTAMP_END) & 1) {
+                packet->timestamp_end = s->context[CAP_TIMESTAMP_END];
+        }
+        if ((s->context_have >> CAP_CPU_ID) & 1) {
+                packet->cpu_id = s->context[CAP_CPU_ID];
+        }
+        if ((s->context_have >> CAP_EVENTS_DISCARDED) & 1) {
+                events_discarded = s->context[CAP_EVENTS_DISCARDED];
+                if (events_discarded > packet->events_discarded) {
+                        packet->lost_events =
+                            events_discarded - packet->events_discarded;
+                }
+                packet->events_discarded = events_discarded;
+        }
+        if ((s->context_have >> CAP_PACKET_SIZE) & 1) {
+                packet->packet_size = s->context[CAP_PACKET_SIZE] / 8;
+        }
+}
+
+/* readPacketContext() for the event _s is at */
+static const struct packetContext *
+stream_packet(struct mappedStream *s)
+{
+        struct packetContext *packet = &s->packet;
+        uint64_t timestamp_begin = s->context[CAP_TIMESTAMP_BEGIN];
+
+        if (G_UNLIKELY(!s->seen)) {
+                s->seen = true;
+                if ((s->context_have >> CAP_TIMESTAMP_BEGIN) & 1) {
+                        packet->timestamp_begin = timestamp_begin;
+                }
+                read_context(s, packet);
+                packet->new_packet = true;
+                packet->first_packet = true;
+                return packet;
+        }
+        packet->first_packet = false;
+
+        /* Without timestamp_begin every event is read as a new packet */
+        if (!((s->context_have >> CAP_TIMESTAMP_BEGIN) & 1)) {
+                read_context(s, packet);
+                packet->new_packet = true;
+                return packet;
+        }
+
+        packet->new_packet = (timestamp_begin != packet->timestamp_begin);
+        if (packet->new_packet) {
+                packet->timestamp_begin = timestamp_begin;
+                read_context(s, packet);
+        }
+
+        return packet;
+}
+
+/*
+ * The streams are merged with the priority heap of babeltrace's iterator,
+ * so events with the same timestamp come out in the same order
+ */
+static bool
+stream_gt(const struct mappedStream *a, const struct mappedStream *b)
+{
+        return a->timestamp < b->timestamp;
+}
+
+static void
+heapify(unsigned int i)
+{
+        struct mappedStream **ptrs = native_decoder.heap, *tmp;
+        unsigned int len = native_decoder.heap_len, l, r, largest;
+
+        for (;;) {
+                l = 2 * i + 1;
+                r = 2 * i + 2;
+                largest = (l < len && stream_gt(ptrs[l], ptrs[i])) ? l : i;
+                if (r < len && stream_gt(ptrs[r], ptrs[largest])) {
+                        largest = r;
+                }
+                if (largest == i) {
+                        break;
+                }
+                tmp = ptrs[i];
+                ptrs[i] = ptrs[largest];
+                ptrs[largest] = tmp;
+                i = largest;
+        }
+}
+
+static void
+heap_insert(struct mappedStream *s)
+{
+        struct mappedStream **ptrs = native_decoder.heap;
+        unsigned int pos = native_decoder.heap_len++;
+
+        while (pos > 0 && stream_gt(s, ptrs[(pos - 1) / 2])) {
+                ptrs[pos] = ptrs[(pos - 1) / 2];
+                pos = (pos - 1) / 2;
+        }
+        ptrs[pos] = s;
+}
+
+static void
+heap_remove(void)
+{
+        native_decoder.heap_len--;
+        if (native_decoder.heap_len > 0) {
+                native_decoder.heap[0] =
+                    native_decoder.heap[native_decoder.heap_len];
+                heapify(0);
+        }
+}
+
+/* Moves on from the event of _s, at the top of the heap */
+static void
+advance(struct mappedStream *s)
+{
+        if (next_event(s)) {
+                heapify(0);
+        } else {
+                heap_remove();
+        }
+}
+
+/* Reads the first event of every stream, for a pass from the beginning */
+void
+rewindStreams(void)
+{
+        struct mappedStream *s;
+        unsigned int i;
+        int ret;
+
+        native_decoder.heap_len = 0;
+        for (i = 0; i < native_decoder.streams->len; i++) {
+                s = g_ptr_array_index(native_decoder.streams, i);
+                s->packet_offset = 0;
+                s->seen = false;
+                memset(&s->packet, 0, sizeof(s->packet));
+                s->packet.clock_offset = s->trace->meta.clock_offset;
+                s->packet.id_size = s->trace->meta.id_size;
+
+                ret = open_packet(s);
+                if (ret == 0 && read_event(s)) {
+                        heap_insert(s);
+                } else if (ret <= 0) {
+                        fprintf(stderr, "[warning] Couldn't decode %s, it "
+                            "is left out.\n", s->path);
+                }
+        }
+}
+
+static int
+capture_of(int scope, const char *name)
+{
+        unsigned int i;
+
+        for (i = 0; scope == SCOPE_PAYLOAD && i < NFIELDS; i++) {
+                if (strcmp(event_fields[i], name) == 0) {
+                        return CAP_FIELDS + i;
+                }
+        }
+        for (i = 0; i < G_N_ELEMENTS(capture_names); i++) {
+                if (capture_names[i].scope == scope &&
+                    strcmp(capture_names[i].name, name) == 0) {
+                        return capture_names[i].cap;
+                }
+        }
+
+        return CAP_NONE;
+}
+
+/*
+ * Compiles _type. Returns NULL if it can't be decoded natively: lengths
+ * and tags are only looked up among the fields before them in the same
+ * struct.
+ */
+static struct node *
+compile(struct mappedTrace *t, const struct ctfType *type, int scope,
+    GHashTable *arg_types_ht)
+{
+        struct node *node;
+        const struct ctfField *f;
+        unsigned int i;
+
+        node = g_new0(struct node, 1);
+        g_ptr_array_add(t->nodes, node);
+        node->kind = type->kind;
+        node->align = MAX(1, type->align);
+
+        switch (type->kind) {
+        case CTF_INTEGER:
+        case CTF_FLOAT:
+        case CTF_ENUM:
+                node->bits = type->size;
+                node->is_signed = type->is_signed;
+                node->big_endian = type->big_endian;
+                node->text = type->text;
+                node->fixed = true;
+                node->size = type->size;
+                return node;
+        case CTF_STRING:
+                node->align = 8;
+                node->text = true;
+                return node;
+        case CTF_ARRAY:
+        case CTF_SEQUENCE:
+                if (type->elem->kind == CTF_SEQUENCE ||
+                    type->elem->kind == CTF_VARIANT) {
+                        return NULL;
+                }
+                node->elem = compile(t, type->elem, SCOPE_NONE, NULL);
+                if (node->elem == NULL) {
+                        return NULL;
+                }
+                node->align = node->elem->align;
+                node->length = type->length;
+                node->text = type->text;
+                if (node->elem->fixed) {
+                        node->stride = ALIGN_BITS(node->elem->size,
+                            node->elem->align);
+                        node->fixed = (type->kind == CTF_ARRAY);
+                        node->size = node->length > 0 ? (node->length - 1) *
+                            node->stride + node->elem->size : 0;
+                }
+                return node;
+        case CTF_STRUCT:
+                return compile_struct(t, node, type, scope, arg_types_ht) ?
+                    node : NULL;
+        case CTF_VARIANT:
+                /* options are aligned on their own */
+                node->align = 1;
+                node->n = type->fields->len;
+                node->members = g_new0(struct node *, MAX(1, node->n));
+                for (i = 0; i < node->n; i++) {
+                        f = &g_array_index(type->fields, struct ctfField, i);
+                        if (f->type->kind == CTF_SEQUENCE ||
+                            f->type->kind == CTF_VARIANT) {
+                                return NULL;
+                        }
+                        node->members[i] = compile(t, f->type,
+                            scope == SCOPE_EVENT_HEADER ?
+                            SCOPE_HEADER_OPTION : SCOPE_NONE, NULL);
+                        if (node->members[i] == NULL) {
+                                return NULL;
+                        }
+                }
+                return node;
+        default:
+                return NULL;
+        }
+}
+
+static bool
+compile_struct(struct mappedTrace *t, struct node *node,
+    const struct ctfType *type, int scope, GHashTable *arg_types_ht)
+{
+        const struct ctfField *f, *ref;
+        const char *name;
+        struct node *m;
+        uint64_t off = 0;
+        unsigned int i;
+        gpointer arg;
+        int j;
+
+        node->n = type->fields->len;
+        node->members = g_new0(struct node *, MAX(1, node->n));
+        node->offsets = g_new0(uint64_t, MAX(1, node->n));
+        node->caps = g_new0(int, MAX(1, node->n));
+        node->args = g_new0(unsigned int, MAX(1, node->n));
+        node->keep = g_new0(bool, MAX(1, node->n));
+        node->reads = g_new0(unsigned int, MAX(1, node->n));
+        node->fixed = true;
+
+        for (i = 0; i < node->n; i++) {
+                f = &g_array_index(type->fields, struct ctfField, i);
+                m = compile(t, f->type, f->type->kind == CTF_VARIANT ?
+                    scope : SCOPE_NONE, NULL);
+                if (m == NULL) {
+                        return false;
+                }
+                node->members[i] = m;
+                node->caps[i] = capture_of(scope, f->name);
+
+                /* the arguments getArgValue() prints */
+                name = f->name[0] == '_' ? f->name + 1 : f->name;
+                if (scope == SCOPE_PAYLOAD && m->kind == CTF_INTEGER &&
+                    (arg = g_hash_table_lookup(arg_types_ht, name))) {
+                        node->args[i] = GPOINTER_TO_INT(arg);
+                }
+                if (node->caps[i] != CAP_NONE || node->args[i] != 0) {
+                        node->reads[node->nreads++] = i;
+                }
+
+                if (m->kind == CTF_SEQUENCE || m->kind == CTF_VARIANT) {
+                        name = strrchr(f->type->ref, '.');
+                        name = name != NULL ? name + 1 : f->type->ref;
+                        for (j = (int) i - 1; j >= 0; j--) {
+                                ref = &g_array_index(type->fields,
+                                    struct ctfField, j);
+                                if (strcmp(ref->name, name) == 0) {
+                                        break;
+                                }
+                        }
+                        if (j < 0 || (node->members[j]->kind != CTF_INTEGER &&
+                                node->members[j]->kind != CTF_ENUM)) {
+                                return false;
+                        }
+                        if (m->kind == CTF_VARIANT &&
+                            !compile_ranges(m, f->type, ref->type)) {
+                                return false;
+                        }
+                        m->ref = j;
+                        node->keep[j] = true;
+                        node->has_refs = true;
+                }
+
+                node->fixed = node->fixed && m->fixed;
+                off = ALIGN_BITS(off, m->align);
+                node->offsets[i] = off;
+                off += m->size;
+                node->align = MAX(node->align, m->align);
+        }
+        node->size = off;
+        if (node->nreads > MAX_ARGS) {
+                return false;
+        }
+
+        return true;
+}
+
+/* Matches the labels of enum _tag with the options of _variant */
+static bool
+compile_ranges(struct node *node, const struct ctfType *variant,
+    const struct ctfType *tag)
+{
+        const struct ctfMapping *mapping;
+        const struct ctfField *option;
+        unsigned int i, k;
+
+        if (tag->kind != CTF_ENUM) {
+                return false;
+        }
+        node->tag_signed = tag->is_signed;
+        node->ranges = g_new0(struct tagRange, MAX(1, tag->mappings->len));
+        for (i = 0; i < tag->mappings->len; i++) {
+                mapping = &g_array_index(tag->mappings, struct ctfMapping, i);
+                for (k = 0; k < variant->fields->len; k++) {
+                        option = &g_array_index(variant->fields,
+                            struct ctfField, k);
+                        if (strcmp(option->name, mapping->label) == 0) {
+                                node->ranges[node->nranges].begin =
+                                    mapping->begin;
+                                node->ranges[node->nranges].end =
+                                    mapping->end;
+                                node->ranges[node->nranges].option = k;
+                                node->nranges++;
+                                break;
+                        }
+                }
+        }
+
+        return true;
+}
+
+/* Compiles the struct of a scope, which may be missing */
+static bool
+compile_scope(struct mappedTrace *t, const struct ctfType *type, int scope,
+    GHashTable *arg_types_ht, struct node **node)
+{
+        *node = NULL;
+        if (type == NULL) {
+                return true;
+        } else if (type->kind != CTF_STRUCT) {
+                return false;
+        }
+        *node = compile(t, type, scope, arg_types_ht);
+
+        return *node != NULL;
+}
+
+static const struct ctfType *
+option_type(const struct ctfType *variant, const char *name)
+{
+        const struct ctfField *option;
+        unsigned int i;
+
+        for (i = 0; i < variant->fields->len; i++) {
+                option = &g_array_index(variant->fields, struct ctfField, i);
+                if (strcmp(option->name, name) == 0) {
+                        return option->type;
+                }
+        }
+
+        return NULL;
+}
+
+/* Whether field _i of struct _type is _name, of _kind, _size and _align */
+static bool
+is_field(const struct ctfType *type, unsigned int i, const char *name,
+    int kind, unsigned int size, unsigned int align)
+{
+        const struct ctfField *f;
+
+        if (type == NULL || type->kind != CTF_STRUCT ||
+            i >= type->fields->len) {
+                return false;
+        }
+        f = &g_array_index(type->fields, struct ctfField, i);
+
+        return strcmp(f->name, name) == 0 && f->type->kind == kind &&
+            f->type->size == size && f->type->align == align &&
+            !f->type->is_signed && !f->type->big_endian;
+}
+
+/* Tells the compact and large headers of LTTng from any other */
+static int
+header_kind(const struct ctfType *header)
+{
+        const struct ctfType *id, *v, *compact, *extended;
+        const struct ctfMapping *mapping;
+        unsigned int bits, align, i;
+        int64_t escape;
+
+        if (header == NULL) {
+                return HEADER_NONE;
+        }
+        if (header->kind != CTF_STRUCT || header->fields->len != 2 ||
+            header->align != 8) {
+                return HEADER_GENERIC;
+        }
+        id = g_array_index(header->fields, struct ctfField, 0).type;
+        v = g_array_index(header->fields, struct ctfField, 1).type;
+        bits = id->size;
+        align = bits == 5 ? 1 : 8;
+        if ((bits != 5 && bits != 16) ||
+            !is_field(header, 0, "id", CTF_ENUM, bits, align) ||
+            strcmp(g_array_index(header->fields, struct ctfField, 1).name,
+                "v") != 0 || v->kind != CTF_VARIANT || v->ref == NULL ||
+            strcmp(v->ref, "id") != 0) {
+                return HEADER_GENERIC;
+        }
+
+        compact = option_type(v, "compact");
+        extended = option_type(v, "extended");
+        if (v->fields->len != 2 || compact == NULL || extended == NULL ||
+            compact->fields == NULL || compact->fields->len != 1 ||
+            !is_field(compact, 0, "timestamp", CTF_INTEGER,
+                bits == 5 ? 27 : 32, align) ||
+            extended->fields == NULL || extended->fields->len != 2 ||
+            !is_field(extended, 0, "id", CTF_INTEGER, 32, 8) ||
+            !is_field(extended, 1, "timestamp", CTF_INTEGER, 64, 8)) {
+                return HEADER_GENERIC;
+        }
+
+        escape = ((int64_t) 1 << bits) - 1;
+        for (i = 0; i < id->mappings->len; i++) {
+                mapping = &g_array_index(id->mappings, struct ctfMapping, i);
+                if (strcmp(mapping->label, "compact") == 0 &&
+                    mapping->begin == 0 && mapping->end == escape - 1) {
+                        continue;
+                } else if (strcmp(mapping->label, "extended") == 0 &&
+                    mapping->begin == escape && mapping->end == escape) {
+                        continue;
+                }
+                return HEADER_GENERIC;
+        }
+
+        return bits == 5 ? HEADER_COMPACT : HEADER_LARGE;
+}
+
+/*
+ * Compiles the metadata of trace directory _dir, only its stream classes
+ * with a NULL _event_class_ht. Returns NULL if any of it can't be decoded
+ * natively.
+ */
+static struct mappedTrace *
+map_metadata(const char *dir, GHashTable *event_class_ht,
+    GHashTable *arg_types_ht)
+{
+        struct ctfMetadata *ctf;
+        const struct ctfStreamDecl *sd;
+        const struct ctfEventDecl *ed;
+        struct mappedTrace *t;
+        struct mappedClass *sc;
+        struct mappedEvent *ev;
+        const char *why = NULL;
+        unsigned int i;
+
+        ctf = parseMetadata(dir);
+        if (ctf == NULL) {
+                debug("Native decoder: can't parse the metadata of %s\n",
+                    dir);
+                return NULL;
+        }
+
+        t = g_new0(struct mappedTrace, 1);
+        t->dir = g_strdup(dir);
+        t->classes = g_ptr_array_new_with_free_func(free_class);
+        t->nodes = g_ptr_array_new_with_free_func(free_node);
+        t->events = g_ptr_array_new_with_free_func(g_free);
+        /* babeltrace's timestamps are in ns */
+        if (ctf->clock_freq != 0 && ctf->clock_freq != 1000000000) {
+                why = "a clock that doesn't count nanoseconds";
+                goto error;
+        }
+        t->clock_offset = ctf->clock_offset_s * 1000000000 +
+            ctf->clock_offset;
+        if (readMetadata(dir, &t->meta) < 0) {
+                t->meta.clock_offset = 0;
+                t->meta.id_size = id_size;
+        }
+        if (!compile_scope(t, ctf->packet_header, SCOPE_PACKET_HEADER, NULL,
+                &t->packet_header)) {
+                why = "its packet header";
+                goto error;
+        }
+
+        /* a trace without stream block has a single stream class */
+        if (ctf->streams->len == 0) {
+                g_ptr_array_add(ctf->streams,
+                    g_new0(struct ctfStreamDecl, 1));
+        }
+        for (i = 0; i < ctf->streams->len; i++) {
+                sd = g_ptr_array_index(ctf->streams, i);
+                if (sd->id >= MAX_ID) {
+                        why = "a stream id";
+                        goto error;
+                }
+                if (sd->id >= t->classes->len) {
+                        g_ptr_array_set_size(t->classes, sd->id + 1);
+                }
+                if (g_ptr_array_index(t->classes, sd->id) != NULL) {
+                        why = "a stream id declared twice";
+                        goto error;
+                }
+                sc = g_new0(struct mappedClass, 1);
+                sc->events = g_ptr_array_new();
+                g_ptr_array_index(t->classes, sd->id) = sc;
+                if (!compile_scope(t, sd->packet_context,
+                        SCOPE_PACKET_CONTEXT, NULL, &sc->packet_context) ||
+                    !compile_scope(t, sd->event_header, SCOPE_EVENT_HEADER,
+                        NULL, &sc->event_header) ||
+                    !compile_scope(t, sd->event_context, SCOPE_NONE, NULL,
+                        &sc->event_context)) {
+                        why = "a stream block";
+                        goto error;
+                }
+                sc->header = header_kind(sd->event_header);
+                debug("Native decoder: stream %" PRIu64 " of %s has %s "
+                    "event headers\n", sd->id, dir,
+                    sc->header == HEADER_COMPACT ? "compact" :
+                    sc->header == HEADER_LARGE ? "large" :
+                    sc->header == HEADER_NONE ? "no" : "generic");
+        }
+
+        for (i = 0; event_class_ht != NULL && i < ctf->events->len; i++) {
+                ed = g_ptr_array_index(ctf->events, i);
+                sc = ed->stream_id < t->classes->len ?
+                    g_ptr_array_index(t->classes, ed->stream_id) : NULL;
+                if (sc == NULL || ed->id >= MAX_ID) {
+                        why = "the ids of an event";
+                        goto error;
+                }
+                ev = g_new0(struct mappedEvent, 1);
+                g_ptr_array_add(t->events, ev);
+                /* babeltrace's event names are interned */
+                ev->class = g_hash_table_lookup(event_class_ht,
+                    g_intern_string(ed->name));
+                if (ev->class == NULL ||
+                    !compile_scope(t, ed->context, SCOPE_NONE, NULL,
+                        &ev->context) ||
+                    !compile_scope(t, ed->fields, SCOPE_PAYLOAD,
+                        arg_types_ht, &ev->fields)) {
+                        why = ed->name;
+                        goto error;
+                }
+                if (ed->id >= sc->events->len) {
+                        g_ptr_array_set_size(sc->events, ed->id + 1);
+                }
+                g_ptr_array_index(sc->events, ed->id) = ev;
+        }
+        freeMetadata(ctf);
+
+        return t;
+
+error:
+        debug("Native decoder: can't decode %s of %s\n", why, dir);
+        freeMetadata(ctf);
+        free_trace(t);
+
+        return NULL;
+}
+
+/* Maps stream file _file of trace _t, NULL if it can't be decoded */
+static struct mappedStream *
+map_stream(struct mappedTrace *t, const struct streamFile *file)
+{
+        struct mappedStream *s = g_new0(struct mappedStream, 1);
+        struct stat sb;
+        uint64_t pos = 0, stream_id = 0;
+        void *map;
+        int fd;
+
+        s->trace = t;
+        s->file = file;
+        s->path = g_build_filename(file->trace_dir, file->name, NULL);
+        fd = open(s->path, O_RDONLY);
+        if (fd < 0 || fstat(fd, &sb) < 0) {
+                goto error;
+        }
+        s->size = sb.st_size;
+        if (s->size > 0) {
+                map = mmap(NULL, s->size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (map == MAP_FAILED) {
+                        goto error;
+                }
+                s->map = map;
+                madvise(map, s->size, MADV_SEQUENTIAL);
+        }
+        close(fd);
+        fd = -1;
+
+        /* the stream class is in the header of the first packet */
+        if (s->size > 0 && t->packet_header != NULL) {
+                s->base = s->map;
+                s->content = (uint64_t) s->size * 8;
+                s->cap.have = 0;
+                if (!walk_struct(s, t->packet_header, &pos, &s->cap)) {
+                        goto error;
+                }
+                stream_id = cap_value(&s->cap, CAP_STREAM_ID);
+        }
+        if (stream_id >= t->classes->len ||
+            !(s->sc = g_ptr_array_index(t->classes, stream_id))) {
+                goto error;
+        }
+
+        return s;
+
+error:
+        debug("Native decoder: can't map %s\n", s->path);
+        if (fd >= 0) {
+                close(fd);
+        }
+        free_stream(s);
+
+        return NULL;
+}
+
+static void
+free_node(gpointer data)
+{
+        struct node *node = data;
+
+        g_free(node->members);
+        g_free(node->offsets);
+        g_free(node->caps);
+        g_free(node->args);
+        g_free(node->keep);
+        g_free(node->reads);
+        g_free(node->ranges);
+        g_free(node);
+}
+
+static void
+free_class(gpointer data)
+{
+        struct mappedClass *sc = data;
+
+        if (sc != NULL) {
+                g_ptr_array_free(sc->events, TRUE);
+                g_free(sc);
+        }
+}
+
+static void
+free_trace(gpointer data)
+{
+        struct mappedTrace *t = data;
+
+        g_ptr_array_free(t->classes, TRUE);
+        g_ptr_array_free(t->events, TRUE);
+        g_ptr_array_free(t->nodes, TRUE);
+        g_free(t->dir);
+        g_free(t);
+}
+
+static void
+free_stream(gpointer data)
+{
+        struct mappedStream *s = data;
+
+        if (s->map != NULL) {
+                munmap((void *) s->map, s->size);
+        }
+        g_free(s->path);
+        g_free(s);
+}
+
+/*
+ * Maps _files into _streams, in the order babeltrace adds them, with their
+ * traces in _traces. Returns -1 if one of them can't be decoded, the
+ * streams mapped so far are in _streams all the same.
+ */
+static int
+map_streams(GPtrArray *files, GHashTable *event_class_ht,
+    GHashTable *arg_types_ht, GPtrArray *traces, GPtrArray *streams)
+{
+        GPtrArray *found;
+        const struct streamFile *file;
+        struct mappedTrace *t = NULL;
+        struct mappedStream *s;
+        unsigned int i, c, k;
+        int ret = 0;
+
+        found = g_ptr_array_new();
+        for (i = 0; i <= files->len && ret == 0; i++) {
+                file = i < files->len ? g_ptr_array_index(files, i) : NULL;
+                /* babeltrace adds the streams of a trace by stream class */
+                if (t != NULL && (file == NULL ||
+                        strcmp(t->dir, file->trace_dir) != 0)) {
+                        for (c = 0; c < t->classes->len; c++) {
+                                for (k = 0; k < found->len; k++) {
+                                        s = g_ptr_array_index(found, k);
+                                        if (s->sc == g_ptr_array_index(
+                                                t->classes, c)) {
+                                                g_ptr_array_add(streams, s);
+                                        }
+                                }
+                        }
+                        g_ptr_array_set_size(found, 0);
+                        t = NULL;
+                }
+                if (file == NULL) {
+                        break;
+                }
+                if (t == NULL) {
+                        t = map_metadata(file->trace_dir, event_class_ht,
+                            arg_types_ht);
+                        if (t == NULL) {
+                                ret = -1;
+                                break;
+                        }
+                        g_ptr_array_add(traces, t);
+                }
+                s = map_stream(t, file);
+                if (s == NULL) {
+                        ret = -1;
+                        break;
+                }
+                g_ptr_array_add(found, s);
+        }
+        /* streams not handed over yet */
+        for (k = 0; ret < 0 && k < found->len; k++) {
+                g_ptr_array_add(streams, g_ptr_array_index(found, k));
+        }
+        g_ptr_array_free(found, TRUE);
+
+        return ret;
+}
+
+/*
+ * Maps the stream files of every trace under _path for the native decoder.
+ * Returns -1, leaving it disabled, if one of them can't be decoded.
+ */
+int
+mapTrace(const char *path, GHashTable *event_class_ht,
+    GHashTable *arg_types_ht)
+{
+        GPtrArray *files;
+        int ret;
+
+        native_decoder.traces = g_ptr_array_new_with_free_func(free_trace);
+        native_decoder.streams = g_ptr_array_new_with_free_func(free_stream);
+        files = listStreamFiles(path);
+        ret = map_streams(files, event_class_ht, arg_types_ht,
+            native_decoder.traces, native_decoder.streams);
+        g_ptr_array_free(files, TRUE);
+
+        if (ret < 0 || native_decoder.streams->len == 0) {
+                unmapTrace();
+                return -1;
+        }
+        native_decoder.heap = g_new(struct mappedStream *,
+            native_decoder.streams->len);
+        native_decoder.enabled = true;
+        debug("Native decoder: %u streams of %u traces\n",
+            native_decoder.streams->len, native_decoder.traces->len);
+
+        return 0;
+}
+
+/*
+ * Appends to _ids the streams of _files with events, in the order
+ * babeltrace adds them to its iterator, with the stream class and CPU of
+ * their first packet. Returns -1 if one of them can't be read.
+ */
+int
+readStreamIds(GPtrArray *files, GArray *ids)
+{
+        GPtrArray *traces, *streams;
+        struct mappedStream *s;
+        struct streamIds id;
+        unsigned int i;
+        int ret;
+
+        traces = g_ptr_array_new_with_free_func(free_trace);
+        streams = g_ptr_array_new_with_free_func(free_stream);
+        ret = map_streams(files, NULL, NULL, traces, streams);
+
+        for (i = 0; i < streams->len && ret == 0; i++) {
+                s = g_ptr_array_index(streams, i);
+                switch (open_packet(s)) {
+                case 0:
+                        break;
+                case 1:
+                        /* babeltrace leaves it out of its heap */
+                        continue;
+                default:
+                        ret = -1;
+                        continue;
+                }
+                id.file = s->file;
+                for (id.stream_id = 0; g_ptr_array_index(s->trace->classes,
+                        id.stream_id) != s->sc; id.stream_id++) {
+                }
+                id.cpu_id = (s->context_have >> CAP_CPU_ID) & 1 ?
+                    s->context[CAP_CPU_ID] : 0;
+                g_array_append_val(ids, id);
+        }
+        g_ptr_array_free(streams, TRUE);
+        g_ptr_array_free(traces, TRUE);
+
+        return ret;
+}
+
+/*
+ * readEvent() of the native decoder: the event of the stream at the top of
+ * the heap. Returns false once every stream is over.
+ */
+bool
+readNativeEvent(struct eventSource *src)
+{
+        struct mappedStream *s;
+
+        if (native_decoder.heap_len == 0) {
+                return false;
+        }
+        s = native_decoder.heap[0];
+        src->stream = s;
+        src->packet = stream_packet(s);
+        src->class = s->event->class;
+        src->timestamp = s->timestamp;
+
+        return true;
+}
+
+/* nextEvent() of the native decoder */
+void
+nextNativeEvent(struct eventSource *src)
+{
+        advance(src->stream);
+}
+
+/* Payload field _field of the event _s is at, 0 if it has none */
+uint64_t
+nativeField(const struct mappedStream *s, int field)
+{
+        return cap_value(&s->cap, CAP_FIELDS + field);
+}
+
+bool
+hasNativeField(const struct mappedStream *s, int field)
+{
+        return (s->cap.have >> (CAP_FIELDS + field)) & 1;
+}
+
+/* Text of payload field _field, see cap_text() */
+const char *
+nativeText(const struct mappedStream *s, int field, char *buf, size_t size)
+{
+        return cap_text(&s->cap, CAP_FIELDS + field, buf, size);
+}
+
+/* The id of the event _s is at, the extended one if it has it */
+uint64_t
+nativeEventId(const struct mappedStream *s)
+{
+        if (s->id + 1 == s->packet.id_size) {
+                return s->extended_id;
+        }
+
+        return s->id;
+}
+
+/* getArgValue() for the event _s is at */
+void
+writeNativeArgs(const struct mappedStream *s, uint64_t event_type,
+    struct prvWriter *w)
+{
+        const struct capture *cap = &s->cap;
+        unsigned int i;
+
+        for (i = 0; i < cap->nargs; i++) {
+                writeChar(w, ':');
+                writeField(w, event_type + cap->arg_types[i]);
+                if (cap->arg_signed[i]) {
+                        writeInt(w, (int64_t) cap->args[i]);
+                } else {
+                        writeUint(w, cap->args[i]);
+                }
+        }
+}
+
+void
+unmapTrace(void)
+{
+        if (native_decoder.streams != NULL) {
+                g_ptr_array_free(native_decoder.streams, TRUE);
+        }
+        if (native_decoder.traces != NULL) {
+                g_ptr_array_free(native_decoder.traces, TRUE);
+        }
+        g_free(native_decoder.heap);
+        memset(&native_decoder, 0, sizeof(native_decoder));
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,83 @@
+#pragma once
+#ifndef MAPTRACE_H
+#define MAPTRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <glib.h>
+
+#include "types.h"
+#include "registerIds.h"
+#include "writeRecords.h"
+#include "streamFiles.h"
+#include "readEvents.h"
+
+enum
+{
+        DECODER_BABELTRACE = 0,
+        DECODER_NATIVE
+};
+
+/*
+ * --decoder=native: the stream files are mapped and decoded here instead
+ * of by babeltrace. The metadata is compiled into a decoder for each event
+ * layout, with the offsets of fixed-size payloads worked out beforehand,
+ * which only reads the fields the converter uses. Streams are merged by
+ * timestamp in the same order as babeltrace's iterator and read through an
+ * eventSource, see readEvents.h, so the conversion is the same for both. A
+ * trace using something the native decoder can't read is left to
+ * babeltrace.
+ */
+struct nativeDecoder
+{
+        bool enabled;
+        /* struct mappedTrace, one for each trace under the input path */
+        GPtrArray *traces;
+        /* struct mappedStream, in the order babeltrace adds them */
+        GPtrArray *streams;
+        /* the streams with events left, on the timestamp of the next one */
+        struct mappedStream **heap;
+        unsigned int heap_len;
+};
+
+extern struct nativeDecoder native_decoder;
+
+/* A stream file as babeltrace's iterator knows it, see readStreamIds() */
+struct streamIds
+{
+        const struct streamFile *file;
+        uint64_t stream_id;
+        uint32_t cpu_id;
+};
+
+int mapTrace(const char *_path, GHashTable *_event_class_ht,
+    GHashTable *_arg_types_ht);
+
+void rewindStreams(void);
+
+bool readNativeEvent(struct eventSource *_src);
+
+void nextNativeEvent(struct eventSource *_src);
+
+uint64_t nativeField(const struct mappedStream *_s, int _field);
+
+bool hasNativeField(const struct mappedStream *_s, int _field);
+
+const char *nativeText(const struct mappedStream *_s, int _field,
+    char *_buf, size_t _size);
+
+uint64_t nativeEventId(const struct mappedStream *_s);
+
+void writeNativeArgs(const struct mappedStream *_s, uint64_t _event_type,
+    struct prvWriter *_w);
+
+int readStreamIds(GPtrArray *_files, GArray *_ids);
+
+void unmapTrace(void);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
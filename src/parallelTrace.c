@@ -0,0 +1,350 @@
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "types.h"
+#include "lttng2prv.h"
+#include "mapTrace.h"
+#include "parallelTrace.h"
+#include "spoolBody.h"
+#include "streamFiles.h"
+
+/* State shared by all workers, only read while they run */
+struct parallelShared
+{
+        struct prvRegistry *reg;
+        uint32_t ncpus;
+        uint32_t nsoftirqs;
+        GHashTable *arg_types_ht;
+        GHashTable *event_class_ht;
+};
+
+struct parallelJob
+{
+        unsigned int id;
+        /* stream groups, by group_key() */
+        GHashTable *groups;
+        char *shadow;
+        struct bt_context *ctx;
+        struct streamSpool *streams;
+        GThread *thread;
+        struct parallelShared *shared;
+};
+
+/*
+ * The streams of one CPU in every trace, the unit of work of the jobs. The
+ * UST events of a CPU run in the application its kernel stream switched
+ * to, so they must be read by the same job.
+ */
+struct streamGroup
+{
+        uint64_t size;
+        unsigned int job;
+};
+
+static char *group_key(const struct streamFile *_file);
+
+static gboolean keep_job_stream(const struct streamFile *_file,
+    gpointer _data);
+
+static gint compare_groups(gconstpointer _a, gconstpointer _b);
+
+static unsigned int assign_groups(GHashTable *_groups, unsigned int _jobs);
+
+static GHashTable *stream_ranks(const char *_path, GPtrArray *_files,
+    unsigned int *_nstreams);
+
+static gpointer run_job(gpointer _data);
+
+/* The CPU, -1 for streams without one, to be freed with g_free() */
+static char *
+group_key(const struct streamFile *file)
+{
+        return g_strdup_printf("%d", file->cpu);
+}
+
+static gboolean
+keep_job_stream(const struct streamFile *file, gpointer data)
+{
+        const struct parallelJob *job = data;
+        const struct streamGroup *group;
+        char *key;
+
+        key = group_key(file);
+        group = g_hash_table_lookup(job->groups, key);
+        g_free(key);
+
+        return group != NULL && group->job == job->id;
+}
+
+static gint
+compare_groups(gconstpointer a, gconstpointer b)
+{
+        const struct streamGroup *ga = *(struct streamGroup *const *) a;
+        const struct streamGroup *gb = *(struct streamGroup *const *) b;
+
+        return (ga->size < gb->size) - (ga->size > gb->size);
+}
+
+/*
+ * Gives each group, largest first, to the job with the fewest bytes so
+ * far. Returns the number of jobs used.
+ */
+static unsigned int
+assign_groups(GHashTable *groups, unsigned int jobs)
+{
+        GPtrArray *sorted;
+        GHashTableIter iter;
+        gpointer value;
+        struct streamGroup *group;
+        uint64_t *load;
+        unsigned int njobs, i, j, least;
+
+        njobs = MAX(1, MIN(jobs, g_hash_table_size(groups)));
+        sorted = g_ptr_array_new();
+        g_hash_table_iter_init(&iter, groups);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+                g_ptr_array_add(sorted, value);
+        }
+        g_ptr_array_sort(sorted, compare_groups);
+
+        load = g_new0(uint64_t, njobs);
+        for (i = 0; i < sorted->len; i++) {
+                group = g_ptr_array_index(sorted, i);
+                least = 0;
+                for (j = 1; j < njobs; j++) {
+                        if (load[j] < load[least]) {
+                                least = j;
+                        }
+                }
+                group->job = least;
+                load[least] += group->size;
+        }
+        g_free(load);
+        g_ptr_array_free(sorted, TRUE);
+
+        return njobs;
+}
+
+/*
+ * The rank of each stream of _files with events, by spoolStreamKey(), in
+ * the order babeltrace's iterator adds them. NULL if they can't be read or
+ * two streams have the same key.
+ */
+static GHashTable *
+stream_ranks(const char *path, GPtrArray *files, unsigned int *nstreams)
+{
+        GHashTable *ranks;
+        GArray *ids;
+        const struct streamIds *id;
+        char *key;
+        unsigned int i;
+
+        ids = g_array_new(FALSE, FALSE, sizeof(struct streamIds));
+        ranks = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        if (readStreamIds(files, ids) < 0) {
+                fprintf(stderr, "[warning] Can't read the streams of %s, "
+                    "converting them without --jobs.\n", path);
+                g_hash_table_destroy(ranks);
+                ranks = NULL;
+        }
+        for (i = 0; ranks != NULL && i < ids->len; i++) {
+                id = &g_array_index(ids, struct streamIds, i);
+                key = spoolStreamKey(id->file->trace_dir, path,
+                    id->stream_id, id->cpu_id);
+                if (g_hash_table_contains(ranks, key)) {
+                        fprintf(stderr, "[warning] Two streams of %s are "
+                            "%s, converting them without --jobs.\n", path,
+                            key);
+                        g_free(key);
+                        g_hash_table_destroy(ranks);
+                        ranks = NULL;
+                        break;
+                }
+                g_hash_table_insert(ranks, key, GUINT_TO_POINTER(i + 1));
+        }
+        *nstreams = ids->len;
+        g_array_free(ids, TRUE);
+
+        return ranks;
+}
+
+static gpointer
+run_job(gpointer data)
+{
+        struct parallelJob *job = data;
+        struct parallelShared *shared = job->shared;
+        uint32_t ncpus = shared->ncpus;
+        uint32_t nsoftirqs = shared->nsoftirqs;
+
+        iter_trace(job->ctx, NULL, NULL, job->streams, false, shared->reg,
+            &ncpus, &nsoftirqs, shared->arg_types_ht,
+            shared->event_class_ht);
+        finishStreamSpool(job->streams);
+
+        return NULL;
+}
+
+/*
+ * Converts the trace with up to _jobs workers. Each one decodes the streams
+ * of a share of the CPUs, balanced by size, through its own babeltrace
+ * context and spools the records of each stream to a file. Once they are
+ * done the calling thread merges the streams as babeltrace's iterator
+ * would, so events with the same timestamp keep the order of the
+ * conversion without jobs, and resolves the records into _prv. The
+ * registry, only read by the workers, and the counts must come from
+ * getThreadInfo(), _ncpus already counts from 1.
+ *
+ * Returns 1, having written nothing, if the streams can't be ordered like
+ * babeltrace does: the trace is then to be converted without jobs.
+ */
+int
+parallelTrace(const char *path, const char *prefix, unsigned int jobs,
+    struct prvWriter *prv, struct prvRegistry *reg, const uint32_t ncpus,
+    const uint32_t nsoftirqs, GHashTable *arg_types_ht,
+    GHashTable *event_class_ht)
+{
+        struct parallelShared shared;
+        struct parallelJob *job_list;
+        struct spoolResolver resolver;
+        GPtrArray *files;
+        GHashTable *groups;
+        struct streamGroup *group;
+        GHashTable *ranks;
+        struct streamSpool **streams;
+        unsigned int njobs, nstreams, started = 0, i;
+        int ret = 0;
+
+        shared.reg = reg;
+        shared.ncpus = ncpus;
+        shared.nsoftirqs = nsoftirqs;
+        shared.arg_types_ht = arg_types_ht;
+        shared.event_class_ht = event_class_ht;
+
+        files = listStreamFiles(path);
+        ranks = stream_ranks(path, files, &nstreams);
+        if (ranks == NULL) {
+                g_ptr_array_free(files, TRUE);
+                return 1;
+        }
+
+        groups = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            g_free);
+        for (i = 0; i < files->len; i++) {
+                const struct streamFile *file = g_ptr_array_index(files, i);
+                char *key = group_key(file);
+
+                group = g_hash_table_lookup(groups, key);
+                if (group == NULL) {
+                        group = g_new0(struct streamGroup, 1);
+                        g_hash_table_insert(groups, key, group);
+                } else {
+                        g_free(key);
+                }
+                group->size += file->size;
+        }
+
+        njobs = assign_groups(groups, jobs);
+        debug("Converting %u CPUs with %u jobs\n",
+            g_hash_table_size(groups), njobs);
+
+        job_list = g_new0(struct parallelJob, njobs);
+        streams = g_new0(struct streamSpool *, njobs);
+
+        /*
+         * Contexts are created here, one after the other, only the
+         * iteration runs in parallel.
+         */
+        for (i = 0; i < njobs; i++) {
+                struct parallelJob *job = &job_list[i];
+
+                job->id = i;
+                job->groups = groups;
+                job->shared = &shared;
+
+                job->shadow = createShadowTrace(prefix, path, files,
+                    keep_job_stream, job);
+                if (!job->shadow) {
+                        ret = -1;
+                        goto end;
+                }
+
+                job->ctx = bt_context_create();
+                if (!job->ctx ||
+                    bt_context_add_traces_recursive(job->ctx, job->shadow,
+                        "ctf", NULL) < 0) {
+                        fprintf(stderr,
+                            "[error] Couldn't open the streams of job %u.\n",
+                            i);
+                        ret = -1;
+                        goto end;
+                }
+
+                job->streams = createStreamSpool(prefix, nstreams, ranks,
+                    job->shadow);
+                if (!job->streams) {
+                        ret = -1;
+                        goto end;
+                }
+                streams[i] = job->streams;
+        }
+
+        for (i = 0; i < njobs; i++) {
+                job_list[i].thread = g_thread_new("lttng2prv-job", run_job,
+                    &job_list[i]);
+                started++;
+        }
+
+        for (i = 0; i < njobs; i++) {
+                g_thread_join(job_list[i].thread);
+        }
+        started = 0;
+
+        for (i = 0; i < njobs; i++) {
+                if (streams[i]->unranked) {
+                        fprintf(stderr, "[warning] A stream of %s wasn't "
+                            "found beforehand, converting it without "
+                            "--jobs.\n", path);
+                        ret = 1;
+                        goto end;
+                }
+        }
+        initSpoolResolver(&resolver, reg, ncpus, nsoftirqs);
+        ret = mergeStreamSpools(streams, njobs, prv, &resolver);
+        if (ret < 0) {
+                fprintf(stderr, "[error] Couldn't read the job output.\n");
+        }
+
+end:
+        for (i = 0; i < njobs; i++) {
+                struct parallelJob *job = &job_list[i];
+
+                if (i < started) {
+                        g_thread_join(job->thread);
+                }
+                freeStreamSpool(job->streams);
+                if (job->ctx) {
+                        bt_context_put(job->ctx);
+                }
+                if (job->shadow) {
+                        removeShadowTrace(job->shadow);
+                        g_free(job->shadow);
+                }
+        }
+
+        g_free(streams);
+        g_free(job_list);
+        g_hash_table_destroy(ranks);
+        g_hash_table_destroy(groups);
+        g_ptr_array_free(files, TRUE);
+
+        return ret;
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,22 @@
+#pragma once
+#ifndef PARALLELTRACE_H
+#define PARALLELTRACE_H
+
+#include <stdio.h>
+#include <glib.h>
+
+#include "types.h"
+#include "registerIds.h"
+#include "writeRecords.h"
+
+int parallelTrace(const char *_path, const char *_prefix, unsigned int _jobs,
+    struct prvWriter *_prv, struct prvRegistry *_reg, const uint32_t _ncpus,
+    const uint32_t _nsoftirqs, GHashTable *_arg_types_ht,
+    GHashTable *_event_class_ht);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
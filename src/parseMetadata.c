@@ -0,0 +1,1018 @@
+/* Reads the TSDL metadata of a trace for the native decoder */
+
+#define _DEFAULT_SOURCE
+
+#include <ctype.h>
+#include <endian.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parseMetadata.h"
+#include "lttng2prv.h"
+
+/* Header of each packet of a packetized metadata file, in bytes */
+#define METADATA_HEADER_SIZE 37
+
+enum
+{
+        TOKEN_END = 0,
+        TOKEN_IDENT,
+        TOKEN_NUMBER,
+        TOKEN_STRING,
+        TOKEN_PUNCT
+};
+
+struct token
+{
+        int type;
+        const char *text;
+        uint64_t value;
+};
+
+struct parser
+{
+        struct ctfMetadata *meta;
+        /* struct token, ending with a TOKEN_END */
+        GArray *tokens;
+        unsigned int pos;
+        /* typealiases, typedefs and named structs, enums and variants */
+        GHashTable *names;
+        bool error;
+};
+
+static char *read_text(const char *_path);
+
+static void tokenize(struct parser *_p, const char *_s);
+
+static const struct token *peek(struct parser *_p, unsigned int _ahead);
+
+static bool is(const struct token *_t, const char *_text);
+
+static bool accept(struct parser *_p, const char *_text);
+
+static bool expect(struct parser *_p, const char *_text);
+
+static void fail(struct parser *_p, const char *_what);
+
+static bool is_keyword(const struct token *_t);
+
+static struct ctfType *new_type(struct parser *_p, int _kind);
+
+static const struct ctfType *lookup(struct parser *_p, const char *_prefix,
+    const char *_name);
+
+static void add_name(struct parser *_p, const char *_prefix,
+    const char *_name, const struct ctfType *_type);
+
+static char *join_names(struct parser *_p);
+
+static int64_t signed_number(struct parser *_p);
+
+static bool next_entry(struct parser *_p, const char **_key,
+    const struct token **_value, const struct ctfType **_type,
+    bool *_negative);
+
+static bool truth(const struct token *_t);
+
+static bool big_order(struct parser *_p, const struct token *_t);
+
+static const struct ctfType *parse_type(struct parser *_p);
+
+static const struct ctfType *parse_integer(struct parser *_p);
+
+static const struct ctfType *parse_float(struct parser *_p);
+
+static const struct ctfType *parse_string(struct parser *_p);
+
+static const struct ctfType *parse_enum(struct parser *_p);
+
+static const struct ctfType *parse_struct(struct parser *_p);
+
+static const struct ctfType *parse_variant(struct parser *_p);
+
+static void parse_fields(struct parser *_p, GArray *_fields);
+
+static const struct ctfType *parse_declarator(struct parser *_p,
+    const struct ctfType *_type);
+
+static void parse_typealias(struct parser *_p);
+
+static void parse_typedef(struct parser *_p);
+
+static void parse_block(struct parser *_p, const char *_name);
+
+static void scan_byte_order(struct parser *_p);
+
+/*
+ * Returns the text of the metadata file of trace directory _path, joining
+ * the packets of a packetized one
+ */
+static char *
+read_text(const char *path)
+{
+        GString *text;
+        gchar *file, *data;
+        gsize size, off;
+        uint32_t magic, content, packet;
+        bool swap;
+
+        file = g_build_filename(path, "metadata", NULL);
+        if (!g_file_get_contents(file, &data, &size, NULL)) {
+                g_free(file);
+                return NULL;
+        }
+        g_free(file);
+
+        memcpy(&magic, data, MIN(size, sizeof(magic)));
+        if (size < sizeof(magic) || (magic != METADATA_MAGIC &&
+                magic != GUINT32_SWAP_LE_BE(METADATA_MAGIC))) {
+                return data;
+        }
+        swap = (magic != METADATA_MAGIC);
+
+        text = g_string_sized_new(size);
+        for (off = 0; off + METADATA_HEADER_SIZE <= size; off += packet) {
+                memcpy(&content, data + off + 24, sizeof(content));
+                memcpy(&packet, data + off + 28, sizeof(packet));
+                if (swap) {
+                        content = GUINT32_SWAP_LE_BE(content);
+                        packet = GUINT32_SWAP_LE_BE(packet);
+                }
+                content /= 8;
+                packet /= 8;
+                if (content < METADATA_HEADER_SIZE || content > packet ||
+                    off + content > size) {
+                        break;
+                }
+                g_string_append_len(text, data + off + METADATA_HEADER_SIZE,
+                    content - METADATA_HEADER_SIZE);
+        }
+        g_free(data);
+
+        return g_string_free(text, FALSE);
+}
+
+/* Splits _s into the tokens of _p */
+static void
+tokenize(struct parser *p, const char *s)
+{
+        struct token tok;
+        const char *start;
+        char *end;
+        GString *str;
+
+        while (*s != '\0') {
+                memset(&tok, 0, sizeof(tok));
+                if (isspace((unsigned char) *s)) {
+                        s++;
+                        continue;
+                } else if (s[0] == '/' && s[1] == '*') {
+                        end = strstr(s + 2, "*/");
+                        s = end != NULL ? end + 2 : s + strlen(s);
+                        continue;
+                } else if (s[0] == '/' && s[1] == '/') {
+                        s += strcspn(s, "\n");
+                        continue;
+                } else if (isalpha((unsigned char) *s) || *s == '_') {
+                        /* scopes such as packet.header are one name */
+                        start = s;
+                        while (isalnum((unsigned char) *s) || *s == '_' ||
+                            (*s == '.' && (isalpha((unsigned char) s[1]) ||
+                                s[1] == '_'))) {
+                                s++;
+                        }
+                        tok.type = TOKEN_IDENT;
+                        tok.text = g_string_chunk_insert_len(
+                            p->meta->strings, start, s - start);
+                } else if (isdigit((unsigned char) *s)) {
+                        start = s;
+                        tok.value = strtoull(s, &end, 0);
+                        s = end;
+                        while (*s == 'u' || *s == 'U' || *s == 'l' ||
+                            *s == 'L') {
+                                s++;
+                        }
+                        tok.type = TOKEN_NUMBER;
+                        tok.text = g_string_chunk_insert_len(
+                            p->meta->strings, start, s - start);
+                } else if (*s == '"') {
+                        str = g_string_new(NULL);
+                        for (s++; *s != '\0' && *s != '"'; s++) {
+                                if (*s == '\\' && s[1] != '\0') {
+                                        s++;
+                                }
+                                g_string_append_c(str, *s);
+                        }
+                        if (*s == '"') {
+                                s++;
+                        }
+                        tok.type = TOKEN_STRING;
+                        tok.text = g_string_chunk_insert(p->meta->strings,
+                            str->str);
+                        g_string_free(str, TRUE);
+                } else {
+                        tok.type = TOKEN_PUNCT;
+                        if (strncmp(s, ":=", 2) == 0) {
+                                tok.text = ":=";
+                        } else if (strncmp(s, "...", 3) == 0) {
+                                tok.text = "...";
+                        } else {
+                                tok.text = g_string_chunk_insert_len(
+                                    p->meta->strings, s, 1);
+                        }
+                        s += strlen(tok.text);
+                }
+                g_array_append_val(p->tokens, tok);
+        }
+
+        memset(&tok, 0, sizeof(tok));
+        tok.text = "end of the metadata";
+        g_array_append_val(p->tokens, tok);
+}
+
+static const struct token *
+peek(struct parser *p, unsigned int ahead)
+{
+        return &g_array_index(p->tokens, struct token,
+            MIN(p->pos + ahead, p->tokens->len - 1));
+}
+
+static bool
+is(const struct token *t, const char *text)
+{
+        return (t->type == TOKEN_IDENT || t->type == TOKEN_PUNCT) &&
+            strcmp(t->text, text) == 0;
+}
+
+static bool
+accept(struct parser *p, const char *text)
+{
+        if (!p->error && is(peek(p, 0), text)) {
+                p->pos++;
+                return true;
+        }
+
+        return false;
+}
+
+static bool
+expect(struct parser *p, const char *text)
+{
+        if (accept(p, text)) {
+                return true;
+        }
+        fail(p, text);
+
+        return false;
+}
+
+/* Stops the parser at the first error, _what is what was expected */
+static void
+fail(struct parser *p, const char *what)
+{
+        if (!p->error) {
+                debug("Metadata: expected %s, found \"%s\"\n", what,
+                    peek(p, 0)->text);
+        }
+        p->error = true;
+}
+
+static bool
+is_keyword(const struct token *t)
+{
+        return is(t, "integer") || is(t, "floating_point") ||
+            is(t, "string") || is(t, "enum") || is(t, "struct") ||
+            is(t, "variant");
+}
+
+static struct ctfType *
+new_type(struct parser *p, int kind)
+{
+        struct ctfType *type = g_new0(struct ctfType, 1);
+
+        type->kind = kind;
+        type->align = 1;
+        g_ptr_array_add(p->meta->types, type);
+
+        return type;
+}
+
+/* The type named _name, "struct _name" and so on with a _prefix */
+static const struct ctfType *
+lookup(struct parser *p, const char *prefix, const char *name)
+{
+        const struct ctfType *type;
+        char *key;
+
+        if (name == NULL) {
+                fail(p, "a type");
+                return NULL;
+        }
+        key = prefix != NULL ? g_strconcat(prefix, " ", name, NULL) :
+            g_strdup(name);
+        type = g_hash_table_lookup(p->names, key);
+        g_free(key);
+        if (type == NULL) {
+                fail(p, "a declared type");
+        }
+
+        return type;
+}
+
+static void
+add_name(struct parser *p, const char *prefix, const char *name,
+    const struct ctfType *type)
+{
+        if (name == NULL || type == NULL) {
+                return;
+        }
+        g_hash_table_replace(p->names, prefix != NULL ?
+            g_strconcat(prefix, " ", name, NULL) : g_strdup(name),
+            (gpointer) type);
+}
+
+/*
+ * Reads a type name of several words, such as "unsigned long", up to the
+ * next token that isn't a word. The name lives in the metadata strings.
+ */
+static char *
+join_names(struct parser *p)
+{
+        GString *name = g_string_new(NULL);
+        char *ret;
+
+        while (peek(p, 0)->type == TOKEN_IDENT && !is_keyword(peek(p, 0))) {
+                if (name->len > 0) {
+                        g_string_append_c(name, ' ');
+                }
+                g_string_append(name, peek(p, 0)->text);
+                p->pos++;
+        }
+        ret = name->len > 0 ?
+            g_string_chunk_insert(p->meta->strings, name->str) : NULL;
+        g_string_free(name, TRUE);
+
+        return ret;
+}
+
+static int64_t
+signed_number(struct parser *p)
+{
+        bool negative = accept(p, "-");
+        uint64_t value;
+
+        if (peek(p, 0)->type != TOKEN_NUMBER) {
+                fail(p, "a number");
+                return 0;
+        }
+        value = peek(p, 0)->value;
+        p->pos++;
+
+        return negative ? -(int64_t) value : (int64_t) value;
+}
+
+/*
+ * Reads the next "key = value;" or "key := type;" of a block, or a
+ * typealias. Returns false at the closing brace or on an error.
+ */
+static bool
+next_entry(struct parser *p, const char **key, const struct token **value,
+    const struct ctfType **type, bool *negative)
+{
+        *key = NULL;
+        *value = NULL;
+        *type = NULL;
+        *negative = false;
+
+        if (accept(p, "}") || p->error) {
+                return false;
+        }
+        if (accept(p, "typealias")) {
+                parse_typealias(p);
+                return !p->error;
+        }
+        if (peek(p, 0)->type != TOKEN_IDENT) {
+                fail(p, "an attribute");
+                return false;
+        }
+        *key = peek(p, 0)->text;
+        p->pos++;
+
+        if (accept(p, ":=")) {
+                *type = parse_type(p);
+        } else if (expect(p, "=")) {
+                *negative = accept(p, "-");
+                *value = peek(p, 0);
+                if ((*value)->type == TOKEN_END ||
+                    (*value)->type == TOKEN_PUNCT) {
+                        fail(p, "a value");
+                }
+                p->pos++;
+        }
+        expect(p, ";");
+
+        return !p->error;
+}
+
+static bool
+truth(const struct token *t)
+{
+        if (t->type == TOKEN_NUMBER) {
+                return t->value != 0;
+        }
+
+        return g_ascii_strcasecmp(t->text, "true") == 0;
+}
+
+static bool
+big_order(struct parser *p, const struct token *t)
+{
+        if (is(t, "native")) {
+                return p->meta->big_endian;
+        }
+
+        return is(t, "be") || is(t, "big") || is(t, "network");
+}
+
+/*
+ * Reads a type specifier: a type keyword with its body, or the name of a
+ * typealias
+ */
+static const struct ctfType *
+parse_type(struct parser *p)
+{
+        if (accept(p, "integer")) {
+                return parse_integer(p);
+        } else if (accept(p, "floating_point")) {
+                return parse_float(p);
+        } else if (accept(p, "string")) {
+                return parse_string(p);
+        } else if (accept(p, "enum")) {
+                return parse_enum(p);
+        } else if (accept(p, "struct")) {
+                return parse_struct(p);
+        } else if (accept(p, "variant")) {
+                return parse_variant(p);
+        }
+
+        return lookup(p, NULL, join_names(p));
+}
+
+static const struct ctfType *
+parse_integer(struct parser *p)
+{
+        struct ctfType *type = new_type(p, CTF_INTEGER);
+        const struct ctfType *unused;
+        const struct token *value;
+        const char *key;
+        bool negative, aligned = false;
+
+        type->big_endian = p->meta->big_endian;
+        expect(p, "{");
+        while (next_entry(p, &key, &value, &unused, &negative)) {
+                if (key == NULL || value == NULL) {
+                        continue;
+                } else if (strcmp(key, "size") == 0) {
+                        type->size = value->value;
+                } else if (strcmp(key, "align") == 0) {
+                        type->align = value->value;
+                        aligned = true;
+                } else if (strcmp(key, "signed") == 0) {
+                        type->is_signed = truth(value);
+                } else if (strcmp(key, "byte_order") == 0) {
+                        type->big_endian = big_order(p, value);
+                } else if (strcmp(key, "encoding") == 0) {
+                        type->text = g_ascii_strcasecmp(value->text,
+                            "none") != 0;
+                }
+        }
+        if (!aligned) {
+                type->align = type->size % 8 == 0 ? 8 : 1;
+        }
+        if (type->size == 0 || type->size > 64 || type->align == 0 ||
+            (type->align & (type->align - 1)) != 0) {
+                fail(p, "an integer of up to 64 bits");
+        }
+
+        return type;
+}
+
+static const struct ctfType *
+parse_float(struct parser *p)
+{
+        struct ctfType *type = new_type(p, CTF_FLOAT);
+        const struct ctfType *unused;
+        const struct token *value;
+        const char *key;
+        bool negative, aligned = false;
+
+        type->big_endian = p->meta->big_endian;
+        expect(p, "{");
+        while (next_entry(p, &key, &value, &unused, &negative)) {
+                if (key == NULL || value == NULL) {
+                        continue;
+                } else if (strcmp(key, "exp_dig") == 0 ||
+                    strcmp(key, "mant_dig") == 0) {
+                        type->size += value->value;
+                } else if (strcmp(key, "align") == 0) {
+                        type->align = value->value;
+                        aligned = true;
+                } else if (strcmp(key, "byte_order") == 0) {
+                        type->big_endian = big_order(p, value);
+                }
+        }
+        if (!aligned) {
+                type->align = type->size % 8 == 0 ? 8 : 1;
+        }
+        if (type->size == 0 || type->size > 64 || type->align == 0 ||
+            (type->align & (type->align - 1)) != 0) {
+                fail(p, "a float of up to 64 bits");
+        }
+
+        return type;
+}
+
+static const struct ctfType *
+parse_string(struct parser *p)
+{
+        struct ctfType *type = new_type(p, CTF_STRING);
+        const struct ctfType *unused;
+        const struct token *value;
+        const char *key;
+        bool negative;
+
+        type->align = 8;
+        type->text = true;
+        if (accept(p, "{")) {
+                while (next_entry(p, &key, &value, &unused, &negative)) {
+                        continue;
+                }
+        }
+
+        return type;
+}
+
+static const struct ctfType *
+parse_enum(struct parser *p)
+{
+        struct ctfType *type;
+        const struct ctfType *container;
+        struct ctfMapping mapping;
+        const char *name = NULL;
+        int64_t next = 0;
+
+        if (peek(p, 0)->type == TOKEN_IDENT && !is_keyword(peek(p, 0))) {
+                name = peek(p, 0)->text;
+                p->pos++;
+        }
+        if (!is(peek(p, 0), ":") && !is(peek(p, 0), "{")) {
+                return lookup(p, "enum", name);
+        }
+        if (accept(p, ":")) {
+                container = is_keyword(peek(p, 0)) ? parse_type(p) :
+                    lookup(p, NULL, join_names(p));
+        } else {
+                container = lookup(p, NULL, "int");
+        }
+        if (container == NULL || container->kind != CTF_INTEGER) {
+                fail(p, "an integer container");
+                return NULL;
+        }
+
+        type = new_type(p, CTF_ENUM);
+        type->size = container->size;
+        type->align = container->align;
+        type->is_signed = container->is_signed;
+        type->big_endian = container->big_endian;
+        type->elem = container;
+        type->mappings = g_array_new(FALSE, TRUE, sizeof(struct ctfMapping));
+
+        expect(p, "{");
+        while (!p->error && !accept(p, "}")) {
+                if (peek(p, 0)->type != TOKEN_IDENT &&
+                    peek(p, 0)->type != TOKEN_STRING) {
+                        fail(p, "an enum label");
+                        break;
+                }
+                mapping.label = peek(p, 0)->text;
+                p->pos++;
+                mapping.begin = next;
+                if (accept(p, "=")) {
+                        mapping.begin = signed_number(p);
+                }
+                mapping.end = mapping.begin;
+                if (accept(p, "...")) {
+                        mapping.end = signed_number(p);
+                }
+                g_array_append_val(type->mappings, mapping);
+                next = mapping.end + 1;
+                if (!accept(p, ",")) {
+                        expect(p, "}");
+                        break;
+                }
+        }
+        add_name(p, "enum", name, type);
+
+        return type;
+}
+
+static const struct ctfType *
+parse_struct(struct parser *p)
+{
+        struct ctfType *type;
+        const struct ctfField *field;
+        const char *name = NULL;
+        unsigned int i;
+        int64_t align;
+
+        if (peek(p, 0)->type == TOKEN_IDENT && !is_keyword(peek(p, 0))) {
+                name = peek(p, 0)->text;
+                p->pos++;
+        }
+        if (!accept(p, "{")) {
+                return lookup(p, "struct", name);
+        }
+
+        type = new_type(p, CTF_STRUCT);
+        type->fields = g_array_new(FALSE, TRUE, sizeof(struct ctfField));
+        parse_fields(p, type->fields);
+        if (accept(p, "align")) {
+                expect(p, "(");
+                align = signed_number(p);
+                type->align = MAX(1, align);
+                expect(p, ")");
+        }
+        for (i = 0; i < type->fields->len; i++) {
+                field = &g_array_index(type->fields, struct ctfField, i);
+                type->align = MAX(type->align, field->type->align);
+        }
+        add_name(p, "struct", name, type);
+
+        return type;
+}
+
+/* Variants take the alignment of the option they hold */
+static const struct ctfType *
+parse_variant(struct parser *p)
+{
+        struct ctfType *type, *tagged;
+        const struct ctfType *named;
+        const char *name = NULL, *tag = NULL;
+
+        if (peek(p, 0)->type == TOKEN_IDENT && !is_keyword(peek(p, 0))) {
+                name = peek(p, 0)->text;
+                p->pos++;
+        }
+        if (accept(p, "<")) {
+                tag = peek(p, 0)->text;
+                p->pos++;
+                expect(p, ">");
+        }
+        if (!accept(p, "{")) {
+                named = lookup(p, "variant", name);
+                if (named == NULL || tag == NULL) {
+                        return named;
+                }
+                tagged = new_type(p, CTF_VARIANT);
+                tagged->ref = tag;
+                tagged->fields = g_array_new(FALSE, TRUE,
+                    sizeof(struct ctfField));
+                g_array_append_vals(tagged->fields, named->fields->data,
+                    named->fields->len);
+                return tagged;
+        }
+
+        type = new_type(p, CTF_VARIANT);
+        type->ref = tag;
+        type->fields = g_array_new(FALSE, TRUE, sizeof(struct ctfField));
+        parse_fields(p, type->fields);
+        add_name(p, "variant", name, type);
+
+        return type;
+}
+
+/* Reads the fields of a struct or the options of a variant, up to "}" */
+static void
+parse_fields(struct parser *p, GArray *fields)
+{
+        struct ctfField field;
+        const struct ctfType *type;
+        char *name;
+
+        while (!p->error && !accept(p, "}")) {
+                if (peek(p, 0)->type == TOKEN_END) {
+                        fail(p, "}");
+                } else if (accept(p, "typealias")) {
+                        parse_typealias(p);
+                } else if (accept(p, "typedef")) {
+                        parse_typedef(p);
+                } else {
+                        if (is_keyword(peek(p, 0))) {
+                                type = parse_type(p);
+                                name = NULL;
+                        } else {
+                                /* the last word is the field name */
+                                name = join_names(p);
+                                if (name != NULL && strrchr(name, ' ')) {
+                                        *strrchr(name, ' ') = '\0';
+                                        type = lookup(p, NULL, name);
+                                        field.name = name + strlen(name) + 1;
+                                } else {
+                                        fail(p, "a field");
+                                        break;
+                                }
+                        }
+                        if (name == NULL && peek(p, 0)->type == TOKEN_IDENT) {
+                                field.name = peek(p, 0)->text;
+                                p->pos++;
+                        } else if (name == NULL) {
+                                fail(p, "a field name");
+                                break;
+                        }
+                        field.type = parse_declarator(p, type);
+                        expect(p, ";");
+                        if (field.type != NULL) {
+                                g_array_append_val(fields, field);
+                        }
+                }
+        }
+}
+
+/*
+ * Wraps _type in the arrays and sequences of the "[N]" and "[length]"
+ * that follow a name, the last one innermost
+ */
+static const struct ctfType *
+parse_declarator(struct parser *p, const struct ctfType *type)
+{
+        GPtrArray *dims = g_ptr_array_new();
+        const struct token *dim;
+        struct ctfType *wrap;
+        const char *ref;
+        int i;
+
+        while (accept(p, "[")) {
+                g_ptr_array_add(dims, (gpointer) peek(p, 0));
+                p->pos++;
+                expect(p, "]");
+        }
+        for (i = (int) dims->len - 1; i >= 0 && type != NULL; i--) {
+                dim = g_ptr_array_index(dims, i);
+                if (dim->type == TOKEN_NUMBER) {
+                        wrap = new_type(p, CTF_ARRAY);
+                        wrap->length = dim->value;
+                } else if (dim->type == TOKEN_IDENT) {
+                        wrap = new_type(p, CTF_SEQUENCE);
+                        /* lengths are siblings, whatever the scope says */
+                        ref = strrchr(dim->text, '.');
+                        wrap->ref = ref != NULL ? ref + 1 : dim->text;
+                } else {
+                        fail(p, "an array length");
+                        break;
+                }
+                wrap->elem = type;
+                wrap->align = type->align;
+                wrap->text = type->kind == CTF_INTEGER && type->text &&
+                    type->size == 8;
+                type = wrap;
+        }
+        g_ptr_array_free(dims, TRUE);
+
+        return p->error ? NULL : type;
+}
+
+/* typealias <type> := <name>; */
+static void
+parse_typealias(struct parser *p)
+{
+        const struct ctfType *type = parse_type(p);
+        char *name;
+
+        type = parse_declarator(p, type);
+        expect(p, ":=");
+        name = join_names(p);
+        while (accept(p, "*")) {
+                continue;
+        }
+        if (name == NULL) {
+                fail(p, "a typealias name");
+        }
+        expect(p, ";");
+        add_name(p, NULL, name, type);
+}
+
+/* typedef <type> <name>; */
+static void
+parse_typedef(struct parser *p)
+{
+        const struct ctfType *type;
+        char *name;
+
+        if (is_keyword(peek(p, 0))) {
+                type = parse_type(p);
+                name = join_names(p);
+        } else {
+                name = join_names(p);
+                if (name == NULL || strrchr(name, ' ') == NULL) {
+                        fail(p, "a typedef");
+                        return;
+                }
+                *strrchr(name, ' ') = '\0';
+                type = lookup(p, NULL, name);
+                name += strlen(name) + 1;
+        }
+        type = parse_declarator(p, type);
+        expect(p, ";");
+        add_name(p, NULL, name, type);
+}
+
+/* Reads the trace, clock, stream or event block _name, up to "}" */
+static void
+parse_block(struct parser *p, const char *name)
+{
+        struct ctfStreamDecl *stream = NULL;
+        struct ctfEventDecl *event = NULL;
+        const struct token *value;
+        const struct ctfType *type;
+        const char *key;
+        bool negative, clock = false;
+        int64_t number;
+
+        if (strcmp(name, "stream") == 0) {
+                stream = g_new0(struct ctfStreamDecl, 1);
+                g_ptr_array_add(p->meta->streams, stream);
+        } else if (strcmp(name, "event") == 0) {
+                event = g_new0(struct ctfEventDecl, 1);
+                g_ptr_array_add(p->meta->events, event);
+        } else if (strcmp(name, "clock") == 0) {
+                /* events are stamped with the first one */
+                clock = (p->meta->clock_freq == 0);
+                if (clock) {
+                        p->meta->clock_freq = 1000000000;
+                }
+        }
+
+        while (next_entry(p, &key, &value, &type, &negative)) {
+                if (key == NULL) {
+                        continue;
+                }
+                number = value != NULL && value->type == TOKEN_NUMBER ?
+                    (negative ? -(int64_t) value->value :
+                    (int64_t) value->value) : 0;
+                if (strcmp(name, "trace") == 0 &&
+                    strcmp(key, "packet.header") == 0) {
+                        p->meta->packet_header = type;
+                } else if (clock && strcmp(key, "freq") == 0) {
+                        p->meta->clock_freq = number;
+                } else if (clock && strcmp(key, "offset_s") == 0) {
+                        p->meta->clock_offset_s = number;
+                } else if (clock && strcmp(key, "offset") == 0) {
+                        p->meta->clock_offset = number;
+                } else if (stream != NULL && strcmp(key, "id") == 0) {
+                        stream->id = number;
+                } else if (stream != NULL &&
+                    strcmp(key, "packet.context") == 0) {
+                        stream->packet_context = type;
+                } else if (stream != NULL &&
+                    strcmp(key, "event.header") == 0) {
+                        stream->event_header = type;
+                } else if (stream != NULL &&
+                    strcmp(key, "event.context") == 0) {
+                        stream->event_context = type;
+                } else if (event != NULL && strcmp(key, "name") == 0 &&
+                    value != NULL) {
+                        event->name = value->text;
+                } else if (event != NULL && strcmp(key, "id") == 0) {
+                        event->id = number;
+                } else if (event != NULL && strcmp(key, "stream_id") == 0) {
+                        event->stream_id = number;
+                } else if (event != NULL && strcmp(key, "context") == 0) {
+                        event->context = type;
+                } else if (event != NULL && strcmp(key, "fields") == 0) {
+                        event->fields = type;
+                }
+        }
+        if (event != NULL && event->name == NULL) {
+                fail(p, "an event name");
+        }
+}
+
+/*
+ * "native" integers take the byte order of the trace block, which may come
+ * after them
+ */
+static void
+scan_byte_order(struct parser *p)
+{
+        const struct token *t;
+        unsigned int i, depth = 0;
+        bool trace = false;
+
+        for (i = 0; i + 2 < p->tokens->len; i++) {
+                t = &g_array_index(p->tokens, struct token, i);
+                if (is(t, "{")) {
+                        depth++;
+                } else if (is(t, "}") && depth > 0 && --depth == 0) {
+                        trace = false;
+                } else if (depth == 0 && is(t, "trace") && is(t + 1, "{")) {
+                        trace = true;
+                } else if (trace && depth == 1 && is(t, "byte_order") &&
+                    is(t + 1, "=")) {
+                        p->meta->big_endian = is(t + 2, "be") ||
+                            is(t + 2, "big") || is(t + 2, "network");
+                }
+        }
+}
+
+/*
+ * Parses the metadata of trace directory _path. Returns NULL if it can't
+ * be read or uses something outside the subset of TSDL LTTng writes.
+ */
+struct ctfMetadata *
+parseMetadata(const char *path)
+{
+        struct ctfMetadata *meta;
+        struct parser p;
+        const char *name;
+        char *text;
+
+        text = read_text(path);
+        if (text == NULL) {
+                return NULL;
+        }
+
+        meta = g_new0(struct ctfMetadata, 1);
+        meta->streams = g_ptr_array_new_with_free_func(g_free);
+        meta->events = g_ptr_array_new_with_free_func(g_free);
+        meta->types = g_ptr_array_new();
+        meta->strings = g_string_chunk_new(4096);
+
+        memset(&p, 0, sizeof(p));
+        p.meta = meta;
+        p.tokens = g_array_new(FALSE, TRUE, sizeof(struct token));
+        p.names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            NULL);
+        tokenize(&p, text);
+        g_free(text);
+        scan_byte_order(&p);
+
+        while (!p.error && peek(&p, 0)->type != TOKEN_END) {
+                if (accept(&p, "typealias")) {
+                        parse_typealias(&p);
+                } else if (accept(&p, "typedef")) {
+                        parse_typedef(&p);
+                } else if (is_keyword(peek(&p, 0))) {
+                        parse_type(&p);
+                        expect(&p, ";");
+                } else if (peek(&p, 0)->type == TOKEN_IDENT &&
+                    is(peek(&p, 1), "{")) {
+                        name = peek(&p, 0)->text;
+                        p.pos += 2;
+                        parse_block(&p, name);
+                        expect(&p, ";");
+                } else {
+                        fail(&p, "a declaration");
+                }
+        }
+
+        g_array_free(p.tokens, TRUE);
+        g_hash_table_destroy(p.names);
+        if (p.error) {
+                freeMetadata(meta);
+                return NULL;
+        }
+
+        return meta;
+}
+
+void
+freeMetadata(struct ctfMetadata *meta)
+{
+        struct ctfType *type;
+        unsigned int i;
+
+        if (meta == NULL) {
+                return;
+        }
+        for (i = 0; i < meta->types->len; i++) {
+                type = g_ptr_array_index(meta->types, i);
+                if (type->fields != NULL) {
+                        g_array_free(type->fields, TRUE);
+                }
+                if (type->mappings != NULL) {
+                        g_array_free(type->mappings, TRUE);
+                }
+                g_free(type);
+        }
+        g_ptr_array_free(meta->types, TRUE);
+        g_ptr_array_free(meta->streams, TRUE);
+        g_ptr_array_free(meta->events, TRUE);
+        g_string_chunk_free(meta->strings);
+        g_free(meta);
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
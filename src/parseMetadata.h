@@ -0,0 +1,118 @@
+#pragma once
+#ifndef PARSEMETADATA_H
+#define PARSEMETADATA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <glib.h>
+
+#include "types.h"
+
+/* Magic number of the packets of a packetized metadata file */
+#define METADATA_MAGIC 0x75D11D57
+
+/* Kinds of struct ctfType */
+enum
+{
+        CTF_INTEGER = 0,
+        CTF_FLOAT,
+        CTF_STRING,
+        CTF_ENUM,
+        CTF_ARRAY,
+        CTF_SEQUENCE,
+        CTF_STRUCT,
+        CTF_VARIANT
+};
+
+/* A field of a struct, or an option of a variant */
+struct ctfField
+{
+        const char *name;
+        const struct ctfType *type;
+};
+
+/* A label of an enum and the range of values it stands for */
+struct ctfMapping
+{
+        const char *label;
+        int64_t begin;
+        int64_t end;
+};
+
+/*
+ * A type declared by the TSDL metadata. Sizes and alignments are in bits,
+ * as in the metadata.
+ */
+struct ctfType
+{
+        int kind;
+        /* integers, floats and enums */
+        unsigned int size;
+        unsigned int align;
+        bool is_signed;
+        bool big_endian;
+        /* an integer with a character encoding */
+        bool text;
+        /* the elements of arrays and sequences, the container of enums */
+        const struct ctfType *elem;
+        /* of arrays */
+        uint64_t length;
+        /* the field with the length of a sequence or the tag of a variant */
+        const char *ref;
+        /* struct ctfField of structs and variants */
+        GArray *fields;
+        /* struct ctfMapping of enums */
+        GArray *mappings;
+};
+
+/* A stream block */
+struct ctfStreamDecl
+{
+        uint64_t id;
+        const struct ctfType *packet_context;
+        const struct ctfType *event_header;
+        const struct ctfType *event_context;
+};
+
+/* An event block */
+struct ctfEventDecl
+{
+        const char *name;
+        uint64_t id;
+        uint64_t stream_id;
+        const struct ctfType *context;
+        const struct ctfType *fields;
+};
+
+/*
+ * The part of the metadata of a trace its stream files are decoded with:
+ * the scopes of the trace, stream and event blocks and the first clock.
+ * Everything is freed with freeMetadata().
+ */
+struct ctfMetadata
+{
+        bool big_endian;
+        const struct ctfType *packet_header;
+        /* 0 without a clock block */
+        uint64_t clock_freq;
+        int64_t clock_offset_s;
+        /* in cycles */
+        int64_t clock_offset;
+        /* struct ctfStreamDecl * and struct ctfEventDecl *, in order */
+        GPtrArray *streams;
+        GPtrArray *events;
+        /* every struct ctfType, and the names they refer to */
+        GPtrArray *types;
+        GStringChunk *strings;
+};
+
+struct ctfMetadata *parseMetadata(const char *_path);
+
+void freeMetadata(struct ctfMetadata *_meta);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -1,12 +1,14 @@
-#define UNUSED(x) (void)(x)
-
 #include "types.h"
+#include "writeRecords.h"
+#include "splitOutput.h"
+#include "trackStates.h"
+#include "registerIds.h"
 #include <glib.h>
 #include <babeltrace/ctf/events.h>
 
 void
-printPRVHeader(struct bt_context *ctx, FILE *fp,
-    GHashTable *tid_info_ht, int nresources)
+printPRVHeader(struct bt_context *ctx, struct prvWriter *w,
+    const struct prvRegistry *reg, int nresources)
 {
         UNUSED(ctx);
 
@@ -14,47 +16,62 @@ printPRVHeader(struct bt_context *ctx, FILE *fp,
         struct tm *local = localtime(&now);
         uint64_t ftime = trace_times.last_stream_timestamp -
             trace_times.first_stream_timestamp;
+        int ftime_len = 0;
 
         char day[3], mon[3], hour[3], min[3];
+        char head[128];
+        guint nappl;
         sprintf(day, "%.2d", local->tm_mday);
         sprintf(mon, "%.2d", local->tm_mon + 1);
         sprintf(hour, "%.2d", local->tm_hour);
         sprintf(min, "%.2d", local->tm_min);
 
-        fprintf(fp, "#Paraver (%s/%s/%d at %s:%s):%" PRIu64 "_ns:1(%d):%d:",
+        snprintf(head, sizeof(head),
+            "#Paraver (%s/%s/%d at %s:%s):",
             day,
             mon,
             local->tm_year + 1900,
             hour,
-            min,
+            min
+        );
+        writeString(w, head);
+
+        /* the duration of a slice is rewritten once it ends */
+        if (output_split.enabled) {
+                output_split.ftime_offset = w->bytes + w->len -
+                    output_split.bytes;
+                ftime_len = SLICE_FTIME_LEN;
+                ftime = 0;
+        }
+        snprintf(head, sizeof(head), "%0*" PRIu64 "_ns:1(%d):%d",
+            ftime_len,
             ftime,
             nresources,
-            g_hash_table_size(tid_info_ht) /* nAppl */
+            reg->threads->len /* nAppl */
         );
-
-        GHashTableIter ht_iter;
-        gpointer key, value;
-        g_hash_table_iter_init(&ht_iter, tid_info_ht);
-
-        while (g_hash_table_iter_next(&ht_iter, &key, &value)) {
-                fprintf(fp, "1(1:1):");
+        writeString(w, head);
+
+        /*
+         * ":1(1:1)" for each application. The output may be a pipe or a
+         * compressed stream, so colons are only written where they belong
+         * instead of removing the last one afterwards.
+         */
+        for (nappl = reg->threads->len; nappl > 0; nappl--) {
+                writeBytes(w, ":1(1:1)", 7);
         }
-        /* Remove last colon */
-        fseek(fp, -1, SEEK_CUR);
-        fprintf(fp, ")\n");
+        writeBytes(w, ")\n", 2);
 }
 
 void
-printROW(FILE *fp, GHashTable *tid_info_ht, GList *tid_prv_l,
-    GHashTable *irq_name_ht, GList *irq_prv_l, const uint32_t ncpus,
+printROW(FILE *fp, const struct prvRegistry *reg, const uint32_t ncpus,
     const uint32_t nsoftirqs)
 {
-        gpointer value;
+        const struct prvIrq *irq;
         uint32_t rcount = 0;
-        GList *list;
+        unsigned int i;
 
         fprintf(fp, "LEVEL CPU SIZE %d\n",
-            ncpus + nsoftirqs + g_hash_table_size(irq_name_ht));
+            ncpus + nsoftirqs + reg->irqs->len);
         while (rcount < ncpus) {
                 fprintf(fp, "CPU %d\n", rcount + 1);
                 rcount++;
@@ -66,31 +83,23 @@ printROW(FILE *fp, GHashTable *tid_info_ht, GList *tid_prv_l,
                 rcount++;
         }
 
-        while (irq_prv_l != NULL) {
-                value = g_hash_table_lookup(irq_name_ht, irq_prv_l->data);
-                fprintf(fp, "IRQ %d %s\n",
-                    GPOINTER_TO_INT(irq_prv_l->data), (const char *)value);
-                irq_prv_l = irq_prv_l->next;
+        for (i = 0; i < reg->irqs->len; i++) {
+                irq = &g_array_index(reg->irqs, struct prvIrq, i);
+                fprintf(fp, "IRQ %d %s\n", (int) irq->irq, irq->name);
         }
         fprintf(fp, "\n\n");
 
-        list = tid_prv_l;
-        fprintf(fp, "LEVEL APPL SIZE %d\n", g_hash_table_size(tid_info_ht));
-        while (list != NULL) {
-                value = g_hash_table_lookup(tid_info_ht, list->data);
-                fprintf(fp, "%s\n", (const char *)value);
-                list = list->next;
+        fprintf(fp, "LEVEL APPL SIZE %d\n", reg->threads->len);
+        for (i = 0; i < reg->threads->len; i++) {
+                fprintf(fp, "%s\n",
+                    g_array_index(reg->threads, struct prvThread, i).name);
         }
 
-        list = tid_prv_l;
-        fprintf(fp, "\nLEVEL THREAD SIZE %d\n", g_hash_table_size(tid_info_ht));
-        while (list != NULL) {
-                value = g_hash_table_lookup(tid_info_ht, list->data);
-                fprintf(fp, "%s\n", (const char *)value);
-                list = list->next;
+        fprintf(fp, "\nLEVEL THREAD SIZE %d\n", reg->threads->len);
+        for (i = 0; i < reg->threads->len; i++) {
+                fprintf(fp, "%s\n",
+                    g_array_index(reg->threads, struct prvThread, i).name);
         }
-
-        g_list_free(list);
 }
 
 void
@@ -108,13 +117,26 @@ printPCFHeader(FILE *fp)
             "DEFAULT_SEMANTIC\n\n"
             "THREAD_FUNC\t\tState As Is\n\n\n");
 
-        fprintf(fp,
-            "STATES\n"
-            "0\t\tIDLE\n"
-            "1\t\tSYSCALL\n"
-            "2\t\tUSERMODE\n"
-            "3\t\tSOFT_IRQ\n"
-            "4\t\tIRQ\n\n\n");
+        /* state records carry the STATE_* values of the 20000000 events */
+        if (thread_states.enabled) {
+                fprintf(fp,
+                    "STATES\n"
+                    "0\t\tUSERMODE\n"
+                    "1\t\tSYSCALL\n"
+                    "2\t\tSOFT_IRQ\n"
+                    "3\t\tIRQ\n"
+                    "4\t\tNETWORK\n"
+                    "5\t\tWAIT_CPU\n"
+                    "6\t\tWAIT_BLOCK\n\n\n");
+        } else {
+                fprintf(fp,
+                    "STATES\n"
+                    "0\t\tIDLE\n"
+                    "1\t\tSYSCALL\n"
+                    "2\t\tUSERMODE\n"
+                    "3\t\tSOFT_IRQ\n"
+                    "4\t\tIRQ\n\n\n");
+        }
 
         fprintf(fp,
             "STATES_COLOR\n"
@@ -0,0 +1,221 @@
+#include <string.h>
+
+#include "readEvents.h"
+#include "lttng2prv.h"
+#include "mapTrace.h"
+
+const char *const event_fields[NFIELDS] = {
+        [FIELD_TID] = "_tid",
+        [FIELD_PID] = "_pid",
+        [FIELD_NAME] = "_name",
+        [FIELD_COMM] = "_comm",
+        [FIELD_NEXT_TID] = "_next_tid",
+        [FIELD_NEXT_COMM] = "_next_comm",
+        [FIELD_PREV_TID] = "_prev_tid",
+        [FIELD_PREV_COMM] = "_prev_comm",
+        [FIELD_PREV_STATE] = "_prev_state",
+        [FIELD_CHILD_TID] = "_child_tid",
+        [FIELD_CHILD_PID] = "_child_pid",
+        [FIELD_CHILD_COMM] = "_child_comm",
+        [FIELD_VEC] = "_vec",
+        [FIELD_IRQ] = "_irq"
+};
+
+static const struct bt_definition *payload_field(
+    const struct eventSource *_src, int _field);
+
+static const struct bt_definition *
+payload_field(const struct eventSource *src, int field)
+{
+        const struct bt_definition *scope;
+
+        scope = bt_ctf_get_top_level_scope(src->event, BT_EVENT_FIELDS);
+
+        return bt_ctf_get_field(src->event, scope, event_fields[field]);
+}
+
+/*
+ * Reads the events of _iter, or with a NULL _iter the streams of the
+ * native decoder from their beginning. The iterator is destroyed by
+ * closeEventSource().
+ */
+void
+openEventSource(struct eventSource *src, struct bt_ctf_iter *iter,
+    GHashTable *event_class_ht)
+{
+        memset(src, 0, sizeof(*src));
+        src->iter = iter;
+        src->event_class_ht = event_class_ht;
+        initPacketCache(&src->packets);
+        if (iter == NULL) {
+                rewindStreams();
+        }
+}
+
+void
+closeEventSource(struct eventSource *src)
+{
+        if (src->iter != NULL) {
+                bt_ctf_iter_destroy(src->iter);
+        }
+        freePacketCache(&src->packets);
+}
+
+/*
+ * Reads the event _src is at, with its packet context and class. Returns
+ * false once the events are over.
+ */
+bool
+readEvent(struct eventSource *src)
+{
+        int flags = 0;
+
+        if (src->iter == NULL) {
+                if (!readNativeEvent(src)) {
+                        return false;
+                }
+                /* where babeltrace's iterator flags them */
+                src->lost = src->packet->new_packet &&
+                    src->packet->lost_events > 0;
+                if (src->lost) {
+                        src->lost_count += src->packet->lost_events;
+                }
+                return true;
+        }
+
+        src->event = bt_ctf_iter_read_event_flags(src->iter, &flags);
+        if (src->event == NULL) {
+                return false;
+        }
+        src->packet = readPacketContext(&src->packets, src->event);
+        src->class = getEventClass(src->event_class_ht, src->event,
+            &src->scratch);
+        src->timestamp = bt_ctf_get_timestamp(src->event);
+        src->lost = flags != 0;
+        if (src->lost) {
+                src->lost_count = bt_ctf_get_lost_events_count(src->iter);
+        }
+
+        return true;
+}
+
+/* Moves on to the next event, returns false on an error */
+bool
+nextEvent(struct eventSource *src)
+{
+        if (src->iter == NULL) {
+                nextNativeEvent(src);
+                return true;
+        }
+
+        return bt_iter_next(bt_ctf_get_iter(src->iter)) >= 0;
+}
+
+/* Integer payload field _field of the event read, 0 if it has none */
+uint64_t
+eventField(const struct eventSource *src, int field)
+{
+        const struct bt_definition *def;
+
+        if (src->iter == NULL) {
+                return nativeField(src->stream, field);
+        }
+
+        def = payload_field(src, field);
+        if (def == NULL) {
+                return 0;
+        }
+        /* _vec is the only unsigned one */
+        if (field == FIELD_VEC) {
+                return bt_get_unsigned_int(def);
+        }
+
+        return bt_get_signed_int(def);
+}
+
+bool
+hasEventField(const struct eventSource *src, int field)
+{
+        if (src->iter == NULL) {
+                return hasNativeField(src->stream, field);
+        }
+
+        return payload_field(src, field) != NULL;
+}
+
+/*
+ * Text payload field _field of the event read. A char array is copied to
+ * _buf up to its first NUL, a string may be returned as it is. Empty if
+ * the event has none.
+ */
+const char *
+eventText(const struct eventSource *src, int field, char *buf, size_t size)
+{
+        const struct bt_definition *def;
+        const char *text;
+
+        if (src->iter == NULL) {
+                return nativeText(src->stream, field, buf, size);
+        }
+
+        buf[0] = '\0';
+        def = payload_field(src, field);
+        if (def == NULL) {
+                return buf;
+        }
+        if (bt_ctf_field_type(bt_ctf_get_decl_from_def(def)) ==
+            CTF_TYPE_STRING) {
+                text = bt_ctf_get_string(def);
+                return text != NULL ? text : buf;
+        }
+        text = bt_ctf_get_char_array(def);
+        if (text != NULL) {
+                g_strlcpy(buf, text, size);
+        }
+
+        return buf;
+}
+
+/*
+ * The id of the event read in its stream class, the one of the extended
+ * header when the compact one holds the escape value
+ */
+uint64_t
+eventId(const struct eventSource *src)
+{
+        const struct bt_definition *scope;
+        uint64_t id;
+
+        if (src->iter == NULL) {
+                return nativeEventId(src->stream);
+        }
+
+        scope = bt_ctf_get_top_level_scope(src->event,
+            BT_STREAM_EVENT_HEADER);
+        id = bt_ctf_get_uint64(bt_ctf_get_enum_int(
+                bt_ctf_get_field(src->event, scope, "id")));
+        if (id + 1 == src->packet->id_size) {
+                id = bt_ctf_get_uint64(bt_ctf_get_struct_field_index(
+                        bt_ctf_get_field(src->event, scope, "v"), 0));
+        }
+
+        return id;
+}
+
+/* Appends the arguments of the event read, see getArgValue() */
+void
+writeEventArgs(const struct eventSource *src, uint64_t event_type,
+    GHashTable *arg_types_ht, GHashTable *arg_plans_ht, struct prvWriter *w)
+{
+        if (src->iter == NULL) {
+                writeNativeArgs(src->stream, event_type, w);
+                return;
+        }
+
+        getArgValue(src->event, event_type, arg_types_ht, arg_plans_ht, w);
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,94 @@
+#pragma once
+#ifndef READEVENTS_H
+#define READEVENTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <glib.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf/iterator.h>
+
+#include "types.h"
+#include "classifyEvents.h"
+#include "readPacketContext.h"
+#include "writeRecords.h"
+
+/* The payload fields the conversion reads, see eventField() */
+enum
+{
+        FIELD_TID = 0,
+        FIELD_PID,
+        FIELD_NAME,
+        FIELD_COMM,
+        FIELD_NEXT_TID,
+        FIELD_NEXT_COMM,
+        FIELD_PREV_TID,
+        FIELD_PREV_COMM,
+        FIELD_PREV_STATE,
+        FIELD_CHILD_TID,
+        FIELD_CHILD_PID,
+        FIELD_CHILD_COMM,
+        FIELD_VEC,
+        FIELD_IRQ,
+        NFIELDS
+};
+
+/* Names of the FIELD_* fields in the payload of the events */
+extern const char *const event_fields[NFIELDS];
+
+/*
+ * Where the loops over the events read them from: babeltrace's iterator,
+ * or the streams mapped by the native decoder, see mapTrace.h. Both give
+ * the same events in the same order with the same packet contexts, so
+ * updateThreadInfo() and iter_trace() convert them without knowing which
+ * one decoded them.
+ */
+struct eventSource
+{
+        /* babeltrace: the iterator, the event read and its streams */
+        struct bt_ctf_iter *iter;
+        struct bt_ctf_event *event;
+        struct packetCache packets;
+        /* --decoder=native: the stream of the event read */
+        struct mappedStream *stream;
+
+        GHashTable *event_class_ht;
+        struct eventClass scratch;
+
+        /* the event read */
+        const struct packetContext *packet;
+        const struct eventClass *class;
+        uint64_t timestamp;
+        /* events were lost before it, _lost_count of them so far */
+        bool lost;
+        uint64_t lost_count;
+};
+
+void openEventSource(struct eventSource *_src, struct bt_ctf_iter *_iter,
+    GHashTable *_event_class_ht);
+
+void closeEventSource(struct eventSource *_src);
+
+bool readEvent(struct eventSource *_src);
+
+bool nextEvent(struct eventSource *_src);
+
+uint64_t eventField(const struct eventSource *_src, int _field);
+
+bool hasEventField(const struct eventSource *_src, int _field);
+
+const char *eventText(const struct eventSource *_src, int _field,
+    char *_buf, size_t _size);
+
+uint64_t eventId(const struct eventSource *_src);
+
+void writeEventArgs(const struct eventSource *_src, uint64_t _event_type,
+    GHashTable *_arg_types_ht, GHashTable *_arg_plans_ht,
+    struct prvWriter *_w);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
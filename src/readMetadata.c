@@ -0,0 +1,139 @@
+/* Clock offset and header size of each trace, from its metadata */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "readMetadata.h"
+
+/* Metadata of the traces of each context, by handle id */
+static GHashTable *context_metadata = NULL;
+static GMutex metadata_lock;
+
+static void free_context_metadata(gpointer _data);
+
+/*
+ * Reads the event header size, and the clock offset and frequency from the
+ * metadata of the trace in _path
+ */
+int
+readMetadata(const char *path, struct traceMetadata *meta)
+{
+        char *metadatafn, *tmp;
+        FILE *metadatafp;
+
+        metadatafn = g_build_filename(path, "metadata", NULL);
+        metadatafp = fopen(metadatafn, "r");
+        g_free(metadatafn);
+        if (!metadatafp) {
+                return -1;
+        }
+
+        meta->clock_offset = 0;
+        meta->id_size = 32;
+        meta->clock_freq = 0;
+        tmp = malloc(512 * sizeof(char *));
+        while (fgets(tmp, 512, metadatafp) != NULL) {
+                if (strstr(tmp, "event.header := struct event_header_large")) {
+                        debug("Extended header in %s.\n", path);
+                        meta->id_size = 65536;
+                }
+                if (strstr(tmp, "offset = ")) {
+                        strtok(tmp, "=");
+                        meta->clock_offset = strtoul(strtok(NULL, "="), NULL,
+                            10);
+                        debug("Trace offset of %s = %lu\n", path,
+                            meta->clock_offset);
+                }
+                if (strstr(tmp, "freq = ")) {
+                        strtok(tmp, "=");
+                        meta->clock_freq = strtoul(strtok(NULL, "="), NULL,
+                            10);
+                }
+        }
+        fclose(metadatafp);
+        free(tmp);
+
+        return 0;
+}
+
+static void
+free_context_metadata(gpointer data)
+{
+        g_array_free(data, TRUE);
+}
+
+/*
+ * Reads the metadata of the trace in _path, opened as _handle_id in _ctx,
+ * for getTraceMetadata()
+ */
+void
+addTraceMetadata(struct bt_context *ctx, int handle_id, const char *path)
+{
+        struct traceMetadata meta;
+        GArray *traces;
+
+        if (readMetadata(path, &meta) < 0) {
+                fprintf(stderr, "[warning] Couldn't read the metadata of "
+                    "%s.\n", path);
+                meta.clock_offset = 0;
+                meta.id_size = id_size;
+        }
+
+        g_mutex_lock(&metadata_lock);
+        if (context_metadata == NULL) {
+                context_metadata = g_hash_table_new_full(g_direct_hash,
+                    g_direct_equal, NULL, free_context_metadata);
+        }
+        traces = g_hash_table_lookup(context_metadata, ctx);
+        if (traces == NULL) {
+                traces = g_array_new(FALSE, TRUE,
+                    sizeof(struct traceMetadata));
+                g_hash_table_insert(context_metadata, ctx, traces);
+        }
+        if ((unsigned int) handle_id >= traces->len) {
+                g_array_set_size(traces, handle_id + 1);
+        }
+        g_array_index(traces, struct traceMetadata, handle_id) = meta;
+        g_mutex_unlock(&metadata_lock);
+}
+
+/*
+ * Returns the metadata of the trace of _event. Only looked up for the first
+ * event of each stream, see readPacketContext().
+ */
+struct traceMetadata
+getTraceMetadata(const struct bt_ctf_event *event)
+{
+        struct traceMetadata meta = { 0, id_size, 0 };
+        GArray *traces;
+        int handle_id;
+
+        handle_id = bt_ctf_event_get_handle_id(event);
+        g_mutex_lock(&metadata_lock);
+        traces = context_metadata == NULL ? NULL :
+            g_hash_table_lookup(context_metadata,
+                bt_ctf_event_get_context(event));
+        if (traces != NULL && handle_id >= 0 &&
+            (unsigned int) handle_id < traces->len) {
+                meta = g_array_index(traces, struct traceMetadata, handle_id);
+        }
+        g_mutex_unlock(&metadata_lock);
+
+        return meta;
+}
+
+void
+freeTraceMetadata(void)
+{
+        if (context_metadata != NULL) {
+                g_hash_table_destroy(context_metadata);
+                context_metadata = NULL;
+        }
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,40 @@
+#pragma once
+#ifndef READMETADATA_H
+#define READMETADATA_H
+
+#include <stdint.h>
+#include <babeltrace/ctf/events.h>
+
+#include "types.h"
+
+/*
+ * What the converter needs from the metadata of each trace: the offset of
+ * its clock, added to the raw packet timestamps, and the event id meaning
+ * an extended header, 32 for compact headers and 65536 for large ones
+ * (ids are read plus 1). The traces found under the input path, a kernel
+ * trace and any number of UST ones, each have their own. The frequency of
+ * the clock, 0 if the metadata doesn't give it, tells whether the raw
+ * timestamps are in ns.
+ */
+struct traceMetadata
+{
+        uint64_t clock_offset;
+        unsigned int id_size;
+        uint64_t clock_freq;
+};
+
+int readMetadata(const char *_path, struct traceMetadata *_meta);
+
+void addTraceMetadata(struct bt_context *_ctx, int _handle_id,
+    const char *_path);
+
+struct traceMetadata getTraceMetadata(const struct bt_ctf_event *_event);
+
+void freeTraceMetadata(void);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,199 @@
+/* Read the packet context of an event once per packet */
+
+#include "readPacketContext.h"
+#include "getThreadInfo.h"
+#include "readMetadata.h"
+
+void
+initPacketCache(struct packetCache *cache)
+{
+        cache->last = NULL;
+        cache->streams = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+            NULL, g_free);
+        cache->resume = NULL;
+}
+
+void
+freePacketCache(struct packetCache *cache)
+{
+        g_hash_table_destroy(cache->streams);
+        cache->streams = NULL;
+        cache->last = NULL;
+}
+
+static void
+read_packet(struct packetContext *packet)
+{
+        uint64_t events_discarded;
+
+        packet->timestamp_end = 0;
+        packet->cpu_id = 0;
+        packet->lost_events = 0;
+        packet->packet_size = 0;
+
+        if (packet->timestamp_end_def != NULL) {
+                packet->timestamp_end =
+                    bt_get_unsigned_int(packet->timestamp_end_def);
+        }
+        if (packet->cpu_id_def != NULL) {
+                packet->cpu_id = bt_get_unsigned_int(packet->cpu_id_def);
+        }
+        if (packet->events_discarded_def != NULL) {
+                events_discarded =
+                    bt_get_unsigned_int(packet->events_discarded_def);
+                if (events_discarded > packet->events_discarded) {
+                        packet->lost_events =
+                            events_discarded - packet->events_discarded;
+                }
+                packet->events_discarded = events_discarded;
+        }
+        if (packet->packet_size_def != NULL) {
+                packet->packet_size =
+                    bt_get_unsigned_int(packet->packet_size_def) / 8;
+        }
+}
+
+/*
+ * Takes the events discarded by the stream of _packet up to the checkpoint
+ * being resumed from, so lost events already printed aren't printed again.
+ * Streams of several channels on a CPU are told apart by the packet being
+ * read, else taken in order.
+ */
+static void
+resume_stream(GArray *states, struct packetContext *packet)
+{
+        struct streamState *state, *found = NULL;
+        unsigned int i;
+
+        for (i = 0; i < states->len; i++) {
+                state = &g_array_index(states, struct streamState, i);
+                if (state->used || state->cpu_id != packet->cpu_id) {
+                        continue;
+                }
+                if (state->timestamp_begin == packet->timestamp_begin) {
+                        found = state;
+                        break;
+                }
+                if (found == NULL) {
+                        found = state;
+                }
+        }
+        if (found == NULL) {
+                return;
+        }
+
+        found->used = true;
+        packet->first_packet = false;
+        packet->lost_events = 0;
+        if (found->timestamp_begin == packet->timestamp_begin) {
+                /* in the middle of a packet already reported */
+                return;
+        }
+        if (packet->events_discarded > found->events_discarded) {
+                packet->lost_events =
+                    packet->events_discarded - found->events_discarded;
+        }
+}
+
+/*
+ * Returns the packet context of _event. new_packet is set on the first
+ * event of each packet. Streams are told apart by their packet context
+ * scope and consecutive events mostly come from the same stream, so the
+ * last one is checked before the table.
+ */
+const struct packetContext *
+readPacketContext(struct packetCache *cache, const struct bt_ctf_event *event)
+{
+        const struct bt_definition *scope;
+        struct packetContext *packet = cache->last;
+        struct traceMetadata meta;
+        uint64_t timestamp_begin;
+
+        scope = bt_ctf_get_top_level_scope(event, BT_STREAM_PACKET_CONTEXT);
+
+        if (G_UNLIKELY(packet == NULL || packet->scope != scope)) {
+                packet = g_hash_table_lookup(cache->streams, scope);
+        }
+
+        if (G_UNLIKELY(packet == NULL)) {
+                packet = g_new0(struct packetContext, 1);
+                packet->scope = scope;
+                packet->timestamp_begin_def = bt_ctf_get_field(event, scope,
+                    "timestamp_begin");
+                packet->timestamp_end_def = bt_ctf_get_field(event, scope,
+                    "timestamp_end");
+                packet->cpu_id_def = bt_ctf_get_field(event, scope,
+                    "cpu_id");
+                packet->events_discarded_def = bt_ctf_get_field(event,
+                    scope, "events_discarded");
+                packet->packet_size_def = bt_ctf_get_field(event, scope,
+                    "packet_size");
+                if (packet->timestamp_begin_def != NULL) {
+                        packet->timestamp_begin = bt_get_unsigned_int(
+                            packet->timestamp_begin_def);
+                }
+                read_packet(packet);
+                packet->new_packet = true;
+                packet->first_packet = true;
+                meta = getTraceMetadata(event);
+                packet->clock_offset = meta.clock_offset;
+                packet->id_size = meta.id_size;
+                if (G_UNLIKELY(cache->resume != NULL)) {
+                        resume_stream(cache->resume, packet);
+                }
+                g_hash_table_insert(cache->streams, (gpointer) scope, packet);
+                cache->last = packet;
+                return packet;
+        }
+        cache->last = packet;
+        packet->first_packet = false;
+
+        /* Without timestamp_begin every event is read as a new packet */
+        if (packet->timestamp_begin_def == NULL) {
+                read_packet(packet);
+                packet->new_packet = true;
+                return packet;
+        }
+
+        timestamp_begin = bt_get_unsigned_int(packet->timestamp_begin_def);
+        packet->new_packet = (timestamp_begin != packet->timestamp_begin);
+        if (packet->new_packet) {
+                packet->timestamp_begin = timestamp_begin;
+                read_packet(packet);
+        }
+
+        return packet;
+}
+
+/*
+ * Appends the state of every stream read so far to _states. _current has
+ * just started a packet whose lost events aren't printed yet.
+ */
+void
+getStreamStates(const struct packetCache *cache,
+    const struct packetContext *current, GArray *states)
+{
+        GHashTableIter iter;
+        gpointer key, value;
+        const struct packetContext *packet;
+        struct streamState state;
+
+        g_hash_table_iter_init(&iter, cache->streams);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+                packet = value;
+                state.cpu_id = packet->cpu_id;
+                state.timestamp_begin = packet->timestamp_begin;
+                state.events_discarded = packet->events_discarded;
+                state.used = false;
+                if (packet == current) {
+                        state.timestamp_begin = 0;
+                        state.events_discarded -= packet->lost_events;
+                }
+                g_array_append_val(states, state);
+        }
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
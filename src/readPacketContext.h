@@ -0,0 +1,81 @@
+#pragma once
+#ifndef READPACKETCONTEXT_H
+#define READPACKETCONTEXT_H
+
+#include <stdbool.h>
+#include <glib.h>
+#include <babeltrace/ctf/events.h>
+
+#include "types.h"
+
+/*
+ * Packet context of a stream. babeltrace allocates the packet context of a
+ * stream once and reads every new packet into it, so the definitions of its
+ * fields only have to be looked up by name the first time the stream is
+ * seen. Their values are read again only when timestamp_begin shows that
+ * the stream moved on to another packet.
+ *
+ * events_discarded is a running count for the stream, lost_events is how
+ * much it grew since the previous packet, the events lost between both.
+ */
+struct packetContext
+{
+        const struct bt_definition *scope;
+        const struct bt_definition *timestamp_begin_def;
+        const struct bt_definition *timestamp_end_def;
+        const struct bt_definition *cpu_id_def;
+        const struct bt_definition *events_discarded_def;
+        const struct bt_definition *packet_size_def;
+
+        uint64_t timestamp_begin;
+        uint64_t timestamp_end;
+        uint32_t cpu_id;
+        uint64_t events_discarded;
+        /* in bytes, 0 if the stream doesn't say */
+        uint64_t packet_size;
+        uint64_t lost_events;
+        bool new_packet;
+        /* first packet of the stream seen by this iterator */
+        bool first_packet;
+        /* of the trace of the stream, see readMetadata.h */
+        uint64_t clock_offset;
+        unsigned int id_size;
+};
+
+/*
+ * Where a stream was when a checkpoint was taken. timestamp_begin is 0 if
+ * the lost events of its packet weren't printed yet.
+ */
+struct streamState
+{
+        uint32_t cpu_id;
+        uint64_t timestamp_begin;
+        uint64_t events_discarded;
+        bool used;
+};
+
+/* Packet contexts of the streams read by one iterator */
+struct packetCache
+{
+        struct packetContext *last;
+        GHashTable *streams;
+        /* struct streamState of a resumed conversion, or NULL */
+        GArray *resume;
+};
+
+void initPacketCache(struct packetCache *_cache);
+
+void freePacketCache(struct packetCache *_cache);
+
+const struct packetContext *readPacketContext(struct packetCache *_cache,
+    const struct bt_ctf_event *_event);
+
+void getStreamStates(const struct packetCache *_cache,
+    const struct packetContext *_current, GArray *_states);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,149 @@
+/* Paraver ids of the threads and IRQs of the trace */
+
+#include <string.h>
+
+#include "registerIds.h"
+
+static void init_table(struct idTable *_t);
+
+static void insert_id(struct idTable *_t, uint32_t _key, uint32_t _id);
+
+static void free_table(struct idTable *_t);
+
+static void rename_id(struct prvRegistry *_reg, const char **_name,
+    const char *_new_name);
+
+static void
+init_table(struct idTable *t)
+{
+        t->direct = g_array_new(FALSE, TRUE, sizeof(uint32_t));
+        t->overflow = g_hash_table_new(g_direct_hash, g_direct_equal);
+}
+
+static void
+insert_id(struct idTable *t, uint32_t key, uint32_t id)
+{
+        if (key >= REGISTRY_DIRECT_MAX) {
+                g_hash_table_insert(t->overflow, GUINT_TO_POINTER(key),
+                    GUINT_TO_POINTER(id));
+                return;
+        }
+        if (key >= t->direct->len) {
+                g_array_set_size(t->direct, key + 1);
+        }
+        g_array_index(t->direct, uint32_t, key) = id;
+}
+
+static void
+free_table(struct idTable *t)
+{
+        g_array_free(t->direct, TRUE);
+        g_hash_table_destroy(t->overflow);
+}
+
+/* A thread renamed by exec, or seen again with the same name */
+static void
+rename_id(struct prvRegistry *reg, const char **name, const char *new_name)
+{
+        if (strcmp(*name, new_name) != 0) {
+                *name = g_string_chunk_insert_const(reg->names, new_name);
+        }
+}
+
+struct prvRegistry *
+createRegistry(void)
+{
+        struct prvRegistry *reg = g_new0(struct prvRegistry, 1);
+
+        reg->threads = g_array_new(FALSE, FALSE, sizeof(struct prvThread));
+        reg->irqs = g_array_new(FALSE, FALSE, sizeof(struct prvIrq));
+        init_table(&reg->tid_prv);
+        init_table(&reg->irq_prv);
+        reg->names = g_string_chunk_new(4096);
+
+        return reg;
+}
+
+/* Registers thread _tid as _name, returns its Paraver id */
+uint32_t
+addThread(struct prvRegistry *reg, uint32_t tid, const char *name)
+{
+        struct prvThread thread;
+        uint32_t id;
+
+        id = lookupThread(reg, tid);
+        if (id != 0) {
+                rename_id(reg, &g_array_index(reg->threads,
+                        struct prvThread, id - 1).name, name);
+                return id;
+        }
+
+        thread.tid = tid;
+        thread.name = g_string_chunk_insert_const(reg->names, name);
+        g_array_append_val(reg->threads, thread);
+        id = reg->threads->len;
+        insert_id(&reg->tid_prv, tid, id);
+
+        return id;
+}
+
+/* Registers IRQ _irq as _name, returns its Paraver id */
+uint32_t
+addIrq(struct prvRegistry *reg, uint32_t irq, const char *name)
+{
+        struct prvIrq entry;
+        uint32_t id;
+
+        id = lookupIrq(reg, irq);
+        if (id != 0) {
+                rename_id(reg, &g_array_index(reg->irqs,
+                        struct prvIrq, id - 1).name, name);
+                return id;
+        }
+
+        entry.irq = irq;
+        entry.name = g_string_chunk_insert_const(reg->names, name);
+        g_array_append_val(reg->irqs, entry);
+        id = reg->irqs->len;
+        insert_id(&reg->irq_prv, irq, id);
+
+        return id;
+}
+
+/*
+ * Number of ids in _t. The array spans up to the largest key, not the keys
+ * registered, so its empty slots are left out.
+ */
+unsigned int
+countIds(const struct idTable *t)
+{
+        unsigned int i, n;
+
+        n = g_hash_table_size(t->overflow);
+        for (i = 0; i < t->direct->len; i++) {
+                if (g_array_index(t->direct, uint32_t, i) != 0) {
+                        n++;
+                }
+        }
+
+        return n;
+}
+
+void
+destroyRegistry(struct prvRegistry *reg)
+{
+        if (reg == NULL) {
+                return;
+        }
+        g_array_free(reg->threads, TRUE);
+        g_array_free(reg->irqs, TRUE);
+        free_table(&reg->tid_prv);
+        free_table(&reg->irq_prv);
+        g_string_chunk_free(reg->names);
+        g_free(reg);
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,94 @@
+#pragma once
+#ifndef REGISTERIDS_H
+#define REGISTERIDS_H
+
+#include <stdint.h>
+#include <glib.h>
+
+#include "types.h"
+
+/*
+ * Keys below this are looked up in a plain array grown to the largest one
+ * seen, PID_MAX_LIMIT of 64-bit Linux. Larger ones go to a hash table.
+ */
+#define REGISTRY_DIRECT_MAX (1 << 22)
+
+/* Paraver ids by TID or IRQ number, 0 for none */
+struct idTable
+{
+        GArray *direct;
+        GHashTable *overflow;
+};
+
+struct prvThread
+{
+        uint32_t tid;
+        const char *name;
+};
+
+struct prvIrq
+{
+        uint32_t irq;
+        const char *name;
+};
+
+/*
+ * Threads and IRQs of the trace. Paraver ids are assigned in order of
+ * appearance and never change: the thread with id i + 1 is at index i of
+ * threads, and the same for irqs. A thread or IRQ registered again keeps
+ * its id and takes the new name. Names are interned.
+ */
+struct prvRegistry
+{
+        GArray *threads;
+        GArray *irqs;
+        struct idTable tid_prv;
+        struct idTable irq_prv;
+        GStringChunk *names;
+};
+
+struct prvRegistry *createRegistry(void);
+
+uint32_t addThread(struct prvRegistry *_reg, uint32_t _tid,
+    const char *_name);
+
+uint32_t addIrq(struct prvRegistry *_reg, uint32_t _irq, const char *_name);
+
+unsigned int countIds(const struct idTable *_t);
+
+void destroyRegistry(struct prvRegistry *_reg);
+
+static inline uint32_t
+lookupId(const struct idTable *t, uint32_t key)
+{
+        if (key < t->direct->len) {
+                return g_array_index(t->direct, uint32_t, key);
+        }
+        if (key >= REGISTRY_DIRECT_MAX) {
+                return GPOINTER_TO_UINT(g_hash_table_lookup(t->overflow,
+                    GUINT_TO_POINTER(key)));
+        }
+
+        return 0;
+}
+
+/* Paraver id of thread _tid, 0 if it isn't registered */
+static inline uint32_t
+lookupThread(const struct prvRegistry *reg, uint32_t tid)
+{
+        return lookupId(&reg->tid_prv, tid);
+}
+
+/* Paraver id of IRQ _irq, from 1, 0 if it isn't registered */
+static inline uint32_t
+lookupIrq(const struct prvRegistry *reg, uint32_t irq)
+{
+        return lookupId(&reg->irq_prv, irq);
+}
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
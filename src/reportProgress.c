@@ -0,0 +1,234 @@
+/* Progress line of the passes over the trace, for --progress */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "reportProgress.h"
+#include "streamFiles.h"
+#include "writeRecords.h"
+
+gint progress_tick;
+
+static struct
+{
+        bool enabled;
+        GThread *thread;
+        /* guards the rest, the thread prints holding it */
+        GMutex lock;
+        GCond cond;
+        bool stop;
+        /* current pass, NULL between passes */
+        const char *label;
+        uint64_t start;
+        /* trace clock span of the pass, end is 0 if unknown */
+        uint64_t begin;
+        uint64_t end;
+        /* totals published by the loops */
+        uint64_t events;
+        uint64_t bytes;
+        uint64_t first;
+        uint64_t timestamp;
+        /* size of the stream files */
+        uint64_t total_bytes;
+        int width;
+} progress;
+
+static gpointer progress_thread(gpointer _data);
+
+static void print_line(void);
+
+void
+initProgressCounter(struct progressCounter *c)
+{
+        memset(c, 0, sizeof(*c));
+        c->tick = g_atomic_int_get(&progress_tick);
+}
+
+/*
+ * Adds what the loop of _c read since the last call to the totals. A 0
+ * _timestamp, as when a pass ends, leaves the trace time as it was.
+ */
+void
+publishProgress(struct progressCounter *c, uint64_t timestamp)
+{
+        c->tick = g_atomic_int_get(&progress_tick);
+
+        g_mutex_lock(&progress.lock);
+        progress.events += c->events - c->published_events;
+        progress.bytes += c->bytes - c->published_bytes;
+        if (timestamp != 0) {
+                if (progress.first == 0 || timestamp < progress.first) {
+                        progress.first = timestamp;
+                }
+                if (timestamp > progress.timestamp) {
+                        progress.timestamp = timestamp;
+                }
+        }
+        g_mutex_unlock(&progress.lock);
+
+        c->published_events = c->events;
+        c->published_bytes = c->bytes;
+}
+
+/*
+ * Prints "label: trace time, bytes read, events/s, ETA" over the previous
+ * line. The ETA follows the trace time when the end of the pass is known,
+ * the bytes read otherwise.
+ */
+static void
+print_line(void)
+{
+        char line[256];
+        double elapsed, fraction = 0;
+        uint64_t begin, eta;
+        int len;
+
+        elapsed = (monotonicTime() - progress.start) / 1e9;
+        begin = progress.begin ? progress.begin : progress.first;
+        if (progress.timestamp < begin) {
+                begin = progress.timestamp;
+        }
+
+        len = snprintf(line, sizeof(line), "%s: %.1f", progress.label,
+            (progress.timestamp - begin) / 1e9);
+        if (progress.end > progress.begin) {
+                len += snprintf(line + len, sizeof(line) - len, "/%.1f",
+                    (progress.end - progress.begin) / 1e9);
+                fraction = (double) (progress.timestamp - begin) /
+                    (progress.end - progress.begin);
+        } else if (progress.total_bytes > 0) {
+                fraction = (double) progress.bytes / progress.total_bytes;
+        }
+        len += snprintf(line + len, sizeof(line) - len, " s, %.0f",
+            progress.bytes / 1048576.0);
+        if (progress.total_bytes > 0) {
+                len += snprintf(line + len, sizeof(line) - len, "/%.0f",
+                    progress.total_bytes / 1048576.0);
+        }
+        len += snprintf(line + len, sizeof(line) - len,
+            " MiB, %.2f M events/s, ETA ",
+            elapsed > 0 ? progress.events / elapsed / 1e6 : 0);
+        if (fraction > 0.001 && fraction <= 1) {
+                eta = elapsed * (1 - fraction) / fraction;
+                len += snprintf(line + len, sizeof(line) - len,
+                    "%u:%02u:%02u", (unsigned int) (eta / 3600),
+                    (unsigned int) (eta / 60 % 60), (unsigned int) (eta % 60));
+        } else {
+                len += snprintf(line + len, sizeof(line) - len, "-");
+        }
+
+        /* blanks over what is left of a longer previous line */
+        fprintf(stderr, "\r%s%*s", line,
+            progress.width > len ? progress.width - len : 0, "");
+        fflush(stderr);
+        progress.width = len;
+}
+
+static gpointer
+progress_thread(gpointer data)
+{
+        gint64 deadline;
+
+        UNUSED(data);
+
+        g_mutex_lock(&progress.lock);
+        while (!progress.stop) {
+                deadline = g_get_monotonic_time() + PROGRESS_INTERVAL;
+                while (!progress.stop && g_cond_wait_until(&progress.cond,
+                        &progress.lock, deadline)) {
+                        continue;
+                }
+                if (progress.stop) {
+                        break;
+                }
+                g_atomic_int_inc(&progress_tick);
+                if (progress.label != NULL) {
+                        print_line();
+                }
+        }
+        g_mutex_unlock(&progress.lock);
+
+        return NULL;
+}
+
+/*
+ * Starts the thread printing the progress of the passes over the trace in
+ * _trace_path, unless _mode is PROGRESS_AUTO and stderr isn't a terminal.
+ */
+void
+startProgressThread(int mode, const char *trace_path)
+{
+        GPtrArray *files;
+        unsigned int i;
+
+        if (mode == PROGRESS_NONE ||
+            (mode == PROGRESS_AUTO && !isatty(STDERR_FILENO))) {
+                return;
+        }
+
+        files = listStreamFiles(trace_path);
+        for (i = 0; i < files->len; i++) {
+                progress.total_bytes += ((struct streamFile *)
+                    g_ptr_array_index(files, i))->size;
+        }
+        g_ptr_array_free(files, TRUE);
+
+        progress.stop = false;
+        progress.enabled = true;
+        progress.thread = g_thread_new("lttng2prv-progress", progress_thread,
+            NULL);
+}
+
+/*
+ * Starts reporting a pass over the trace from _begin to _end, in trace
+ * clock time, 0 if unknown.
+ */
+void
+startProgress(const char *label, uint64_t begin, uint64_t end)
+{
+        g_mutex_lock(&progress.lock);
+        progress.label = label;
+        progress.start = monotonicTime();
+        progress.begin = begin;
+        progress.end = end;
+        progress.events = 0;
+        progress.bytes = 0;
+        progress.first = 0;
+        progress.timestamp = 0;
+        g_mutex_unlock(&progress.lock);
+}
+
+/* Prints the last line of the pass and leaves it on the terminal */
+void
+endProgress(void)
+{
+        g_mutex_lock(&progress.lock);
+        if (progress.enabled && progress.label != NULL) {
+                print_line();
+                fputc('\n', stderr);
+                progress.width = 0;
+        }
+        progress.label = NULL;
+        g_mutex_unlock(&progress.lock);
+}
+
+void
+stopProgressThread(void)
+{
+        if (!progress.enabled) {
+                return;
+        }
+        g_mutex_lock(&progress.lock);
+        progress.stop = true;
+        g_cond_signal(&progress.cond);
+        g_mutex_unlock(&progress.lock);
+        g_thread_join(progress.thread);
+        progress.thread = NULL;
+        progress.enabled = false;
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,75 @@
+#pragma once
+#ifndef REPORTPROGRESS_H
+#define REPORTPROGRESS_H
+
+#include <stdint.h>
+#include <glib.h>
+
+#include "types.h"
+#include "readPacketContext.h"
+
+enum
+{
+        PROGRESS_NONE = 0,
+        /* only when stderr is a terminal */
+        PROGRESS_AUTO,
+        PROGRESS_ALWAYS
+};
+
+/* Time between two progress lines, in us */
+#define PROGRESS_INTERVAL 250000
+
+/*
+ * What a loop over the events has read. It is only added to the totals
+ * printed when the progress thread has ticked since the last time, so the
+ * loops don't share any counter.
+ */
+struct progressCounter
+{
+        int tick;
+        uint64_t events;
+        uint64_t bytes;
+        /* already added to the totals */
+        uint64_t published_events;
+        uint64_t published_bytes;
+};
+
+/* Bumped by the progress thread on every line, read by the loops */
+extern gint progress_tick;
+
+void initProgressCounter(struct progressCounter *_c);
+
+void publishProgress(struct progressCounter *_c, uint64_t _timestamp);
+
+/*
+ * Counts an event at _timestamp, read from _packet. Called for every
+ * event, costs two additions and a load of a variable only written on each
+ * tick.
+ */
+static inline void
+countProgressAt(struct progressCounter *c, const struct packetContext *packet,
+    uint64_t timestamp)
+{
+        c->events++;
+        if (packet->new_packet) {
+                c->bytes += packet->packet_size;
+        }
+        if (G_UNLIKELY(c->tick != g_atomic_int_get(&progress_tick))) {
+                publishProgress(c, timestamp);
+        }
+}
+
+void startProgressThread(int _mode, const char *_trace_path);
+
+void startProgress(const char *_label, uint64_t _begin, uint64_t _end);
+
+void endProgress(void);
+
+void stopProgressThread(void);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
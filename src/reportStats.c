@@ -0,0 +1,329 @@
+/* Counters and timings reported by --stats */
+
+#define _DEFAULT_SOURCE
+
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "reportStats.h"
+#include "writeRecords.h"
+
+struct runStats run_stats;
+
+struct outputStats
+{
+        char *name;
+        /* -1 when the file isn't made of records */
+        int64_t records;
+        uint64_t bytes;
+        /* bytes on disk, after compression */
+        uint64_t stored_bytes;
+};
+
+struct tableStats
+{
+        char *name;
+        unsigned int size;
+};
+
+/* Named after the functions they time */
+static const char *const phase_names[PHASE_COUNT] =
+{
+        "metadata",
+        "bt_context_add_traces",
+        "getThreadInfo",
+        "iter_trace",
+        "listEvents"
+};
+
+/* Same names as in the .pcf, NULL for the unused slots */
+static const char *const type_names[STATS_NTYPES] =
+{
+        "System Call",
+        "Soft IRQ",
+        "IRQ Handler",
+        "Network Calls",
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+        "Others"
+};
+
+static uint64_t cpu_time(void);
+
+static void print_text(FILE *_fp, long _rss);
+
+static void print_json(FILE *_fp, long _rss);
+
+static void print_json_string(FILE *_fp, const char *_s);
+
+/* CPU time of all the threads of the process, in ns */
+static uint64_t
+cpu_time(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+        return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Phases can be started and ended several times, their times add up. Two
+ * clock reads each, so they are timed even without --stats.
+ */
+void
+startPhase(int phase)
+{
+        run_stats.phases[phase].wall_start = monotonicTime();
+        run_stats.phases[phase].cpu_start = cpu_time();
+}
+
+void
+endPhase(int phase)
+{
+        struct phaseStats *p = &run_stats.phases[phase];
+
+        p->wall_ns += monotonicTime() - p->wall_start;
+        p->cpu_ns += cpu_time() - p->cpu_start;
+}
+
+/* Adds the STATS_NTYPES event counts of a conversion job */
+void
+addEventCounts(const uint64_t *counts)
+{
+        unsigned int i;
+
+        g_mutex_lock(&run_stats.lock);
+        for (i = 0; i < STATS_NTYPES; i++) {
+                run_stats.events[i] += counts[i];
+        }
+        g_mutex_unlock(&run_stats.lock);
+}
+
+void
+statsOutput(const char *name, int64_t records, uint64_t bytes,
+    uint64_t stored_bytes)
+{
+        struct outputStats o;
+
+        if (run_stats.outputs == NULL) {
+                run_stats.outputs = g_array_new(FALSE, FALSE,
+                    sizeof(struct outputStats));
+        }
+        o.name = g_strdup(name);
+        o.records = records;
+        o.bytes = bytes;
+        o.stored_bytes = stored_bytes;
+        g_array_append_val(run_stats.outputs, o);
+}
+
+void
+statsTable(const char *name, unsigned int size)
+{
+        struct tableStats t;
+
+        if (run_stats.tables == NULL) {
+                run_stats.tables = g_array_new(FALSE, FALSE,
+                    sizeof(struct tableStats));
+        }
+        t.name = g_strdup(name);
+        t.size = size;
+        g_array_append_val(run_stats.tables, t);
+}
+
+void
+statsWrites(uint64_t bytes, uint64_t writes, uint64_t wait_ns)
+{
+        run_stats.write_bytes = bytes;
+        run_stats.writes = writes;
+        run_stats.wait_ns = wait_ns;
+}
+
+static void
+print_text(FILE *fp, long rss)
+{
+        struct outputStats *o;
+        struct tableStats *t;
+        unsigned int i;
+
+        fprintf(fp, "%-24s %12s %12s\n", "phase", "wall (s)", "cpu (s)");
+        for (i = 0; i < PHASE_COUNT; i++) {
+                fprintf(fp, "%-24s %12.3f %12.3f\n", phase_names[i],
+                    run_stats.phases[i].wall_ns / 1e9,
+                    run_stats.phases[i].cpu_ns / 1e9);
+        }
+
+        fprintf(fp, "\n%-24s %12s\n", "event type", "events");
+        for (i = 0; i < STATS_NTYPES; i++) {
+                if (type_names[i] != NULL || run_stats.events[i] > 0) {
+                        fprintf(fp, "%-24s %12" PRIu64 "\n",
+                            type_names[i] ? type_names[i] : "Unknown",
+                            run_stats.events[i]);
+                }
+        }
+
+        fprintf(fp, "\n%-24s %12s %12s %12s\n", "output", "records",
+            "bytes", "stored");
+        for (i = 0; run_stats.outputs != NULL && i < run_stats.outputs->len;
+            i++) {
+                o = &g_array_index(run_stats.outputs, struct outputStats, i);
+                if (o->records < 0) {
+                        fprintf(fp, "%-24s %12s", o->name, "-");
+                } else {
+                        fprintf(fp, "%-24s %12" PRId64, o->name, o->records);
+                }
+                fprintf(fp, " %12" PRIu64 " %12" PRIu64 "\n", o->bytes,
+                    o->stored_bytes);
+        }
+
+        fprintf(fp, "\n%-24s %12s %12s %12s\n", "writer", "bytes",
+            "writes", "wait (s)");
+        fprintf(fp, "%-24s %12" PRIu64 " %12" PRIu64 " %12.3f\n", "prv",
+            run_stats.write_bytes, run_stats.writes,
+            run_stats.wait_ns / 1e9);
+
+        fprintf(fp, "\n%-24s %12s\n", "table", "entries");
+        for (i = 0; run_stats.tables != NULL && i < run_stats.tables->len;
+            i++) {
+                t = &g_array_index(run_stats.tables, struct tableStats, i);
+                fprintf(fp, "%-24s %12u\n", t->name, t->size);
+        }
+
+        fprintf(fp, "\n%-24s %12ld\n", "peak rss (KB)", rss);
+}
+
+static void
+print_json_string(FILE *fp, const char *s)
+{
+        fputc('"', fp);
+        for (; *s != '\0'; s++) {
+                if (*s == '"' || *s == '\\') {
+                        fprintf(fp, "\\%c", *s);
+                } else if ((unsigned char) *s < 0x20) {
+                        fprintf(fp, "\\u%04x", *s);
+                } else {
+                        fputc(*s, fp);
+                }
+        }
+        fputc('"', fp);
+}
+
+static void
+print_json(FILE *fp, long rss)
+{
+        struct outputStats *o;
+        struct tableStats *t;
+        unsigned int i;
+        const char *sep;
+
+        fprintf(fp, "{\n  \"phases\": {");
+        for (i = 0; i < PHASE_COUNT; i++) {
+                fprintf(fp, "%s\n    \"%s\": { \"wall_s\": %.6f, "
+                    "\"cpu_s\": %.6f }", i ? "," : "", phase_names[i],
+                    run_stats.phases[i].wall_ns / 1e9,
+                    run_stats.phases[i].cpu_ns / 1e9);
+        }
+
+        fprintf(fp, "\n  },\n  \"events\": [");
+        sep = "";
+        for (i = 0; i < STATS_NTYPES; i++) {
+                if (type_names[i] == NULL && run_stats.events[i] == 0) {
+                        continue;
+                }
+                fprintf(fp, "%s\n    { \"event_type\": %u, \"name\": "
+                    "\"%s\", \"events\": %" PRIu64 " }", sep,
+                    STATS_TYPE_BASE + i * STATS_TYPE_STEP,
+                    type_names[i] ? type_names[i] : "Unknown",
+                    run_stats.events[i]);
+                sep = ",";
+        }
+
+        fprintf(fp, "\n  ],\n  \"outputs\": [");
+        for (i = 0; run_stats.outputs != NULL && i < run_stats.outputs->len;
+            i++) {
+                o = &g_array_index(run_stats.outputs, struct outputStats, i);
+                fprintf(fp, "%s\n    { \"file\": ", i ? "," : "");
+                print_json_string(fp, o->name);
+                fprintf(fp, ", \"records\": ");
+                if (o->records < 0) {
+                        fprintf(fp, "null");
+                } else {
+                        fprintf(fp, "%" PRId64, o->records);
+                }
+                fprintf(fp, ", \"bytes\": %" PRIu64 ", \"stored_bytes\": %"
+                    PRIu64 " }", o->bytes, o->stored_bytes);
+        }
+
+        fprintf(fp, "\n  ],\n  \"writer\": { \"bytes\": %" PRIu64 ", "
+            "\"writes\": %" PRIu64 ", \"wait_s\": %.6f },",
+            run_stats.write_bytes, run_stats.writes,
+            run_stats.wait_ns / 1e9);
+
+        fprintf(fp, "\n  \"tables\": {");
+        for (i = 0; run_stats.tables != NULL && i < run_stats.tables->len;
+            i++) {
+                t = &g_array_index(run_stats.tables, struct tableStats, i);
+                fprintf(fp, "%s\n    \"%s\": %u", i ? "," : "", t->name,
+                    t->size);
+        }
+
+        fprintf(fp, "\n  },\n  \"peak_rss_kb\": %ld\n}\n", rss);
+}
+
+/* Prints the report in the --stats format */
+void
+printStats(FILE *fp)
+{
+        struct rusage usage;
+        long rss = 0;
+
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+                rss = usage.ru_maxrss;
+        }
+
+        switch (run_stats.format) {
+        case STATS_TEXT:
+                print_text(fp, rss);
+                break;
+        case STATS_JSON:
+                print_json(fp, rss);
+                break;
+        default:
+                break;
+        }
+}
+
+void
+freeStats(void)
+{
+        unsigned int i;
+
+        for (i = 0; run_stats.outputs != NULL && i < run_stats.outputs->len;
+            i++) {
+                g_free(g_array_index(run_stats.outputs, struct outputStats,
+                    i).name);
+        }
+        for (i = 0; run_stats.tables != NULL && i < run_stats.tables->len;
+            i++) {
+                g_free(g_array_index(run_stats.tables, struct tableStats,
+                    i).name);
+        }
+        if (run_stats.outputs != NULL) {
+                g_array_free(run_stats.outputs, TRUE);
+        }
+        if (run_stats.tables != NULL) {
+                g_array_free(run_stats.tables, TRUE);
+        }
+        run_stats.outputs = NULL;
+        run_stats.tables = NULL;
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,92 @@
+#pragma once
+#ifndef REPORTSTATS_H
+#define REPORTSTATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <glib.h>
+
+enum
+{
+        STATS_NONE = 0,
+        STATS_TEXT,
+        STATS_JSON
+};
+
+/* Phases of the conversion timed by --stats */
+enum
+{
+        PHASE_METADATA = 0,
+        PHASE_DISCOVERY,
+        PHASE_THREAD_INFO,
+        PHASE_CONVERSION,
+        PHASE_LIST_EVENTS,
+        PHASE_COUNT
+};
+
+/*
+ * Events are counted by event_type, which are 10000000 plus a multiple of
+ * 100000, one slot per multiple. Anything above goes to the last slot.
+ */
+#define STATS_TYPE_BASE 10000000
+#define STATS_TYPE_STEP 100000
+#define STATS_NTYPES 10
+
+struct phaseStats
+{
+        uint64_t wall_ns;
+        uint64_t cpu_ns;
+        /* set while the phase runs */
+        uint64_t wall_start;
+        uint64_t cpu_start;
+};
+
+struct runStats
+{
+        int format;
+        struct phaseStats phases[PHASE_COUNT];
+        /* guards events, added to by every conversion job */
+        GMutex lock;
+        uint64_t events[STATS_NTYPES];
+        /* what the .prv writer handed to the output and waited for it */
+        uint64_t write_bytes;
+        uint64_t writes;
+        uint64_t wait_ns;
+        /* struct outputStats and struct tableStats, in report order */
+        GArray *outputs;
+        GArray *tables;
+};
+
+extern struct runStats run_stats;
+
+static inline unsigned int
+statsTypeIndex(uint64_t event_type)
+{
+        uint64_t i = (event_type - STATS_TYPE_BASE) / STATS_TYPE_STEP;
+
+        return i < STATS_NTYPES ? i : STATS_NTYPES - 1;
+}
+
+void startPhase(int _phase);
+
+void endPhase(int _phase);
+
+void addEventCounts(const uint64_t *_counts);
+
+void statsOutput(const char *_name, int64_t _records, uint64_t _bytes,
+    uint64_t _stored_bytes);
+
+void statsTable(const char *_name, unsigned int _size);
+
+void statsWrites(uint64_t _bytes, uint64_t _writes, uint64_t _wait_ns);
+
+void printStats(FILE *_fp);
+
+void freeStats(void);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
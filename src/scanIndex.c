@@ -0,0 +1,337 @@
+/* Discovery from the packet indexes and the statedump, for --index */
+
+#define _DEFAULT_SOURCE
+
+#include <endian.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <babeltrace/ctf/iterator.h>
+
+#include "scanIndex.h"
+#include "lttng2prv.h"
+#include "classifyEvents.h"
+#include "readMetadata.h"
+#include "readEvents.h"
+#include "mapTrace.h"
+#include "reportProgress.h"
+#include "spoolBody.h"
+#include "streamFiles.h"
+
+/* Header of an index file, big endian */
+struct indexHeader
+{
+        uint32_t magic;
+        uint32_t index_major;
+        uint32_t index_minor;
+        uint32_t packet_index_len;
+};
+
+/* Fields of index 1.0 entries, big endian. 1.1 adds more after them. */
+struct indexEntry
+{
+        uint64_t offset;
+        uint64_t packet_size;
+        uint64_t content_size;
+        uint64_t timestamp_begin;
+        uint64_t timestamp_end;
+        uint64_t events_discarded;
+        uint64_t stream_id;
+};
+
+struct traceIndex trace_index;
+
+static char *index_path(const struct streamFile *_file);
+
+static int read_index(const char *_path, uint64_t _clock_offset,
+    uint64_t *_first, uint64_t *_last);
+
+static bool has_statedump(GHashTable *_event_class_ht);
+
+static void read_statedump(struct bt_context *_bt_ctx, uint32_t *_ncpus,
+    struct prvRegistry *_reg, GHashTable *_event_class_ht);
+
+/*
+ * Returns the index file of a stream, next to the stream file itself and
+ * not to a link to it from a --cpus shadow trace, or NULL
+ */
+static char *
+index_path(const struct streamFile *file)
+{
+        char *stream, *real, *dir, *name, *path;
+
+        stream = g_build_filename(file->trace_dir, file->name, NULL);
+        real = realpath(stream, NULL);
+        g_free(stream);
+        if (real == NULL) {
+                return NULL;
+        }
+
+        dir = g_path_get_dirname(real);
+        name = g_strconcat(file->name, ".idx", NULL);
+        path = g_build_filename(dir, "index", name, NULL);
+        g_free(name);
+        g_free(dir);
+        free(real);
+
+        return path;
+}
+
+/*
+ * Widens [_first, _last] to the packets of the index in _path, in trace
+ * clock time. A packet still being written at the end is left out. The
+ * index holds raw clock values, so the clock must count nanoseconds.
+ */
+static int
+read_index(const char *path, uint64_t clock_offset, uint64_t *first,
+    uint64_t *last)
+{
+        struct indexHeader header;
+        struct indexEntry entry;
+        uint64_t begin, end;
+        size_t len;
+        FILE *fp;
+        int ret = -1;
+
+        if (!(fp = fopen(path, "r"))) {
+                return -1;
+        }
+        if (fread(&header, sizeof(header), 1, fp) != 1 ||
+            be32toh(header.magic) != CTF_INDEX_MAGIC) {
+                goto end;
+        }
+        len = be32toh(header.packet_index_len);
+        if (len < sizeof(entry)) {
+                goto end;
+        }
+
+        ret = 0;
+        while (fread(&entry, sizeof(entry), 1, fp) == 1) {
+                if (len > sizeof(entry) &&
+                    fseek(fp, len - sizeof(entry), SEEK_CUR) < 0) {
+                        ret = -1;
+                        break;
+                }
+                begin = be64toh(entry.timestamp_begin);
+                end = be64toh(entry.timestamp_end);
+                /* packets of streams without timestamps in their context */
+                if (end == 0 || end < begin) {
+                        continue;
+                }
+                begin += clock_offset;
+                end += clock_offset;
+                if (*first == 0 || begin < *first) {
+                        *first = begin;
+                }
+                if (end > *last) {
+                        *last = end;
+                }
+        }
+
+end:
+        fclose(fp);
+
+        return ret;
+}
+
+/* Whether the metadata has a statedump end to stop at */
+static bool
+has_statedump(GHashTable *event_class_ht)
+{
+        GHashTableIter iter;
+        gpointer value;
+
+        g_hash_table_iter_init(&iter, event_class_ht);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+                if (((const struct eventClass *) value)->flags &
+                    CLASS_STATEDUMP_END) {
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+/*
+ * Registers the threads of the statedump, and the threads and IRQs seen
+ * before it ends, decoding the beginning of the trace only
+ */
+static void
+read_statedump(struct bt_context *bt_ctx, uint32_t *ncpus,
+    struct prvRegistry *reg, GHashTable *event_class_ht)
+{
+        struct bt_iter_pos begin_pos;
+        struct bt_ctf_iter *iter = NULL;
+        struct eventSource src;
+        struct progressCounter progress;
+        /* laid out for every vector instead, see scanIndex.h */
+        uint32_t nsoftirqs = 0;
+
+        if (!native_decoder.enabled) {
+                begin_pos.type = BT_SEEK_BEGIN;
+                iter = bt_ctf_iter_create(bt_ctx, &begin_pos, NULL);
+        }
+        openEventSource(&src, iter, event_class_ht);
+        initProgressCounter(&progress);
+
+        while (readEvent(&src)) {
+                countProgressAt(&progress, src.packet, src.timestamp);
+                updateThreadInfo(&src, ncpus, reg, &nsoftirqs);
+
+                if (src.class->flags & CLASS_STATEDUMP_END) {
+                        debug("Statedump over, %u threads\n",
+                            reg->threads->len);
+                        break;
+                }
+                if (!nextEvent(&src)) {
+                        break;
+                }
+        }
+
+        closeEventSource(&src);
+        publishProgress(&progress, 0);
+}
+
+/*
+ * Finds _ncpus and the times of the trace in _path from the packet
+ * indexes and registers the threads of the statedump of _bt_ctx. Returns
+ * -1, having changed nothing, if a stream has no index, and the thread
+ * information has to come from getThreadInfo().
+ */
+int
+scanIndex(struct bt_context *bt_ctx, const char *path, uint32_t *ncpus,
+    struct prvRegistry *reg, GHashTable *event_class_ht)
+{
+        GPtrArray *files;
+        const struct streamFile *file;
+        struct traceMetadata meta = { 0, 32, 0 };
+        const char *meta_dir = NULL;
+        uint64_t first = 0, last = 0;
+        uint32_t max_cpu = 0;
+        char *idx;
+        unsigned int i;
+        int ret = 0;
+
+        files = listStreamFiles(path);
+        if (files->len == 0) {
+                ret = -1;
+        }
+        for (i = 0; i < files->len && ret == 0; i++) {
+                file = g_ptr_array_index(files, i);
+                /* the streams of a trace are listed together */
+                if (meta_dir == NULL || strcmp(meta_dir, file->trace_dir)) {
+                        meta_dir = file->trace_dir;
+                        if (readMetadata(meta_dir, &meta) < 0) {
+                                meta.clock_offset = 0;
+                                meta.clock_freq = 0;
+                        }
+                }
+                /* babeltrace's timestamps are in ns, the index's aren't */
+                if (meta.clock_freq != 0 && meta.clock_freq != 1000000000) {
+                        fprintf(stderr, "[warning] The clock of %s doesn't "
+                            "count nanoseconds, reading the whole trace for "
+                            "the thread information.\n", meta_dir);
+                        ret = -1;
+                        break;
+                }
+
+                idx = index_path(file);
+                if (idx == NULL || read_index(idx, meta.clock_offset, &first,
+                        &last) < 0) {
+                        fprintf(stderr, "[warning] No packet index for "
+                            "%s/%s, reading the whole trace for the thread "
+                            "information.\n", file->trace_dir, file->name);
+                        ret = -1;
+                }
+                g_free(idx);
+
+                if (file->cpu > 0 && (uint32_t) file->cpu > max_cpu) {
+                        max_cpu = file->cpu;
+                }
+        }
+        g_ptr_array_free(files, TRUE);
+        if (ret < 0) {
+                return -1;
+        }
+
+        *ncpus = MAX(*ncpus, max_cpu);
+        trace_times.first_stream_timestamp = first;
+        trace_times.last_stream_timestamp = last;
+        debug("Packet indexes: %u CPUs, from %" PRIu64 " to %" PRIu64 "\n",
+            *ncpus + 1, first, last);
+
+        if (has_statedump(event_class_ht)) {
+                read_statedump(bt_ctx, ncpus, reg, event_class_ht);
+        }
+        trace_index.enabled = true;
+
+        return 0;
+}
+
+/*
+ * Holds the body of the .prv back in an unlinked file next to the output,
+ * see trace_index
+ */
+int
+createIndexBody(const char *prefix)
+{
+        int fd;
+
+        fd = createSpoolFile(prefix);
+        if (fd < 0) {
+                return -1;
+        }
+        trace_index.body = createWriter(fd, write_buffer_size);
+        if (trace_index.body == NULL) {
+                close(fd);
+                return -1;
+        }
+
+        return 0;
+}
+
+/* Appends the body held back to _w, once the header is written */
+int
+copyIndexBody(struct prvWriter *w)
+{
+        struct prvWriter *body = trace_index.body;
+        ssize_t n;
+
+        if (flushWriter(body) < 0 || lseek(body->fd, 0, SEEK_SET) < 0) {
+                return -1;
+        }
+
+        /* its buffer is empty from now on */
+        while ((n = read(body->fd, body->buf, body->size)) != 0) {
+                if (n < 0) {
+                        if (errno == EINTR) {
+                                continue;
+                        }
+                        return -1;
+                }
+                writeBytes(w, body->buf, n);
+        }
+
+        return 0;
+}
+
+void
+freeIndex(void)
+{
+        int fd;
+
+        if (trace_index.body != NULL) {
+                fd = trace_index.body->fd;
+                destroyWriter(trace_index.body);
+                close(fd);
+        }
+        memset(&trace_index, 0, sizeof(trace_index));
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
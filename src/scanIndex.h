@@ -0,0 +1,53 @@
+#pragma once
+#ifndef SCANINDEX_H
+#define SCANINDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <glib.h>
+#include <babeltrace/ctf/events.h>
+
+#include "types.h"
+#include "registerIds.h"
+#include "writeRecords.h"
+
+/* Magic of an LTTng packet index file, index/<stream>.idx */
+#define CTF_INDEX_MAGIC 0xC1F1DCC1
+
+/* Largest softirq vector of Linux, NR_SOFTIRQS - 1 */
+#define INDEX_SOFTIRQS 9
+
+/*
+ * --index. The CPUs and the times of the trace come from the packet
+ * indexes LTTng writes next to the stream files, and the threads from the
+ * statedump, the only events decoded before the conversion. The threads
+ * and IRQs found later are registered by iter_trace() when they first
+ * show up, so the body is held in an unlinked file until the .prv header
+ * can count them. Softirq resources are laid out for every vector Linux
+ * has.
+ */
+struct traceIndex
+{
+        bool enabled;
+        /* the body of the .prv, until the header is written */
+        struct prvWriter *body;
+};
+
+extern struct traceIndex trace_index;
+
+int scanIndex(struct bt_context *_bt_ctx, const char *_path,
+    uint32_t *_ncpus, struct prvRegistry *_reg,
+    GHashTable *_event_class_ht);
+
+int createIndexBody(const char *_prefix);
+
+int copyIndexBody(struct prvWriter *_w);
+
+void freeIndex(void);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,356 @@
+/* Conversion of a time window of the trace */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "seekWindow.h"
+#include "lttng2prv.h"
+#include "classifyEvents.h"
+#include "readPacketContext.h"
+#include "filterEvents.h"
+#include "streamFiles.h"
+
+struct traceWindow trace_window;
+
+/* Thread found running on a CPU by the lookback */
+struct cpuThread
+{
+        int64_t tid;
+        char name[16];
+};
+
+static uint64_t first_event_timestamp(struct bt_context *_bt_ctx);
+
+static void scan_switches(struct bt_context *_bt_ctx, uint64_t _from,
+    uint64_t _to, GArray *_found, GHashTable *_event_class_ht);
+
+static uint32_t stream_cpus(const char *_path, uint32_t _ncpus,
+    GArray *_cpu_threads);
+
+/*
+ * Parses [@]<number>[ns|us|ms|s]. Times are nanoseconds since the first
+ * event of the trace, or trace clock time with a leading @.
+ */
+int
+parseTimeSpec(const char *arg, struct timeSpec *spec)
+{
+        char *end;
+        uint64_t mult = 1;
+
+        if (arg == NULL) {
+                return -1;
+        }
+        spec->absolute = (*arg == '@');
+        if (spec->absolute) {
+                arg++;
+        }
+        if (*arg < '0' || *arg > '9') {
+                return -1;
+        }
+        spec->ns = strtoull(arg, &end, 10);
+
+        if (strcmp(end, "") == 0 || strcmp(end, "ns") == 0) {
+                mult = 1;
+        } else if (strcmp(end, "us") == 0) {
+                mult = 1000;
+        } else if (strcmp(end, "ms") == 0) {
+                mult = 1000000;
+        } else if (strcmp(end, "s") == 0) {
+                mult = 1000000000;
+        } else {
+                return -1;
+        }
+        spec->ns *= mult;
+        spec->set = true;
+
+        return 0;
+}
+
+static uint64_t
+first_event_timestamp(struct bt_context *bt_ctx)
+{
+        struct bt_iter_pos begin_pos;
+        struct bt_ctf_iter *iter;
+        struct bt_ctf_event *event;
+        uint64_t timestamp = 0;
+
+        begin_pos.type = BT_SEEK_BEGIN;
+        iter = bt_ctf_iter_create(bt_ctx, &begin_pos, NULL);
+        if ((event = bt_ctf_iter_read_event(iter)) != NULL) {
+                timestamp = bt_ctf_get_timestamp(event);
+        }
+        bt_ctf_iter_destroy(iter);
+
+        return timestamp;
+}
+
+/*
+ * Turns --begin/--end into trace clock times. Only the first event is read
+ * to anchor relative times.
+ */
+int
+resolveWindow(struct bt_context *bt_ctx, const struct timeSpec *begin,
+    const struct timeSpec *end)
+{
+        uint64_t first;
+
+        trace_window.enabled = false;
+        trace_window.cpu_tids = NULL;
+        if (!begin->set && !end->set) {
+                return 0;
+        }
+
+        first = first_event_timestamp(bt_ctx);
+        trace_window.begin = first;
+        trace_window.end = UINT64_MAX;
+        if (begin->set) {
+                trace_window.begin = begin->absolute ? begin->ns :
+                    first + begin->ns;
+        }
+        if (end->set) {
+                trace_window.end = end->absolute ? end->ns : first + end->ns;
+        }
+        if (trace_window.end < trace_window.begin) {
+                fprintf(stderr, "[error] The window ends before it begins.\n");
+                return -1;
+        }
+        trace_window.enabled = true;
+        debug("Converting from %lu to %lu\n", trace_window.begin,
+            trace_window.end);
+
+        return 0;
+}
+
+/*
+ * Iterator over the window, or over the whole trace without one. With
+ * _from_start it starts at the beginning of the trace anyway, for the
+ * statedump, see skipToWindow().
+ */
+struct bt_ctf_iter *
+createWindowIter(struct bt_context *bt_ctx, bool from_start)
+{
+        struct bt_iter_pos begin_pos, end_pos;
+
+        begin_pos.type = BT_SEEK_BEGIN;
+        if (!trace_window.enabled) {
+                return bt_ctf_iter_create(bt_ctx, &begin_pos, NULL);
+        }
+
+        if (!from_start) {
+                begin_pos.type = BT_SEEK_TIME;
+                begin_pos.u.seek_time = trace_window.begin;
+        }
+        end_pos.type = BT_SEEK_TIME;
+        end_pos.u.seek_time = trace_window.end;
+
+        return bt_ctf_iter_create(bt_ctx, &begin_pos, &end_pos);
+}
+
+/*
+ * The thread names of the statedump are needed whatever the window, the
+ * rest of the trace before the window is not. Seeks _iter to the window
+ * once the statedump is over and returns true if it did.
+ */
+bool
+skipToWindow(struct bt_ctf_iter *iter, unsigned int class_flags,
+    uint64_t timestamp)
+{
+        struct bt_iter_pos pos;
+
+        if (!trace_window.enabled || !(class_flags & CLASS_STATEDUMP_END) ||
+            timestamp >= trace_window.begin) {
+                return false;
+        }
+
+        debug("Statedump over, seeking to the window\n");
+        pos.type = BT_SEEK_TIME;
+        pos.u.seek_time = trace_window.begin;
+
+        return bt_iter_set_pos(bt_ctf_get_iter(iter), &pos) == 0;
+}
+
+/*
+ * Records the last sched_switch of each CPU in [_from, _to) into _found,
+ * indexed by CPU. CPUs without one get a tid of -1.
+ */
+static void
+scan_switches(struct bt_context *bt_ctx, uint64_t from, uint64_t to,
+    GArray *found, GHashTable *event_class_ht)
+{
+        struct bt_iter_pos begin_pos, end_pos;
+        struct bt_ctf_iter *iter;
+        struct bt_ctf_event *event;
+        const struct bt_definition *scope;
+        const struct eventClass *class;
+        struct cpuThread none = { -1, "" };
+        struct eventClass scratch;
+        struct packetCache packets;
+        struct cpuThread *thread;
+        uint32_t cpu;
+
+        begin_pos.type = BT_SEEK_TIME;
+        begin_pos.u.seek_time = from;
+        end_pos.type = BT_SEEK_TIME;
+        end_pos.u.seek_time = to - 1;
+        iter = bt_ctf_iter_create(bt_ctx, &begin_pos, &end_pos);
+        initPacketCache(&packets);
+
+        while ((event = bt_ctf_iter_read_event(iter)) != NULL) {
+                if ((uint64_t) bt_ctf_get_timestamp(event) >= to) {
+                        break;
+                }
+                class = getEventClass(event_class_ht, event, &scratch);
+                if (class->flags & CLASS_SWITCH) {
+                        cpu = readPacketContext(&packets, event)->cpu_id;
+                        while (cpu >= found->len) {
+                                g_array_append_val(found, none);
+                        }
+                        thread = &g_array_index(found, struct cpuThread, cpu);
+                        scope = bt_ctf_get_top_level_scope(event,
+                            BT_EVENT_FIELDS);
+                        thread->tid = bt_get_signed_int(
+                            bt_ctf_get_field(event, scope, "_next_tid"));
+                        g_strlcpy(thread->name, bt_ctf_get_char_array(
+                                bt_ctf_get_field(event, scope, "_next_comm")),
+                            sizeof(thread->name));
+                }
+                if (bt_iter_next(bt_ctf_get_iter(iter)) < 0) {
+                        break;
+                }
+        }
+
+        freePacketCache(&packets);
+        bt_ctf_iter_destroy(iter);
+}
+
+/*
+ * Marks with a tid of -1 the CPUs up to _ncpus with a stream file under
+ * _path, those left out by --cpus excepted, and returns how many there
+ * are. The others have no events to switch on.
+ */
+static uint32_t
+stream_cpus(const char *path, uint32_t ncpus, GArray *cpu_threads)
+{
+        const struct streamFile *file;
+        struct cpuThread *thread;
+        GPtrArray *files;
+        uint32_t count = 0;
+        unsigned int i;
+
+        files = listStreamFiles(path);
+        for (i = 0; i < files->len; i++) {
+                file = g_ptr_array_index(files, i);
+                if (file->cpu < 0 || (uint32_t) file->cpu > ncpus ||
+                    file->size == 0 || !keepStream(file, NULL)) {
+                        continue;
+                }
+                thread = &g_array_index(cpu_threads, struct cpuThread,
+                    file->cpu);
+                if (thread->tid != -1) {
+                        thread->tid = -1;
+                        count++;
+                }
+        }
+        g_ptr_array_free(files, TRUE);
+
+        return count;
+}
+
+/*
+ * Finds the thread running on each CPU when the window begins, from the
+ * last sched_switch before it. The trace at _path is read backwards in
+ * growing steps until every CPU with a stream is known or the trace
+ * begins, so the cost depends on how long CPUs go without switching, not
+ * on where the window is. The threads found are registered.
+ */
+void
+bootstrapWindow(struct bt_context *bt_ctx, const char *path, uint32_t ncpus,
+    struct prvRegistry *reg, GHashTable *event_class_ht)
+{
+        /* -2 for CPUs without a stream, see stream_cpus() */
+        struct cpuThread none = { -2, "" };
+        struct cpuThread *thread;
+        GArray *cpu_threads, *found;
+        uint64_t first, from, to, lookback = WINDOW_LOOKBACK;
+        uint32_t cpu, missing;
+
+        if (!trace_window.enabled) {
+                return;
+        }
+
+        cpu_threads = g_array_new(FALSE, FALSE, sizeof(struct cpuThread));
+        found = g_array_new(FALSE, FALSE, sizeof(struct cpuThread));
+        for (cpu = 0; cpu <= ncpus; cpu++) {
+                g_array_append_val(cpu_threads, none);
+        }
+
+        first = first_event_timestamp(bt_ctx);
+        to = trace_window.begin;
+        missing = stream_cpus(path, ncpus, cpu_threads);
+        while (missing > 0 && to > first) {
+                from = (to - first > lookback) ? to - lookback : first;
+                debug("Looking for running threads from %lu\n", from);
+
+                g_array_set_size(found, 0);
+                scan_switches(bt_ctx, from, to, found, event_class_ht);
+                for (cpu = 0; cpu < found->len && cpu <= ncpus; cpu++) {
+                        thread = &g_array_index(cpu_threads,
+                            struct cpuThread, cpu);
+                        /* only switches after the ones already found */
+                        if (thread->tid == -1 && g_array_index(found,
+                                struct cpuThread, cpu).tid >= 0) {
+                                *thread = g_array_index(found,
+                                    struct cpuThread, cpu);
+                                missing--;
+                        }
+                }
+
+                to = from;
+                lookback *= 4;
+        }
+
+        trace_window.cpu_tids = g_array_new(FALSE, FALSE, sizeof(int64_t));
+        for (cpu = 0; cpu <= ncpus; cpu++) {
+                thread = &g_array_index(cpu_threads, struct cpuThread, cpu);
+                if (thread->tid >= 0) {
+                        registerThread(thread->tid, thread->name, reg);
+                }
+                g_array_append_val(trace_window.cpu_tids, thread->tid);
+        }
+
+        g_array_free(found, TRUE);
+        g_array_free(cpu_threads, TRUE);
+}
+
+/* Narrows the times of the trace to the window */
+void
+clipTraceTimes(void)
+{
+        if (!trace_window.enabled) {
+                return;
+        }
+
+        trace_times.first_stream_timestamp = MAX(
+            trace_times.first_stream_timestamp, trace_window.begin);
+        trace_times.last_stream_timestamp = MIN(
+            trace_times.last_stream_timestamp, trace_window.end);
+        if (trace_times.last_stream_timestamp <
+            trace_times.first_stream_timestamp) {
+                trace_times.last_stream_timestamp =
+                    trace_times.first_stream_timestamp;
+        }
+}
+
+void
+freeWindow(void)
+{
+        if (trace_window.cpu_tids != NULL) {
+                g_array_free(trace_window.cpu_tids, TRUE);
+                trace_window.cpu_tids = NULL;
+        }
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
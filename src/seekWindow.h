@@ -0,0 +1,64 @@
+#pragma once
+#ifndef SEEKWINDOW_H
+#define SEEKWINDOW_H
+
+#include <stdbool.h>
+#include <glib.h>
+#include <babeltrace/ctf/events.h>
+#include <babeltrace/ctf/iterator.h>
+
+#include "registerIds.h"
+
+#include "types.h"
+
+/* First lookback when searching the state of the CPUs at the window begin */
+#define WINDOW_LOOKBACK 10000000
+
+/* A --begin or --end argument */
+struct timeSpec
+{
+        bool set;
+        /* trace clock time instead of time since the first event */
+        bool absolute;
+        uint64_t ns;
+};
+
+/*
+ * Part of the trace converted, in trace clock time and inclusive. Only
+ * read once conversion starts, so parallel iterators can share it.
+ */
+struct traceWindow
+{
+        bool enabled;
+        uint64_t begin;
+        uint64_t end;
+        /* system TID running on each CPU at begin, -1 if unknown */
+        GArray *cpu_tids;
+};
+
+extern struct traceWindow trace_window;
+
+int parseTimeSpec(const char *_arg, struct timeSpec *_spec);
+
+int resolveWindow(struct bt_context *_bt_ctx, const struct timeSpec *_begin,
+    const struct timeSpec *_end);
+
+struct bt_ctf_iter *createWindowIter(struct bt_context *_bt_ctx,
+    bool _from_start);
+
+bool skipToWindow(struct bt_ctf_iter *_iter, unsigned int _class_flags,
+    uint64_t _timestamp);
+
+void bootstrapWindow(struct bt_context *_bt_ctx, const char *_path,
+    uint32_t _ncpus, struct prvRegistry *_reg, GHashTable *_event_class_ht);
+
+void clipTraceTimes(void);
+
+void freeWindow(void);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,348 @@
+/* Sort of the .prv records by time within a memory budget */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "sortRecords.h"
+#include "spoolBody.h"
+
+/* A record of the run in memory */
+struct sortLine
+{
+        uint64_t key;
+        size_t offset;
+        size_t len;
+};
+
+struct recordSorter
+{
+        size_t budget;
+        char *prefix;
+        /* records of the current run, the last one may be incomplete */
+        char *data;
+        size_t size;
+        size_t len;
+        /* start of the first record not indexed yet */
+        size_t pending;
+        GArray *lines;
+        /* descriptors of the spilled runs, in the order they were written */
+        GArray *runs;
+        uint64_t spilled;
+};
+
+static uint64_t record_key(const char *_line);
+
+static gint compare_lines(gconstpointer _a, gconstpointer _b);
+
+static void append_data(struct recordSorter *_s, const char *_buf,
+    size_t _len);
+
+static void index_lines(struct recordSorter *_s);
+
+static void write_merged(const char *_line, size_t _len, gpointer _data);
+
+static int merge_runs(struct recordSorter *_s, struct prvWriter *_out);
+
+static int spill_run(struct recordSorter *_s);
+
+/*
+ * The time of a record, its sixth field, the begin time of a state. Lines
+ * without one go first.
+ */
+static uint64_t
+record_key(const char *line)
+{
+        uint64_t key = 0;
+        unsigned int fields = 0;
+
+        while (fields < 5 && *line != '\n' && *line != '\0') {
+                if (*line++ == ':') {
+                        fields++;
+                }
+        }
+        while (*line >= '0' && *line <= '9') {
+                key = key * 10 + (*line++ - '0');
+        }
+
+        return key;
+}
+
+/* Records of a run are told apart by where they were written */
+static gint
+compare_lines(gconstpointer a, gconstpointer b)
+{
+        const struct sortLine *la = a;
+        const struct sortLine *lb = b;
+
+        if (la->key != lb->key) {
+                return la->key < lb->key ? -1 : 1;
+        }
+
+        return (la->offset > lb->offset) - (la->offset < lb->offset);
+}
+
+static void
+append_data(struct recordSorter *s, const char *buf, size_t len)
+{
+        size_t size;
+
+        if (s->size - s->len < len) {
+                size = MAX(s->len + len, MIN(MAX(2 * s->size, SORT_MIN_READ),
+                    s->budget));
+                s->data = g_realloc(s->data, size);
+                s->size = size;
+        }
+        memcpy(s->data + s->len, buf, len);
+        s->len += len;
+}
+
+/* Indexes the records completed by the last buffer */
+static void
+index_lines(struct recordSorter *s)
+{
+        struct sortLine line;
+        const char *p, *end;
+
+        end = s->data + s->len;
+        p = s->data + s->pending;
+        while ((p = memchr(p, '\n', end - p)) != NULL) {
+                p++;
+                line.offset = s->pending;
+                line.len = p - s->data - s->pending;
+                line.key = record_key(s->data + s->pending);
+                g_array_append_val(s->lines, line);
+                s->pending += line.len;
+        }
+}
+
+static void
+write_merged(const char *line, size_t len, gpointer data)
+{
+        writeBytes(data, line, len);
+}
+
+/* Merges the spilled runs into _out, leaving none */
+static int
+merge_runs(struct recordSorter *s, struct prvWriter *out)
+{
+        FILE **in;
+        unsigned int n = s->runs->len, i;
+        size_t read_size;
+        int fd, ret = 0;
+
+        read_size = CLAMP(s->budget / n, SORT_MIN_READ, SORT_MAX_READ);
+        in = g_new0(FILE *, n);
+        for (i = 0; i < n; i++) {
+                fd = g_array_index(s->runs, int, i);
+                if (lseek(fd, 0, SEEK_SET) < 0 ||
+                    !(in[i] = fdopen(fd, "r"))) {
+                        perror("sort run");
+                        close(fd);
+                        ret = -1;
+                        continue;
+                }
+                setvbuf(in[i], NULL, _IOFBF, read_size);
+        }
+        g_array_set_size(s->runs, 0);
+
+        if (ret == 0 &&
+            mergeLines(in, n, record_key, write_merged, out) < 0) {
+                ret = -1;
+        }
+
+        for (i = 0; i < n; i++) {
+                if (in[i]) {
+                        fclose(in[i]);
+                }
+        }
+        g_free(in);
+
+        return ret;
+}
+
+/*
+ * Sorts the complete records in memory and writes them out as a run,
+ * keeping the incomplete one for the next run. Too many runs are merged
+ * into one.
+ */
+static int
+spill_run(struct recordSorter *s)
+{
+        struct prvWriter *run;
+        struct sortLine *line;
+        unsigned int i;
+        int fd, ret;
+
+        g_array_sort(s->lines, compare_lines);
+
+        fd = createSpoolFile(s->prefix);
+        if (fd < 0) {
+                return -1;
+        }
+        run = createWriter(fd, 0);
+        if (!run) {
+                close(fd);
+                return -1;
+        }
+        for (i = 0; i < s->lines->len; i++) {
+                line = &g_array_index(s->lines, struct sortLine, i);
+                writeBytes(run, s->data + line->offset, line->len);
+        }
+        s->spilled += run->bytes + run->len;
+        if (destroyWriter(run) < 0) {
+                close(fd);
+                return -1;
+        }
+        g_array_append_val(s->runs, fd);
+        debug("Spilled sort run %u, %u records\n", s->runs->len,
+            s->lines->len);
+
+        memmove(s->data, s->data + s->pending, s->len - s->pending);
+        s->len -= s->pending;
+        s->pending = 0;
+        g_array_set_size(s->lines, 0);
+
+        if (s->runs->len < SORT_MAX_RUNS) {
+                return 0;
+        }
+
+        fd = createSpoolFile(s->prefix);
+        if (fd < 0) {
+                return -1;
+        }
+        run = createWriter(fd, 0);
+        if (!run) {
+                close(fd);
+                return -1;
+        }
+        ret = merge_runs(s, run);
+        if (destroyWriter(run) < 0 || ret < 0) {
+                close(fd);
+                return -1;
+        }
+        g_array_append_val(s->runs, fd);
+
+        return 0;
+}
+
+/*
+ * Sorts everything written to _w from now on, within about _budget bytes
+ * of memory plus a writer buffer. Runs are spilled next to _prefix.
+ */
+int
+startSort(struct prvWriter *w, size_t budget, const char *prefix)
+{
+        struct recordSorter *s;
+
+        /* the header is not sorted */
+        if (flushWriter(w) < 0) {
+                return -1;
+        }
+
+        s = g_new0(struct recordSorter, 1);
+        s->budget = budget;
+        s->prefix = g_strdup(prefix);
+        s->lines = g_array_new(FALSE, FALSE, sizeof(struct sortLine));
+        s->runs = g_array_new(FALSE, FALSE, sizeof(int));
+        w->sort = s;
+
+        return 0;
+}
+
+/* Takes the buffered records of _w into the run, in place of a write */
+int
+sortBuffer(struct prvWriter *w)
+{
+        struct recordSorter *s = w->sort;
+
+        if (w->len > 0 && !w->error) {
+                if (s->lines->len > 0 && s->len + w->len +
+                    s->lines->len * sizeof(struct sortLine) > s->budget &&
+                    spill_run(s) < 0) {
+                        fprintf(stderr, "[error] Couldn't spill the sorted "
+                            "records.\n");
+                        w->error = 1;
+                } else {
+                        append_data(s, w->buf, w->len);
+                        index_lines(s);
+                }
+        }
+        w->len = 0;
+
+        return w->error ? -1 : 0;
+}
+
+/*
+ * Writes the sorted records out through _w, which then goes on as a plain
+ * writer.
+ */
+int
+finishSort(struct prvWriter *w)
+{
+        struct recordSorter *s = w->sort;
+        struct sortLine *line;
+        unsigned int i;
+        int ret = 0;
+
+        if (s == NULL) {
+                return 0;
+        }
+        sortBuffer(w);
+        w->sort = NULL;
+        if (w->error) {
+                destroySorter(s);
+                return -1;
+        }
+
+        /* a body not ending in a new line */
+        if (s->pending < s->len) {
+                append_data(s, "\n", 1);
+                index_lines(s);
+        }
+
+        if (s->runs->len == 0) {
+                g_array_sort(s->lines, compare_lines);
+                for (i = 0; i < s->lines->len; i++) {
+                        line = &g_array_index(s->lines, struct sortLine, i);
+                        writeBytes(w, s->data + line->offset, line->len);
+                }
+        } else if (spill_run(s) < 0 || merge_runs(s, w) < 0) {
+                fprintf(stderr, "[error] Couldn't merge the sorted "
+                    "records.\n");
+                ret = -1;
+        }
+        debug("Sorted the records, %lu bytes spilled\n", s->spilled);
+
+        destroySorter(s);
+
+        return ret;
+}
+
+void
+destroySorter(struct recordSorter *s)
+{
+        unsigned int i;
+
+        if (s == NULL) {
+                return;
+        }
+        for (i = 0; i < s->runs->len; i++) {
+                close(g_array_index(s->runs, int, i));
+        }
+        g_array_free(s->runs, TRUE);
+        g_array_free(s->lines, TRUE);
+        g_free(s->data);
+        g_free(s->prefix);
+        g_free(s);
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,40 @@
+#pragma once
+#ifndef SORTRECORDS_H
+#define SORTRECORDS_H
+
+#include <stddef.h>
+
+#include "types.h"
+#include "writeRecords.h"
+
+/* Most runs merged at once, more are first merged into one */
+#define SORT_MAX_RUNS 256
+
+/* Bounds of the read buffer of each run in the final merge */
+#define SORT_MIN_READ (64 << 10)
+#define SORT_MAX_READ (4 << 20)
+
+/* Budget of the sort --state-records implies without --sort-mem */
+#define SORT_STATES_MEM ((size_t) 256 << 20)
+
+/*
+ * --sort-mem. Once started, the buffers a writer flushes are kept as a run
+ * of records instead of being written out. When a run reaches the memory
+ * budget it is sorted by time and spilled to an unlinked file next to the
+ * output, and closeWriter() merges the runs into the output. Records with
+ * the same time keep the order they were written in.
+ */
+int startSort(struct prvWriter *_w, size_t _budget, const char *_prefix);
+
+int sortBuffer(struct prvWriter *_w);
+
+int finishSort(struct prvWriter *_w);
+
+void destroySorter(struct recordSorter *_sort);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,191 @@
+/* Slices of the .prv for --split-by-time and --split-by-size */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "splitOutput.h"
+#include "lttng2prv.h"
+
+struct outputSplit output_split;
+
+static int patch_duration(struct prvWriter *_w, uint64_t _duration);
+
+static void link_slice(unsigned int _index, const char *_suffix);
+
+void
+initSplit(const char *prefix, uint64_t by_time, uint64_t by_size)
+{
+        output_split.enabled = true;
+        output_split.by_time = by_time;
+        output_split.by_size = by_size;
+        output_split.prefix = g_strdup(prefix);
+        output_split.index = 1;
+        output_split.begin = 0;
+        output_split.bytes = 0;
+        output_split.states = g_array_new(FALSE, TRUE,
+            sizeof(struct sliceState));
+}
+
+/* <output>.NNN<_suffix>, to be freed with g_free() */
+char *
+sliceName(unsigned int index, const char *suffix)
+{
+        return g_strdup_printf("%s.%03u%s", output_split.prefix, index,
+            suffix);
+}
+
+/* Rewrites the padded duration in the header of the current slice */
+static int
+patch_duration(struct prvWriter *w, uint64_t duration)
+{
+        char ftime[SLICE_FTIME_LEN + 1];
+
+        if (flushWriter(w) < 0) {
+                return -1;
+        }
+        snprintf(ftime, sizeof(ftime), "%0*" PRIu64, SLICE_FTIME_LEN,
+            duration);
+        if (pwrite(w->fd, ftime, SLICE_FTIME_LEN,
+                output_split.ftime_offset) != SLICE_FTIME_LEN) {
+                return -1;
+        }
+
+        return 0;
+}
+
+/*
+ * Ends the current slice before the event at _event_time, since the slice
+ * start, and begins the next one with its header and the thread states.
+ * A slice cut by time ends at the limit, a gap of several slice lengths
+ * without events doesn't make empty slices.
+ */
+int
+nextSlice(struct bt_context *ctx, struct prvWriter *w,
+    const struct prvRegistry *reg, int nresources, uint64_t event_time)
+{
+        struct sliceState *s;
+        uint64_t duration, advance;
+        unsigned int appl;
+        char *name;
+        int fd;
+
+        if (output_split.by_time != 0 && event_time >= output_split.by_time) {
+                duration = output_split.by_time;
+                advance = event_time - event_time % output_split.by_time;
+        } else {
+                duration = event_time;
+                advance = event_time;
+        }
+        if (patch_duration(w, duration) < 0) {
+                fprintf(stderr, "[error] Couldn't finish slice %u.\n",
+                    output_split.index);
+                return -1;
+        }
+
+        name = sliceName(output_split.index + 1, ".prv");
+        fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0 || dup2(fd, w->fd) < 0) {
+                fprintf(stderr, "[error] Couldn't open slice %s.\n", name);
+                if (fd >= 0) {
+                        close(fd);
+                }
+                g_free(name);
+                return -1;
+        }
+        close(fd);
+        debug("Slice %s from %" PRIu64 " ns\n", name,
+            output_split.begin + advance);
+        g_free(name);
+
+        output_split.index++;
+        output_split.begin += advance;
+        output_split.bytes = w->bytes;
+        printPRVHeader(ctx, w, reg, nresources);
+
+        for (appl = 0; appl < output_split.states->len; appl++) {
+                s = &g_array_index(output_split.states, struct sliceState,
+                    appl);
+                if (!s->set) {
+                        continue;
+                }
+                writeBytes(w, "2:", 2);
+                writeField(w, s->cpu_id + 1);
+                writeField(w, appl);
+                writeField(w, 1);
+                writeField(w, 1);
+                writeField(w, 0);
+                writeField(w, 20000000);
+                writeUint(w, s->state);
+                writeChar(w, '\n');
+        }
+
+        return 0;
+}
+
+/* Links <output>.NNN<_suffix> to the shared <output><_suffix> */
+static void
+link_slice(unsigned int index, const char *suffix)
+{
+        char *name, *target, *base;
+
+        name = sliceName(index, suffix);
+        target = g_strconcat(output_split.prefix, suffix, NULL);
+        base = g_path_get_basename(target);
+        unlink(name);
+        if (symlink(base, name) < 0) {
+                fprintf(stderr, "[warning] Couldn't link %s to %s: %s\n",
+                    name, base, strerror(errno));
+        }
+        g_free(base);
+        g_free(target);
+        g_free(name);
+}
+
+/*
+ * Ends the last slice at the end of the trace and gives every slice the
+ * .pcf and .row of the whole trace
+ */
+int
+finishSplit(struct prvWriter *w)
+{
+        unsigned int i;
+        uint64_t end;
+
+        end = trace_times.last_stream_timestamp -
+            trace_times.first_stream_timestamp;
+        if (patch_duration(w, end > output_split.begin ?
+                end - output_split.begin : 0) < 0) {
+                fprintf(stderr, "[error] Couldn't finish slice %u.\n",
+                    output_split.index);
+                return -1;
+        }
+
+        for (i = 1; i <= output_split.index; i++) {
+                link_slice(i, ".pcf");
+                link_slice(i, ".row");
+        }
+
+        return 0;
+}
+
+void
+freeSplit(void)
+{
+        g_free(output_split.prefix);
+        if (output_split.states != NULL) {
+                g_array_free(output_split.states, TRUE);
+        }
+        memset(&output_split, 0, sizeof(output_split));
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,94 @@
+#pragma once
+#ifndef SPLITOUTPUT_H
+#define SPLITOUTPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <glib.h>
+#include <babeltrace/ctf/events.h>
+
+#include "types.h"
+#include "writeRecords.h"
+#include "registerIds.h"
+
+/* Digits of the padded duration in the header of a slice */
+#define SLICE_FTIME_LEN 20
+
+/*
+ * --split-by-time and --split-by-size. The .prv is written as a series of
+ * self-contained slices <output>.NNN.prv, all through the same writer: at
+ * the first event past the limit the writer is flushed, its descriptor is
+ * moved to the next file and a new header is printed. Slice times start at
+ * 0, and each slice begins with the last state record of every thread.
+ * The duration in a header is only known once the slice ends, it is
+ * printed padded and rewritten in place.
+ */
+struct sliceState
+{
+        uint32_t cpu_id;
+        uint32_t state;
+        bool set;
+};
+
+struct outputSplit
+{
+        bool enabled;
+        /* trace time and .prv bytes of a slice, 0 for no limit */
+        uint64_t by_time;
+        uint64_t by_size;
+        char *prefix;
+        unsigned int index;
+        /* start of the slice in trace time since the first event */
+        uint64_t begin;
+        /* writer bytes before the slice */
+        uint64_t bytes;
+        /* where the duration is in the slice header */
+        uint64_t ftime_offset;
+        /* last state of each thread, indexed by its Paraver id */
+        GArray *states;
+};
+
+extern struct outputSplit output_split;
+
+void initSplit(const char *_prefix, uint64_t _by_time, uint64_t _by_size);
+
+char *sliceName(unsigned int _index, const char *_suffix);
+
+/* Whether the event at _event_time, since the slice start, begins a slice */
+static inline bool
+splitDue(const struct prvWriter *w, uint64_t event_time)
+{
+        return (output_split.by_time != 0 &&
+            event_time >= output_split.by_time) ||
+            (output_split.by_size != 0 &&
+            w->bytes + w->len - output_split.bytes >= output_split.by_size);
+}
+
+/* Keeps the state last printed for thread _appl, for the next slice */
+static inline void
+keepSliceState(uint64_t appl, uint32_t cpu_id, uint32_t state)
+{
+        struct sliceState *s;
+
+        if (appl >= output_split.states->len) {
+                g_array_set_size(output_split.states, appl + 1);
+        }
+        s = &g_array_index(output_split.states, struct sliceState, appl);
+        s->cpu_id = cpu_id;
+        s->state = state;
+        s->set = true;
+}
+
+int nextSlice(struct bt_context *_ctx, struct prvWriter *_w,
+    const struct prvRegistry *_reg, int _nresources, uint64_t _event_time);
+
+int finishSplit(struct prvWriter *_w);
+
+void freeSplit(void);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,671 @@
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "spoolBody.h"
+
+/*
+ * Creates an anonymous spool file next to the output, big traces do not
+ * fit in the usual tmpfs /tmp. Returns its descriptor, or -1.
+ */
+int
+createSpoolFile(const char *prefix)
+{
+        char *template;
+        int fd;
+
+        template = g_strdup_printf("%s.prv.XXXXXX", prefix);
+        fd = mkstemp(template);
+        if (fd < 0) {
+                perror("mkstemp");
+                g_free(template);
+                return -1;
+        }
+        unlink(template);
+        g_free(template);
+
+        return fd;
+}
+
+FILE *
+createSpool(const char *prefix)
+{
+        int fd;
+        FILE *spool;
+
+        fd = createSpoolFile(prefix);
+        if (fd < 0) {
+                return NULL;
+        }
+
+        spool = fdopen(fd, "w+");
+        if (!spool) {
+                perror("fdopen");
+                close(fd);
+        }
+
+        return spool;
+}
+
+void
+initSpoolResolver(struct spoolResolver *resolver,
+    const struct prvRegistry *reg, const uint32_t ncpus,
+    const uint32_t nsoftirqs)
+{
+        resolver->reg = reg;
+        resolver->ncpus = ncpus;
+        resolver->nsoftirqs = nsoftirqs;
+        resolver->last_appl = 0;
+}
+
+/*
+ * Returns the key of a spooled line, the trace time of the event that
+ * produced it.
+ */
+uint64_t
+spoolLineKey(const char *line)
+{
+        return strtoull(line + 1, NULL, 10);
+}
+
+/*
+ * Writes the final form of a spooled line to _w, replacing symbolic
+ * resources and applications by their Paraver values. Lines must be fed in
+ * trace order.
+ */
+void
+resolveSpoolLine(struct spoolResolver *resolver, const char *line,
+    struct prvWriter *w)
+{
+        char *p;
+        char type, res_kind, appl_kind;
+        uint64_t res_idx, appl_cpu, appl;
+        uint32_t resource;
+        const uint32_t ncpus = resolver->ncpus;
+
+        type = line[0];
+        /* skip the key */
+        p = strchr(line, ':') + 1;
+
+        if (type == SPOOL_SWITCH || type == SPOOL_OVERRIDE) {
+                appl_cpu = strtoull(p, &p, 10);
+                appl = strtoull(p + 1, NULL, 10);
+                if (type == SPOOL_SWITCH) {
+                        if (appl_cpu == ncpus - 1) {
+                                resolver->last_appl = appl;
+                        }
+                } else if (appl_cpu != ncpus - 1) {
+                        resolver->last_appl = appl;
+                }
+                return;
+        }
+
+        res_kind = *p++;
+        res_idx = strtoull(p, &p, 10);
+        appl_kind = *++p;
+        appl_cpu = strtoull(p + 1, &p, 10);
+        if (appl_kind == 'a') {
+                appl = strtoull(p + 1, &p, 10);
+                if (appl_cpu == ncpus - 1) {
+                        appl = resolver->last_appl;
+                }
+        } else {
+                appl = lookupThread(resolver->reg, appl_cpu);
+        }
+        p++;
+
+        if (type == SPOOL_RECORD_NONZERO && appl == 0) {
+                return;
+        }
+
+        if (res_kind == SPOOL_RES_SOFTIRQ) {
+                resource = ncpus - 1 + res_idx;
+        } else if (res_kind == SPOOL_RES_IRQ) {
+                resource = ncpus + resolver->nsoftirqs +
+                    lookupIrq(resolver->reg, res_idx) - 1;
+        } else {
+                resource = res_idx;
+        }
+
+        writeBytes(w, "2:", 2);
+        writeField(w, resource + 1);
+        writeField(w, appl);
+        writeString(w, p);
+}
+
+/* Next line of each file being merged */
+struct spoolHead
+{
+        char *line;
+        size_t len;
+        ssize_t n;
+        uint64_t key;
+};
+
+/* Where mergeSpools() resolves the merged lines */
+struct spoolMerge
+{
+        struct spoolResolver *resolver;
+        struct prvWriter *w;
+};
+
+static int head_before(struct spoolHead *_heads, unsigned int _a,
+    unsigned int _b);
+
+static void sift_down(struct spoolHead *_heads, unsigned int *_heap,
+    unsigned int _size);
+
+static void resolve_merged(const char *_line, size_t _len, gpointer _data);
+
+static struct spoolStream *create_stream(int _fd);
+
+static void account_stream(struct streamSpool *_spool);
+
+static int read_chunk(struct spoolStream *_st, const struct spoolChunk *_c);
+
+static const char *read_stream_line(struct spoolStream *_st);
+
+static bool next_stream_event(struct spoolStream *_st);
+
+static void stream_heapify(struct spoolStream **_heap, unsigned int _len);
+
+/*
+ * Orders files by the key of their next line. Ties go to the lower index,
+ * lines of a single spool keep their order.
+ */
+static int
+head_before(struct spoolHead *heads, unsigned int a, unsigned int b)
+{
+        return heads[a].key < heads[b].key ||
+            (heads[a].key == heads[b].key && a < b);
+}
+
+static void
+sift_down(struct spoolHead *heads, unsigned int *heap, unsigned int size)
+{
+        unsigned int pos = 0, child, tmp;
+
+        while ((child = 2 * pos + 1) < size) {
+                if (child + 1 < size &&
+                    head_before(heads, heap[child + 1], heap[child])) {
+                        child++;
+                }
+                if (!head_before(heads, heap[child], heap[pos])) {
+                        break;
+                }
+                tmp = heap[pos];
+                heap[pos] = heap[child];
+                heap[child] = tmp;
+                pos = child;
+        }
+}
+
+/*
+ * k-way merge of the lines of _n files, each one sorted by _key, handing
+ * them in order to _output. Ties go to the file listed first.
+ */
+int
+mergeLines(FILE **in, unsigned int n, uint64_t (*key)(const char *),
+    void (*output)(const char *, size_t, gpointer), gpointer data)
+{
+        struct spoolHead *heads = g_new0(struct spoolHead, n);
+        unsigned int *heap = g_new(unsigned int, n);
+        unsigned int size = 0;
+        unsigned int i, j;
+        int ret = 0;
+
+        for (i = 0; i < n; i++) {
+                heads[i].n = getline(&heads[i].line, &heads[i].len, in[i]);
+                if (heads[i].n != -1) {
+                        heads[i].key = key(heads[i].line);
+                        /* sift up */
+                        j = size++;
+                        heap[j] = i;
+                        while (j > 0 &&
+                            head_before(heads, heap[j], heap[(j - 1) / 2])) {
+                                heap[j] = heap[(j - 1) / 2];
+                                heap[(j - 1) / 2] = i;
+                                j = (j - 1) / 2;
+                        }
+                }
+        }
+
+        while (size > 0) {
+                i = heap[0];
+                output(heads[i].line, heads[i].n, data);
+                heads[i].n = getline(&heads[i].line, &heads[i].len, in[i]);
+                if (heads[i].n != -1) {
+                        heads[i].key = key(heads[i].line);
+                } else {
+                        heap[0] = heap[--size];
+                }
+                sift_down(heads, heap, size);
+        }
+
+        for (i = 0; i < n; i++) {
+                if (ferror(in[i])) {
+                        ret = -1;
+                }
+                free(heads[i].line);
+        }
+        g_free(heads);
+        g_free(heap);
+
+        return ret;
+}
+
+static void
+resolve_merged(const char *line, size_t len, gpointer data)
+{
+        struct spoolMerge *merge = data;
+
+        UNUSED(len);
+
+        resolveSpoolLine(merge->resolver, line, merge->w);
+}
+
+/*
+ * k-way merge of _n spools, each one in trace order, into _w with their
+ * final Paraver values.
+ */
+int
+mergeSpools(FILE **spools, unsigned int n, struct prvWriter *w,
+    struct spoolResolver *resolver)
+{
+        struct spoolMerge merge = { resolver, w };
+
+        return mergeLines(spools, n, spoolLineKey, resolve_merged, &merge);
+}
+
+/*
+ * Copies the spooled body into _w with its final Paraver values. _ncpus
+ * already counts from 1.
+ */
+int
+resolveSpool(FILE *spool, struct prvWriter *w,
+    const struct prvRegistry *reg, const uint32_t ncpus,
+    const uint32_t nsoftirqs)
+{
+        struct spoolResolver resolver;
+
+        initSpoolResolver(&resolver, reg, ncpus, nsoftirqs);
+
+        fflush(spool);
+        rewind(spool);
+
+        return mergeSpools(&spool, 1, w, &resolver);
+}
+
+/*
+ * Key of a stream of the trace in _trace_dir, a directory under _root,
+ * with the stream class and CPU read from its packets. The jobs read
+ * shadows of the trace, so the key only takes the part of the path below
+ * _root. To be freed with g_free().
+ */
+char *
+spoolStreamKey(const char *trace_dir, const char *root, uint64_t stream_id,
+    uint32_t cpu_id)
+{
+        const char *rel = trace_dir + MIN(strlen(root), strlen(trace_dir));
+
+        while (*rel == '/') {
+                rel++;
+        }
+
+        return g_strdup_printf("%s:%" PRIu64 ":%u", rel, stream_id, cpu_id);
+}
+
+static struct spoolStream *
+create_stream(int fd)
+{
+        struct spoolStream *st = g_new0(struct spoolStream, 1);
+
+        st->w = createWriter(fd, SPOOL_STREAM_BUFFER);
+        st->chunks = g_array_new(FALSE, FALSE, sizeof(struct spoolChunk));
+        st->fd = fd;
+
+        return st;
+}
+
+/*
+ * Creates the spool of a job that reads the shadow trace _root, with the
+ * rank of each of the _nstreams streams of the whole trace in _ranks.
+ * Returns NULL if the spool file can't be created.
+ */
+struct streamSpool *
+createStreamSpool(const char *prefix, unsigned int nstreams,
+    GHashTable *ranks, const char *root)
+{
+        struct streamSpool *spool;
+        int fd;
+
+        fd = createSpoolFile(prefix);
+        if (fd < 0) {
+                return NULL;
+        }
+
+        spool = g_new0(struct streamSpool, 1);
+        spool->fd = fd;
+        spool->nstreams = nstreams;
+        spool->streams = g_new0(struct spoolStream *, nstreams + 1);
+        spool->ranks = ranks;
+        spool->root = root;
+        spool->streams[nstreams] = create_stream(fd);
+        spool->current = spool->streams[nstreams];
+        if (spool->current->w == NULL) {
+                freeStreamSpool(spool);
+                return NULL;
+        }
+
+        return spool;
+}
+
+/*
+ * Returns the rank of a stream of the job, -1 if the trace didn't have
+ * it when the ranks were worked out.
+ */
+int
+spoolStreamRank(const struct streamSpool *spool, const char *trace_dir,
+    uint64_t stream_id, uint32_t cpu_id)
+{
+        char *key = spoolStreamKey(trace_dir, spool->root, stream_id,
+            cpu_id);
+        gpointer rank = g_hash_table_lookup(spool->ranks, key);
+
+        g_free(key);
+
+        return GPOINTER_TO_INT(rank) - 1;
+}
+
+/*
+ * The writers of the streams share the spool file, each flush goes to its
+ * end. Only the current stream writes, so what it flushed since it became
+ * current is the next chunk.
+ */
+static void
+account_stream(struct streamSpool *spool)
+{
+        struct spoolStream *st = spool->current;
+        struct spoolChunk c;
+
+        if (st->w->error) {
+                spool->error = true;
+        }
+        if (st->w->bytes > st->flushed) {
+                c.offset = spool->end;
+                c.len = st->w->bytes - st->flushed;
+                g_array_append_val(st->chunks, c);
+                spool->end += c.len;
+                st->flushed = st->w->bytes;
+        }
+}
+
+/*
+ * Starts the records of an event at _timestamp of the stream of rank
+ * _rank and returns the writer they go to.
+ */
+struct prvWriter *
+spoolStreamEvent(struct streamSpool *spool, int rank, uint64_t timestamp)
+{
+        struct spoolStream *st;
+
+        account_stream(spool);
+        if (G_UNLIKELY(rank < 0 || (unsigned int) rank >= spool->nstreams)) {
+                spool->unranked = true;
+                spool->current = spool->streams[spool->nstreams];
+                return spool->current->w;
+        }
+
+        st = spool->streams[rank];
+        if (G_UNLIKELY(st == NULL)) {
+                st = spool->streams[rank] = create_stream(spool->fd);
+                if (st->w == NULL) {
+                        spool->error = true;
+                        g_array_free(st->chunks, TRUE);
+                        g_free(st);
+                        spool->streams[rank] = NULL;
+                        spool->current = spool->streams[spool->nstreams];
+                        return spool->current->w;
+                }
+        }
+        spool->current = st;
+        writeChar(st->w, SPOOL_EVENT);
+        writeUint(st->w, timestamp);
+        writeChar(st->w, '\n');
+
+        return st->w;
+}
+
+/*
+ * Writes out what the streams of the job still buffer, a write error is
+ * left for mergeStreamSpools()
+ */
+void
+finishStreamSpool(struct streamSpool *spool)
+{
+        unsigned int i;
+
+        account_stream(spool);
+        for (i = 0; i <= spool->nstreams; i++) {
+                if (spool->streams[i] == NULL) {
+                        continue;
+                }
+                spool->current = spool->streams[i];
+                flushWriter(spool->current->w);
+                account_stream(spool);
+        }
+}
+
+/* Appends chunk _c to the lines of _st left to read */
+static int
+read_chunk(struct spoolStream *st, const struct spoolChunk *c)
+{
+        size_t rest = st->len - st->pos;
+        uint64_t done = 0;
+        ssize_t n;
+
+        memmove(st->buf, st->buf + st->pos, rest);
+        st->len = rest;
+        st->pos = 0;
+        /* room for the NUL after the last line */
+        if (st->alloc < rest + c->len + 1) {
+                st->alloc = rest + c->len + 1;
+                st->buf = g_realloc(st->buf, st->alloc);
+        }
+        while (done < c->len) {
+                n = pread(st->fd, st->buf + rest + done, c->len - done,
+                    c->offset + done);
+                if (n <= 0) {
+                        return -1;
+                }
+                done += n;
+        }
+        st->len += c->len;
+        st->buf[st->len] = '\0';
+
+        return 0;
+}
+
+/*
+ * Returns the next line of _st, with its newline, or NULL once the stream
+ * is over. The line stays valid until the next call.
+ */
+static const char *
+read_stream_line(struct spoolStream *st)
+{
+        char *line, *nl;
+
+        if (st->held != '\0') {
+                st->buf[st->pos] = st->held;
+                st->held = '\0';
+        }
+        while (st->buf == NULL ||
+            (nl = memchr(st->buf + st->pos, '\n', st->len - st->pos)) ==
+            NULL) {
+                if (st->next_chunk >= st->chunks->len ||
+                    read_chunk(st, &g_array_index(st->chunks,
+                            struct spoolChunk, st->next_chunk++)) < 0) {
+                        return NULL;
+                }
+        }
+
+        line = st->buf + st->pos;
+        st->pos = nl + 1 - st->buf;
+        st->held = st->buf[st->pos];
+        st->buf[st->pos] = '\0';
+
+        return line;
+}
+
+/*
+ * Resolves the records of the event of _st and reads the timestamp of its
+ * next one, returns false at the end of the stream.
+ */
+static bool
+next_stream_event(struct spoolStream *st)
+{
+        const char *line;
+
+        while ((line = read_stream_line(st)) != NULL) {
+                if (line[0] == SPOOL_EVENT) {
+                        st->timestamp = strtoull(line + 1, NULL, 10);
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+/* heapify() of babeltrace's priority heap, from the top */
+static void
+stream_heapify(struct spoolStream **heap, unsigned int len)
+{
+        struct spoolStream *tmp;
+        unsigned int i = 0, l, r, largest;
+
+        for (;;) {
+                l = 2 * i + 1;
+                r = 2 * i + 2;
+                largest = (l < len &&
+                    heap[l]->timestamp < heap[i]->timestamp) ? l : i;
+                if (r < len && heap[r]->timestamp < heap[largest]->timestamp) {
+                        largest = r;
+                }
+                if (largest == i) {
+                        break;
+                }
+                tmp = heap[i];
+                heap[i] = heap[largest];
+                heap[largest] = tmp;
+                i = largest;
+        }
+}
+
+/*
+ * Merges the stream spools of _n jobs into _w with their final Paraver
+ * values. The records before the first event go first, then the streams
+ * are merged the way babeltrace's iterator does: inserted into its heap by
+ * rank and, after each event, sifted down from the top or replaced by the
+ * last one once over. Each rank is read by one job. Returns -1, having
+ * written nothing, if a job couldn't spool all of its streams.
+ */
+int
+mergeStreamSpools(struct streamSpool **spools, unsigned int n,
+    struct prvWriter *w, struct spoolResolver *resolver)
+{
+        unsigned int nstreams = n > 0 ? spools[0]->nstreams : 0;
+        struct spoolStream **heap = g_new(struct spoolStream *, nstreams);
+        struct spoolStream *st;
+        unsigned int len = 0, rank, pos, i;
+        const char *line;
+        int ret = 0;
+
+        for (i = 0; i < n; i++) {
+                if (spools[i]->error || spools[i]->unranked) {
+                        g_free(heap);
+                        return -1;
+                }
+        }
+
+        for (i = 0; i < n; i++) {
+                st = spools[i]->streams[nstreams];
+                while ((line = read_stream_line(st)) != NULL) {
+                        resolveSpoolLine(resolver, line, w);
+                }
+        }
+
+        for (rank = 0; rank < nstreams && ret == 0; rank++) {
+                for (i = 0, st = NULL; i < n && st == NULL; i++) {
+                        st = spools[i]->streams[rank];
+                }
+                if (st == NULL || !next_stream_event(st)) {
+                        continue;
+                }
+                /* sift up */
+                for (pos = len++; pos > 0 &&
+                    st->timestamp < heap[(pos - 1) / 2]->timestamp;
+                    pos = (pos - 1) / 2) {
+                        heap[pos] = heap[(pos - 1) / 2];
+                }
+                heap[pos] = st;
+        }
+
+        while (len > 0 && ret == 0) {
+                st = heap[0];
+                while ((line = read_stream_line(st)) != NULL &&
+                    line[0] != SPOOL_EVENT) {
+                        resolveSpoolLine(resolver, line, w);
+                }
+                if (line != NULL) {
+                        st->timestamp = strtoull(line + 1, NULL, 10);
+                } else {
+                        heap[0] = heap[--len];
+                }
+                stream_heapify(heap, len);
+        }
+
+        for (i = 0; i < n; i++) {
+                for (rank = 0; rank <= nstreams; rank++) {
+                        st = spools[i]->streams[rank];
+                        if (st != NULL && st->next_chunk < st->chunks->len) {
+                                ret = -1;
+                        }
+                }
+        }
+        g_free(heap);
+
+        return ret;
+}
+
+void
+freeStreamSpool(struct streamSpool *spool)
+{
+        struct spoolStream *st;
+        unsigned int i;
+
+        if (spool == NULL) {
+                return;
+        }
+        for (i = 0; i <= spool->nstreams; i++) {
+                st = spool->streams[i];
+                if (st == NULL) {
+                        continue;
+                }
+                destroyWriter(st->w);
+                g_array_free(st->chunks, TRUE);
+                g_free(st->buf);
+                g_free(st);
+        }
+        g_free(spool->streams);
+        close(spool->fd);
+        g_free(spool);
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,163 @@
+#pragma once
+#ifndef SPOOLBODY_H
+#define SPOOLBODY_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <glib.h>
+
+#include "types.h"
+#include "writeRecords.h"
+#include "registerIds.h"
+
+/*
+ * Single-pass body spool.
+ *
+ * When the body is written before the registries are complete, the
+ * resource and application fields of a record cannot be printed yet: the
+ * resource of a softirq or IRQ depends on the final number of CPUs and
+ * softirqs, and a thread may get its Paraver id after it is first
+ * referenced. Records are spooled one per line as
+ *
+ *   <R|Z><key>:<c|s|i><index>:<a<cpu>.<appl>|t<tid>>:<rest of the record>
+ *
+ * where R is a plain record and Z a record dropped if its application
+ * resolves to 0, the key is the trace time of the originating event, c/s/i
+ * select a CPU, softirq vector or IRQ number, and the application is either
+ * the one running on a CPU or the Paraver id of a system TID. Two
+ * directives track the application of the last CPU, whose slot is shared
+ * with softirq vector 0:
+ *
+ *   S<key>:<cpu>.<appl>        sched_switch on <cpu>
+ *   O<key>:<cpu>.<appl>        softirq vector 0 raised on <cpu>
+ */
+#define SPOOL_RECORD            'R'
+#define SPOOL_RECORD_NONZERO    'Z'
+#define SPOOL_SWITCH            'S'
+#define SPOOL_OVERRIDE          'O'
+
+#define SPOOL_RES_CPU           'c'
+#define SPOOL_RES_SOFTIRQ       's'
+#define SPOOL_RES_IRQ           'i'
+
+/*
+ * Stream spools of the parallel jobs.
+ *
+ * A job spools the records of each stream it reads through a buffer of
+ * its own, written to the spool file of the job in chunks, and starts the
+ * records of every event with
+ *
+ *   E<timestamp>               event of the stream at <timestamp>
+ *
+ * so that mergeStreamSpools() can read each stream back on its own and
+ * merge them with the priority heap of babeltrace's iterator. Streams are
+ * numbered in the order babeltrace adds them to it, their rank, and events
+ * with the same timestamp come out in the same order as without --jobs.
+ */
+#define SPOOL_EVENT             'E'
+
+/* Buffer of each stream of a job, the size of the chunks */
+#define SPOOL_STREAM_BUFFER     (64 << 10)
+
+struct spoolChunk
+{
+        uint64_t offset;
+        uint64_t len;
+};
+
+struct spoolStream
+{
+        struct prvWriter *w;
+        /* bytes of _w already in _chunks */
+        uint64_t flushed;
+        /* struct spoolChunk, in stream order */
+        GArray *chunks;
+        /* what the merge read back: the chunks left, the lines of the
+         * chunk being read and the timestamp of the next event */
+        int fd;
+        unsigned int next_chunk;
+        char *buf;
+        size_t len;
+        size_t pos;
+        size_t alloc;
+        char held;
+        uint64_t timestamp;
+};
+
+struct streamSpool
+{
+        int fd;
+        /* end of the chunks written so far */
+        uint64_t end;
+        /* struct spoolStream by rank, NULL for streams of other jobs, and
+         * the records before the first event at _nstreams */
+        struct spoolStream **streams;
+        unsigned int nstreams;
+        struct spoolStream *current;
+        /* rank of each stream by spoolStreamKey(), shared by the jobs */
+        GHashTable *ranks;
+        /* the directory the trace paths of the job are relative to */
+        const char *root;
+        /* a stream without a rank was read, the merge can't order it */
+        bool unranked;
+        bool error;
+};
+
+struct spoolResolver
+{
+        const struct prvRegistry *reg;
+        uint32_t ncpus;
+        uint32_t nsoftirqs;
+        /* application in the slot shared by the last CPU and softirq 0 */
+        uint64_t last_appl;
+};
+
+int createSpoolFile(const char *_prefix);
+
+FILE *createSpool(const char *_prefix);
+
+void initSpoolResolver(struct spoolResolver *_resolver,
+    const struct prvRegistry *_reg, const uint32_t _ncpus,
+    const uint32_t _nsoftirqs);
+
+uint64_t spoolLineKey(const char *_line);
+
+void resolveSpoolLine(struct spoolResolver *_resolver, const char *_line,
+    struct prvWriter *_w);
+
+int mergeLines(FILE **_in, unsigned int _n,
+    uint64_t (*_key)(const char *),
+    void (*_output)(const char *, size_t, gpointer), gpointer _data);
+
+int mergeSpools(FILE **_spools, unsigned int _n, struct prvWriter *_w,
+    struct spoolResolver *_resolver);
+
+int resolveSpool(FILE *_spool, struct prvWriter *_w,
+    const struct prvRegistry *_reg, const uint32_t _ncpus,
+    const uint32_t _nsoftirqs);
+
+char *spoolStreamKey(const char *_trace_dir, const char *_root,
+    uint64_t _stream_id, uint32_t _cpu_id);
+
+struct streamSpool *createStreamSpool(const char *_prefix,
+    unsigned int _nstreams, GHashTable *_ranks, const char *_root);
+
+int spoolStreamRank(const struct streamSpool *_spool,
+    const char *_trace_dir, uint64_t _stream_id, uint32_t _cpu_id);
+
+struct prvWriter *spoolStreamEvent(struct streamSpool *_spool, int _rank,
+    uint64_t _timestamp);
+
+void finishStreamSpool(struct streamSpool *_spool);
+
+int mergeStreamSpools(struct streamSpool **_spools, unsigned int _n,
+    struct prvWriter *_w, struct spoolResolver *_resolver);
+
+void freeStreamSpool(struct streamSpool *_spool);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,244 @@
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include <dirent.h>
+#include <errno.h>
+#include <ftw.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "streamFiles.h"
+
+static int collect_trace_dir(const char *_fpath, const struct stat *_sb,
+    int _tflag, struct FTW *_ftwbuf);
+
+static int remove_entry(const char *_fpath, const struct stat *_sb,
+    int _tflag, struct FTW *_ftwbuf);
+
+static int stream_cpu(const char *_name);
+
+static void free_stream_file(gpointer _data);
+
+static GPtrArray *trace_dirs = NULL;
+
+static int
+collect_trace_dir(const char *fpath, const struct stat *sb, int tflag,
+    struct FTW *ftwbuf)
+{
+        UNUSED(sb);
+        UNUSED(ftwbuf);
+        char *metadata;
+
+        if (tflag != FTW_D) {
+                return 0;
+        }
+
+        metadata = g_build_filename(fpath, "metadata", NULL);
+        if (access(metadata, R_OK) == 0) {
+                g_ptr_array_add(trace_dirs, g_strdup(fpath));
+        }
+        g_free(metadata);
+
+        return 0;
+}
+
+/*
+ * Returns the CPU of a <channel>_<cpu> stream file name, -1 if none.
+ */
+static int
+stream_cpu(const char *name)
+{
+        const char *sep = strrchr(name, '_');
+        const char *p;
+
+        if (sep == NULL || sep[1] == '\0') {
+                return -1;
+        }
+        for (p = sep + 1; *p != '\0'; p++) {
+                if (*p < '0' || *p > '9') {
+                        return -1;
+                }
+        }
+
+        return atoi(sep + 1);
+}
+
+static void
+free_stream_file(gpointer data)
+{
+        struct streamFile *file = data;
+
+        g_free(file->trace_dir);
+        g_free(file->name);
+        g_free(file);
+}
+
+/*
+ * Lists the stream files of every trace found under _path, that is every
+ * regular file next to a metadata file except the metadata itself.
+ */
+GPtrArray *
+listStreamFiles(const char *path)
+{
+        GPtrArray *files;
+        DIR *dir;
+        struct dirent *entry;
+        struct stat sb;
+        struct streamFile *file;
+        char *fpath;
+        unsigned int i;
+
+        files = g_ptr_array_new_with_free_func(free_stream_file);
+        trace_dirs = g_ptr_array_new_with_free_func(g_free);
+
+        if (nftw(path, collect_trace_dir, 10, 0) < 0) {
+                perror("nftw");
+        }
+
+        for (i = 0; i < trace_dirs->len; i++) {
+                const char *trace_dir = g_ptr_array_index(trace_dirs, i);
+
+                if (!(dir = opendir(trace_dir))) {
+                        perror("opendir");
+                        continue;
+                }
+                while ((entry = readdir(dir)) != NULL) {
+                        if (entry->d_name[0] == '.' ||
+                            strcmp(entry->d_name, "metadata") == 0) {
+                                continue;
+                        }
+                        fpath = g_build_filename(trace_dir, entry->d_name,
+                            NULL);
+                        if (stat(fpath, &sb) == 0 && S_ISREG(sb.st_mode)) {
+                                file = g_new0(struct streamFile, 1);
+                                file->trace_dir = g_strdup(trace_dir);
+                                file->name = g_strdup(entry->d_name);
+                                file->cpu = stream_cpu(entry->d_name);
+                                file->size = sb.st_size;
+                                g_ptr_array_add(files, file);
+                        }
+                        g_free(fpath);
+                }
+                closedir(dir);
+        }
+
+        g_ptr_array_free(trace_dirs, TRUE);
+        trace_dirs = NULL;
+
+        return files;
+}
+
+/*
+ * Creates a directory tree next to _prefix that mirrors the traces under
+ * _path with symbolic links, keeping only the stream files accepted by
+ * _keep (and their packet indexes). babeltrace opens it like the original
+ * trace but only decodes the selected streams. Returns the new directory.
+ */
+char *
+createShadowTrace(const char *prefix, const char *path, GPtrArray *files,
+    gboolean (*keep)(const struct streamFile *, gpointer), gpointer data)
+{
+        char *shadow, *dir, *target, *link;
+        char real[PATH_MAX];
+        size_t root_len = strlen(path);
+        GHashTable *dirs;
+        unsigned int i;
+
+        shadow = g_strdup_printf("%s.shadow.XXXXXX", prefix);
+        if (!mkdtemp(shadow)) {
+                perror("mkdtemp");
+                g_free(shadow);
+                return NULL;
+        }
+
+        dirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+        for (i = 0; i < files->len; i++) {
+                const struct streamFile *file = g_ptr_array_index(files, i);
+
+                if (!keep(file, data)) {
+                        continue;
+                }
+
+                dir = g_build_filename(shadow,
+                    file->trace_dir + MIN(root_len, strlen(file->trace_dir)),
+                    NULL);
+                if (!g_hash_table_contains(dirs, dir)) {
+                        if (g_mkdir_with_parents(dir, 0700) < 0) {
+                                perror("mkdir");
+                        }
+                        target = g_build_filename(file->trace_dir, "metadata",
+                            NULL);
+                        link = g_build_filename(dir, "metadata", NULL);
+                        if (realpath(target, real) == NULL ||
+                            symlink(real, link) < 0) {
+                                perror("symlink");
+                        }
+                        g_free(target);
+                        g_free(link);
+                        g_hash_table_add(dirs, g_strdup(dir));
+                }
+
+                target = g_build_filename(file->trace_dir, file->name, NULL);
+                link = g_build_filename(dir, file->name, NULL);
+                if (realpath(target, real) == NULL ||
+                    symlink(real, link) < 0) {
+                        perror("symlink");
+                }
+                g_free(target);
+                g_free(link);
+
+                target = g_strdup_printf("%s/index/%s.idx", file->trace_dir,
+                    file->name);
+                if (realpath(target, real) != NULL) {
+                        link = g_build_filename(dir, "index", NULL);
+                        g_mkdir_with_parents(link, 0700);
+                        g_free(link);
+                        link = g_strdup_printf("%s/index/%s.idx", dir,
+                            file->name);
+                        if (symlink(real, link) < 0) {
+                                perror("symlink");
+                        }
+                        g_free(link);
+                }
+                g_free(target);
+                g_free(dir);
+        }
+
+        g_hash_table_destroy(dirs);
+
+        return shadow;
+}
+
+static int
+remove_entry(const char *fpath, const struct stat *sb, int tflag,
+    struct FTW *ftwbuf)
+{
+        UNUSED(sb);
+        UNUSED(tflag);
+        UNUSED(ftwbuf);
+
+        if (remove(fpath) < 0) {
+                perror("remove");
+        }
+
+        return 0;
+}
+
+/*
+ * Removes a tree made by createShadowTrace(), links only.
+ */
+void
+removeShadowTrace(const char *shadow)
+{
+        nftw(shadow, remove_entry, 10, FTW_DEPTH | FTW_PHYS);
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
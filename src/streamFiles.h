@@ -0,0 +1,34 @@
+#pragma once
+#ifndef STREAMFILES_H
+#define STREAMFILES_H
+
+#include <glib.h>
+
+#include "types.h"
+
+/*
+ * A stream file of one of the CTF traces found under the input path.
+ * LTTng names them <channel>_<cpu>, one per CPU and channel.
+ */
+struct streamFile
+{
+        char *trace_dir;        /* directory holding the metadata file */
+        char *name;             /* file name inside trace_dir */
+        int cpu;                /* -1 if the name carries no CPU */
+        uint64_t size;          /* in bytes */
+};
+
+GPtrArray *listStreamFiles(const char *_path);
+
+char *createShadowTrace(const char *_prefix, const char *_path,
+    GPtrArray *_files, gboolean (*_keep)(const struct streamFile *, gpointer),
+    gpointer _data);
+
+void removeShadowTrace(const char *_shadow);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,156 @@
+/* Thread states as Paraver state records, for --state-records */
+
+#include <string.h>
+
+#include "trackStates.h"
+
+struct stateRecords thread_states;
+
+void
+initStates(void)
+{
+        thread_states.enabled = true;
+        thread_states.threads = g_array_new(FALSE, TRUE,
+            sizeof(struct threadState));
+        thread_states.resources = g_array_new(FALSE, TRUE,
+            sizeof(struct resourceState));
+}
+
+/* Prints the interval of thread _appl in _state on resource _cpu_id */
+void
+writeStateRecord(struct prvWriter *w, uint32_t cpu_id, uint64_t appl,
+    uint64_t begin, uint64_t end, uint32_t state)
+{
+        writeBytes(w, "1:", 2);
+        writeField(w, cpu_id + 1);
+        writeField(w, appl);
+        writeField(w, 1);
+        writeField(w, 1);
+        writeField(w, begin);
+        writeField(w, end);
+        writeUint(w, state);
+        writeChar(w, '\n');
+}
+
+/* Ends the interval of the handler on resource _res at _time */
+static void
+close_resource(struct prvWriter *w, uint32_t res, uint64_t time)
+{
+        struct resourceState *r;
+
+        if (res >= thread_states.resources->len) {
+                return;
+        }
+        r = &g_array_index(thread_states.resources, struct resourceState,
+            res);
+        if (r->set && time > r->begin) {
+                writeStateRecord(w, res, r->appl, r->begin, time, r->state);
+        }
+        r->set = false;
+}
+
+/*
+ * A handler in _state starts on resource _res at _time, interrupting
+ * thread _appl on its CPU _cpu_id. The thread is in _state until the
+ * handler exits, see exitHandler().
+ */
+void
+enterHandler(struct prvWriter *w, uint64_t appl, uint32_t cpu_id,
+    uint32_t res, uint32_t state, uint64_t time)
+{
+        struct threadState *s;
+        struct resourceState *r;
+
+        if (appl == 0) {
+                return;
+        }
+        s = thread_state(appl);
+        if (s->set) {
+                /* past the deepest one, the innermost is overwritten */
+                s->interrupted[MIN(s->depth, STATE_DEPTH - 1)] = s->state;
+                s->depth = MIN(s->depth + 1, STATE_DEPTH);
+        }
+        move_state(w, appl, s, cpu_id, state, time);
+
+        /* vector 0 of the softirqs may share its slot with a CPU */
+        if (res == cpu_id) {
+                return;
+        }
+        close_resource(w, res, time);
+        if (res >= thread_states.resources->len) {
+                g_array_set_size(thread_states.resources, res + 1);
+        }
+        r = &g_array_index(thread_states.resources, struct resourceState,
+            res);
+        r->begin = time;
+        r->appl = appl;
+        r->state = state;
+        r->set = true;
+}
+
+/*
+ * The handler on resource _res exits at _time, thread _appl is back in the
+ * state it interrupted
+ */
+void
+exitHandler(struct prvWriter *w, uint64_t appl, uint32_t cpu_id,
+    uint32_t res, uint64_t time)
+{
+        struct threadState *s;
+
+        if (res != cpu_id) {
+                close_resource(w, res, time);
+        }
+        if (appl == 0) {
+                return;
+        }
+        s = thread_state(appl);
+        /* without its entry, when the trace began in the handler */
+        if (s->depth == 0) {
+                return;
+        }
+        s->depth--;
+        move_state(w, appl, s, cpu_id, s->interrupted[s->depth], time);
+}
+
+/*
+ * Ends the interval of every thread and handler at _end, the end of the
+ * trace
+ */
+void
+closeStates(struct prvWriter *w, uint64_t end)
+{
+        struct threadState *s;
+        unsigned int appl, res;
+
+        for (appl = 0; appl < thread_states.threads->len; appl++) {
+                s = &g_array_index(thread_states.threads, struct threadState,
+                    appl);
+                if (s->set && end > s->begin) {
+                        writeStateRecord(w, s->cpu_id, appl, s->begin, end,
+                            s->state);
+                }
+                s->set = false;
+                s->depth = 0;
+        }
+        for (res = 0; res < thread_states.resources->len; res++) {
+                close_resource(w, res, end);
+        }
+}
+
+void
+freeStates(void)
+{
+        if (thread_states.threads != NULL) {
+                g_array_free(thread_states.threads, TRUE);
+        }
+        if (thread_states.resources != NULL) {
+                g_array_free(thread_states.resources, TRUE);
+        }
+        memset(&thread_states, 0, sizeof(thread_states));
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,126 @@
+#pragma once
+#ifndef TRACKSTATES_H
+#define TRACKSTATES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <glib.h>
+
+#include "types.h"
+#include "writeRecords.h"
+
+/*
+ * --state-records. Instead of a 20000000 event on every state change, the
+ * state of each thread is followed here and printed as one Paraver state
+ * record, 1:cpu:appl:task:thread:begin:end:state, when it ends: at the
+ * next change of state or of resource, or at the end of the trace.
+ * Changes to the state a thread is already in on the same resource extend
+ * its interval. An IRQ or softirq handler interrupts the state of the
+ * thread on its CPU, which is back once the handler exits, and its IRQ or
+ * softirq resource has an interval of its own for the handler. Records are
+ * printed as intervals end, not in begin order, so they are sorted.
+ */
+
+/* Handlers followed nested in one another on a CPU */
+#define STATE_DEPTH 4
+
+struct threadState
+{
+        uint64_t begin;
+        uint32_t cpu_id;
+        uint32_t state;
+        bool set;
+        /* the states interrupted by the handlers the thread is in */
+        uint32_t interrupted[STATE_DEPTH];
+        unsigned int depth;
+};
+
+/* The handler running on an IRQ or softirq resource */
+struct resourceState
+{
+        uint64_t begin;
+        uint64_t appl;
+        uint32_t state;
+        bool set;
+};
+
+struct stateRecords
+{
+        bool enabled;
+        /* current state of each thread, indexed by its Paraver id */
+        GArray *threads;
+        /* struct resourceState by resource, as iter_trace() numbers them */
+        GArray *resources;
+};
+
+extern struct stateRecords thread_states;
+
+void initStates(void);
+
+void writeStateRecord(struct prvWriter *_w, uint32_t _cpu_id,
+    uint64_t _appl, uint64_t _begin, uint64_t _end, uint32_t _state);
+
+/* The state of thread _appl, 0 is no thread */
+static inline struct threadState *
+thread_state(uint64_t appl)
+{
+        if (appl >= thread_states.threads->len) {
+                g_array_set_size(thread_states.threads, appl + 1);
+        }
+
+        return &g_array_index(thread_states.threads, struct threadState,
+            appl);
+}
+
+/* Moves thread _appl, in _s, to _state on resource _cpu_id at _time */
+static inline void
+move_state(struct prvWriter *w, uint64_t appl, struct threadState *s,
+    uint32_t cpu_id, uint32_t state, uint64_t time)
+{
+        if (s->set && s->state == state && s->cpu_id == cpu_id) {
+                return;
+        }
+        if (s->set && time > s->begin) {
+                writeStateRecord(w, s->cpu_id, appl, s->begin, time,
+                    s->state);
+        }
+        s->begin = time;
+        s->cpu_id = cpu_id;
+        s->state = state;
+        s->set = true;
+}
+
+/*
+ * Thread _appl enters _state on resource _cpu_id at _time, ending the
+ * interval it was in and any handler it was interrupted by
+ */
+static inline void
+changeState(struct prvWriter *w, uint64_t appl, uint32_t cpu_id,
+    uint32_t state, uint64_t time)
+{
+        struct threadState *s;
+
+        if (appl == 0) {
+                return;
+        }
+        s = thread_state(appl);
+        s->depth = 0;
+        move_state(w, appl, s, cpu_id, state, time);
+}
+
+void enterHandler(struct prvWriter *_w, uint64_t _appl, uint32_t _cpu_id,
+    uint32_t _res, uint32_t _state, uint64_t _time);
+
+void exitHandler(struct prvWriter *_w, uint64_t _appl, uint32_t _cpu_id,
+    uint32_t _res, uint64_t _time);
+
+void closeStates(struct prvWriter *_w, uint64_t _end);
+
+void freeStates(void);
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -3,17 +3,46 @@
 #define TYPES_H
 
 #include <inttypes.h>
+#include <stddef.h>
 #include <stdbool.h>
 
 #define debug(...) if (verbose) fprintf(stderr, __VA_ARGS__)
+#define UNUSED(x) (void)(x)
 
 extern bool verbose;
+extern unsigned int id_size;
+extern size_t write_buffer_size;
 
 enum
 {
         OPT_NONE = 0,
         OPT_OUTPUT,
         OPT_TIMESTAMPS,
+        OPT_SINGLE_PASS,
+        OPT_JOBS,
+        OPT_BUFFER_SIZE,
+        OPT_ASYNC,
+        OPT_QUEUE_DEPTH,
+        OPT_COMPRESS,
+        OPT_COMPRESS_THREADS,
+        OPT_BEGIN,
+        OPT_END,
+        OPT_CPUS,
+        OPT_TIDS,
+        OPT_PIDS,
+        OPT_EVENTS,
+        OPT_STATS,
+        OPT_PROGRESS,
+        OPT_CHECKPOINT,
+        OPT_RESUME,
+        OPT_FOLLOW,
+        OPT_SPLIT_TIME,
+        OPT_SPLIT_SIZE,
+        OPT_SORT_MEM,
+        OPT_STATE_RECORDS,
+        OPT_INDEX,
+        OPT_NO_CACHE,
+        OPT_DECODER,
         OPT_VERBOSE
 };
 
@@ -0,0 +1,432 @@
+/* Asynchronous output stage of a record writer */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include "types.h"
+#include "writeRecords.h"
+
+/*
+ * The converter fills one buffer while up to _depth full ones are written
+ * out, either by a background thread or through io_uring. There are
+ * depth + 1 buffers: the current one and the ones queued, being written or
+ * free. The converter only waits when it fills a buffer and none is free.
+ */
+struct writeQueue
+{
+        int mode;
+        int fd;
+        struct prvCompressor *comp;
+        unsigned int nbufs;
+        char **bufs;
+        size_t *lens;
+        unsigned int current;
+
+        /* indices of the free buffers */
+        unsigned int *free_bufs;
+        unsigned int nfree;
+
+        /* ring of the buffers waiting for the writer thread */
+        unsigned int *pending;
+        unsigned int head;
+        unsigned int npending;
+
+        bool stop;
+        int error;
+        GMutex lock;
+        GCond cond;
+        GThread *thread;
+
+#ifdef HAVE_LIBURING
+        struct io_uring ring;
+        off_t *offsets;
+        off_t offset;
+        unsigned int inflight;
+#endif
+};
+
+static gpointer write_thread(gpointer _data);
+
+static void free_queue(struct writeQueue *_q);
+
+#ifdef HAVE_LIBURING
+static int pwrite_fully(int _fd, const char *_buf, size_t _len,
+    off_t _offset);
+#endif
+
+static gpointer
+write_thread(gpointer data)
+{
+        struct writeQueue *q = data;
+        unsigned int i;
+        int ret;
+
+        g_mutex_lock(&q->lock);
+        for (;;) {
+                while (q->npending == 0 && !q->stop) {
+                        g_cond_wait(&q->cond, &q->lock);
+                }
+                if (q->npending == 0) {
+                        break;
+                }
+                i = q->pending[q->head];
+                q->head = (q->head + 1) % q->nbufs;
+                q->npending--;
+
+                /* after an error buffers are only recycled */
+                ret = 0;
+                if (!q->error) {
+                        g_mutex_unlock(&q->lock);
+                        ret = outputBuffer(q->fd, q->comp, q->bufs[i],
+                            q->lens[i]);
+                        g_mutex_lock(&q->lock);
+                }
+                if (ret < 0) {
+                        q->error = 1;
+                }
+                q->free_bufs[q->nfree++] = i;
+                g_cond_broadcast(&q->cond);
+        }
+        g_mutex_unlock(&q->lock);
+
+        return NULL;
+}
+
+#ifdef HAVE_LIBURING
+/*
+ * pwrite() of all of _buf at _offset, retried until done or failed. A write
+ * of nothing fails too, rather than being retried forever.
+ */
+static int
+pwrite_fully(int fd, const char *buf, size_t len, off_t offset)
+{
+        ssize_t n;
+
+        while (len > 0) {
+                n = pwrite(fd, buf, len, offset);
+                if (n < 0) {
+                        if (errno == EINTR) {
+                                continue;
+                        }
+                        perror("pwrite");
+                        return -1;
+                }
+                if (n == 0) {
+                        fprintf(stderr, "[error] pwrite: nothing written\n");
+                        return -1;
+                }
+                buf += n;
+                len -= n;
+                offset += n;
+        }
+
+        return 0;
+}
+
+/*
+ * Waits for the oldest write in flight and recycles its buffer. Short
+ * writes are completed synchronously.
+ */
+static void
+reap_write(struct writeQueue *q)
+{
+        struct io_uring_cqe *cqe;
+        unsigned int i;
+        size_t done;
+        int ret;
+
+        do {
+                ret = io_uring_wait_cqe(&q->ring, &cqe);
+        } while (ret == -EINTR);
+        if (ret < 0) {
+                fprintf(stderr, "[error] io_uring: %s\n", strerror(-ret));
+                q->error = 1;
+                q->inflight = 0;
+                return;
+        }
+
+        i = (unsigned int) (uintptr_t) io_uring_cqe_get_data(cqe);
+        if (cqe->res < 0) {
+                fprintf(stderr, "[error] write: %s\n", strerror(-cqe->res));
+                q->error = 1;
+        } else if ((size_t) cqe->res < q->lens[i]) {
+                done = cqe->res;
+                if (pwrite_fully(q->fd, q->bufs[i] + done, q->lens[i] - done,
+                        q->offsets[i] + done) < 0) {
+                        q->error = 1;
+                }
+        }
+        io_uring_cqe_seen(&q->ring, cqe);
+
+        q->inflight--;
+        q->free_bufs[q->nfree++] = i;
+}
+
+/*
+ * io_uring writes at explicit offsets, so it is only used on descriptors
+ * that can seek. Returns -1 if it can't be used.
+ */
+static int
+start_uring(struct writeQueue *q)
+{
+        q->offset = lseek(q->fd, 0, SEEK_CUR);
+        if (q->offset < 0) {
+                debug("Output can't seek, using a writer thread.\n");
+                return -1;
+        }
+        if (io_uring_queue_init(q->nbufs, &q->ring, 0) < 0) {
+                debug("io_uring unavailable, using a writer thread.\n");
+                return -1;
+        }
+        q->offsets = g_new0(off_t, q->nbufs);
+        q->inflight = 0;
+
+        return 0;
+}
+
+static void
+submit_write(struct writeQueue *q, unsigned int i)
+{
+        struct io_uring_sqe *sqe;
+
+        sqe = io_uring_get_sqe(&q->ring);
+        io_uring_prep_write(sqe, q->fd, q->bufs[i], q->lens[i], q->offset);
+        io_uring_sqe_set_data(sqe, (void *) (uintptr_t) i);
+        q->offsets[i] = q->offset;
+        q->offset += q->lens[i];
+        io_uring_submit(&q->ring);
+        q->inflight++;
+}
+#endif
+
+static void
+free_queue(struct writeQueue *q)
+{
+        unsigned int i;
+
+        for (i = 0; i < q->nbufs; i++) {
+                free(q->bufs[i]);
+        }
+        g_free(q->bufs);
+        g_free(q->lens);
+        g_free(q->free_bufs);
+        g_free(q->pending);
+#ifdef HAVE_LIBURING
+        g_free(q->offsets);
+#endif
+        g_mutex_clear(&q->lock);
+        g_cond_clear(&q->cond);
+        g_free(q);
+}
+
+/*
+ * Makes _w asynchronous, with up to _depth full buffers queued to the
+ * output. WRITER_URING falls back to a writer thread when io_uring isn't
+ * available, the output can't seek or it is compressed. On failure _w
+ * stays synchronous and -1 is returned.
+ */
+int
+startAsyncWriter(struct prvWriter *w, int mode, unsigned int depth)
+{
+        struct writeQueue *q;
+        unsigned int i;
+
+        if (mode == WRITER_SYNC || w->queue != NULL) {
+                return 0;
+        }
+        if (depth == 0) {
+                depth = WRITER_DEFAULT_DEPTH;
+        }
+        flushWriter(w);
+
+        q = g_new0(struct writeQueue, 1);
+        q->mode = mode;
+        q->fd = w->fd;
+        q->comp = w->comp;
+        q->nbufs = depth + 1;
+        q->bufs = g_new0(char *, q->nbufs);
+        q->lens = g_new0(size_t, q->nbufs);
+        q->free_bufs = g_new(unsigned int, q->nbufs);
+        q->pending = g_new(unsigned int, q->nbufs);
+        g_mutex_init(&q->lock);
+        g_cond_init(&q->cond);
+
+        /* the current buffer of the writer is the first one */
+        q->bufs[0] = w->buf;
+        q->current = 0;
+        for (i = 1; i < q->nbufs; i++) {
+                q->bufs[i] = malloc(w->size);
+                if (q->bufs[i] == NULL) {
+                        q->bufs[0] = NULL;
+                        free_queue(q);
+                        return -1;
+                }
+                q->free_bufs[q->nfree++] = i;
+        }
+
+        /* compressed sizes are only known once compressed */
+        if (q->mode == WRITER_URING && q->comp != NULL) {
+                debug("Compressed output, using a writer thread.\n");
+                q->mode = WRITER_THREAD;
+        }
+#ifdef HAVE_LIBURING
+        if (q->mode == WRITER_URING && start_uring(q) < 0) {
+                q->mode = WRITER_THREAD;
+        }
+#else
+        if (q->mode == WRITER_URING) {
+                debug("Built without io_uring, using a writer thread.\n");
+                q->mode = WRITER_THREAD;
+        }
+#endif
+        if (q->mode == WRITER_THREAD) {
+                q->thread = g_thread_new("lttng2prv-write", write_thread, q);
+        }
+        w->queue = q;
+
+        return 0;
+}
+
+/*
+ * Hands the current buffer of _w to the output and gives _w a free one,
+ * waiting for it if all are queued.
+ */
+int
+queueBuffer(struct prvWriter *w)
+{
+        struct writeQueue *q = w->queue;
+        uint64_t start;
+        int error;
+
+        if (w->len == 0) {
+                return q->error ? -1 : 0;
+        }
+        w->bytes += w->len;
+        w->writes++;
+        countRecords(w);
+        q->lens[q->current] = w->len;
+
+#ifdef HAVE_LIBURING
+        if (q->mode == WRITER_URING) {
+                if (!q->error) {
+                        submit_write(q, q->current);
+                } else {
+                        q->free_bufs[q->nfree++] = q->current;
+                }
+                if (q->nfree == 0) {
+                        start = monotonicTime();
+                        reap_write(q);
+                        w->wait_ns += monotonicTime() - start;
+                }
+                q->current = q->free_bufs[--q->nfree];
+                w->buf = q->bufs[q->current];
+                w->len = 0;
+
+                return q->error ? -1 : 0;
+        }
+#endif
+
+        g_mutex_lock(&q->lock);
+        q->pending[(q->head + q->npending) % q->nbufs] = q->current;
+        q->npending++;
+        g_cond_broadcast(&q->cond);
+        if (q->nfree == 0) {
+                start = monotonicTime();
+                while (q->nfree == 0) {
+                        g_cond_wait(&q->cond, &q->lock);
+                }
+                w->wait_ns += monotonicTime() - start;
+        }
+        q->current = q->free_bufs[--q->nfree];
+        error = q->error;
+        g_mutex_unlock(&q->lock);
+
+        w->buf = q->bufs[q->current];
+        w->len = 0;
+
+        return error ? -1 : 0;
+}
+
+/*
+ * Queues the last buffer, waits until everything is written and makes _w
+ * synchronous again, with a buffer of its own.
+ */
+int
+stopAsyncWriter(struct prvWriter *w)
+{
+        struct writeQueue *q = w->queue;
+        uint64_t start;
+        int error;
+
+        if (q == NULL) {
+                return 0;
+        }
+        start = monotonicTime();
+
+        if (w->len > 0) {
+                w->bytes += w->len;
+                w->writes++;
+                countRecords(w);
+                q->lens[q->current] = w->len;
+        }
+
+#ifdef HAVE_LIBURING
+        if (q->mode == WRITER_URING) {
+                if (w->len > 0 && !q->error) {
+                        submit_write(q, q->current);
+                }
+                while (q->inflight > 0) {
+                        reap_write(q);
+                }
+                io_uring_queue_exit(&q->ring);
+                /* leave the descriptor past the data, as write() would */
+                if (!q->error && lseek(q->fd, q->offset, SEEK_SET) < 0) {
+                        perror("lseek");
+                        q->error = 1;
+                }
+        }
+#endif
+        if (q->mode == WRITER_THREAD) {
+                g_mutex_lock(&q->lock);
+                if (w->len > 0) {
+                        q->pending[(q->head + q->npending) % q->nbufs] =
+                            q->current;
+                        q->npending++;
+                }
+                q->stop = true;
+                g_cond_broadcast(&q->cond);
+                g_mutex_unlock(&q->lock);
+                g_thread_join(q->thread);
+        }
+        w->wait_ns += monotonicTime() - start;
+
+        /* the writer keeps the current buffer */
+        w->buf = q->bufs[q->current];
+        w->len = 0;
+        q->bufs[q->current] = NULL;
+        error = q->error;
+        if (error) {
+                w->error = 1;
+        }
+        w->queue = NULL;
+        free_queue(q);
+
+        return error ? -1 : 0;
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,269 @@
+/* Buffered writer for Paraver records */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "writeRecords.h"
+#include "compressOutput.h"
+#include "sortRecords.h"
+
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/*
+ * Buffer of _size bytes, WRITER_DEFAULT_SIZE if 0, for the already open
+ * _fd. The descriptor is not closed by destroyWriter().
+ */
+struct prvWriter *
+createWriter(int fd, size_t size)
+{
+        struct prvWriter *w;
+
+        if (size == 0) {
+                size = WRITER_DEFAULT_SIZE;
+        }
+        /* room for at least one integer */
+        if (size < 2 * WRITER_INT_LEN) {
+                size = 2 * WRITER_INT_LEN;
+        }
+
+        w = malloc(sizeof(struct prvWriter));
+        if (w == NULL) {
+                return NULL;
+        }
+        w->buf = malloc(size);
+        if (w->buf == NULL) {
+                free(w);
+                return NULL;
+        }
+        w->fd = fd;
+        w->size = size;
+        w->len = 0;
+        w->error = 0;
+        w->queue = NULL;
+        w->comp = NULL;
+        w->sort = NULL;
+        w->bytes = 0;
+        w->writes = 0;
+        w->wait_ns = 0;
+        w->records = 0;
+        w->count_records = false;
+
+        return w;
+}
+
+/* Nanoseconds of a monotonic clock, for timings */
+uint64_t
+monotonicTime(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* write() of all of _buf, retried until done or failed */
+int
+writeFully(int fd, const char *buf, size_t len)
+{
+        ssize_t n;
+
+        while (len > 0) {
+                n = write(fd, buf, len);
+                if (n < 0) {
+                        if (errno == EINTR) {
+                                continue;
+                        }
+                        perror("write");
+                        return -1;
+                }
+                buf += n;
+                len -= n;
+        }
+
+        return 0;
+}
+
+/*
+ * Compresses everything written from now on with a _kind stream. The
+ * header must go through the writer too.
+ */
+int
+setWriterCompression(struct prvWriter *w, int kind, unsigned int threads)
+{
+        if (kind == COMPRESS_NONE) {
+                return 0;
+        }
+        flushWriter(w);
+        w->comp = createCompressor(kind, w->fd, threads);
+
+        return w->comp != NULL ? 0 : -1;
+}
+
+/* Writes out a full buffer, through the compressor if there is one */
+int
+outputBuffer(int fd, struct prvCompressor *comp, const char *buf, size_t len)
+{
+        if (comp != NULL) {
+                return compressWrite(comp, buf, len);
+        }
+
+        return writeFully(fd, buf, len);
+}
+
+/*
+ * Writes out the buffered records, or queues them to the output stage of
+ * an asynchronous writer. After an error records are dropped and -1 is
+ * returned until the writer is destroyed.
+ */
+int
+flushWriter(struct prvWriter *w)
+{
+        uint64_t start;
+
+        if (w->sort != NULL) {
+                return sortBuffer(w);
+        }
+        if (w->queue != NULL) {
+                return queueBuffer(w);
+        }
+
+        start = monotonicTime();
+        if (w->len > 0 && !w->error) {
+                w->writes++;
+                w->bytes += w->len;
+                countRecords(w);
+                if (outputBuffer(w->fd, w->comp, w->buf, w->len) < 0) {
+                        w->error = 1;
+                }
+        }
+        w->len = 0;
+        w->wait_ns += monotonicTime() - start;
+
+        return w->error ? -1 : 0;
+}
+
+/* Counts the lines of the buffer handed to the output, for --stats */
+void
+countRecords(struct prvWriter *w)
+{
+        const char *p, *end;
+
+        if (!w->count_records) {
+                return;
+        }
+        end = w->buf + w->len;
+        for (p = w->buf; (p = memchr(p, '\n', end - p)) != NULL; p++) {
+                w->records++;
+        }
+}
+
+/*
+ * Writes out everything, the sorted records first, waiting for the output
+ * stage of an asynchronous writer to finish, and ends the compressed
+ * stream. The counters stay available until destroyWriter().
+ */
+int
+closeWriter(struct prvWriter *w)
+{
+        int ret;
+
+        if (finishSort(w) < 0) {
+                w->error = 1;
+        }
+        if (w->queue != NULL) {
+                ret = stopAsyncWriter(w);
+        } else {
+                ret = flushWriter(w);
+        }
+        if (w->comp != NULL && !w->error && compressFinish(w->comp) < 0) {
+                w->error = 1;
+                ret = -1;
+        }
+
+        return ret;
+}
+
+int
+destroyWriter(struct prvWriter *w)
+{
+        int ret;
+
+        if (w == NULL) {
+                return 0;
+        }
+        ret = closeWriter(w);
+        destroyCompressor(w->comp);
+        free(w->buf);
+        free(w);
+
+        return ret;
+}
+
+/*
+ * Writes the decimal form of _val at _p, two digits at a time, and returns
+ * the end of it.
+ */
+char *
+formatUint(char *p, uint64_t val)
+{
+        char tmp[WRITER_INT_LEN];
+        char *t = tmp + WRITER_INT_LEN;
+        size_t n;
+        unsigned int pair;
+
+        while (val >= 100) {
+                pair = (val % 100) * 2;
+                val /= 100;
+                *--t = digit_pairs[pair + 1];
+                *--t = digit_pairs[pair];
+        }
+        if (val >= 10) {
+                pair = val * 2;
+                *--t = digit_pairs[pair + 1];
+                *--t = digit_pairs[pair];
+        } else {
+                *--t = '0' + val;
+        }
+
+        n = tmp + WRITER_INT_LEN - t;
+        memcpy(p, t, n);
+
+        return p + n;
+}
+
+void
+writeBytes(struct prvWriter *w, const char *data, size_t len)
+{
+        size_t n;
+
+        while (len > 0) {
+                if (w->len == w->size) {
+                        flushWriter(w);
+                }
+                n = MIN(len, w->size - w->len);
+                memcpy(w->buf + w->len, data, n);
+                w->len += n;
+                data += n;
+                len -= n;
+        }
+}
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */
@@ -0,0 +1,147 @@
+#pragma once
+#ifndef WRITERECORDS_H
+#define WRITERECORDS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Default size of the buffer of a record writer */
+#define WRITER_DEFAULT_SIZE (4 << 20)
+
+/* Buffers queued to the output stage of an asynchronous writer */
+#define WRITER_DEFAULT_DEPTH 1
+
+/* How a writer hands its buffer to the output */
+enum
+{
+        WRITER_SYNC = 0,
+        WRITER_THREAD,
+        WRITER_URING
+};
+
+/* Longest decimal form of a 64-bit integer, sign included */
+#define WRITER_INT_LEN 20
+
+struct writeQueue;
+struct prvCompressor;
+struct recordSorter;
+
+/*
+ * Buffered writer for Paraver records. Records are appended to a large
+ * buffer with integer conversions specialised for their all-decimal shape,
+ * without format strings or locale, and the buffer is written to _fd in
+ * single write() calls when full. An asynchronous writer, see
+ * startAsyncWriter(), hands full buffers to a background output stage and
+ * goes on with the next one.
+ */
+struct prvWriter
+{
+        int fd;
+        char *buf;
+        size_t size;
+        size_t len;
+        int error;
+        struct writeQueue *queue;
+        struct prvCompressor *comp;
+        /* takes the flushed buffers while sorting, see sortRecords.h */
+        struct recordSorter *sort;
+
+        /* bytes and buffers written, time spent waiting for the output */
+        uint64_t bytes;
+        uint64_t writes;
+        uint64_t wait_ns;
+        /* lines written, only counted with count_records */
+        uint64_t records;
+        bool count_records;
+};
+
+struct prvWriter *createWriter(int _fd, size_t _size);
+
+int flushWriter(struct prvWriter *_w);
+
+int writeFully(int _fd, const char *_buf, size_t _len);
+
+int setWriterCompression(struct prvWriter *_w, int _kind,
+    unsigned int _threads);
+
+int outputBuffer(int _fd, struct prvCompressor *_comp, const char *_buf,
+    size_t _len);
+
+void countRecords(struct prvWriter *_w);
+
+int closeWriter(struct prvWriter *_w);
+
+int destroyWriter(struct prvWriter *_w);
+
+int startAsyncWriter(struct prvWriter *_w, int _mode, unsigned int _depth);
+
+int queueBuffer(struct prvWriter *_w);
+
+int stopAsyncWriter(struct prvWriter *_w);
+
+uint64_t monotonicTime(void);
+
+char *formatUint(char *_p, uint64_t _val);
+
+void writeBytes(struct prvWriter *_w, const char *_data, size_t _len);
+
+static inline char *
+writerSpace(struct prvWriter *w, size_t n)
+{
+        if (w->size - w->len < n) {
+                flushWriter(w);
+        }
+
+        return w->buf + w->len;
+}
+
+static inline void
+writeChar(struct prvWriter *w, char c)
+{
+        *writerSpace(w, 1) = c;
+        w->len++;
+}
+
+static inline void
+writeUint(struct prvWriter *w, uint64_t val)
+{
+        char *p = writerSpace(w, WRITER_INT_LEN);
+
+        w->len = formatUint(p, val) - w->buf;
+}
+
+static inline void
+writeInt(struct prvWriter *w, int64_t val)
+{
+        char *p = writerSpace(w, WRITER_INT_LEN);
+
+        if (val < 0) {
+                *p++ = '-';
+                w->len = formatUint(p, -(uint64_t) val) - w->buf;
+        } else {
+                w->len = formatUint(p, val) - w->buf;
+        }
+}
+
+/* Writes _val followed by the ':' separator of record fields */
+static inline void
+writeField(struct prvWriter *w, uint64_t val)
+{
+        writeUint(w, val);
+        writeChar(w, ':');
+}
+
+static inline void
+writeString(struct prvWriter *w, const char *s)
+{
+        writeBytes(w, s, strlen(s));
+}
+
+#endif
+
+/*
+ * Modeline for space only BSD KNF code style
+ */
+/* vim: set textwidth=80 colorcolumn=+0 tabstop=8 softtabstop=8 shiftwidth=8 expandtab cinoptions=\:0l1t0+0.5s(0.5su0.5sm1: */